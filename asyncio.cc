@@ -0,0 +1,802 @@
+/* asyncio.cc -- Asynchronous BFile I/O
+
+Copyright (C) 1997-2013, Brian Bray
+
+*/
+
+// off_t, pread() and pwrite() are 64 bit on 32 bit systems too
+#define _FILE_OFFSET_BITS 64
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bw/bwassert.h"
+#include "bw/exception.h"
+#include "bw/file.h"
+#include "bw/asyncio.h"
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <string.h>
+#include <sched.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+#if defined(IORING_FEAT_RW_CUR_POS) && defined(__NR_io_uring_setup)
+#define BW_HAVE_IO_URING
+#endif
+#endif
+
+
+namespace bw {
+
+// Compilation time options
+
+const unsigned ringEntries = 64;		// io_uring submission queue size
+const long maxTransfer = 1L<<30;		// Largest single read or write
+
+
+/*: class AsyncIO
+
+	Reads, writes and syncs of BFiles that don't block the caller.
+
+	Each request names a callback.  When the request finishes, the
+	completion is queued and fd() becomes readable; poll() then runs
+	the queued callbacks in the thread that calls it.  So a GUI (see
+	Scene::setAsyncIO()) or a server loop can start disk I/O, carry on,
+	and handle the results in its own thread without locking.
+
+	On Linux the requests go to the kernel through io_uring when it is
+	available (5.6 and later, and not disabled by a sandbox), else to a
+	small pool of worker threads using pread(), pwrite() and fsync().
+	The results are the same.
+
+	Requests may be started from any thread.  poll() and wait() should
+	be called from one thread only.
+
+	Example:
+		AsyncIO aio;
+		aio.read( file, buf, sizeof(buf), 0, [&]( const AsyncIO::Completion& c ) {
+			c.check();
+			parse( buf, c.result );
+		} );
+		...
+		aio.poll();		// When aio.fd() is readable
+*/
+
+
+/* struct AsyncRequest
+
+   One request, from submission until its callback has run.  Reads and
+   writes that the system does in pieces are continued from done.
+*/
+struct AsyncRequest {
+	AsyncIO::Op	op;
+	int		fd;
+	char*		pch;
+	long		length;
+	BFile::Offset	position;
+	long		done;
+	int		error;
+	AsyncIO::Callback	cb;
+};
+
+
+/* class AsyncEngine
+
+   What the two implementations share: the notification descriptor, the
+   count of pending requests, and running the callbacks.
+*/
+class AsyncEngine {
+public:
+	AsyncEngine();
+	virtual ~AsyncEngine();
+
+	virtual void submit( AsyncRequest* preq ) = 0;
+	virtual bool isKernelAsync() const = 0;
+
+	int poll();
+	void wait();
+
+	int fd() const {
+		return m_notifyFd;
+	}
+
+	std::atomic<int>	m_nPending;
+
+protected:
+	virtual void reap( std::deque<AsyncRequest*>& ready ) = 0;
+	void notify();
+
+	int	m_notifyFd;		// Readable while completions are waiting
+	int	m_notifyWriteFd;	// Same as m_notifyFd for an eventfd
+
+private:
+	void clearNotify();
+
+	std::deque<AsyncRequest*>	m_ready;	// Finished, callbacks not run
+};
+
+AsyncEngine::AsyncEngine()
+	: m_nPending(0),
+	  m_notifyFd(-1),
+	  m_notifyWriteFd(-1)
+{
+#ifdef __linux__
+	m_notifyFd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+	m_notifyWriteFd = m_notifyFd;
+#else
+	int fds[2];
+	if (pipe(fds)==0) {
+		fcntl( fds[0], F_SETFL, O_NONBLOCK );
+		fcntl( fds[1], F_SETFL, O_NONBLOCK );
+		m_notifyFd = fds[0];
+		m_notifyWriteFd = fds[1];
+	}
+#endif
+	if (m_notifyFd<0)
+		throw BFileException( BFileException::SystemError );
+}
+
+AsyncEngine::~AsyncEngine()
+{
+	bwassert( m_ready.empty() );
+	if (m_notifyWriteFd!=m_notifyFd)
+		::close( m_notifyWriteFd );
+	::close( m_notifyFd );
+}
+
+void AsyncEngine::notify()
+{
+	unsigned long long one = 1;
+	// Fails only if already readable
+	(void)!::write( m_notifyWriteFd, &one, m_notifyWriteFd==m_notifyFd ? 8 : 1 );
+}
+
+void AsyncEngine::clearNotify()
+{
+	char buf[64];
+	while (::read( m_notifyFd, buf, sizeof(buf) )>0)
+		;
+}
+
+/* AsyncEngine::poll()
+
+   The notification is cleared before looking for completions, so one
+   that arrives meanwhile leaves the descriptor readable.  If a callback
+   throws, the rest stay queued for the next poll().
+*/
+int AsyncEngine::poll()
+{
+	clearNotify();
+	reap( m_ready );
+
+	int n = 0;
+	while (!m_ready.empty()) {
+		std::unique_ptr<AsyncRequest> preq( m_ready.front() );
+		m_ready.pop_front();
+		--m_nPending;
+		++n;
+
+		AsyncIO::Completion c;
+		c.op = preq->op;
+		c.result = preq->done;
+		c.error = preq->error;
+		try {
+			preq->cb( c );
+		} catch (...) {
+			if (!m_ready.empty())
+				notify();
+			throw;
+		}
+	}
+	return n;
+}
+
+void AsyncEngine::wait()
+{
+	while (m_nPending>0) {
+		struct pollfd pfd;
+		pfd.fd = m_notifyFd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		if (::poll( &pfd, 1, -1 )<0 && errno!=EINTR)
+			throw BFileException( BFileException::SystemError );
+		poll();
+	}
+}
+
+
+/* class PoolEngine
+
+   Worker threads doing ordinary blocking calls.
+*/
+class PoolEngine : public AsyncEngine {
+public:
+	explicit PoolEngine( int nThreads );
+	~PoolEngine();
+
+	void submit( AsyncRequest* preq );
+	bool isKernelAsync() const {
+		return false;
+	}
+
+protected:
+	void reap( std::deque<AsyncRequest*>& ready );
+
+private:
+	void work();
+	static void perform( AsyncRequest& req );
+
+	std::mutex	m_mutex;
+	std::condition_variable	m_cv;
+	std::deque<AsyncRequest*>	m_queue;	// Waiting for a worker
+	std::deque<AsyncRequest*>	m_done;		// Waiting for reap()
+	std::vector<std::thread>	m_threads;
+	bool		m_isStopping;
+};
+
+PoolEngine::PoolEngine( int nThreads )
+	: m_isStopping(false)
+{
+	bwassert( nThreads>0 );
+	for (int i=0; i<nThreads; ++i)
+		m_threads.push_back( std::thread( &PoolEngine::work, this ) );
+}
+
+PoolEngine::~PoolEngine()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_isStopping = true;
+	}
+	m_cv.notify_all();
+	for (size_t i=0; i<m_threads.size(); ++i)
+		m_threads[i].join();
+}
+
+void PoolEngine::submit( AsyncRequest* preq )
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_queue.push_back( preq );
+	}
+	m_cv.notify_one();
+}
+
+void PoolEngine::reap( std::deque<AsyncRequest*>& ready )
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	ready.insert( ready.end(), m_done.begin(), m_done.end() );
+	m_done.clear();
+}
+
+void PoolEngine::work()
+{
+	for (;;) {
+		AsyncRequest* preq;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while (m_queue.empty() && !m_isStopping)
+				m_cv.wait( lock );
+			if (m_queue.empty())
+				return;
+			preq = m_queue.front();
+			m_queue.pop_front();
+		}
+
+		perform( *preq );
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_done.push_back( preq );
+		}
+		notify();
+	}
+}
+
+void PoolEngine::perform( AsyncRequest& req )
+{
+	if (req.op==AsyncIO::Sync) {
+		if (fsync(req.fd)!=0)
+			req.error = errno;
+		return;
+	}
+
+	while (req.done<req.length) {
+		long n = req.length-req.done;
+		if (n>maxTransfer)
+			n = maxTransfer;
+		long ret;
+		if (req.op==AsyncIO::Read)
+			ret = pread( req.fd, req.pch+req.done, n, req.position+req.done );
+		else
+			ret = pwrite( req.fd, req.pch+req.done, n, req.position+req.done );
+		if (ret<0) {
+			if (errno==EINTR)
+				continue;
+			req.error = errno;
+			return;
+		}
+		if (ret==0) {
+			if (req.op==AsyncIO::Write)
+				req.error = EIO;
+			return;			// End of file
+		}
+		req.done += ret;
+	}
+}
+
+
+#ifdef BW_HAVE_IO_URING
+
+/* class UringEngine
+
+   Requests go in the io_uring submission queue; the kernel posts
+   completions in the completion queue and signals the notification
+   eventfd (registered with the ring).  The rings are shared memory,
+   indexed by free running head and tail counters.
+
+   No more requests are in flight than the completion queue holds, so
+   it can't overflow.  Others wait in m_backlog.
+*/
+class UringEngine : public AsyncEngine {
+public:
+	static UringEngine* create();
+	~UringEngine();
+
+	void submit( AsyncRequest* preq );
+	bool isKernelAsync() const {
+		return true;
+	}
+
+protected:
+	void reap( std::deque<AsyncRequest*>& ready );
+
+private:
+	UringEngine();
+	bool setup();
+	bool queue( AsyncRequest* preq );
+	void enter();
+
+	std::mutex	m_mutex;
+	int		m_ringFd;
+	void*		m_pSqRing;
+	size_t		m_sqRingSize;
+	void*		m_pCqRing;
+	size_t		m_cqRingSize;
+	struct io_uring_sqe*	m_psqes;
+	size_t		m_sqesSize;
+
+	unsigned*	m_psqTail;
+	unsigned	m_sqMask;
+	unsigned*	m_psqArray;
+	unsigned*	m_pcqHead;
+	unsigned*	m_pcqTail;
+	unsigned	m_cqMask;
+	struct io_uring_cqe*	m_pcqes;
+
+	unsigned	m_nSqEntries;
+	unsigned	m_nInFlight;		// Queued and not yet reaped
+	unsigned	m_nMaxInFlight;
+	unsigned	m_nUnsubmitted;		// Queued but not yet given to the kernel
+	std::deque<AsyncRequest*>	m_backlog;
+};
+
+UringEngine::UringEngine()
+	: m_ringFd(-1),
+	  m_pSqRing(MAP_FAILED),
+	  m_sqRingSize(0),
+	  m_pCqRing(MAP_FAILED),
+	  m_cqRingSize(0),
+	  m_psqes((struct io_uring_sqe*)MAP_FAILED),
+	  m_sqesSize(0),
+	  m_nSqEntries(0),
+	  m_nInFlight(0),
+	  m_nMaxInFlight(0),
+	  m_nUnsubmitted(0)
+{}
+
+/* UringEngine::create()
+
+   Returns 0 if the kernel doesn't have (or won't allow) io_uring.
+*/
+UringEngine* UringEngine::create()
+{
+	std::unique_ptr<UringEngine> pue( new UringEngine() );
+	if (!pue->setup())
+		return 0;
+	return pue.release();
+}
+
+bool UringEngine::setup()
+{
+	struct io_uring_params p;
+	memset( &p, 0, sizeof(p) );
+	m_ringFd = syscall( __NR_io_uring_setup, ringEntries, &p );
+	if (m_ringFd<0)
+		return false;
+	if (!(p.features & IORING_FEAT_RW_CUR_POS))
+		return false;			// Older than IORING_OP_READ/WRITE
+
+	m_sqRingSize = p.sq_off.array + p.sq_entries*sizeof(unsigned);
+	m_cqRingSize = p.cq_off.cqes + p.cq_entries*sizeof(struct io_uring_cqe);
+	bool isSingle = (p.features & IORING_FEAT_SINGLE_MMAP)!=0;
+	if (isSingle && m_cqRingSize>m_sqRingSize)
+		m_sqRingSize = m_cqRingSize;
+
+	m_pSqRing = mmap( 0, m_sqRingSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+	                  m_ringFd, IORING_OFF_SQ_RING );
+	if (m_pSqRing==MAP_FAILED)
+		return false;
+	if (!isSingle) {
+		m_pCqRing = mmap( 0, m_cqRingSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+		                  m_ringFd, IORING_OFF_CQ_RING );
+		if (m_pCqRing==MAP_FAILED)
+			return false;
+	}
+	m_sqesSize = p.sq_entries*sizeof(struct io_uring_sqe);
+	m_psqes = (struct io_uring_sqe*)mmap( 0, m_sqesSize, PROT_READ|PROT_WRITE,
+	                                      MAP_SHARED|MAP_POPULATE, m_ringFd, IORING_OFF_SQES );
+	if (m_psqes==MAP_FAILED)
+		return false;
+
+	char* psq = (char*)m_pSqRing;
+	char* pcq = isSingle ? psq : (char*)m_pCqRing;
+	m_psqTail = (unsigned*)(psq+p.sq_off.tail);
+	m_sqMask = *(unsigned*)(psq+p.sq_off.ring_mask);
+	m_psqArray = (unsigned*)(psq+p.sq_off.array);
+	m_pcqHead = (unsigned*)(pcq+p.cq_off.head);
+	m_pcqTail = (unsigned*)(pcq+p.cq_off.tail);
+	m_cqMask = *(unsigned*)(pcq+p.cq_off.ring_mask);
+	m_pcqes = (struct io_uring_cqe*)(pcq+p.cq_off.cqes);
+	m_nSqEntries = p.sq_entries;
+	m_nMaxInFlight = p.cq_entries;
+
+	return syscall( __NR_io_uring_register, m_ringFd, IORING_REGISTER_EVENTFD,
+	                &m_notifyFd, 1 )==0;
+}
+
+UringEngine::~UringEngine()
+{
+	if (m_psqes!=MAP_FAILED)
+		munmap( m_psqes, m_sqesSize );
+	if (m_pCqRing!=MAP_FAILED)
+		munmap( m_pCqRing, m_cqRingSize );
+	if (m_pSqRing!=MAP_FAILED)
+		munmap( m_pSqRing, m_sqRingSize );
+	if (m_ringFd>=0)
+		::close( m_ringFd );
+}
+
+/* UringEngine::queue()
+
+   Adds a submission queue entry for the rest of a request.  Requires
+   the lock, and room in the completion queue.  Only this process moves
+   the submission tail, and the kernel consumes entries when they are
+   submitted by enter(), so with fewer than m_nSqEntries unsubmitted the
+   slot at the tail is free.
+
+   Returns false if the submission queue is full and enter() couldn't
+   empty it (the kernel was short of resources).  The request is then
+   left to the caller to keep in m_backlog until the next reap.
+*/
+bool UringEngine::queue( AsyncRequest* preq )
+{
+	if (m_nUnsubmitted==m_nSqEntries) {
+		enter();
+		if (m_nUnsubmitted==m_nSqEntries)
+			return false;
+	}
+
+	unsigned tail = *m_psqTail;
+	unsigned index = tail & m_sqMask;
+	struct io_uring_sqe* psqe = &m_psqes[index];
+	memset( psqe, 0, sizeof(*psqe) );
+
+	psqe->fd = preq->fd;
+	psqe->user_data = (unsigned long long)(size_t)preq;
+	if (preq->op==AsyncIO::Sync)
+		psqe->opcode = IORING_OP_FSYNC;
+	else {
+		long n = preq->length-preq->done;
+		if (n>maxTransfer)
+			n = maxTransfer;
+		psqe->opcode = preq->op==AsyncIO::Read ? IORING_OP_READ : IORING_OP_WRITE;
+		psqe->addr = (unsigned long long)(size_t)(preq->pch+preq->done);
+		psqe->len = n;
+		psqe->off = preq->position+preq->done;
+	}
+
+	m_psqArray[index] = index;
+	__atomic_store_n( m_psqTail, tail+1, __ATOMIC_RELEASE );
+	++m_nInFlight;
+	++m_nUnsubmitted;
+	return true;
+}
+
+/* UringEngine::enter()
+
+   Hands the queued entries to the kernel.  Requires the lock.  If the
+   kernel is short of resources, the entries are left for the next call
+   (from the next reap) unless nothing else is in flight.
+*/
+void UringEngine::enter()
+{
+	while (m_nUnsubmitted>0) {
+		int ret = syscall( __NR_io_uring_enter, m_ringFd, m_nUnsubmitted, 0, 0, 0, 0 );
+		if (ret<0) {
+			if (errno==EINTR)
+				continue;
+			if (errno==EAGAIN || errno==EBUSY) {
+				if (m_nInFlight>m_nUnsubmitted)
+					return;
+				sched_yield();
+				continue;
+			}
+			throw BFileException( BFileException::SystemError );
+		}
+		m_nUnsubmitted -= ret;
+	}
+}
+
+void UringEngine::submit( AsyncRequest* preq )
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_nInFlight<m_nMaxInFlight && m_backlog.empty() && queue( preq ))
+		enter();
+	else
+		m_backlog.push_back( preq );
+}
+
+void UringEngine::reap( std::deque<AsyncRequest*>& ready )
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::vector<AsyncRequest*> again;
+
+	unsigned head = *m_pcqHead;
+	unsigned tail = __atomic_load_n( m_pcqTail, __ATOMIC_ACQUIRE );
+	for (; head!=tail; ++head) {
+		const struct io_uring_cqe& cqe = m_pcqes[head & m_cqMask];
+		AsyncRequest* preq = (AsyncRequest*)(size_t)cqe.user_data;
+		int res = cqe.res;
+		--m_nInFlight;
+
+		if (res<0) {
+			if (res==-EINTR || res==-EAGAIN)
+				again.push_back( preq );
+			else {
+				preq->error = -res;
+				ready.push_back( preq );
+			}
+		} else if (preq->op==AsyncIO::Sync)
+			ready.push_back( preq );
+		else if (res==0) {
+			if (preq->op==AsyncIO::Write)
+				preq->error = EIO;
+			ready.push_back( preq );	// End of file
+		} else {
+			preq->done += res;
+			if (preq->done<preq->length)
+				again.push_back( preq );	// Done in pieces
+			else
+				ready.push_back( preq );
+		}
+	}
+	__atomic_store_n( m_pcqHead, head, __ATOMIC_RELEASE );
+
+	// Continue pieces first, then start waiting requests
+	for (size_t i=0; i<again.size(); ++i)
+		m_backlog.push_front( again[again.size()-1-i] );
+	while (!m_backlog.empty() && m_nInFlight<m_nMaxInFlight && queue( m_backlog.front() ))
+		m_backlog.pop_front();
+	enter();
+}
+
+#endif	// BW_HAVE_IO_URING
+
+
+/*: AsyncIO::Completion::check()
+
+	Throws: BFileException (SystemError) if the request failed, with
+	its errno value.
+*/
+void AsyncIO::Completion::check() const
+{
+	if (error!=0) {
+		errno = error;
+		throw BFileException( BFileException::SystemError );
+	}
+}
+
+/*: AsyncIO::AsyncIO()
+
+	Creates a queue with no requests.  With mode Auto io_uring is used
+	if the kernel allows it, otherwise nThreads worker threads.
+
+	Throws: BFileException if the notification descriptor can't be made
+*/
+AsyncIO::AsyncIO( Mode mode, int nThreads )
+	: m_pEngine(0)
+{
+#ifdef BW_HAVE_IO_URING
+	if (mode==Auto)
+		m_pEngine = UringEngine::create();
+#else
+	(void)mode;
+#endif
+	if (!m_pEngine)
+		m_pEngine = new PoolEngine( nThreads );
+}
+
+/*: AsyncIO::~AsyncIO()
+
+	Waits for every outstanding request and runs its callback, so that
+	no buffer is still in use.  Exceptions from callbacks are ignored.
+*/
+AsyncIO::~AsyncIO()
+{
+	while (m_pEngine->m_nPending>0) {
+		try {
+			m_pEngine->wait();
+		} catch (...) {
+		}
+	}
+	delete m_pEngine;
+}
+
+/*: AsyncIO::read()
+
+	Starts reading length bytes at position into buffer.  The file
+	position isn't used or changed.  The completion's result is less
+	than length only at end of file.
+
+	Requires: Open file.  buffer stays valid until the callback runs.
+
+	Throws: BFileException if the request can't be started
+*/
+void AsyncIO::read( const BFile& file, void* buffer, long length, BFile::Offset position,
+                    Callback cb )
+{
+	bwassert( file.isOpen() );
+	bwassert( length>=0 && position>=0 );
+
+	AsyncRequest* preq = new AsyncRequest();
+	preq->op = Read;
+	preq->fd = handleOf( file );
+	preq->pch = (char*)buffer;
+	preq->length = length;
+	preq->position = position;
+	preq->done = 0;
+	preq->error = 0;
+	preq->cb = cb;
+
+	++m_pEngine->m_nPending;
+	m_pEngine->submit( preq );
+}
+
+/*: AsyncIO::write()
+
+	Starts writing length bytes from buffer at position.  The file
+	position isn't used or changed.
+
+	Requires: File open for writing.  buffer stays valid until the
+	callback runs.
+
+	Throws: BFileException if the request can't be started
+*/
+void AsyncIO::write( BFile& file, const void* buffer, long length, BFile::Offset position,
+                     Callback cb )
+{
+	bwassert( file.isOpen() );
+	bwassert( length>=0 && position>=0 );
+
+	AsyncRequest* preq = new AsyncRequest();
+	preq->op = Write;
+	preq->fd = handleOf( file );
+	preq->pch = (char*)buffer;
+	preq->length = length;
+	preq->position = position;
+	preq->done = 0;
+	preq->error = 0;
+	preq->cb = cb;
+
+	++m_pEngine->m_nPending;
+	m_pEngine->submit( preq );
+}
+
+/*: AsyncIO::sync()
+
+	Starts an fsync() of the file.  Requests are not ordered, so wait
+	for the completion of writes that must be covered before starting
+	the sync.
+
+	Requires: Open file
+
+	Throws: BFileException if the request can't be started
+*/
+void AsyncIO::sync( BFile& file, Callback cb )
+{
+	bwassert( file.isOpen() );
+
+	AsyncRequest* preq = new AsyncRequest();
+	preq->op = Sync;
+	preq->fd = handleOf( file );
+	preq->pch = 0;
+	preq->length = 0;
+	preq->position = 0;
+	preq->done = 0;
+	preq->error = 0;
+	preq->cb = cb;
+
+	++m_pEngine->m_nPending;
+	m_pEngine->submit( preq );
+}
+
+/*: AsyncIO::poll()
+
+	Runs the callbacks of the requests that have finished, in the
+	calling thread.  Never blocks.  If a callback throws, the exception
+	is passed on and the remaining callbacks are run by the next poll().
+
+	Returns: number of callbacks run
+*/
+int AsyncIO::poll()
+{
+	return m_pEngine->poll();
+}
+
+/*: AsyncIO::wait()
+
+	Blocks until all requests have finished, running their callbacks.
+*/
+void AsyncIO::wait()
+{
+	m_pEngine->wait();
+}
+
+/*: AsyncIO::fd()
+
+	Returns a descriptor that is readable while completions are
+	waiting for poll().  Don't read from it.
+*/
+int AsyncIO::fd() const
+{
+	return m_pEngine->fd();
+}
+
+/*: AsyncIO::pending()
+
+	Returns the number of requests whose callbacks have not run yet.
+*/
+int AsyncIO::pending() const
+{
+	return m_pEngine->m_nPending;
+}
+
+/*: AsyncIO::isKernelAsync()
+
+	Indicates that requests go to the kernel through io_uring rather
+	than to worker threads.
+*/
+bool AsyncIO::isKernelAsync() const
+{
+	return m_pEngine->isKernelAsync();
+}
+
+}	// namespace bw
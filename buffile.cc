@@ -0,0 +1,331 @@
+/* buffile.cc -- buffered reading and writing of BFiles
+
+Copyright (C) 1996-2013, Brian Bray
+
+*/
+
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#include "bw/bwassert.h"
+#include "bw/exception.h"
+#include "bw/string.h"
+#include "bw/file.h"
+#include "bw/buffile.h"
+
+
+namespace bw {
+
+/*: class BFileReader
+
+	Buffered input from a BFile.
+
+	BFile goes to the operating system on every call, so reading a
+	record a field at a time costs a system call per field.  A
+	BFileReader reads the file in large chunks and hands out the bytes
+	from memory.  It adds peek(), get(), readLine() and readValue() for
+	parsing.
+
+	The BFile is not owned.  Don't use the BFile directly while a reader
+	is in use: its position is ahead of the reader's by whatever is
+	buffered.
+*/
+
+/*: BFileReader::BFileReader()
+
+	Reads from an open file, starting at its current position, using a
+	buffer of bufferSize bytes.
+*/
+BFileReader::BFileReader( BFile& file, long bufferSize )
+	: m_file(file),
+	  m_pBuffer(0),
+	  m_size(bufferSize),
+	  m_pos(0),
+	  m_end(0),
+	  m_atEof(false)
+{
+	bwassert( file.isOpen() );
+	bwassert( bufferSize>0 );
+	m_pBuffer = new char[m_size];
+}
+
+BFileReader::~BFileReader()
+{
+	delete [] m_pBuffer;
+}
+
+/* BFileReader::fill()
+
+   Refills an empty buffer.  Returns false at end of file.
+*/
+bool BFileReader::fill()
+{
+	bwassert( m_pos==m_end );
+	if (m_atEof)
+		return false;
+
+	m_pos = 0;
+	m_end = m_file.readUpTo( m_pBuffer, m_size );
+	if (m_end==0) {
+		m_atEof = true;
+		return false;
+	}
+	return true;
+}
+
+/*: BFileReader::readUpTo()
+
+	Reads up to length bytes into buffer.  Requests at least as large as
+	the buffer are read directly into the caller's buffer.
+
+	Returns: count of bytes read, less than length only at end of file
+*/
+long BFileReader::readUpTo( void* buffer, long length )
+{
+	char* pch = (char*)buffer;
+	long done = 0;
+
+	while (done<length) {
+		long n = m_end-m_pos;
+		if (n==0) {
+			if (m_atEof)
+				break;
+			if (length-done >= m_size) {
+				n = m_file.readUpTo( pch+done, length-done );
+				if (n==0) {
+					m_atEof = true;
+					break;
+				}
+				done += n;
+				continue;
+			}
+			if (!fill())
+				break;
+			n = m_end-m_pos;
+		}
+		if (n>length-done)
+			n = length-done;
+		memcpy( pch+done, m_pBuffer+m_pos, n );
+		m_pos += n;
+		done += n;
+	}
+	return done;
+}
+
+/*: BFileReader::read()
+
+	Reads length bytes into buffer.
+
+	Throws: BFileException (UnexpectedEof) if there are fewer than length
+	bytes left.
+*/
+void BFileReader::read( void* buffer, long length )
+{
+	if (readUpTo(buffer,length)!=length)
+		throw BFileException( BFileException::UnexpectedEof );
+}
+
+/*: BFileReader::readLine()
+
+	Reads text up to the next '\n' or the end of the file into line.  The
+	'\n' and a '\r' just before it are consumed but not stored.
+
+	Returns: false if there was nothing left to read.
+*/
+bool BFileReader::readLine( String& line )
+{
+	if (m_pos==m_end && !fill())
+		return false;
+
+	std::string text;		// Only used for lines that cross buffers
+	for (;;) {
+		const char* ps = m_pBuffer+m_pos;
+		const char* pnl = (const char*)memchr( ps, '\n', m_end-m_pos );
+		if (pnl) {
+			long n = pnl-ps;
+			m_pos += n+1;
+			if (text.empty()) {
+				if (n>0 && ps[n-1]=='\r')
+					--n;
+				line = String( ps, n );
+				return true;
+			}
+			text.append( ps, n );
+			break;
+		}
+		text.append( ps, m_end-m_pos );
+		m_pos = m_end;
+		if (!fill())
+			break;
+	}
+
+	long n = text.size();
+	if (n>0 && text[n-1]=='\r')
+		--n;
+	line = String( text.data(), n );
+	return true;
+}
+
+/*: BFileReader::skip()
+
+	Discards length bytes.
+
+	Throws: BFileException (UnexpectedEof) if there are fewer than length
+	bytes left.
+*/
+void BFileReader::skip( long length )
+{
+	bwassert( length>=0 );
+
+	long n = m_end-m_pos;
+	if (length<=n) {
+		m_pos += length;
+		return;
+	}
+	length -= n;
+	m_pos = m_end;
+
+	// Seek over whatever isn't buffered, but don't seek past the end
+	BFile::Offset pos = m_file.tell();
+	BFile::Offset end = m_file.seek( 0, BFile::fromEnd );
+	if (end-pos < length) {
+		m_atEof = true;
+		throw BFileException( BFileException::UnexpectedEof );
+	}
+	m_file.seek( pos+length );
+}
+
+/*: BFileReader::atEof()
+
+	Indicates that everything in the file has been read.  May read ahead
+	to find out.
+*/
+bool BFileReader::atEof()
+{
+	return m_pos==m_end && !fill();
+}
+
+/*: BFileReader::tell()
+
+	Returns the position in the file of the next byte to be read.
+*/
+BFile::Offset BFileReader::tell() const
+{
+	return m_file.tell() - (m_end-m_pos);
+}
+
+
+/*: class BFileWriter
+
+	Buffered output to a BFile.
+
+	Writes are gathered in a buffer and written to the file together
+	when the buffer fills, on flush() and on destruction.  Writes at
+	least as large as the buffer go straight to the file.
+
+	The BFile is not owned.  Flush before using the BFile directly.
+*/
+
+/*: BFileWriter::BFileWriter()
+
+	Writes to an open file, starting at its current position, using a
+	buffer of bufferSize bytes.
+*/
+BFileWriter::BFileWriter( BFile& file, long bufferSize )
+	: m_file(file),
+	  m_pBuffer(0),
+	  m_size(bufferSize),
+	  m_len(0)
+{
+	bwassert( file.isOpen() );
+	bwassert( bufferSize>0 );
+	m_pBuffer = new char[m_size];
+}
+
+/*: BFileWriter::~BFileWriter()
+
+	Flushes the buffer.  Errors are ignored; call flush() first to see
+	them.
+*/
+BFileWriter::~BFileWriter()
+{
+	try {
+		flush();
+	} catch (BException&) {
+	}
+	delete [] m_pBuffer;
+}
+
+/* BFileWriter::writeLarge()
+
+   Write that doesn't fit in the space left in the buffer.
+*/
+void BFileWriter::writeLarge( const void* buffer, long length )
+{
+	const char* pch = (const char*)buffer;
+
+	// Top up the buffer first, so writes stay buffer sized
+	if (m_len>0) {
+		long n = m_size-m_len;
+		memcpy( m_pBuffer+m_len, pch, n );
+		m_len += n;
+		pch += n;
+		length -= n;
+		flush();
+	}
+	if (length>=m_size) {
+		m_file.write( pch, length );
+		return;
+	}
+	memcpy( m_pBuffer, pch, length );
+	m_len = length;
+}
+
+/*: BFileWriter::writeLine()
+
+	Writes psz followed by '\n'.
+*/
+void BFileWriter::writeLine( const char* psz )
+{
+	write( psz, strlen(psz) );
+	put( '\n' );
+}
+
+/*: BFileWriter::flush()
+
+	Writes everything buffered to the file.
+
+	Throws: BFileException if the write fails.  The buffered data is
+	discarded.
+*/
+void BFileWriter::flush()
+{
+	if (m_len==0)
+		return;
+	long len = m_len;
+	m_len = 0;
+	m_file.write( m_pBuffer, len );
+}
+
+/*: BFileWriter::commit()
+
+	Flushes and then commits the file to the device.
+*/
+void BFileWriter::commit()
+{
+	flush();
+	m_file.commit();
+}
+
+/*: BFileWriter::tell()
+
+	Returns the position in the file of the next byte to be written.
+*/
+BFile::Offset BFileWriter::tell() const
+{
+	return m_file.tell() + m_len;
+}
+
+}	// namespace bw
+
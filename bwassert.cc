@@ -108,6 +108,7 @@ void BAssert::doassert( const char* msg, const char* fileName,
 	std::string s = std::string("Internal error at ") + fileName + ": " + std::to_string(lineNum) + " Failed assertion \"" + msg + "\"";
 
 	if ( isFatal ) {
+		BTraceRing::dump();		// Recent trace output, if the trace ring is in use
 		throw BDebugException( s.c_str() );
 	} else {
 		std::cerr << s << endl;
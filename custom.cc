@@ -13,12 +13,20 @@ Copyright (C) 1997-2013, Brian Bray
 #include <sstream>
 #include <fstream>
 #include <list>
-#include <map>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
 #include "bw/bwassert.h"
 #include "bw/string.h"
+#include "bw/ustring.h"
+#include "bw/hashmap.h"
 #include "bw/custom.h"
 #include "bw/exception.h"
 #include "bw/process.h"
+#include <atomic>
+#include <chrono>
+#include "bw/metrics.h"
 
 
 namespace bw {
@@ -350,12 +358,10 @@ bool CustomFile::isWritable() const
 
 const String* CustomFile::locate( const String& strCategory, const String& strKey ) const
 {
-	using std::map;
-
 	ValType::const_iterator iter = m_val.find(strCategory);
 	if (iter!=m_val.end()) {
-		const map< String, String> &sect = (*iter).second;
-		map< String, String>::const_iterator jter;
+		const StringMap<String> &sect = (*iter).second;
+		StringMap<String>::const_iterator jter;
 		jter = sect.find(strKey);
 		if (jter!=sect.end())
 			return &(*jter).second;
@@ -421,6 +427,7 @@ std::list<String> CustomFile::getCategories() const
 
 	for (iter=m_val.begin(); iter!=m_val.end(); ++iter)
 		res.push_back((*iter).first);
+	res.sort();
 
 	return res;
 }
@@ -428,21 +435,22 @@ std::list<String> CustomFile::getCategories() const
 
 std::list<String> CustomFile::getKeys( const String& strCategory ) const
 {
-	using std::map;
-
 	std::list<String> res;
 	ValType::const_iterator iter = m_val.find(strCategory);
 	if (iter!=m_val.end()) {
-		const map< String, String> &sect = (*iter).second;
-		map< String, String>::const_iterator jter;
+		const StringMap<String> &sect = (*iter).second;
+		StringMap<String>::const_iterator jter;
 
 		for (jter=sect.begin(); jter!=sect.end(); ++jter)
 			res.push_back((*jter).first);
 	}
+	res.sort();
 
 	return res;
 }
 
+static MetricHistogram s_syncTime( "bw_custom_sync_seconds", "Time to write a CustomFile" );
+
 /* CustomFile::sync()
 
    Writes change(s) back to file.
@@ -454,13 +462,14 @@ void CustomFile::sync()
 
 	using std::ofstream;
 	using std::ios;
-	using std::map;
+	using std::list;
 	using std::ostringstream;
 	using std::ends;
 
 	if (!m_isWritable)
 		return;			// Don't even try
 
+	MetricTimer mt( s_syncTime );
 	ofstream ost;
 	ostringstream tempname;
 	tempname << m_fname << "~~" << ::getpid() << ends;;
@@ -468,17 +477,21 @@ void CustomFile::sync()
 	// If it's not open yet, assume old file problem
 	ost.open( tempname.str().c_str(), ios::out|ios::trunc );
 
-	ValType::const_iterator iter;
+	// The tables are unordered, write sections and keys sorted so that
+	// the file doesn't shuffle on every change.
+	list<String> cats = getCategories();
+	list<String>::const_iterator iter;
 
-	for (iter=m_val.begin(); iter!=m_val.end(); ++iter) {
-		if ((*iter).first!="")
-			ost << "\n[" << (*iter).first << "]\n";
+	for (iter=cats.begin(); iter!=cats.end(); ++iter) {
+		if (*iter!="")
+			ost << "\n[" << *iter << "]\n";
 
-		const map< String, String> &sect = (*iter).second;
-		map< String, String>::const_iterator jter;
+		const StringMap<String> &sect = (*m_val.find(*iter)).second;
+		list<String> keys = getKeys(*iter);
+		list<String>::const_iterator jter;
 
-		for (jter=sect.begin(); jter!=sect.end(); ++jter) {
-			ost << (*jter).first << "=" << (*jter).second << "\n";
+		for (jter=keys.begin(); jter!=keys.end(); ++jter) {
+			ost << *jter << "=" << (*sect.find(*jter)).second << "\n";
 		}
 	}
 
@@ -4,6 +4,8 @@ Copyright (C) 1997-2013, Brian Bray
 
 */
 
+#include <string>
+
 #include "bw/exception.h"
 #include "bw/bwassert.h"
 #include "bw/string.h"
@@ -11,12 +13,56 @@ Copyright (C) 1997-2013, Brian Bray
 #include "bw/directory.h"
 
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <dirent.h>
-#include <fnmatch.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#ifdef SYS_getdents64
+#define BW_HAVE_GETDENTS64
+#endif
+#endif
 
 
 namespace bw {
 
+// Compilation time options
+
+const long scanBufferSize = 128*1024;	// Directory entries read per system call
+
+
+/* typeFromDirent()
+
+   The FileName::Type for a d_type value.  Returns false if the type
+   isn't known from the directory entry: the file system doesn't record
+   it, or it's a symbolic link (whose target's type is wanted).
+*/
+static bool typeFromDirent( unsigned char dtype, FileName::Type& type )
+{
+	switch (dtype) {
+	case DT_REG:
+		type = FileName::RegularFile;
+		return true;
+	case DT_DIR:
+		type = FileName::Directory;
+		return true;
+	case DT_FIFO:
+		type = FileName::Pipe;
+		return true;
+	case DT_CHR:
+	case DT_BLK:
+		type = FileName::Device;
+		return true;
+	case DT_SOCK:
+		type = FileName::NoAccess;	// Strange type, as getFileType()
+		return true;
+	default:
+		return false;			// DT_UNKNOWN, DT_LNK
+	}
+}
+
 
 /*: class Directory
 
@@ -38,6 +84,7 @@ namespace bw {
 Directory::Directory(const FileName& fnDir, const FileName& fnPattern)
 	:   m_fnDir( fnDir ),
 	    m_fnPattern( fnPattern ),
+	    m_pattern( fnPattern ),
 	    m_atEof( false )
 {
 	FileName fnFull = fnDir;
@@ -70,7 +117,7 @@ void Directory::step()
 	if (!m_atEof) {
 		m_pde = readdir((DIR*)m_pvdir);
 
-		while ( m_pde && fnmatch( m_fnPattern, m_pde->d_name, 0 ) )
+		while ( m_pde && !m_pattern.matches( m_pde->d_name ) )
 			m_pde = readdir((DIR*)m_pvdir);
 
 		if (m_pde) {
@@ -148,12 +195,233 @@ void Directory::rewind()
   Returns the file type of the currect search result.
   The result is described under FileName::getFileType().
   FileName::NoAccess is returned on errors or atEof().  This routine is
-  provided because it is faster than getFileType() on some platforms (since
-  the directory holds this information).
+  provided because it is faster than getFileType() (since the directory
+  usually holds this information).
 */
 FileName::Type Directory::getType() const
 {
-	return m_fnResult.getFileType();  // Not faster on POSIX
+	FileName::Type type = FileName::NoAccess;
+	if (!m_atEof && typeFromDirent( m_pde->d_type, type ))
+		return type;
+	return m_fnResult.getFileType();
+}
+
+
+/*: class DirectoryScan
+
+  Enumerates the entries of a directory, for directories too large for
+  Directory to be quick.  On Linux the entries are read with
+  getdents64() many at a time, the pattern is compiled once (see
+  FilePattern), names are returned in place without making a FileName,
+  and getType() uses the type recorded in the directory entry.  A file
+  is only stat'ed if the file system doesn't record types, or for a
+  symbolic link.
+
+  Errors reading the directory end the enumeration, as for Directory.
+
+  Example:
+	DirectoryScan ds( "/var/spool/in", "*.msg" );
+	while (ds.next()) {
+		if (ds.getType()==FileName::RegularFile)
+			queue( ds.name() );
+	}
+*/
+
+/*: DirectoryScan::DirectoryScan()
+
+  Opens the directory fnDir to enumerate the entries matching fnPattern.
+  If the directory can't be opened, nothing is found.
+
+  Prototype: DirectoryScan(const FileName& fnDir, const FileName& fnPattern="*")
+*/
+DirectoryScan::DirectoryScan(const FileName& fnDir, const FileName& fnPattern)
+	:   m_fnDir( fnDir ),
+	    m_pattern( fnPattern ),
+	    m_fd( -1 ),
+	    m_pvdir( 0 ),
+	    m_pBuffer( 0 ),
+	    m_pos( 0 ),
+	    m_end( 0 ),
+	    m_pszName( 0 ),
+	    m_dtype( DT_UNKNOWN )
+{
+	m_fd = open( (const char*)fnDir, O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+	if (m_fd<0)
+		return;
+
+#ifdef BW_HAVE_GETDENTS64
+	m_pBuffer = new char[scanBufferSize];
+#else
+	m_pvdir = fdopendir( m_fd );
+	if (!m_pvdir) {
+		close( m_fd );
+		m_fd = -1;
+	}
+#endif
+}
+
+/* DirectoryScan::~DirectoryScan()
+
+   Destructor.
+*/
+DirectoryScan::~DirectoryScan()
+{
+	delete [] m_pBuffer;
+	if (m_pvdir)
+		closedir( (DIR*)m_pvdir );	// Also closes m_fd
+	else if (m_fd>=0)
+		close( m_fd );
+}
+
+#ifdef BW_HAVE_GETDENTS64
+
+// The record returned by getdents64()
+struct LinuxDirent64 {
+	unsigned long long	d_ino;
+	long long		d_off;
+	unsigned short		d_reclen;
+	unsigned char		d_type;
+	char			d_name[1];
+};
+
+/* DirectoryScan::fill()
+
+   Reads the next batch of entries.  Returns false at the end (or on
+   errors).
+*/
+bool DirectoryScan::fill()
+{
+	long ret = syscall( SYS_getdents64, m_fd, m_pBuffer, scanBufferSize );
+	if (ret<=0)
+		return false;
+	m_pos = 0;
+	m_end = ret;
+	return true;
+}
+
+#else
+
+bool DirectoryScan::fill()
+{
+	return false;
+}
+
+#endif
+
+/*: DirectoryScan::next()
+
+  Advances to the next entry matching the pattern, other than "." and
+  "..".  The first call finds the first entry.
+
+  Returns: false if there are no more entries
+*/
+bool DirectoryScan::next()
+{
+	m_pszName = 0;
+	if (m_fd<0)
+		return false;
+
+	for (;;) {
+		const char* psz;
+		unsigned char dtype;
+#ifdef BW_HAVE_GETDENTS64
+		if (m_pos>=m_end && !fill())
+			return false;
+		const LinuxDirent64* pde = (const LinuxDirent64*)(m_pBuffer+m_pos);
+		m_pos += pde->d_reclen;
+		psz = pde->d_name;
+		dtype = pde->d_type;
+#else
+		const dirent* pde = readdir( (DIR*)m_pvdir );
+		if (!pde)
+			return false;
+		psz = pde->d_name;
+		dtype = pde->d_type;
+#endif
+		if (psz[0]=='.' && (psz[1]=='\0' || (psz[1]=='.' && psz[2]=='\0')))
+			continue;
+		if (!m_pattern.matches( psz ))
+			continue;
+
+		m_pszName = psz;
+		m_dtype = dtype;
+		return true;
+	}
+}
+
+/*: DirectoryScan::fileName()
+
+  Returns the directory and name of the current entry.
+*/
+FileName DirectoryScan::fileName() const
+{
+	bwassert( m_pszName );
+	FileName fn = m_fnDir;
+	fn.append( m_pszName );
+	return fn;
+}
+
+/*: DirectoryScan::getType()
+
+  Returns the type of the current entry, as FileName::getFileType()
+  would.  NoAccess is returned on errors.
+*/
+FileName::Type DirectoryScan::getType()
+{
+	bwassert( m_pszName );
+
+	FileName::Type type = FileName::NoAccess;
+	if (typeFromDirent( m_dtype, type ))
+		return type;
+
+	struct stat bStat;
+	if (fstatat( m_fd, m_pszName, &bStat, 0 )==0) {
+		if (S_ISREG(bStat.st_mode))
+			return FileName::RegularFile;
+		if (S_ISDIR(bStat.st_mode))
+			return FileName::Directory;
+		if (S_ISFIFO(bStat.st_mode))
+			return FileName::Pipe;
+		if (S_ISCHR(bStat.st_mode) || S_ISBLK(bStat.st_mode))
+			return FileName::Device;
+	}
+	return FileName::NoAccess;
+}
+
+/*: DirectoryScan::isSubdirectory()
+
+  Indicates that the current entry is a directory.  Unlike getType(),
+  symbolic links are not followed, so a tree can be walked without
+  loops.
+*/
+bool DirectoryScan::isSubdirectory()
+{
+	bwassert( m_pszName );
+
+	if (m_dtype!=DT_UNKNOWN)
+		return m_dtype==DT_DIR;
+
+	struct stat bStat;
+	return fstatat( m_fd, m_pszName, &bStat, AT_SYMLINK_NOFOLLOW )==0 &&
+	       S_ISDIR(bStat.st_mode);
+}
+
+/*: DirectoryScan::rewind()
+
+  Restarts the enumeration from the beginning.
+*/
+void DirectoryScan::rewind()
+{
+	m_pszName = 0;
+	if (m_fd<0)
+		return;
+#ifdef BW_HAVE_GETDENTS64
+	lseek( m_fd, 0, SEEK_SET );
+	m_pos = 0;
+	m_end = 0;
+#else
+	rewinddir( (DIR*)m_pvdir );
+#endif
 }
 
 }   // namespace
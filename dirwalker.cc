@@ -0,0 +1,435 @@
+/* dirwalker.cc -- parallel walk of a directory tree
+
+Copyright (C) 1997-2013, Brian Bray
+
+*/
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bw/exception.h"
+#include "bw/bwassert.h"
+#include "bw/string.h"
+#include "bw/filename.h"
+#include "bw/directory.h"
+#include "bw/dirwalker.h"
+
+
+namespace bw {
+
+// Compilation time options
+
+const int defaultQueueSize = 4096;	// Entries found but not yet taken
+
+
+/*: class DirectoryWalker
+
+  Lists every entry in a directory tree.  Directories are read by a pool
+  of threads with DirectoryScan (so mostly without a stat per entry),
+  and the entries found are passed to the caller through a bounded
+  queue: the workers wait if the caller falls behind.
+
+  Each worker keeps the directories it finds in its own deque and reads
+  the most recent first, which keeps its memory local and the deques
+  short.  A worker with nothing to do steals the oldest directory from
+  another, which is usually near the top of the tree and so carries the
+  most work with it.
+
+  Symbolic links to directories are listed but not followed.
+  Directories that can't be read are listed but contribute nothing.
+
+  Paths are built in a buffer per worker and copied into queue slots
+  whose strings are kept from use to use; next() swaps strings with the
+  caller's Entry.  So once the buffers have grown to the longest path,
+  the only allocations are one per directory.
+
+  Example:
+	DirectoryWalker dw( "/var/spool" );
+	dw.setPattern( "*.msg" );
+	dw.setTypes( DirectoryWalker::typeBit(FileName::RegularFile) );
+	DirectoryWalker::Entry e;
+	while (dw.next(e))
+		process( e.path );
+*/
+
+struct WalkJob {
+	std::string	path;
+	int		depth;
+};
+
+struct WalkWorker {
+	std::mutex		mutex;
+	std::deque<WalkJob>	jobs;	// Own end is the back, thieves take the front
+	std::thread		thread;
+};
+
+class WalkerState {
+public:
+	WalkerState( const FileName& fnRoot, int nThreads );
+
+	void start();
+	void stop();
+	bool next( DirectoryWalker::Entry& entry );
+
+	// Settings
+	std::string	root;
+	int		nThreads;
+	FilePattern	pattern;
+	unsigned	typeMask;
+	DirectoryWalker::PruneFn	prune;
+	int		queueSize;
+	bool		isStarted;
+
+private:
+	void work( int iWorker );
+	bool takeJob( int iWorker, WalkJob& job );
+	void pushJob( int iWorker, const std::string& path, int depth );
+	void scan( int iWorker, const WalkJob& job, std::string& path );
+	bool emit( const std::string& path, size_t nameOffset, FileName::Type type, int depth );
+
+	std::vector<std::unique_ptr<WalkWorker>>	m_workers;
+	std::atomic<bool>	m_isStopping;
+
+	// Directories queued or being read; the walk ends when it reaches zero
+	std::atomic<long>	m_nOutstanding;
+
+	// For idle workers to wait for new directories
+	std::mutex		m_idleMutex;
+	std::condition_variable	m_idleCv;
+	unsigned long		m_generation;	// Changes when a directory is queued
+
+	// Results, a ring of reused entries
+	std::mutex		m_queueMutex;
+	std::condition_variable	m_notEmpty;
+	std::condition_variable	m_notFull;
+	std::vector<DirectoryWalker::Entry>	m_slots;
+	size_t			m_head;
+	size_t			m_count;
+	int			m_nRunning;	// Workers not yet finished
+};
+
+WalkerState::WalkerState( const FileName& fnRoot, int nThreads_ )
+	:   root( (const char*)fnRoot ),
+	    nThreads( nThreads_ ),
+	    pattern( "*" ),
+	    typeMask( ~0u ),
+	    queueSize( defaultQueueSize ),
+	    isStarted( false ),
+	    m_isStopping( false ),
+	    m_nOutstanding( 0 ),
+	    m_generation( 0 ),
+	    m_head( 0 ),
+	    m_count( 0 ),
+	    m_nRunning( 0 )
+{
+	bwassert( nThreads>0 );
+	if (root.empty())
+		root = ".";
+}
+
+void WalkerState::start()
+{
+	bwassert( !isStarted );
+	isStarted = true;
+
+	m_slots.resize( queueSize );
+	for (int i=0; i<nThreads; ++i)
+		m_workers.push_back( std::unique_ptr<WalkWorker>( new WalkWorker() ) );
+
+	m_nOutstanding = 1;
+	WalkJob job;
+	job.path = root;
+	job.depth = 0;
+	m_workers[0]->jobs.push_back( job );
+
+	m_nRunning = nThreads;
+	for (int i=0; i<nThreads; ++i)
+		m_workers[i]->thread = std::thread( &WalkerState::work, this, i );
+}
+
+void WalkerState::stop()
+{
+	m_isStopping = true;
+	{
+		std::lock_guard<std::mutex> lock(m_idleMutex);
+		m_idleCv.notify_all();
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		m_notFull.notify_all();
+		m_notEmpty.notify_all();
+	}
+	for (size_t i=0; i<m_workers.size(); ++i) {
+		if (m_workers[i]->thread.joinable())
+			m_workers[i]->thread.join();
+	}
+}
+
+void WalkerState::work( int iWorker )
+{
+	WalkJob job;
+	std::string path;		// Reused for every entry
+	while (takeJob( iWorker, job )) {
+		scan( iWorker, job, path );
+		if (--m_nOutstanding==0) {
+			std::lock_guard<std::mutex> lock(m_idleMutex);
+			m_idleCv.notify_all();
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(m_queueMutex);
+	if (--m_nRunning==0)
+		m_notEmpty.notify_all();
+}
+
+/* WalkerState::takeJob()
+
+   Finds a directory to read: the newest of the worker's own, else the
+   oldest of another worker's.  Waits if there are none, until one is
+   queued or the walk is over.  The generation is noted before looking,
+   so a directory queued meanwhile isn't missed.
+
+   Returns: false when the walk is over
+*/
+bool WalkerState::takeJob( int iWorker, WalkJob& job )
+{
+	for (;;) {
+		unsigned long generation;
+		{
+			std::lock_guard<std::mutex> lock(m_idleMutex);
+			generation = m_generation;
+		}
+		if (m_isStopping)
+			return false;
+
+		{
+			WalkWorker& w = *m_workers[iWorker];
+			std::lock_guard<std::mutex> lock(w.mutex);
+			if (!w.jobs.empty()) {
+				job.path.swap( w.jobs.back().path );
+				job.depth = w.jobs.back().depth;
+				w.jobs.pop_back();
+				return true;
+			}
+		}
+		for (int i=1; i<nThreads; ++i) {
+			WalkWorker& w = *m_workers[(iWorker+i) % nThreads];
+			std::lock_guard<std::mutex> lock(w.mutex);
+			if (!w.jobs.empty()) {
+				job.path.swap( w.jobs.front().path );
+				job.depth = w.jobs.front().depth;
+				w.jobs.pop_front();
+				return true;
+			}
+		}
+
+		std::unique_lock<std::mutex> lock(m_idleMutex);
+		while (generation==m_generation && m_nOutstanding>0 && !m_isStopping)
+			m_idleCv.wait( lock );
+		if (m_nOutstanding==0)
+			return false;
+	}
+}
+
+void WalkerState::pushJob( int iWorker, const std::string& path, int depth )
+{
+	++m_nOutstanding;
+	{
+		WalkWorker& w = *m_workers[iWorker];
+		std::lock_guard<std::mutex> lock(w.mutex);
+		w.jobs.push_back( WalkJob() );
+		w.jobs.back().path = path;
+		w.jobs.back().depth = depth;
+	}
+	std::lock_guard<std::mutex> lock(m_idleMutex);
+	++m_generation;
+	m_idleCv.notify_one();
+}
+
+/* WalkerState::scan()
+
+   Reads one directory, queueing its subdirectories and listing the
+   entries that pass the filters.
+*/
+void WalkerState::scan( int iWorker, const WalkJob& job, std::string& path )
+{
+	DirectoryScan ds( job.path.c_str() );
+	int depth = job.depth+1;
+
+	path = job.path;
+	if (path[path.size()-1]!='/')
+		path += '/';
+	size_t nameOffset = path.size();
+
+	while (ds.next()) {
+		if (m_isStopping)
+			return;
+
+		path.resize( nameOffset );
+		path += ds.name();
+
+		if (ds.isSubdirectory() && (!prune || prune( path.c_str(), depth )))
+			pushJob( iWorker, path, depth );
+
+		if (!pattern.matches( ds.name() ))
+			continue;
+		FileName::Type type = ds.getType();
+		if (!(typeMask & DirectoryWalker::typeBit(type)))
+			continue;
+		if (!emit( path, nameOffset, type, depth ))
+			return;
+	}
+}
+
+/* WalkerState::emit()
+
+   Copies an entry into the queue, waiting for room.  Returns false if
+   the walk was stopped.
+*/
+bool WalkerState::emit( const std::string& path, size_t nameOffset, FileName::Type type,
+                        int depth )
+{
+	std::unique_lock<std::mutex> lock(m_queueMutex);
+	while (m_count==m_slots.size() && !m_isStopping)
+		m_notFull.wait( lock );
+	if (m_isStopping)
+		return false;
+
+	DirectoryWalker::Entry& e = m_slots[(m_head+m_count) % m_slots.size()];
+	e.path.assign( path );			// Keeps the slot's buffer
+	e.nameOffset = nameOffset;
+	e.type = type;
+	e.depth = depth;
+	if (m_count++==0)
+		m_notEmpty.notify_one();
+	return true;
+}
+
+bool WalkerState::next( DirectoryWalker::Entry& entry )
+{
+	std::unique_lock<std::mutex> lock(m_queueMutex);
+	while (m_count==0 && m_nRunning>0 && !m_isStopping)
+		m_notEmpty.wait( lock );
+	if (m_count==0 || m_isStopping)
+		return false;
+
+	DirectoryWalker::Entry& e = m_slots[m_head];
+	entry.path.swap( e.path );
+	entry.nameOffset = e.nameOffset;
+	entry.type = e.type;
+	entry.depth = e.depth;
+	m_head = (m_head+1) % m_slots.size();
+	if (m_count--==m_slots.size())
+		m_notFull.notify_all();		// Every waiting worker may go on
+	return true;
+}
+
+
+/*: DirectoryWalker::DirectoryWalker()
+
+  Prepares to walk the tree below fnRoot with nThreads threads.  The
+  walk starts with the first call of next().
+*/
+DirectoryWalker::DirectoryWalker( const FileName& fnRoot, int nThreads )
+	:   m_pState( new WalkerState( fnRoot, nThreads ) )
+{}
+
+/*: DirectoryWalker::~DirectoryWalker()
+
+  Stops the walk (if running) and waits for the threads.
+*/
+DirectoryWalker::~DirectoryWalker()
+{
+	stop();
+	delete m_pState;
+}
+
+/*: DirectoryWalker::setPattern()
+
+  Lists only entries whose names match fnPattern (see FilePattern).
+  Directories that don't match are still read.
+
+  Requires: Walk not started
+*/
+void DirectoryWalker::setPattern( const FileName& fnPattern )
+{
+	bwassert( !m_pState->isStarted );
+	m_pState->pattern = FilePattern( fnPattern );
+}
+
+/*: DirectoryWalker::setTypes()
+
+  Lists only entries of the types in typeMask, made by or'ing
+  typeBit() values.  Symbolic links have the type of their target.
+
+  Requires: Walk not started
+*/
+void DirectoryWalker::setTypes( unsigned typeMask )
+{
+	bwassert( !m_pState->isStarted );
+	m_pState->typeMask = typeMask;
+}
+
+/*: DirectoryWalker::setPrune()
+
+  Sets a function called with the path and depth of each subdirectory
+  found.  If it returns false the subdirectory isn't read (it is still
+  listed if it passes the filters).  The function is called on the
+  worker threads, possibly several at once.
+
+  Requires: Walk not started
+*/
+void DirectoryWalker::setPrune( PruneFn fn )
+{
+	bwassert( !m_pState->isStarted );
+	m_pState->prune = fn;
+}
+
+/*: DirectoryWalker::setQueueSize()
+
+  Sets the number of entries that can be found before the workers wait
+  for next() to take some.
+
+  Requires: Walk not started
+*/
+void DirectoryWalker::setQueueSize( int nEntries )
+{
+	bwassert( !m_pState->isStarted );
+	bwassert( nEntries>0 );
+	m_pState->queueSize = nEntries;
+}
+
+/*: DirectoryWalker::next()
+
+  Takes the next entry found into entry, waiting for the workers if
+  necessary.  The first call starts the walk.  Strings are swapped
+  between entry and the queue, so passing the same Entry each time
+  avoids allocating.
+
+  Returns: false when the tree has been listed, or after stop()
+*/
+bool DirectoryWalker::next( Entry& entry )
+{
+	if (!m_pState->isStarted)
+		m_pState->start();
+	return m_pState->next( entry );
+}
+
+/*: DirectoryWalker::stop()
+
+  Abandons the walk and waits for the worker threads to finish.
+*/
+void DirectoryWalker::stop()
+{
+	if (m_pState->isStarted)
+		m_pState->stop();
+}
+
+}   // namespace bw
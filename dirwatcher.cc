@@ -0,0 +1,412 @@
+/* dirwatcher.cc -- notification of changes to directories
+
+Copyright (C) 1997-2013, Brian Bray
+
+*/
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "bw/exception.h"
+#include "bw/bwassert.h"
+#include "bw/string.h"
+#include "bw/filename.h"
+#include "bw/directory.h"
+#include "bw/dirwatcher.h"
+
+#include <unistd.h>
+#include <errno.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+
+namespace bw {
+
+// Compilation time options
+
+const long eventBufferSize = 64*1024;	// Bytes of events read per system call
+
+
+/*: class DirectoryWatcher
+
+  Reports changes to the contents of directories as they happen, so a
+  program following a spool does work in proportion to the changes
+  instead of rescanning the directory.
+
+  watch() adds a directory.  When fd() becomes readable, read() returns
+  the waiting events in one batch.  fd() can be multiplexed with other
+  input, e.g. with the X connection through Scene::addInput().
+
+  Events are reported for names in the watched directories:  Created,
+  Deleted, MovedFrom and MovedTo (a rename within the watched
+  directories gives both, with the same cookie) and Written (closed
+  after writing, so the file is complete).
+
+  With isRecursive, directories below the watched one are watched too,
+  including directories created or moved in later.  Anything already in
+  such a directory when its watch starts is reported as Created, since
+  it may have been put there before the watch.
+
+  If the system's event queue overflows, events are lost.  Then a
+  single Rescan event is reported for each watched directory (and the
+  recursive watches are brought up to date), and the program should
+  scan that directory once, as it would have had to without the
+  watcher.
+
+  Implemented with inotify on Linux.  Elsewhere the constructor throws.
+
+  Example:
+	DirectoryWatcher dw;
+	dw.watch( "/var/spool/in" );
+	std::vector<DirectoryWatcher::Event> events;
+	// When dw.fd() is readable
+	dw.read( events );
+*/
+
+#ifdef __linux__
+
+const unsigned watchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                           IN_CLOSE_WRITE | IN_ONLYDIR | IN_EXCL_UNLINK;
+
+// inotify gives a directory one watch descriptor however often it's
+// added, so a directory below a recursive watch that is also watched
+// itself has one WatchInfo for both.  The kernel watch is removed when
+// no root needs it any more.
+struct WatchInfo {
+	std::string	path;
+	std::map<std::string,bool>	roots;	// Directories given to watch() that cover
+						// this one, and if they cover those below it
+};
+
+class WatcherState {
+public:
+	WatcherState();
+	~WatcherState();
+
+	bool addTree( const std::string& path, const std::string& root, bool isRecursive,
+	              std::vector<DirectoryWatcher::Event>* pEvents );
+	void removeTree( const std::string& path, const std::string& root );
+	void removeRoot( std::map<int,WatchInfo>::iterator it, const std::string& root );
+	void handle( const struct inotify_event& iev, std::vector<DirectoryWatcher::Event>& events );
+
+	int		fd;
+	char*		pBuffer;
+	std::map<int,WatchInfo>		watches;	// By watch descriptor
+	std::map<std::string,bool>	roots;		// Directories given to watch(), isRecursive
+};
+
+WatcherState::WatcherState()
+	:   fd( -1 ),
+	    pBuffer( 0 )
+{
+	fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+	if (fd<0)
+		throw BFileException( BFileException::SystemError );
+	pBuffer = new char[eventBufferSize];
+}
+
+WatcherState::~WatcherState()
+{
+	delete [] pBuffer;
+	close( fd );
+}
+
+// Removes any trailing '/', so paths join the same way everywhere
+static std::string canonical( const FileName& fn )
+{
+	std::string path( (const char*)fn );
+	while (path.size()>1 && path[path.size()-1]=='/')
+		path.resize( path.size()-1 );
+	return path;
+}
+
+/* WatcherState::addTree()
+
+   Watches path for root, and if isRecursive the directories below it.
+   The contents of directories below path are reported as Created if
+   pEvents isn't 0.  Returns false if path can't be watched.
+*/
+bool WatcherState::addTree( const std::string& path, const std::string& root, bool isRecursive,
+                            std::vector<DirectoryWatcher::Event>* pEvents )
+{
+	int wd = inotify_add_watch( fd, path.c_str(), watchMask );
+	if (wd<0)
+		return false;
+	WatchInfo& wi = watches[wd];
+	wi.path = path;
+	wi.roots[root] = isRecursive;
+	if (!isRecursive)
+		return true;
+
+	DirectoryScan ds( path.c_str() );
+	std::string child;
+	while (ds.next()) {
+		child = path;
+		if (path!="/")
+			child += '/';
+		child += ds.name();
+		bool isDirectory = ds.isSubdirectory();
+		if (pEvents) {
+			DirectoryWatcher::Event ev;
+			ev.type = DirectoryWatcher::Created;
+			ev.path = child;
+			ev.isDirectory = isDirectory;
+			ev.cookie = 0;
+			pEvents->push_back( ev );
+		}
+		if (isDirectory)
+			addTree( child, root, true, pEvents );	// May have gone already
+	}
+	return true;
+}
+
+/* WatcherState::removeTree()
+
+   Stops watching path and the directories below it for root (for a
+   directory moved away, whose watches would otherwise keep the old
+   names).
+*/
+void WatcherState::removeTree( const std::string& path, const std::string& root )
+{
+	std::string prefix = path + '/';
+	std::map<int,WatchInfo>::iterator it = watches.begin();
+	while (it!=watches.end()) {
+		const std::string& p = it->second.path;
+		if (p==path || p.compare( 0, prefix.size(), prefix )==0)
+			removeRoot( it++, root );
+		else
+			++it;
+	}
+}
+
+/* WatcherState::removeRoot()
+
+   Drops root from the watch at it, and the watch if no other root
+   needs it.
+*/
+void WatcherState::removeRoot( std::map<int,WatchInfo>::iterator it, const std::string& root )
+{
+	it->second.roots.erase( root );
+	if (it->second.roots.empty()) {
+		inotify_rm_watch( fd, it->first );
+		watches.erase( it );
+	}
+}
+
+void WatcherState::handle( const struct inotify_event& iev,
+                           std::vector<DirectoryWatcher::Event>& events )
+{
+	std::map<int,WatchInfo>::iterator it = watches.find( iev.wd );
+	if (it==watches.end())
+		return;				// Removed by unwatch() or removeTree()
+	if (iev.mask & IN_IGNORED) {
+		watches.erase( it );		// Directory deleted
+		return;
+	}
+
+	DirectoryWatcher::Event ev;
+	if (iev.mask & IN_CREATE)
+		ev.type = DirectoryWatcher::Created;
+	else if (iev.mask & IN_DELETE)
+		ev.type = DirectoryWatcher::Deleted;
+	else if (iev.mask & IN_MOVED_FROM)
+		ev.type = DirectoryWatcher::MovedFrom;
+	else if (iev.mask & IN_MOVED_TO)
+		ev.type = DirectoryWatcher::MovedTo;
+	else if (iev.mask & IN_CLOSE_WRITE)
+		ev.type = DirectoryWatcher::Written;
+	else
+		return;
+
+	WatchInfo wi = it->second;		// addTree() and removeTree() change the map
+	ev.path = wi.path;
+	if (iev.len>0 && iev.name[0]) {
+		if (wi.path!="/")
+			ev.path += '/';
+		ev.path += iev.name;
+	}
+	ev.isDirectory = (iev.mask & IN_ISDIR)!=0;
+	ev.cookie = iev.cookie;
+	events.push_back( ev );
+
+	if (!ev.isDirectory)
+		return;
+	std::vector<DirectoryWatcher::Event>* pEvents = &events;	// Contents reported once
+	std::map<std::string,bool>::const_iterator itRoot;
+	for (itRoot=wi.roots.begin(); itRoot!=wi.roots.end(); ++itRoot) {
+		if (!itRoot->second)
+			continue;
+		if (ev.type==DirectoryWatcher::Created || ev.type==DirectoryWatcher::MovedTo) {
+			addTree( ev.path, itRoot->first, true, pEvents );
+			pEvents = 0;
+		} else if (ev.type==DirectoryWatcher::MovedFrom)
+			removeTree( ev.path, itRoot->first );
+	}
+}
+
+
+/*: DirectoryWatcher::DirectoryWatcher()
+
+  Creates a watcher with no directories.
+
+  Throws: BFileException if the system won't provide one (eg: too many
+  in use)
+*/
+DirectoryWatcher::DirectoryWatcher()
+	:   m_pState( new WatcherState() )
+{}
+
+/*: DirectoryWatcher::~DirectoryWatcher()
+
+  Stops all watches.
+*/
+DirectoryWatcher::~DirectoryWatcher()
+{
+	delete m_pState;
+}
+
+/*: DirectoryWatcher::watch()
+
+  Starts reporting changes in the directory fnDir.  With isRecursive
+  the directories below it are watched too, and directories later
+  created in or moved into the tree are added as they appear.  Watches
+  may overlap (eg: a directory inside a recursive watch); each stays
+  until it is unwatched.  Watching a directory again replaces its watch.
+
+  Throws: BFileException if fnDir doesn't exist, isn't a directory, or
+  the system limit on watches has been reached
+*/
+void DirectoryWatcher::watch( const FileName& fnDir, bool isRecursive )
+{
+	std::string path = canonical( fnDir );
+	if (m_pState->roots.count( path ))
+		unwatch( fnDir );
+	if (!m_pState->addTree( path, path, isRecursive, 0 ))
+		throw BFileException( BFileException::SystemError );
+	m_pState->roots[path] = isRecursive;
+}
+
+/*: DirectoryWatcher::unwatch()
+
+  Stops reporting changes for a directory given to watch() (and those
+  below it, if the watch was recursive).  Events already read by the
+  system but not by read() are dropped.
+*/
+void DirectoryWatcher::unwatch( const FileName& fnDir )
+{
+	std::string path = canonical( fnDir );
+	m_pState->roots.erase( path );
+
+	std::map<int,WatchInfo>& watches = m_pState->watches;
+	std::map<int,WatchInfo>::iterator it = watches.begin();
+	while (it!=watches.end()) {
+		if (it->second.roots.count( path ))
+			m_pState->removeRoot( it++, path );
+		else
+			++it;
+	}
+}
+
+/*: DirectoryWatcher::fd()
+
+  Returns a descriptor that is readable while there are events for
+  read().  Don't read from it directly.
+*/
+int DirectoryWatcher::fd() const
+{
+	return m_pState->fd;
+}
+
+/*: DirectoryWatcher::read()
+
+  Appends all waiting events to events, without blocking.  If the
+  system dropped events, a Rescan event is added for each watched
+  directory.
+
+  Returns: number of events appended (0 if there were none)
+
+  Throws: BFileException on system errors
+*/
+int DirectoryWatcher::read( std::vector<Event>& events )
+{
+	size_t nBefore = events.size();
+	bool isOverflow = false;
+
+	for (;;) {
+		long len = ::read( m_pState->fd, m_pState->pBuffer, eventBufferSize );
+		if (len<0) {
+			if (errno==EINTR)
+				continue;
+			if (errno==EAGAIN)
+				break;
+			throw BFileException( BFileException::SystemError );
+		}
+
+		for (long pos=0; pos<len; ) {
+			const struct inotify_event& iev = *(const struct inotify_event*)(m_pState->pBuffer+pos);
+			pos += sizeof(struct inotify_event)+iev.len;
+			if (iev.mask & IN_Q_OVERFLOW)
+				isOverflow = true;
+			else
+				m_pState->handle( iev, events );
+		}
+	}
+
+	if (isOverflow) {
+		std::map<std::string,bool>::const_iterator it;
+		for (it=m_pState->roots.begin(); it!=m_pState->roots.end(); ++it) {
+			Event ev;
+			ev.type = Rescan;
+			ev.path = it->first;
+			ev.isDirectory = true;
+			ev.cookie = 0;
+			events.push_back( ev );
+
+			// Catch up with directories created while events were lost
+			if (it->second)
+				m_pState->addTree( it->first, it->first, true, 0 );
+		}
+	}
+
+	return events.size()-nBefore;
+}
+
+#else	// Not Linux
+
+class WatcherState {
+};
+
+DirectoryWatcher::DirectoryWatcher()
+	:   m_pState( 0 )
+{
+	errno = ENOSYS;
+	throw BFileException( BFileException::SystemError );
+}
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+}
+
+void DirectoryWatcher::watch( const FileName&, bool )
+{
+}
+
+void DirectoryWatcher::unwatch( const FileName& )
+{
+}
+
+int DirectoryWatcher::fd() const
+{
+	return -1;
+}
+
+int DirectoryWatcher::read( std::vector<Event>& )
+{
+	return 0;
+}
+
+#endif
+
+}   // namespace bw
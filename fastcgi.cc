@@ -0,0 +1,919 @@
+/* fastcgi.cc -- long running FastCGI responder
+
+Copyright (C) 1997-2013, Brian Bray
+
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bw/bwassert.h"
+#include "bw/exception.h"
+#include "bw/string.h"
+#include "bw/http.h"
+#include "bw/fastcgi.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+
+namespace bw {
+
+// Compilation time options
+
+const size_t inBufferSize = 64*1024;	// Bytes read from the web server at a time
+const size_t outBufferSize = 16*1024;	// Response bytes sent per record
+const int listenBacklog = 128;
+
+
+/*: class FastCGIServer
+
+  A FastCGI responder.  The web server keeps the program running and
+  passes requests to it over a socket, so the cost of starting a process,
+  linking it, reading configuration and connecting to databases is paid
+  once instead of per request.  Anything the handler keeps between calls
+  (caches, SQL connections) stays warm.
+
+  The handler gets a CGIRequest, which has the CGI variables, the body
+  as an istream and the response as an ostream, and the same form
+  parsers as http.h.  A handler written for CGIRequest works unchanged
+  as a plain CGI program with CGIRequest().
+
+  One request is served at a time on each connection (FastCGI's
+  multiplexing is refused, as most web servers expect), and connections
+  are kept open when the web server asks (FCGI_KEEP_CONN).  run() serves
+  one connection at a time; call it on several threads to serve several.
+  The handler then has to be thread safe.
+
+  Example:
+	FastCGIServer server( "/run/app.sock" );
+	server.run( []( CGIRequest& req ) {
+		std::map< String, String > form = req.getAnyData();
+		req.out() << "Content-Type: text/html\r\n\r\n" << ...;
+	} );
+*/
+
+// The FastCGI 1.0 protocol
+enum {
+	fcgiVersion = 1,
+	fcgiHeaderSize = 8,
+	fcgiMaxContent = 65535
+};
+
+enum RecordType {
+	BeginRequest = 1,
+	AbortRequest = 2,
+	EndRequest = 3,
+	Params = 4,
+	Stdin = 5,
+	Stdout = 6,
+	Stderr = 7,
+	GetValues = 9,
+	GetValuesResult = 10,
+	UnknownType = 11
+};
+
+enum {
+	roleResponder = 1,
+	flagKeepConn = 1
+};
+
+enum ProtocolStatus {
+	RequestComplete = 0,
+	CantMpxConn = 1,
+	UnknownRole = 3
+};
+
+/* class CGIParams
+
+   The CGI variables of one request, stored as "name\0value\0" pairs in
+   one buffer that is reused from request to request.  There are only a
+   few dozen, so they are searched in order.
+*/
+class CGIParams {
+public:
+	void clear() {
+		m_data.clear();
+		m_index.clear();
+	}
+
+	void add( const char* pName, size_t nName, const char* pValue, size_t nValue ) {
+		m_index.push_back( m_data.size() );
+		m_data.append( pName, nName );
+		m_data += '\0';
+		m_data.append( pValue, nValue );
+		m_data += '\0';
+	}
+
+	const char* find( const char* pszName ) const {
+		for (size_t i=0; i<m_index.size(); ++i) {
+			const char* psz = m_data.c_str()+m_index[i];
+			if (strcmp( psz, pszName )==0)
+				return psz+strlen( psz )+1;
+		}
+		return 0;
+	}
+
+private:
+	std::string		m_data;
+	std::vector<size_t>	m_index;
+};
+
+/* readLength()
+
+   Reads a name or value length of a FastCGI name-value pair:  one byte
+   below 128, else four with the top bit set.
+*/
+static bool readLength( const unsigned char*& p, const unsigned char* pEnd, size_t& n )
+{
+	if (p>=pEnd)
+		return false;
+	if (*p<128) {
+		n = *p++;
+		return true;
+	}
+	if (pEnd-p<4)
+		return false;
+	n = ((size_t)(p[0]&0x7f)<<24) | ((size_t)p[1]<<16) | ((size_t)p[2]<<8) | p[3];
+	p += 4;
+	return true;
+}
+
+/* class FastCGIConnection
+
+   One connection from the web server:  reads its records through a
+   buffer, and writes records with one system call each.  Failures of
+   the connection throw BFileException; protocol errors throw
+   BFormatException.  Either way the connection is dropped.
+*/
+class FastCGIConnection {
+public:
+	FastCGIConnection();
+	~FastCGIConnection();
+
+	void attach( int fd );
+	void detach();
+
+	bool beginRequest();
+	bool nextStdin();
+	void endRequest( int appStatus );
+	void writeRecord( int type, int id, const char* p, size_t n );
+	void writeStream( int type, const char* p, size_t n );
+
+	const CGIParams& params() const {
+		return m_params;
+	}
+	bool keepConn() const {
+		return m_keepConn;
+	}
+	bool isAborted() const {
+		return m_isAborted;
+	}
+
+	std::string	m_content;		// Content of the record just read
+
+private:
+	bool readRecord();
+	void readExact( char* p, size_t n );
+	void management();
+	void writeEnd( int id, int appStatus, int protocolStatus );
+	void parseParams();
+
+	int		m_fd;
+	std::vector<char>	m_in;
+	size_t	m_nInPos;
+	size_t	m_nInLen;
+
+	int		m_type;			// Of the record just read
+	int		m_id;
+
+	int		m_idActive;		// Request being served, 0 if none
+	bool	m_keepConn;
+	bool	m_isStdinDone;
+	bool	m_isAborted;
+	CGIParams	m_params;
+	std::string	m_paramBuf;		// FCGI_PARAMS stream so far
+};
+
+FastCGIConnection::FastCGIConnection()
+	:   m_fd( -1 ),
+	    m_in( inBufferSize ),
+	    m_nInPos( 0 ),
+	    m_nInLen( 0 ),
+	    m_type( 0 ),
+	    m_id( 0 ),
+	    m_idActive( 0 ),
+	    m_keepConn( false ),
+	    m_isStdinDone( true ),
+	    m_isAborted( false )
+{}
+
+FastCGIConnection::~FastCGIConnection()
+{
+	detach();
+}
+
+void FastCGIConnection::attach( int fd )
+{
+	m_fd = fd;
+	m_nInPos = m_nInLen = 0;
+	m_idActive = 0;
+}
+
+void FastCGIConnection::detach()
+{
+	if (m_fd>=0)
+		::close( m_fd );
+	m_fd = -1;
+}
+
+/* FastCGIConnection::readExact()
+
+   Reads n bytes, from the buffer and then the socket.
+*/
+void FastCGIConnection::readExact( char* p, size_t n )
+{
+	while (n>0) {
+		if (m_nInPos==m_nInLen) {
+			if (n>=m_in.size()) {
+				// Large content goes straight to its destination
+				ssize_t len = ::recv( m_fd, p, n, 0 );
+				if (len<0 && errno==EINTR)
+					continue;
+				if (len<=0) {
+					if (len==0)
+						errno = ECONNRESET;
+					throw BFileException( BFileException::SystemError );
+				}
+				p += len;
+				n -= len;
+				continue;
+			}
+			ssize_t len = ::recv( m_fd, m_in.data(), m_in.size(), 0 );
+			if (len<0 && errno==EINTR)
+				continue;
+			if (len<=0) {
+				if (len==0)
+					errno = ECONNRESET;
+				throw BFileException( BFileException::SystemError );
+			}
+			m_nInPos = 0;
+			m_nInLen = len;
+		}
+		size_t nCopy = std::min( n, m_nInLen-m_nInPos );
+		memcpy( p, m_in.data()+m_nInPos, nCopy );
+		m_nInPos += nCopy;
+		p += nCopy;
+		n -= nCopy;
+	}
+}
+
+/* FastCGIConnection::readRecord()
+
+   Reads the next record into m_type, m_id and m_content.  Returns false
+   if the web server closed the connection between records.
+*/
+bool FastCGIConnection::readRecord()
+{
+	if (m_nInPos==m_nInLen) {
+		ssize_t len;
+		do {
+			len = ::recv( m_fd, m_in.data(), m_in.size(), 0 );
+		} while (len<0 && errno==EINTR);
+		if (len==0)
+			return false;
+		if (len<0) {
+			if (errno==ECONNRESET)
+				return false;
+			throw BFileException( BFileException::SystemError );
+		}
+		m_nInPos = 0;
+		m_nInLen = len;
+	}
+
+	unsigned char header[fcgiHeaderSize];
+	readExact( (char*)header, fcgiHeaderSize );
+	if (header[0]!=fcgiVersion)
+		throw BFormatException( "Unknown FastCGI version" );
+	m_type = header[1];
+	m_id = (header[2]<<8) | header[3];
+	size_t nContent = (header[4]<<8) | header[5];
+	size_t nPadding = header[6];
+
+	m_content.resize( nContent );
+	if (nContent>0)
+		readExact( &m_content[0], nContent );
+	char padding[256];
+	readExact( padding, nPadding );
+	return true;
+}
+
+/* FastCGIConnection::writeRecord()
+
+   Sends one record, with its header, in one system call.
+*/
+void FastCGIConnection::writeRecord( int type, int id, const char* p, size_t n )
+{
+	bwassert( n<=fcgiMaxContent );
+	unsigned char header[fcgiHeaderSize];
+	header[0] = fcgiVersion;
+	header[1] = type;
+	header[2] = id>>8;
+	header[3] = id & 0xff;
+	header[4] = n>>8;
+	header[5] = n & 0xff;
+	header[6] = 0;
+	header[7] = 0;
+
+	struct iovec aiov[2];
+	aiov[0].iov_base = header;
+	aiov[0].iov_len = fcgiHeaderSize;
+	aiov[1].iov_base = (void*)p;
+	aiov[1].iov_len = n;
+	struct msghdr msg;
+	memset( &msg, 0, sizeof(msg) );
+	msg.msg_iov = aiov;
+	msg.msg_iovlen = n>0 ? 2 : 1;
+
+	while (msg.msg_iovlen>0) {
+		ssize_t len = ::sendmsg( m_fd, &msg, MSG_NOSIGNAL );
+		if (len<0) {
+			if (errno==EINTR)
+				continue;
+			throw BFileException( BFileException::SystemError );
+		}
+		// Skip what was sent
+		while (msg.msg_iovlen>0 && (size_t)len>=msg.msg_iov->iov_len) {
+			len -= msg.msg_iov->iov_len;
+			++msg.msg_iov;
+			--msg.msg_iovlen;
+		}
+		if (msg.msg_iovlen>0) {
+			msg.msg_iov->iov_base = (char*)msg.msg_iov->iov_base+len;
+			msg.msg_iov->iov_len -= len;
+		}
+	}
+}
+
+/* FastCGIConnection::writeStream()
+
+   Sends data on the active request's stdout or stderr stream, in as
+   many records as it takes.
+*/
+void FastCGIConnection::writeStream( int type, const char* p, size_t n )
+{
+	while (n>0) {
+		size_t nRecord = std::min( n, (size_t)fcgiMaxContent );
+		writeRecord( type, m_idActive, p, nRecord );
+		p += nRecord;
+		n -= nRecord;
+	}
+}
+
+void FastCGIConnection::writeEnd( int id, int appStatus, int protocolStatus )
+{
+	char body[8];
+	body[0] = (appStatus>>24) & 0xff;
+	body[1] = (appStatus>>16) & 0xff;
+	body[2] = (appStatus>>8) & 0xff;
+	body[3] = appStatus & 0xff;
+	body[4] = protocolStatus;
+	body[5] = body[6] = body[7] = 0;
+	writeRecord( EndRequest, id, body, sizeof(body) );
+}
+
+/* FastCGIConnection::management()
+
+   Answers a record for the application as a whole (request id 0).  Only
+   FCGI_MPXS_CONNS is answered for FCGI_GET_VALUES: the number of
+   connections depends on how many threads call run().
+*/
+void FastCGIConnection::management()
+{
+	if (m_type!=GetValues) {
+		char body[8];
+		memset( body, 0, sizeof(body) );
+		body[0] = m_type;
+		writeRecord( UnknownType, 0, body, sizeof(body) );
+		return;
+	}
+
+	std::string result;
+	const unsigned char* p = (const unsigned char*)m_content.data();
+	const unsigned char* pEnd = p+m_content.size();
+	size_t nName;
+	size_t nValue;
+	while (readLength( p, pEnd, nName ) && readLength( p, pEnd, nValue ) &&
+	       (size_t)(pEnd-p)>=nName+nValue) {
+		if (nName==15 && memcmp( p, "FCGI_MPXS_CONNS", 15 )==0) {
+			result += (char)15;
+			result += (char)1;
+			result += "FCGI_MPXS_CONNS0";
+		}
+		p += nName+nValue;
+	}
+	writeRecord( GetValuesResult, 0, result.data(), result.size() );
+}
+
+void FastCGIConnection::parseParams()
+{
+	m_params.clear();
+	const unsigned char* p = (const unsigned char*)m_paramBuf.data();
+	const unsigned char* pEnd = p+m_paramBuf.size();
+	while (p<pEnd) {
+		size_t nName;
+		size_t nValue;
+		if (!readLength( p, pEnd, nName ) || !readLength( p, pEnd, nValue ) ||
+		    (size_t)(pEnd-p)<nName+nValue)
+			throw BFormatException( "Bad FastCGI parameters" );
+		m_params.add( (const char*)p, nName, (const char*)p+nName, nValue );
+		p += nName+nValue;
+	}
+}
+
+/* FastCGIConnection::beginRequest()
+
+   Reads records up to the end of a request's parameters.  Returns false
+   when the web server is done with the connection.
+*/
+bool FastCGIConnection::beginRequest()
+{
+	m_idActive = 0;
+	m_paramBuf.clear();
+	while (readRecord()) {
+		if (m_id==0) {
+			management();
+			continue;
+		}
+
+		switch (m_type) {
+		case BeginRequest: {
+			if (m_content.size()<8)
+				throw BFormatException( "Bad FastCGI request" );
+			int role = ((unsigned char)m_content[0]<<8) | (unsigned char)m_content[1];
+			if (m_idActive!=0 && m_id!=m_idActive)
+				writeEnd( m_id, 0, CantMpxConn );
+			else if (role!=roleResponder)
+				writeEnd( m_id, 0, UnknownRole );
+			else {
+				m_idActive = m_id;
+				m_keepConn = (m_content[2] & flagKeepConn)!=0;
+				m_isStdinDone = false;
+				m_isAborted = false;
+				m_paramBuf.clear();
+			}
+			break;
+		}
+
+		case Params:
+			if (m_id!=m_idActive)
+				break;
+			if (m_content.empty()) {
+				parseParams();
+				return true;
+			}
+			m_paramBuf += m_content;
+			break;
+
+		case AbortRequest:
+			if (m_id==m_idActive) {
+				writeEnd( m_id, 0, RequestComplete );
+				m_idActive = 0;
+				if (!m_keepConn)
+					return false;
+			}
+			break;
+
+		default:
+			break;			// Nothing else is expected yet
+		}
+	}
+	return false;
+}
+
+/* FastCGIConnection::nextStdin()
+
+   Reads records up to the next piece of the request body, leaving it in
+   m_content.  Returns false at the end of the body.
+*/
+bool FastCGIConnection::nextStdin()
+{
+	while (!m_isStdinDone) {
+		if (!readRecord()) {
+			errno = ECONNRESET;
+			throw BFileException( BFileException::SystemError );
+		}
+		if (m_id==0) {
+			management();
+		} else if (m_id!=m_idActive) {
+			if (m_type==BeginRequest)
+				writeEnd( m_id, 0, CantMpxConn );
+		} else if (m_type==AbortRequest) {
+			m_isAborted = true;
+			m_isStdinDone = true;
+		} else if (m_type==Stdin) {
+			if (m_content.empty())
+				m_isStdinDone = true;
+			else
+				return true;
+		}
+	}
+	return false;
+}
+
+/* FastCGIConnection::endRequest()
+
+   Reads any body the handler left, then closes the output stream and
+   ends the request.
+*/
+void FastCGIConnection::endRequest( int appStatus )
+{
+	while (nextStdin())
+		;
+	if (!m_isAborted)
+		writeRecord( Stdout, m_idActive, 0, 0 );
+	writeEnd( m_idActive, appStatus, RequestComplete );
+	m_idActive = 0;
+}
+
+/* class FastCGIInBuf
+
+   The request body, read a record at a time.  Each record's content is
+   used as the get area, so nothing is copied.  Connection failures end
+   the body early and are noticed by endRequest().
+*/
+class FastCGIInBuf : public std::streambuf {
+public:
+	explicit FastCGIInBuf( FastCGIConnection& conn ) : m_conn( conn ), m_isBroken( false ) {}
+
+	void reset() {
+		setg( 0, 0, 0 );
+		m_isBroken = false;
+	}
+
+protected:
+	int_type underflow() {
+		if (m_isBroken)
+			return traits_type::eof();
+		try {
+			if (!m_conn.nextStdin())
+				return traits_type::eof();
+		} catch (BException&) {
+			m_isBroken = true;
+			return traits_type::eof();
+		}
+		char* p = &m_conn.m_content[0];
+		setg( p, p, p+m_conn.m_content.size() );
+		return traits_type::to_int_type( *p );
+	}
+
+private:
+	FastCGIConnection&	m_conn;
+	bool	m_isBroken;
+};
+
+/* class FastCGIOutBuf
+
+   The response, sent in records of up to outBufferSize bytes.  After a
+   failure to send, the rest is discarded and the error is reported by
+   check() once the handler returns.
+*/
+class FastCGIOutBuf : public std::streambuf {
+public:
+	explicit FastCGIOutBuf( FastCGIConnection& conn )
+		: m_conn( conn ), m_buf( outBufferSize ), m_error( 0 ) {}
+
+	void reset() {
+		setp( m_buf.data(), m_buf.data()+m_buf.size() );
+		m_error = 0;
+	}
+
+	void check() {
+		if (m_error!=0) {
+			errno = m_error;
+			throw BFileException( BFileException::SystemError );
+		}
+	}
+
+protected:
+	int_type overflow( int_type ch ) {
+		send();
+		if (!traits_type::eq_int_type( ch, traits_type::eof() )) {
+			*pptr() = traits_type::to_char_type( ch );
+			pbump( 1 );
+		}
+		return traits_type::not_eof( ch );
+	}
+
+	int sync() {
+		send();
+		return 0;
+	}
+
+private:
+	void send() {
+		size_t n = pptr()-pbase();
+		setp( m_buf.data(), m_buf.data()+m_buf.size() );
+		if (n==0 || m_error!=0 || m_conn.isAborted())
+			return;
+		try {
+			m_conn.writeStream( Stdout, m_buf.data(), n );
+		} catch (BFileException&) {
+			m_error = errno;
+		}
+	}
+
+	FastCGIConnection&	m_conn;
+	std::vector<char>	m_buf;
+	int		m_error;
+};
+
+
+/*: CGIRequest::CGIRequest()
+
+  The request of a plain CGI process:  the variables are in the
+  environment, the body is cin and the response goes to cout.
+*/
+CGIRequest::CGIRequest()
+	:   m_pParams( 0 ),
+	    m_pIn( &std::cin ),
+	    m_pOut( &std::cout )
+{}
+
+CGIRequest::CGIRequest( const CGIParams* pParams, std::istream& is, std::ostream& os )
+	:   m_pParams( pParams ),
+	    m_pIn( &is ),
+	    m_pOut( &os )
+{}
+
+/*: CGIRequest::param()
+
+  Returns a CGI variable (eg: "REQUEST_METHOD", "QUERY_STRING",
+  "CONTENT_TYPE", "HTTP_ACCEPT_ENCODING"), or 0 if the request doesn't
+  have it.
+*/
+const char* CGIRequest::param( const char* pszName ) const
+{
+	if (m_pParams)
+		return m_pParams->find( pszName );
+	return getenv( pszName );
+}
+
+/*: CGIRequest::getAnyData()
+
+  Parses the form data of the request, as getAnyData() etc. in http.h do
+  for a CGI process.
+
+  Throws: BFormatException if the data is malformed
+*/
+std::map< String, String > CGIRequest::getAnyData()
+{
+	const char* pszMethod = param( "REQUEST_METHOD" );
+	if (!pszMethod)
+		return std::map< String, String >();
+	if (strcmp( pszMethod, "GET" )==0)
+		return getGetData();
+	if (strcmp( pszMethod, "POST" )==0) {
+		const char* pszType = param( "CONTENT_TYPE" );
+		if (pszType && strncmp( pszType, "multipart/form-data;", 20 )==0)
+			return getMultiData();
+		return getPostData();
+	}
+	return std::map< String, String >();
+}
+
+std::map< String, String > CGIRequest::getPostData()
+{
+	return parseHTTPData( in() );
+}
+
+std::map< String, String > CGIRequest::getGetData()
+{
+	const char* psz = param( "QUERY_STRING" );
+	if (psz)
+		return parseHTTPData( StringView( psz, strlen(psz) ) );
+	return std::map< String, String >();
+}
+
+/*: CGIRequest::getFormParams()
+
+  The query (GET) or urlencoded body (POST), decoded only as asked for
+  (see FormParams).  Reads the body.
+*/
+FormParams CGIRequest::getFormParams()
+{
+	const char* pszMethod = param( "REQUEST_METHOD" );
+	if (pszMethod && strcmp( pszMethod, "GET" )==0) {
+		const char* psz = param( "QUERY_STRING" );
+		if (psz)
+			return FormParams( StringView( psz, strlen(psz) ) );
+	} else if (pszMethod && strcmp( pszMethod, "POST" )==0) {
+		const char* pszType = param( "CONTENT_TYPE" );
+		if (!pszType || strncmp( pszType, "multipart/", 10 )!=0)
+			return FormParams( in() );
+	}
+	return FormParams();
+}
+
+std::map< String, String > CGIRequest::getMultiData()
+{
+	return parseMultiData( in(), param( "CONTENT_TYPE" ) );
+}
+
+
+/*: FastCGIServer::FastCGIServer()
+
+  Sets up the listening socket.  pszAddress is a Unix socket path (an
+  old socket there is replaced), "host:port", or ":port" for all
+  interfaces.  With 0, the socket is the one a web server passes as fd 0
+  when it starts the program itself.
+
+  Prototype: explicit FastCGIServer( const char* pszAddress=0 )
+  Throws: BFileException if the socket can't be set up
+*/
+FastCGIServer::FastCGIServer( const char* pszAddress )
+	:   m_fdListen( -1 ),
+	    m_isOwned( false ),
+	    m_isStopped( false ),
+	    m_nRequests( 0 )
+{
+	if (!pszAddress) {
+		struct sockaddr_storage addr;
+		socklen_t len = sizeof(addr);
+		if (getsockname( 0, (struct sockaddr*)&addr, &len )<0)
+			throw BFileException( BFileException::SystemError );
+		m_fdListen = 0;
+		return;
+	}
+
+	const char* pszColon = strrchr( pszAddress, ':' );
+	if (pszAddress[0]=='/' || !pszColon) {
+		struct sockaddr_un addr;
+		memset( &addr, 0, sizeof(addr) );
+		addr.sun_family = AF_UNIX;
+		if (strlen( pszAddress )>=sizeof(addr.sun_path)) {
+			errno = ENAMETOOLONG;
+			throw BFileException( BFileException::SystemError );
+		}
+		strcpy( addr.sun_path, pszAddress );
+		m_fdListen = ::socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+		if (m_fdListen<0)
+			throw BFileException( BFileException::SystemError );
+		m_isOwned = true;
+		unlink( pszAddress );
+		if (::bind( m_fdListen, (struct sockaddr*)&addr, sizeof(addr) )<0) {
+			int error = errno;
+			::close( m_fdListen );
+			errno = error;
+			throw BFileException( BFileException::SystemError );
+		}
+		m_strPath = pszAddress;
+	} else {
+		std::string host( pszAddress, pszColon-pszAddress );
+		struct addrinfo hints;
+		memset( &hints, 0, sizeof(hints) );
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_flags = AI_PASSIVE;
+		struct addrinfo* pai;
+		if (getaddrinfo( host.empty() ? 0 : host.c_str(), pszColon+1, &hints, &pai )!=0) {
+			errno = EADDRNOTAVAIL;
+			throw BFileException( BFileException::SystemError );
+		}
+		m_fdListen = ::socket( pai->ai_family, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+		int error = errno;
+		if (m_fdListen>=0) {
+			int on = 1;
+			setsockopt( m_fdListen, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on) );
+			if (::bind( m_fdListen, pai->ai_addr, pai->ai_addrlen )<0) {
+				error = errno;
+				::close( m_fdListen );
+				m_fdListen = -1;
+			}
+		}
+		freeaddrinfo( pai );
+		if (m_fdListen<0) {
+			errno = error;
+			throw BFileException( BFileException::SystemError );
+		}
+		m_isOwned = true;
+	}
+
+	if (::listen( m_fdListen, listenBacklog )<0) {
+		int error = errno;
+		::close( m_fdListen );
+		if (m_strPath!="")
+			unlink( m_strPath );
+		errno = error;
+		throw BFileException( BFileException::SystemError );
+	}
+}
+
+/*: FastCGIServer::~FastCGIServer()
+
+  Closes the listening socket (and removes a Unix socket).
+  Requires: run() has returned on every thread
+*/
+FastCGIServer::~FastCGIServer()
+{
+	if (m_isOwned)
+		::close( m_fdListen );
+	if (m_strPath!="")
+		unlink( m_strPath );
+}
+
+/*: FastCGIServer::run()
+
+  Accepts connections and calls fn for each request on them, until
+  stop().  The streams and buffers are reused from request to request.
+
+  If fn throws, the message is sent to the web server's error log and the
+  request ends with status 1.  A connection that fails is dropped and the
+  next one accepted.
+
+  Throws: BFileException if the listening socket fails
+*/
+void FastCGIServer::run( Handler fn )
+{
+	FastCGIConnection conn;
+	FastCGIInBuf inbuf( conn );
+	FastCGIOutBuf outbuf( conn );
+	std::istream is( &inbuf );
+	std::ostream os( &outbuf );
+
+	while (!m_isStopped) {
+		int fd = ::accept4( m_fdListen, 0, 0, SOCK_CLOEXEC );
+		if (fd<0) {
+			if (m_isStopped)
+				break;
+			if (errno==EINTR || errno==ECONNABORTED)
+				continue;
+			throw BFileException( BFileException::SystemError );
+		}
+		conn.attach( fd );
+
+		try {
+			while (conn.beginRequest()) {
+				inbuf.reset();
+				outbuf.reset();
+				is.clear();
+				os.clear();
+				CGIRequest req( &conn.params(), is, os );
+
+				int appStatus = 0;
+				std::string strError;
+				try {
+					fn( req );
+				} catch (BException& e) {
+					strError = e.message();
+				} catch (std::exception& e) {
+					strError = e.what();
+				}
+				os.flush();
+				outbuf.check();
+				if (!strError.empty()) {
+					strError += '\n';
+					conn.writeStream( Stderr, strError.data(), strError.size() );
+					appStatus = 1;
+				}
+				conn.endRequest( appStatus );
+				++m_nRequests;
+				if (!conn.keepConn() || m_isStopped)
+					break;
+			}
+		} catch (BFileException&) {
+			// Connection failed; drop it
+		} catch (BFormatException&) {
+			// Not speaking FastCGI; drop it
+		}
+		conn.detach();
+	}
+}
+
+/*: FastCGIServer::stop()
+
+  Makes run() return, on every thread, once the request in hand is done.
+  A thread holding a kept connection returns when the web server next
+  uses or closes it.  Safe to call from a handler or another thread.
+*/
+void FastCGIServer::stop()
+{
+	m_isStopped = true;
+	::shutdown( m_fdListen, SHUT_RD );	// Wakes accept()
+}
+
+}	// namespace bw
@@ -8,11 +8,14 @@ Copyright (C) 1997-2013, Brian Bray
 #define NOTRACE
 #include "bw/trace.h"
 
+#include <atomic>
+#include <chrono>
 #include "bw/bwassert.h"
 #include "bw/string.h"
 #include "bw/context.h"
 #include "bw/tools.h"
 #include "bw/figure.h"
+#include "bw/metrics.h"
 
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
@@ -240,6 +243,8 @@ void Figure::doEvent( const Event& ev, EventRet& evr )
 }
 
 
+static MetricHistogram s_drawTime( "bw_figure_draw_seconds", "Time for a Figure to handle a Draw event" );
+
 /* Figure::doFigureEvent()
 
    This is the event handler for the Figure class
@@ -260,6 +265,7 @@ void Figure::doFigureEvent( const Event& ev, EventRet& evr )
 	case Draw:
 		bwassert( m_pfi );
 		if (m_pfi->m_ctx.needRedraw()) {
+			MetricTimer mt( s_drawTime );
 			Canvas cvs( m_pfi );
 			draw( cvs );
 			m_pfi->m_ctx.reset();
@@ -4,6 +4,8 @@ Copyright (C) 1997-2013, Brian Bray
 
 */
 
+// off_t, lseek(), pread() and pwrite() are 64 bit on 32 bit systems too
+#define _FILE_OFFSET_BITS 64
 
 #include "bw/file.h"
 #include "bw/exception.h"
@@ -12,6 +14,7 @@ Copyright (C) 1997-2013, Brian Bray
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <stdlib.h>
 #include <errno.h>
 
@@ -30,6 +33,16 @@ Superclass:
 Subclasses:
 	none
 
+Offsets are 64 bit (BFile::Offset) on every platform, so files over
+2GB work.
+
+read(), write() and seek() use the file position shared by all users
+of the object.  readAt() and writeAt() take the position as an
+argument instead and don't change any state, so several threads can
+read (or write different parts of) one open BFile without a lock.
+
+readv() and writev() scatter and gather a list of buffers (struct
+iovec, from <sys/uio.h>) with one system call.
 */
 
 
@@ -168,7 +181,7 @@ BFile::read
 {
 	bwassert( m_fd>=0 );
 
-	int ret = ::read( m_fd, buffer, length );
+	long ret = ::read( m_fd, buffer, length );
 
 	if( ret<0 )
 		throw BFileException( BFileException::SystemError );
@@ -198,7 +211,7 @@ BFile::readUpTo
 {
 	bwassert( m_fd>=0 );
 
-	int ret = ::read( m_fd, buffer, length );
+	long ret = ::read( m_fd, buffer, length );
 
 	if( ret<0 )
 		throw BFileException( BFileException::SystemError );
@@ -229,9 +242,184 @@ BFile::write
 		throw BFileException( BFileException::SystemError );
 }
 
+/*: BFile::readAt()
+
+	Reads length bytes at position into buffer.  The file position is
+	neither used nor changed, so threads may call this concurrently.
+
+	Requires: Currently opened file
+
+	Throws: BFileException if unable to fully fill buffer
+*/
+void
+BFile::readAt
+(
+    void* buffer,
+    long length,
+    Offset position
+) const
+{
+	if( readUpToAt( buffer, length, position )!=length )
+		throw BFileException( BFileException::UnexpectedEof );
+}
+
+
+/*: BFile::readUpToAt()
+
+	Reads up to length bytes at position into buffer.  The file position
+	is neither used nor changed.
+
+	Requires: Currently opened file
+	Returns: actual count of bytes read, less than length only at end of file
+	Throws: BFileException if unable to complete operation
+*/
+long
+BFile::readUpToAt
+(
+    void* buffer,
+    long length,
+    Offset position
+) const
+{
+	bwassert( m_fd>=0 );
+	bwassert( position>=0 );
+
+	char* pch = (char*)buffer;
+	long done = 0;
+	while( done<length ) {
+		long ret = ::pread( m_fd, pch+done, length-done, position+done );
+		if( ret<0 ) {
+			if( errno==EINTR )
+				continue;
+			throw BFileException( BFileException::SystemError );
+		}
+		if( ret==0 )
+			break;			// End of file
+		done += ret;
+	}
+	return done;
+}
+
+
+/*: BFile::writeAt()
+
+	Writes length bytes from buffer at position.  The file position is
+	neither used nor changed.
+
+	Requires: Currently opened mode ReadWrite, Create, or CreateNew
+	Throws: BFileException if complete buffer is not written
+*/
+void
+BFile::writeAt
+(
+    const void* buffer,
+    long length,
+    Offset position
+)
+{
+	bwassert( m_fd>=0 );
+	bwassert( position>=0 );
+
+	const char* pch = (const char*)buffer;
+	long done = 0;
+	while( done<length ) {
+		long ret = ::pwrite( m_fd, pch+done, length-done, position+done );
+		if( ret<=0 ) {
+			if( ret<0 && errno==EINTR )
+				continue;
+			throw BFileException( BFileException::SystemError );
+		}
+		done += ret;
+	}
+}
+
+
+/*: BFile::readv()
+
+	Reads into count buffers, filling each before the next, with one
+	system call.
+
+	Requires: Currently opened file
+	Promises: Sets atEof() if end of file reached
+	Returns: actual count of bytes read (may be 0)
+	Throws: BFileException if unable to complete operation
+*/
+long
+BFile::readv
+(
+    const struct iovec* iov,
+    int count
+)
+{
+	bwassert( m_fd>=0 );
+
+	long ret = ::readv( m_fd, iov, count );
+
+	if( ret<0 )
+		throw BFileException( BFileException::SystemError );
+
+	long length = 0;
+	for( int i=0; i<count; ++i )
+		length += iov[i].iov_len;
+	if( ret!=length )
+		m_atEof = true;
+
+	return ret;
+}
+
+
+/*: BFile::writev()
+
+	Writes count buffers in order.  Normally one system call; partial
+	writes are continued where they stopped.
+
+	Requires: Currently opened mode ReadWrite, Create, or CreateNew
+	Throws: BFileException if all buffers are not completely written
+*/
+void
+BFile::writev
+(
+    const struct iovec* iov,
+    int count
+)
+{
+	bwassert( m_fd>=0 );
+
+	for(;;) {
+		// Empty buffers write nothing, and writev() of only those returns 0
+		while( count>0 && iov->iov_len==0 ) {
+			++iov;
+			--count;
+		}
+		if( count==0 )
+			break;
+
+		long ret = ::writev( m_fd, iov, count );
+		if( ret<=0 ) {
+			if( ret<0 && errno==EINTR )
+				continue;
+			throw BFileException( BFileException::SystemError );
+		}
+
+		// Skip what was written, finishing a partly written buffer by itself
+		while( count>0 && ret>=(long)iov->iov_len ) {
+			ret -= iov->iov_len;
+			++iov;
+			--count;
+		}
+		if( ret>0 ) {
+			write( (const char*)iov->iov_base+ret, iov->iov_len-ret );
+			++iov;
+			--count;
+		}
+	}
+}
+
 /*: BFile::commit()
 
-	Flushes output to device.
+	Flushes output to device.  Only the data (and the metadata needed
+	to read it back, such as the size) is flushed, not times.  Each call
+	is a device flush; see GroupCommit to share them among threads.
 
 	Requires: Currently opened mode ReadWrite, Create, or CreateNew
 	Throws: BFileException on error
@@ -241,8 +429,13 @@ BFile::commit()
 {
 	bwassert( m_fd>=0 );
 
-	// There is no effective way to commit a single file in UNIX,
-	// so this routine does nothing
+#ifdef __APPLE__
+	int ret = fsync( m_fd );		// No fdatasync()
+#else
+	int ret = fdatasync( m_fd );
+#endif
+	if( ret!=0 )
+		throw BFileException( BFileException::SystemError );
 }
 
 /*: BFile::atEof()
@@ -286,16 +479,16 @@ BFile::isOpen() const
 	Returns: new file position
 	Throws: BfileException if unable to comply
 */
-long
+BFile::Offset
 BFile::seek
 (
-    long position,
+    Offset position,
     SeekMode sm
 )
 {
 	bwassert( m_fd>=0 );
 
-	long ret = lseek( m_fd, position, sm );	// Implementation note: sm matches OS modes
+	off_t ret = lseek( m_fd, position, sm );	// Implementation note: sm matches OS modes
 
 	if( ret<0 )
 		throw BFileException( BFileException::SystemError );
@@ -312,12 +505,12 @@ BFile::seek
 	Requires: Currently opened file
 	Returns: file position
 */
-long
+BFile::Offset
 BFile::tell() const
 {
 	bwassert( m_fd>=0 );
 
-	long ret = ::lseek( m_fd, 0, SEEK_CUR );
+	off_t ret = ::lseek( m_fd, 0, SEEK_CUR );
 
 	if( ret<0 )
 		throw BFileException( BFileException::SystemError );
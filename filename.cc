@@ -4,17 +4,23 @@ Copyright (C) 1997-2013, Brian Bray
 
 */
 
+#include <limits.h>
+#include <string>
+
 #include "bw/bwassert.h"
 #include "bw/string.h"
 #include "bw/filename.h"
 #include "bw/exception.h"
+#include "bw/pathbuilder.h"
 
 #include <ctype.h>
 #include <stdlib.h>
 #include <sys/types.h>
 #include <sys/stat.h>
-#include <limits.h>
 #include <unistd.h>
+#include <string.h>
+#include <fnmatch.h>
+#include <errno.h>
 
 namespace bw {
 
@@ -74,38 +80,37 @@ void FileName::setName(const char* pszFileName)
 	parse();
 }
 
+/* FileName::parse()
+
+   Finds the components, working on the characters in place.
+*/
 void FileName::parse()
 {
-	// Break filename up into components
+	const char* psz = m_sFileName;
+	int nLength = m_sFileName.length();
+
 	// Root:
 	m_nRoot = 0;
-	while (m_sFileName[(int)m_nRoot]=='/' )
+	while (psz[m_nRoot]=='/' )
 		++m_nRoot;
 
 	// Directory
-	m_nDir = m_sFileName.lastIndexOf('/') + 1;
-	if (m_nDir>m_nRoot)
-		m_nDir -= m_nRoot;
-	else
-		m_nDir = 0;
+	const char* pSlash = strrchr( psz, '/' );
+	int nPath = pSlash ? pSlash-psz+1 : 0;
+	m_nDir = nPath>m_nRoot ? nPath-m_nRoot : 0;
 
 	// BaseName and Extension
-	String sName = m_sFileName.substring(m_nRoot+m_nDir);
-	if (sName==".") {
-		m_nBase = 1;
-		m_nExt = 0;
-	} else if (sName=="..") {
-		m_nBase = 2;
+	const char* pName = psz+m_nRoot+m_nDir;
+	int nName = nLength-m_nRoot-m_nDir;
+	if (strcmp( pName, "." )==0 || strcmp( pName, ".." )==0) {
+		m_nBase = nName;
 		m_nExt = 0;
 	} else {
-		m_nBase = sName.lastIndexOf('.');
-		if (m_nBase<0) {
-			m_nBase = sName.length();
-			m_nExt = 0;
-		} else
-			m_nExt = sName.length()-m_nBase;
+		const char* pDot = strrchr( pName, '.' );
+		m_nBase = pDot ? pDot-pName : nName;
+		m_nExt = nName-m_nBase;
 	}
-	bwassert( m_nRoot+m_nDir+m_nBase+m_nExt == m_sFileName.length() );
+	bwassert( m_nRoot+m_nDir+m_nBase+m_nExt == nLength );
 }
 
 /*: routine FileName::isAbsolute()
@@ -125,8 +130,7 @@ bool FileName::isAbsolute() const
 */
 bool FileName::isPattern() const
 {
-	String sName = m_sFileName.substring(m_nRoot+m_nDir);
-	return sName.indexOf('*')>=0 || sName.indexOf('?')>=0;
+	return strpbrk( (const char*)m_sFileName+m_nRoot+m_nDir, "*?" )!=0;
 }
 
 /*: routine FileName::empty()
@@ -216,18 +220,26 @@ void FileName::makeAbsolute()
 /*: FileName::append()
 
   Appends one filename to another.  The appended filename must be
-  a relative path without a drive or initial "/".
+  a relative path without a drive or initial "/".  Only the appended
+  part is examined:  its base name and extension become this one's, and
+  the rest joins the directory.
 */
 void FileName::append(const FileName& fn)
 {
 	bwassert( !fn.isAbsolute() );
 	bwassert( fn.m_nRoot==0 );
 
-	char chLast = m_sFileName[m_sFileName.length()-1];
-	if (chLast!='/' )
+	int nLength = m_sFileName.length();
+	if (nLength>0 && m_sFileName[nLength-1]!='/' )
 		m_sFileName.append('/');
 	m_sFileName.append(fn.m_sFileName);
-	parse();
+
+	if (nLength==0) {
+		m_nDir = fn.m_nDir;
+	} else
+		m_nDir = m_sFileName.length()-m_nRoot-fn.m_nBase-fn.m_nExt;
+	m_nBase = fn.m_nBase;
+	m_nExt = fn.m_nExt;
 }
 
 /*: FileName::currentDirectory()
@@ -276,4 +288,409 @@ FileName::Type FileName::getFileType() const
 	return NoAccess;		// No access, doesn't exist, or strange type
 }
 
+
+/*: class PathBuilder
+
+  Builds paths in a buffer of PATH_MAX characters inside the object, so
+  joining and normalizing paths in a loop (eg: resolving many names
+  below one directory) doesn't touch the heap.  A PathBuilder is usually
+  a local variable.
+
+  The path is kept normalized as it is built:  repeated '/' become one,
+  "." components are dropped, and ".." removes the component before it
+  (at the root it is dropped, and at the start of a relative path it is
+  kept).  There is never a trailing '/', except for the root "/".  The
+  normalization is textual, so "link/.." becomes "" even when link is a
+  symbolic link to a directory elsewhere.
+
+  Example:
+	PathBuilder pb( "/var/spool/./in/" );	// "/var/spool/in"
+	pb.append( "../out/x.dat" );		// "/var/spool/out/x.dat"
+	pb.pop();				// "/var/spool/out"
+*/
+
+/*: PathBuilder::PathBuilder()
+
+  Starts with pszPath, normalized.
+
+  Prototype: explicit PathBuilder( const char* pszPath="" )
+  Throws: BFileException if the path is longer than PATH_MAX
+*/
+PathBuilder::PathBuilder( const char* pszPath )
+	:   m_nLength( 0 )
+{
+	m_achPath[0] = '\0';
+	add( pszPath, strlen( pszPath ) );
+}
+
+/*: PathBuilder::set()
+
+  Replaces the path with pszPath, normalized.
+
+  Throws: BFileException if the path is longer than PATH_MAX (the path is
+  then empty)
+*/
+void PathBuilder::set( const char* pszPath )
+{
+	clear();
+	add( pszPath, strlen( pszPath ) );
+}
+
+/*: PathBuilder::append()
+
+  Adds a relative path to the end, as a directory joined with a name
+  below it.  An absolute path replaces the whole path.
+
+  Prototype: void append( const char* pszPath )
+  Prototype: void append( const PathView& pv )
+  Throws: BFileException if the result would be longer than PATH_MAX (the
+  path is then unchanged)
+*/
+void PathBuilder::append( const char* pszPath )
+{
+	add( pszPath, strlen( pszPath ) );
+}
+
+void PathBuilder::append( const PathView& pv )
+{
+	add( pv.data(), pv.length() );
+}
+
+/*: PathBuilder::pop()
+
+  Removes the last component.  Returns false if the path is "/" or "",
+  which have none.
+*/
+bool PathBuilder::pop()
+{
+	int nRoot = isAbsolute() ? 1 : 0;
+	if (m_nLength<=nRoot)
+		return false;
+
+	int i = m_nLength;
+	while (i>nRoot && m_achPath[i-1]!='/')
+		--i;
+	m_nLength = i>nRoot ? i-1 : nRoot;
+	m_achPath[m_nLength] = '\0';
+	return true;
+}
+
+/*: PathBuilder::lastComponent()
+
+  Returns the final name in the path, or an empty view for "/" and "".
+*/
+PathView PathBuilder::lastComponent() const
+{
+	int i = m_nLength;
+	while (i>0 && m_achPath[i-1]!='/')
+		--i;
+	return PathView( m_achPath+i, m_nLength-i );
+}
+
+/* PathBuilder::add()
+
+   Normalizes pch onto the end of the path.  Normalizing never lengthens
+   the text by more than the separator, so the result can only overflow
+   when the lengths together come near PATH_MAX; only then is the work
+   done on a copy, to leave the path unchanged if it does overflow.
+*/
+void PathBuilder::add( const char* pch, int nLength )
+{
+	if (m_nLength+1+nLength<PATH_MAX) {
+		addUnchecked( pch, nLength );
+		return;
+	}
+
+	PathBuilder pb( *this );
+	if (!pb.addUnchecked( pch, nLength )) {
+		errno = ENAMETOOLONG;
+		throw BFileException( BFileException::SystemError );
+	}
+	m_nLength = pb.m_nLength;
+	memcpy( m_achPath, pb.m_achPath, m_nLength+1 );
+}
+
+/* PathBuilder::addUnchecked()
+
+   Does the work of add(), returning false if the path overflowed (which
+   leaves it in a mess).
+*/
+bool PathBuilder::addUnchecked( const char* pch, int nLength )
+{
+	const char* pEnd = pch+nLength;
+	if (pch<pEnd && *pch=='/') {
+		m_achPath[0] = '/';
+		m_nLength = 1;
+	}
+
+	while (pch<pEnd) {
+		while (pch<pEnd && *pch=='/')
+			++pch;
+		const char* pComponent = pch;
+		while (pch<pEnd && *pch!='/')
+			++pch;
+		int n = pch-pComponent;
+
+		if (n==0 || (n==1 && pComponent[0]=='.'))
+			continue;
+		if (n==2 && pComponent[0]=='.' && pComponent[1]=='.') {
+			PathView pvLast = lastComponent();
+			if (!pvLast.isEmpty() && pvLast!="..") {
+				pop();
+				continue;
+			}
+			if (isAbsolute())
+				continue;		// "/.." is "/"
+		}
+
+		int nSeparator = m_nLength>0 && m_achPath[m_nLength-1]!='/' ? 1 : 0;
+		if (m_nLength+nSeparator+n>=PATH_MAX)
+			return false;
+		if (nSeparator)
+			m_achPath[m_nLength++] = '/';
+		memcpy( m_achPath+m_nLength, pComponent, n );
+		m_nLength += n;
+	}
+	m_achPath[m_nLength] = '\0';
+	return true;
+}
+
+
+/*: class FilePattern
+
+  A file name pattern compiled once, for matching many names (eg: the
+  entries of a large directory).  The syntax and results are those of
+  fnmatch() without flags:  * matches any characters, ? any one
+  character, [...] one character from a set (with ranges and ! or ^ to
+  negate), and \ quotes the next character.
+
+  The common shapes "*", "name", "prefix*" and "*suffix" (eg: "*.txt")
+  are matched with plain comparisons.  Other patterns are compiled to a
+  list of steps:  'c' ch for a literal, '?', '*', and '[' followed by a
+  32 byte bitmap for a set.  Patterns using character classes such as
+  [:alpha:], or ending in an unquoted \ (which fnmatch() never matches),
+  are passed to fnmatch().
+
+  The steps match a byte at a time.  When the pattern is compiled in a
+  multibyte locale (eg: after setlocale( LC_ALL, "" ) in a UTF-8 one),
+  where ? and [...] match a whole character, names with bytes beyond
+  ASCII are passed to fnmatch() as well.
+*/
+
+/*: FilePattern::FilePattern()
+
+  Compiles pszPattern.
+
+  Prototype: explicit FilePattern( const char* pszPattern="*" )
+*/
+FilePattern::FilePattern( const char* pszPattern )
+	:   m_kind( General )
+{
+	bwassert( pszPattern );
+
+	if (strstr( pszPattern, "[:" )) {
+		m_kind = System;
+		m_program = pszPattern;
+		return;
+	}
+
+	// The steps' operands can be any byte, including '*', so the shape is
+	// worked out from these rather than by looking back at m_program
+	int nStars = 0;				// '*' steps
+	bool isLiteral = true;			// Apart from the stars
+	bool isStarFirst = false;		// The first step is '*'
+	bool isStarLast = false;		// The step just added is '*'
+	const char* ps = pszPattern;
+	while (*ps) {
+		char ch = *ps++;
+		if (ch=='*') {
+			// Consecutive stars are the same as one
+			if (!isStarLast) {
+				if (m_program.empty())
+					isStarFirst = true;
+				m_program += '*';
+				++nStars;
+				isStarLast = true;
+			}
+			continue;
+		}
+		isStarLast = false;
+		if (ch=='?') {
+			m_program += '?';
+			isLiteral = false;
+		} else if (ch=='[') {
+			// Find the end of the set; ']' first in the set is a member
+			const char* pEnd = ps;
+			if (*pEnd=='!' || *pEnd=='^')
+				++pEnd;
+			if (*pEnd==']')
+				++pEnd;
+			while (*pEnd && *pEnd!=']') {
+				if (*pEnd=='\\' && pEnd[1])
+					++pEnd;
+				++pEnd;
+			}
+			if (!*pEnd) {
+				// No closing bracket, so '[' is an ordinary character
+				m_program += 'c';
+				m_program += ch;
+				m_literal += ch;
+				continue;
+			}
+
+			unsigned char bitmap[32];
+			memset( bitmap, 0, sizeof(bitmap) );
+			bool isNegated = *ps=='!' || *ps=='^';
+			if (isNegated)
+				++ps;
+			bool isFirst = true;
+			while (isFirst || *ps!=']') {
+				isFirst = false;
+				unsigned char lo = *ps++;
+				if (lo=='\\' && ps<pEnd)
+					lo = *ps++;
+				unsigned char hi = lo;
+				if (*ps=='-' && ps[1]!=']' && ps+1<pEnd) {
+					hi = ps[1];
+					ps += 2;
+					if (hi=='\\' && ps<pEnd)
+						hi = *ps++;
+				}
+				for (int c=lo; c<=hi; ++c)
+					bitmap[c>>3] |= 1<<(c&7);
+			}
+			++ps;				// Past ']'
+			if (isNegated) {
+				for (int i=0; i<32; ++i)
+					bitmap[i] = ~bitmap[i];
+			}
+			m_program += '[';
+			m_program.append( (const char*)bitmap, sizeof(bitmap) );
+			isLiteral = false;
+		} else {
+			if (ch=='\\') {
+				if (!*ps) {
+					m_kind = System;
+					m_program = pszPattern;
+					m_literal.clear();
+					return;
+				}
+				ch = *ps++;
+			}
+			m_program += 'c';
+			m_program += ch;
+			m_literal += ch;
+		}
+	}
+
+	if (!isLiteral) {
+		if (MB_CUR_MAX>1)
+			m_pattern = pszPattern;
+		return;
+	}
+
+	// Recognize the shapes that need no interpreting
+	if (nStars==0)
+		m_kind = Literal;
+	else if (nStars==1 && m_program.size()==1)
+		m_kind = All;
+	else if (nStars==1 && isStarLast)
+		m_kind = Prefix;
+	else if (nStars==1 && isStarFirst)
+		m_kind = Suffix;
+	else
+		return;
+	m_program.clear();
+}
+
+// Indicates if psz is all ASCII, so each byte is a character in any locale
+static bool isAscii( const char* psz )
+{
+	for (const unsigned char* p=(const unsigned char*)psz; *p; ++p) {
+		if (*p>=0x80)
+			return false;
+	}
+	return true;
+}
+
+/*: FilePattern::matches()
+
+  Indicates if the whole of pszName matches the pattern.
+*/
+bool FilePattern::matches( const char* pszName ) const
+{
+	switch (m_kind) {
+	case All:
+		return true;
+	case Literal:
+		return m_literal==pszName;
+	case Prefix:
+		return strncmp( pszName, m_literal.data(), m_literal.size() )==0;
+	case Suffix: {
+		size_t n = strlen( pszName );
+		return n>=m_literal.size() &&
+		       memcmp( pszName+n-m_literal.size(), m_literal.data(), m_literal.size() )==0;
+	}
+	case System:
+		return fnmatch( m_program.c_str(), pszName, 0 )==0;
+	default:
+		if (!m_pattern.empty() && !isAscii( pszName ))
+			return fnmatch( m_pattern.c_str(), pszName, 0 )==0;
+		return matchProgram( pszName );
+	}
+}
+
+/* FilePattern::matchProgram()
+
+   Runs the compiled steps.  On a mismatch the most recent '*' takes one
+   more character and matching resumes after it; earlier stars never need
+   to be revisited, so this is linear for most patterns.
+*/
+bool FilePattern::matchProgram( const char* pszName ) const
+{
+	const char* pStart = m_program.data();
+	const char* pEnd = pStart+m_program.size();
+	const char* p = pStart;
+	const unsigned char* ps = (const unsigned char*)pszName;
+	const char* pStar = 0;			// Step after the last '*'
+	const unsigned char* psStar = 0;	// Where that '*' stopped matching
+
+	while (*ps) {
+		if (p<pEnd) {
+			switch (*p) {
+			case '*':
+				pStar = ++p;
+				psStar = ps;
+				continue;
+			case '?':
+				++p;
+				++ps;
+				continue;
+			case 'c':
+				if ((unsigned char)p[1]==*ps) {
+					p += 2;
+					++ps;
+					continue;
+				}
+				break;
+			case '[':
+				if (p[1+(*ps>>3)] & (1<<(*ps&7))) {
+					p += 33;
+					++ps;
+					continue;
+				}
+				break;
+			}
+		}
+		if (!pStar)
+			return false;
+		p = pStar;
+		ps = ++psStar;
+	}
+
+	while (p<pEnd && *p=='*')
+		++p;
+	return p==pEnd;
+}
+
 }   // namespace
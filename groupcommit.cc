@@ -0,0 +1,145 @@
+/* groupcommit.cc -- Coalesced commits of BFiles
+
+Copyright (C) 1997-2013, Brian Bray
+
+*/
+
+#include <condition_variable>
+#include <mutex>
+
+#include "bw/bwassert.h"
+#include "bw/exception.h"
+#include "bw/file.h"
+#include "bw/groupcommit.h"
+
+#include <unistd.h>
+#include <errno.h>
+
+
+namespace bw {
+
+/*: class GroupCommit
+
+	Group commit.  A device flush takes about as long for one small
+	record as for many, so when several threads each write a record and
+	commit it, most of the time goes in flushes that could have been
+	shared.
+
+	commit() hands out a ticket.  If no flush is running the caller
+	starts one, covering every ticket handed out so far.  Otherwise it
+	waits: callers that arrive during a flush are all covered by the
+	next one, started by whichever of them wakes first.  So under load
+	there is one flush for each batch of waiting callers, and each caller
+	waits for at most two flushes.
+
+	With scope FileSystem the flush is syncfs(), so writers of different
+	files on one file system share the flushes too.  (Off Linux this is
+	sync(), which doesn't wait.)
+
+	After a failed flush every commit() throws: the system may have
+	dropped the unwritten data, so a later flush succeeding doesn't mean
+	it is on the device.
+
+	Example:
+		GroupCommit gc( log );
+		// In each writer thread
+		log.writeAt( rec, len, pos );
+		gc.commit();
+*/
+
+/*: GroupCommit::GroupCommit()
+
+	Commits for file, or for the file system holding it.
+
+	Requires: Open file, which outlives the GroupCommit
+*/
+GroupCommit::GroupCommit( const BFile& file, Scope scope )
+	: m_fd(file.m_fd),
+	  m_scope(scope),
+	  m_nRequested(0),
+	  m_nDurable(0),
+	  m_nFlushes(0),
+	  m_isFlushing(false),
+	  m_error(0)
+{
+	bwassert( file.isOpen() );
+}
+
+/*: GroupCommit::commit()
+
+	Returns when everything written to the file (or file system) before
+	the call, by any thread, has reached the device.
+
+	Throws: BFileException if the flush failed, and for all later calls
+*/
+void GroupCommit::commit()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	unsigned long long ticket = ++m_nRequested;
+
+	while (m_nDurable<ticket && m_error==0) {
+		if (m_isFlushing) {
+			m_cv.wait( lock );
+			continue;
+		}
+
+		// Lead a flush for everyone waiting
+		m_isFlushing = true;
+		unsigned long long covered = m_nRequested;
+		lock.unlock();
+
+		int ret;
+#ifdef __linux__
+		if (m_scope==FileSystem)
+			ret = syncfs( m_fd );
+		else
+			ret = fdatasync( m_fd );
+#elif defined(__APPLE__)
+		if (m_scope==FileSystem) {
+			sync();
+			ret = 0;
+		} else
+			ret = fsync( m_fd );
+#else
+		if (m_scope==FileSystem) {
+			sync();
+			ret = 0;
+		} else
+			ret = fdatasync( m_fd );
+#endif
+		int error = ret==0 ? 0 : errno;
+
+		lock.lock();
+		m_isFlushing = false;
+		++m_nFlushes;
+		if (error!=0)
+			m_error = error;
+		else
+			m_nDurable = covered;
+		m_cv.notify_all();
+	}
+
+	if (m_error!=0) {
+		errno = m_error;
+		throw BFileException( BFileException::SystemError );
+	}
+}
+
+/*: GroupCommit::commits()
+
+	Returns the number of commit() calls, or of device flushes
+	(flushes()), so far.  The ratio is the batching achieved.
+*/
+unsigned long long GroupCommit::commits() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_nRequested;
+}
+
+unsigned long long GroupCommit::flushes() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_nFlushes;
+}
+
+}	// namespace bw
@@ -5,12 +5,20 @@ Copyright (C) 1997-2013, Brian Bray
 */
 
 #include <ostream>
+#include <sstream>
+#include <string>
 using std::ostream;
 
 #include "bw/bwassert.h"
 #include "bw/string.h"
 #include "bw/html.h"
 
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 
 
 namespace bw {
@@ -20,14 +28,14 @@ namespace bw {
 
 	Ostream manipulators for writing HTML files.
 
-	Prototype: os << html::httpProlog( const String& sMimeType );
-	Prototype: os << html::prolog( const String& sTitle, const String& sGenerator="bw" );
+	Prototype: os << html::httpProlog( Text sMimeType );
+	Prototype: os << html::prolog( Text sTitle, Text sGenerator="bw" );
 	Prototype: os << html::epilog;
 
-	Prototype: os << html::heading1( const String& sHead );
-	Prototype: os << html::heading2( const String& sHead );
-	Prototype: os << html::heading3( const String& sHead );
-	Prototype: os << html::heading4( const String& sHead );
+	Prototype: os << html::heading1( Text sHead );
+	Prototype: os << html::heading2( Text sHead );
+	Prototype: os << html::heading3( Text sHead );
+	Prototype: os << html::heading4( Text sHead );
 
 	Prototype: os << html::beginTable( int nCols );
 	Prototype: os << html::beginRow;
@@ -38,13 +46,13 @@ namespace bw {
 	Prototype: os << html::endTable;
 
 	Prototype: os << html::beginDefinitionList;
-	Prototype: os << html::definition( const String& sWhat );
+	Prototype: os << html::definition( Text sWhat );
 	Prototype: os << html::endDefinitionList;
 
-	Prototype: os << html::beginLink( const String& sWhere );
-	Prototype: os << html::beginLink2Link( const String& sWhere );
+	Prototype: os << html::beginLink( Text sWhere );
+	Prototype: os << html::beginLink2Link( Text sWhere );
 	Prototype: os << html::endLink;
-	Prototype: os << html::defineLink( const String& sWhere );
+	Prototype: os << html::defineLink( Text sWhere );
 
 	Prototype: os << html::rule;
 	Prototype: os << html::newPara;
@@ -53,8 +61,8 @@ namespace bw {
 	Prototype: os << html::italicOn;
 	Prototype: os << html::italicOff;
 
-	Prototype: os << html::literal( const String& sWhat );
-	Prototype: os << html::smartFormat( const String& sWhat );
+	Prototype: os << html::literal( Text sWhat );
+	Prototype: os << html::smartFormat( Text sWhat );
 
 	Description:
 
@@ -74,6 +82,11 @@ namespace bw {
 	html::smartFormat( foo ) inserts paragraph markers into foo wherever
 	blank lines are found.
 
+	The manipulators with arguments return an html::Emit, which writes
+	straight into the ostream's buffer when streamed:  no String is built
+	for the tag.  They take a String, a C string or a StringView, and an
+	Emit converts to a String for code that builds text up first.
+
 	Here are a few examples to clarify the other ones that are not self evident:
 
 	Definitions:
@@ -100,21 +113,209 @@ namespace bw {
 	<BR>os << endLink;
 
 */
-String html::httpProlog( const String& sMimeType)
+// Internal routines
+
+// Writes n characters to the stream's buffer (inside a sentry)
+static inline void put( ostream& os, const char* p, long n )
+{
+	if (n>0 && os.rdbuf()->sputn( p, n )!=n)
+		os.setstate( std::ios_base::badbit );
+}
+
+static inline void put( ostream& os, const char* psz )
+{
+	put( os, psz, strlen(psz) );
+}
+
+static inline void put( ostream& os, const html::Text& t )
+{
+	put( os, t.m_pch, t.m_nLength );
+}
+
+// The first character at or after p that literal() replaces, or pEnd
+static const char* findSpecial( const char* p, const char* pEnd, bool isMultiLine )
+{
+#ifdef __SSE2__
+	const __m128i lt = _mm_set1_epi8( '<' );
+	const __m128i amp = _mm_set1_epi8( '&' );
+	const __m128i quot = _mm_set1_epi8( '"' );
+	const __m128i nl = _mm_set1_epi8( isMultiLine ? '\n' : '<' );
+	for (; pEnd-p>=16; p+=16) {
+		__m128i v = _mm_loadu_si128( (const __m128i*)p );
+		__m128i m = _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi8(v,lt), _mm_cmpeq_epi8(v,amp) ),
+		                          _mm_or_si128( _mm_cmpeq_epi8(v,quot), _mm_cmpeq_epi8(v,nl) ) );
+		int mask = _mm_movemask_epi8( m );
+		if (mask)
+			return p + __builtin_ctz(mask);
+	}
+#endif
+	for (; p<pEnd; ++p) {
+		char c = *p;
+		if (c=='<' || c=='&' || c=='"' || (c=='\n' && isMultiLine))
+			break;
+	}
+	return p;
+}
+
+// Escapes text, copying the runs between special characters whole
+static void writeLiteral( ostream& os, const char* p, const char* pEnd, bool isMultiLine )
+{
+	for (;;) {
+		const char* pSpecial = findSpecial( p, pEnd, isMultiLine );
+		put( os, p, pSpecial-p );
+		if (pSpecial==pEnd)
+			break;
+		switch (*pSpecial) {
+		case '<':
+			put( os, "&lt;", 4 );
+			break;
+
+		case '&':
+			put( os, "&amp;", 5 );
+			break;
+
+		case '"':
+			put( os, "&quot;", 6 );
+			break;
+
+		case '\n':
+			put( os, "\n<br>", 5 );
+			break;
+		}
+		p = pSpecial+1;
+	}
+}
+
+// Puts "<P>" after the first newline of each blank line
+static void writeSmartFormat( ostream& os, const char* p, const char* pEnd )
 {
-	return "Content-type: " + sMimeType + "\n\n";
+	const char* pRun = p;
+	while (p<pEnd) {
+		const char* pNewline = (const char*)memchr( p, '\n', pEnd-p );
+		if (!pNewline || pNewline+1>=pEnd)
+			break;
+		if (pNewline[1]=='\n') {
+			put( os, pRun, pNewline+1-pRun );
+			put( os, "<P>", 3 );
+			pRun = pNewline+1;
+		}
+		p = pNewline+1;
+	}
+	put( os, pRun, pEnd-pRun );
 }
 
-String html::prolog( const String& sTitle, const String& sGenerator )
+
+html::Text::Text( const char* psz )
+	:   m_pch( psz ),
+	    m_nLength( strlen(psz) )
 {
-	return "<!DOCTYPE html>\n<HTML>\n<HEAD>\n"
-	       "<META HTTP-EQUIV=\"Content-Type\" content=\"text/html; charset=UTF-8\">\n"
-	       "<TITLE>"
-	       + sTitle +
-	       "</TITLE>\n"
-	       "<META name=\"GENERATOR\" content=\""
-	       + sGenerator +
-	       "\">\n<style type=\"text/css\">\n  body { max-width:43em; margin-left:auto; margin-right:auto }\n</style>\n</HEAD>\n<BODY BGCOLOR=white>\n";
+}
+
+/*: html::Emit::write()
+
+  Writes the manipulator's HTML into the stream's buffer.
+
+  Prototype: void html::Emit::write( std::ostream& os ) const
+*/
+void html::Emit::write( ostream& os ) const
+{
+	ostream::sentry ok( os );
+	if (!ok)
+		return;
+
+	switch (m_kind) {
+	case HttpProlog:
+		put( os, "Content-type: " );
+		put( os, m_a );
+		put( os, "\n\n" );
+		break;
+
+	case Prolog:
+		put( os, "<!DOCTYPE html>\n<HTML>\n<HEAD>\n"
+		         "<META HTTP-EQUIV=\"Content-Type\" content=\"text/html; charset=UTF-8\">\n"
+		         "<TITLE>" );
+		put( os, m_a );
+		put( os, "</TITLE>\n"
+		         "<META name=\"GENERATOR\" content=\"" );
+		put( os, m_b );
+		put( os, "\">\n<style type=\"text/css\">\n  body { max-width:43em; margin-left:auto; margin-right:auto }\n</style>\n</HEAD>\n<BODY BGCOLOR=white>\n" );
+		break;
+
+	case Heading: {
+		char achOpen[] = "<H0>";
+		char achClose[] = "</H0>\n";
+		achOpen[2] = achClose[3] = (char)('0'+m_n);
+		put( os, achOpen, 4 );
+		put( os, m_a );
+		put( os, achClose, 6 );
+		break;
+	}
+
+	case BeginTable: {
+		char ach[] = "<TABLE COLS=00>\n";
+		ach[12] = (char)('0'+m_n/10);
+		ach[13] = (char)('0'+m_n%10);
+		put( os, ach, 16 );
+		break;
+	}
+
+	case Definition:
+		put( os, "<DT>", 4 );
+		put( os, m_a );
+		put( os, "\n<DD>", 5 );
+		break;
+
+	case BeginLink:
+		put( os, "<A HREF=\"", 9 );
+		put( os, m_a );
+		put( os, "\">", 2 );
+		break;
+
+	case BeginLink2Link:
+		put( os, "<A HREF=\"#", 10 );
+		put( os, m_a );
+		put( os, "\">", 2 );
+		break;
+
+	case DefineLink:
+		put( os, "<A NAME=\"", 9 );
+		put( os, m_a );
+		put( os, "\"></A>\n", 7 );
+		break;
+
+	case Literal:
+		writeLiteral( os, m_a.m_pch, m_a.m_pch+m_a.m_nLength, m_n!=0 );
+		break;
+
+	case SmartFormat:
+		writeSmartFormat( os, m_a.m_pch, m_a.m_pch+m_a.m_nLength );
+		break;
+	}
+}
+
+/*: html::Emit::operator String()
+
+  The HTML as a String, for code that builds up text before writing it.
+
+  Prototype: html::Emit::operator String() const
+*/
+html::Emit::operator String() const
+{
+	std::ostringstream os;
+	write( os );
+	std::string s = os.str();
+	return String( s.data(), s.size() );
+}
+
+
+html::Emit html::httpProlog( Text sMimeType )
+{
+	return Emit( Emit::HttpProlog, sMimeType );
+}
+
+html::Emit html::prolog( Text sTitle, Text sGenerator )
+{
+	return Emit( Emit::Prolog, sTitle, sGenerator );
 }
 
 ostream& html::epilog( ostream& os )
@@ -123,40 +324,34 @@ ostream& html::epilog( ostream& os )
 	return os;
 }
 
-String html::heading1( const String& sHead )
+html::Emit html::heading1( Text sHead )
 {
-	return "<H1>" + sHead + "</H1>\n";
+	return Emit( Emit::Heading, sHead, "", 1 );
 }
 
-String html::heading2( const String& sHead )
+html::Emit html::heading2( Text sHead )
 {
-	return "<H2>" + sHead + "</H2>\n";
+	return Emit( Emit::Heading, sHead, "", 2 );
 }
 
-String html::heading3( const String& sHead )
+html::Emit html::heading3( Text sHead )
 {
-	return "<H3>" + sHead + "</H3>\n";
+	return Emit( Emit::Heading, sHead, "", 3 );
 }
 
-String html::heading4( const String& sHead )
+html::Emit html::heading4( Text sHead )
 {
-	return "<H4>" + sHead + "</H4>\n";
+	return Emit( Emit::Heading, sHead, "", 4 );
 }
 
 
 
-String html::beginTable( int nCols )
+html::Emit html::beginTable( int nCols )
 {
 	bwassert( nCols>0 );
 	bwassert( nCols<100 );
 
-	String s;
-	s = "<TABLE COLS=";
-	s.append( '0'+nCols/10 );
-	s.append( '0'+nCols%10 );
-	s.append( ">\n" );
-
-	return s;
+	return Emit( Emit::BeginTable, "", "", nCols );
 }
 
 ostream& html::beginRow( ostream& os )
@@ -202,9 +397,9 @@ ostream& html::beginDefinitionList( ostream& os )
 	return os;
 }
 
-String html::definition( const String& sWhat )
+html::Emit html::definition( Text sWhat )
 {
-	return "<DT>" + sWhat + "\n<DD>";
+	return Emit( Emit::Definition, sWhat );
 }
 
 ostream& html::endDefinitionList( ostream& os )
@@ -214,14 +409,14 @@ ostream& html::endDefinitionList( ostream& os )
 }
 
 
-String html::beginLink( const String& sWhere )
+html::Emit html::beginLink( Text sWhere )
 {
-	return "<A HREF=\"" + sWhere + "\">";
+	return Emit( Emit::BeginLink, sWhere );
 }
 
-String html::beginLink2Link( const String& sWhere )
+html::Emit html::beginLink2Link( Text sWhere )
 {
-	return "<A HREF=\"#" + sWhere + "\">";
+	return Emit( Emit::BeginLink2Link, sWhere );
 }
 
 ostream& html::endLink( ostream& os )
@@ -230,9 +425,9 @@ ostream& html::endLink( ostream& os )
 	return os;
 }
 
-String html::defineLink( const String& sWhere )
+html::Emit html::defineLink( Text sWhere )
 {
-	return "<A NAME=\"" + sWhere + "\"></A>\n";
+	return Emit( Emit::DefineLink, sWhere );
 }
 
 
@@ -273,51 +468,14 @@ ostream& html::italicOff( ostream& os )
 }
 
 
-String html::literal( const String& sWhat, bool isMultiLine )
+html::Emit html::literal( Text sWhat, bool isMultiLine )
 {
-	String s;
-
-	int len = sWhat.length();
-	for (int i=0; i<len; ++i) {
-		switch (sWhat[i]) {
-		case '<':
-			s.append("&lt;");
-			break;
-
-		case '&':
-			s.append("&amp;");
-			break;
-
-		case '"':
-			s.append("&quot;");
-			break;
-
-		case '\n':
-			s.append("\n");
-			if (isMultiLine)
-				s.append("<br>");
-			break;
-
-		default:
-			s.append( sWhat[i] );
-		}
-	}
-	return s;
+	return Emit( Emit::Literal, sWhat, "", isMultiLine );
 }
 
-String html::smartFormat( const String& sWhat )
+html::Emit html::smartFormat( Text sWhat )
 {
-	String s;
-	int		iS = 0;
-	int		indx;
-
-	while ( (indx=iS+sWhat.substring(iS).indexOf("\n\n"))>=iS ) {
-		s.append( sWhat.substring(iS,indx+1) + "<P>" );
-		iS = indx+1;
-	}
-	s.append( sWhat.substring(iS) );
-
-	return s;
+	return Emit( Emit::SmartFormat, sWhat );
 }
 
 }	// namespace bw
@@ -5,60 +5,38 @@ Copyright (C) 1997-2013, Brian Bray
 
 */
 
+#include <functional>
 #include <map>
+#include <iostream>
 #include <sstream>
+#include <string>
+#include <vector>
 
 #define NOTRACE
 #include "bw/trace.h"
-#include "bw/http.h"
 #include "bw/exception.h"
 #include "bw/bwassert.h"
 #include "bw/string.h"
+#include "bw/http.h"
+#include "bw/multipart.h"
 
 #include <cstdlib>
 #include <cstring>
 #include <cctype>
+#include <cerrno>
 
 
 
 extern char **environ;
 
-#define INBUFSIZE 4000
-
 namespace bw {
 
-using std::map;
-using std::istream;
+// Compilation time options
 
-// internal routines
-bool allspace(const char* psz)
-{
-	while(isspace(*psz))
-		++psz;
-	return *psz=='\0';
-}
-
-bool startstr(const char* buf, const char* prefix)
-{
-	return strncmp(buf,prefix,strlen(prefix))==0;
-}
+const size_t maxFileInMemory = 65535;	// Largest upload parseMultiData() keeps (as a String)
 
-String extractkey(const char* buf, const String key)
-{
-	String res = buf;
-	int loc = res.indexOf(key+"=");
-	if (loc<0)
-		return "";
-	res = res.substring(loc+key.length()+1);
-	if (res[0]=='"') {
-		res = res.substring(1);
-		loc = res.indexOf('"');
-		if (loc>=0)
-			res = res.substring(0,loc);
-	}
-	trace << "Extracting " << key << " from " << buf << " :" << res << std::endl;
-	return res;
-}
+using std::map;
+using std::istream;
 
 map< String, String > getAnyData()
 {
@@ -92,128 +70,450 @@ map< String, String > getPostData()
 map< String, String > getGetData()
 {
 	char *psz = getenv("QUERY_STRING");
-	if (psz) {
-		std::istringstream is(psz);
-		return parseHTTPData(is);
-	}
+	if (psz)
+		return parseHTTPData( StringView( psz, strlen(psz) ) );
 	map< String, String > nullmap;
 	return nullmap;
 }
 
+/*: getMultiData()
+
+  Parses a multipart/form-data POST from cin (see parseMultiData()).
+*/
 map< String, String > getMultiData()
 {
-	using std::cin;
-	using std::endl;
-
-	String divide;
-	char inbuf[INBUFSIZE];
-	String keyword;
-	String filename;
-	map< String, String > res;
-
-	char *contenttype = getenv("CONTENT_TYPE");
-	if (contenttype) {
-		trace << "Content type is \"" << contenttype << "\"." << endl;
-		String str = contenttype;
-		if (startstr(contenttype,"multipart/form-data;"))
-			divide = extractkey(str,"boundary");
-	}
-	if (divide=="") {
+	return parseMultiData( std::cin, getenv("CONTENT_TYPE") );
+}
+
+/*: parseMultiData()
+
+  Parses a multipart/form-data body with MultipartParser.  Uploaded
+  files are kept in memory, as they always were:  the field's value is
+  the file's contents and field_name holds the name the browser sent.
+  Nothing is left on disk for callers to remove, so a file larger than
+  a String holds is refused.  Programs taking larger uploads use
+  MultipartParser directly, which can store them in files.
+
+  Prototype: map< String, String > parseMultiData(std::istream& is, const char* pszContentType)
+  Throws: BFormatException if the data is malformed or a file too large
+*/
+map< String, String > parseMultiData( std::istream& is, const char* pszContentType )
+{
+	String boundary = MultipartParser::boundaryOf( pszContentType );
+	if (boundary=="") {
 		throw BFormatException("Incorrect data format");
 	}
-
-	divide = "--" + divide;
-	*inbuf = '\0';
-	while( cin && !startstr(inbuf,divide) )
-		cin.getline( inbuf, INBUFSIZE );
-	while (cin) {
-		bool inheader=true;
-		keyword = "";
-		filename = "";
-		while( cin && inheader) {
-			cin.getline( inbuf, INBUFSIZE );
-			if (allspace(inbuf)) {
-				inheader = false;
-			} else if (startstr(inbuf,"Content-Disposition:")) {
-				keyword = extractkey(inbuf,"name");
-				filename = extractkey(inbuf,"filename");
-			}
-			// Other header lines ignored
+	trace << "Multipart boundary is \"" << boundary << "\"." << std::endl;
+
+	MultipartParser mp( boundary );
+	std::string file;
+	mp.setFileHandler( [&]( const MultipartParser::Part& part, const char* p, size_t n, bool isEnd ) {
+		if (!isEnd) {
+			if (file.size()+n>maxFileInMemory)
+				throw BFormatException("Uploaded file too large");
+			file.append( p, n );
+			return;
 		}
-		if (cin && keyword=="")
-			throw BFormatException("Multipart data format error");
-		if (filename!="")
-			res[keyword+"_name"] = filename;
-
-		// Data starts with next input line
-		while( cin && !inheader) {
-			cin.getline( inbuf, INBUFSIZE );
-			if (startstr( inbuf, divide ))
-				inheader = true;
-			else {
-				int lastloc = strlen(inbuf)-1;
-				if (inbuf[lastloc]=='\r')
-					inbuf[lastloc] = '\0';
-				res[keyword] = res[keyword] + inbuf + "\n";
-			}
-		}
-		if (keyword!="")
-			trace << "Read " << keyword << "=" << res[keyword] << endl;
-	}
-	trace << "Exiting multiread" << endl;
-	return res;
+		mp.fields()[part.name] = String( file.data(), file.size() );
+		mp.fields()[part.name+"_name"] = part.fileName;
+		file.clear();
+	} );
+	mp.parse( is );
+	return mp.fields();
 }
 
 
-String getValue(istream& is , char term)
+// Value of each character as a hex digit, or -1
+static const signed char hexValue[256] = {
+	-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+	-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+	-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+	 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,-1,-1,-1,-1,-1,-1,
+	-1,10,11,12,13,14,15,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+	-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+	-1,10,11,12,13,14,15,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+	-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+	-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+	-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+	-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+	-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+	-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+	-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+	-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+	-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1
+};
+
+/* The first '%', '+' or NUL at or after p, or pEnd */
+static inline const char* findEscape(const char* p, const char* pEnd)
 {
-	const String digits("0123456789ABCDEF");
-	char ic;
-	int nc1, nc2;
-	String ret;
-	while (is.get(ic)) {
-		if (ic==term)
+	while (p<pEnd && *p!='%' && *p!='+' && *p!='\0')
+		++p;
+	return p;
+}
+
+/*: decodeURLComponent()
+
+  Decodes a key or value of form data.  Most have no escapes, so the
+  input is scanned first and returned as it is if there are none.
+  Otherwise the runs between escapes are copied to buf whole and the
+  escapes decoded with a table.
+
+  Prototype: StringView decodeURLComponent(StringView in, std::string& buf)
+  Throws: BFormatException on a bad escape or a NUL character
+*/
+StringView decodeURLComponent(StringView in, std::string& buf)
+{
+	const char* p = in.data();
+	const char* pEnd = p+in.length();
+	const char* pEscape = findEscape( p, pEnd );
+	if (pEscape==pEnd)
+		return in;
+
+	buf.clear();
+	for (;;) {
+		buf.append( p, pEscape-p );
+		if (pEscape==pEnd)
 			break;
-		if (ic=='%') {
-			if (!is.get(ic))
-				break;
-			nc1 = digits.indexOf(toupper(ic));
-			if (!is.get(ic))
-				break;
-			nc2 = digits.indexOf(toupper(ic));
-			if (nc1==-1 || nc2==-1)
+		p = pEscape;
+		if (*p=='+') {
+			buf += ' ';
+			++p;
+		} else if (*p=='%') {
+			if (pEnd-p<3)
 				throw BFormatException("Invalid hex digit");
-			ic = (char)( (nc1<<4) | nc2 );
-		} else if (ic=='+') {
-			ic = ' ';
-		}
-		if (ic=='\0')
+			int nHigh = hexValue[(unsigned char)p[1]];
+			int nLow = hexValue[(unsigned char)p[2]];
+			if (nHigh<0 || nLow<0)
+				throw BFormatException("Invalid hex digit");
+			char c = (char)( (nHigh<<4) | nLow );
+			if (c=='\0')
+				throw BFormatException("Null character in input");
+			buf += c;
+			p += 3;
+		} else {
 			throw BFormatException("Null character in input");
-
-		ret.append(ic);
+		}
+		pEscape = findEscape( p, pEnd );
 	}
+	return StringView( buf.data(), buf.size() );
+}
+
+/*: parseHTTPData()
 
-	return ret;
+  Splits form data into pairs at '&' and each pair at the first '=', and
+  decodes them with decodeURLComponent().  A pair without '=' has an
+  empty value.
+
+  Prototype: void parseHTTPData(StringView data, const FormFn& fn)
+  Throws: BFormatException on a bad escape or a NUL character
+*/
+void parseHTTPData(StringView data, const FormFn& fn)
+{
+	std::string keyBuf;
+	std::string valueBuf;
+	const char* p = data.data();
+	const char* pEnd = p+data.length();
+	while (p<pEnd) {
+		const char* pPairEnd = (const char*)memchr( p, '&', pEnd-p );
+		if (!pPairEnd)
+			pPairEnd = pEnd;
+		const char* pEquals = (const char*)memchr( p, '=', pPairEnd-p );
+		StringView key;
+		StringView value;
+		if (pEquals) {
+			key = decodeURLComponent( StringView( p, pEquals-p ), keyBuf );
+			value = decodeURLComponent( StringView( pEquals+1, pPairEnd-pEquals-1 ), valueBuf );
+		} else {
+			key = decodeURLComponent( StringView( p, pPairEnd-p ), keyBuf );
+		}
+		if (!key.isEmpty())
+			fn( key, value );
+		p = pPairEnd+1;
+	}
 }
 
+map< String, String > parseHTTPData(StringView data)
+{
+	map< String, String > varmap;
+	parseHTTPData( data, [&varmap]( StringView key, StringView value ) {
+		varmap[String( key.data(), key.length() )] = String( value.data(), value.length() );
+	} );
+	return varmap;
+}
 
 map< String, String > parseHTTPData(istream& is)
 {
-	map< String, String > varmap;
-	String key;
-	String value;
-
-	while (is) {
-		key = getValue( is, '=' );
-		value = getValue( is, '&' );
-		if (key!="")
-			varmap[key] = value;
-	}
+	return FormParams( is ).toMap();
+}
+
 
+/*: class FormParams
+
+  Form data, looked up a key at a time.  parseHTTPData() decodes every
+  pair into a map, which is wasted on a handler that reads one or two
+  of them.  FormParams only finds where the pairs are (on the first
+  lookup) and decodes the ones asked for.  Unlike the map, keys sent
+  more than once keep every value (see getAll()).
+
+  Lookups are linear in the number of pairs; keys without escapes are
+  compared in place.
+
+  Example:
+	FormParams params( StringView( pszQuery, strlen(pszQuery) ) );
+	long nPage = params.getLong( "page", 1 );
+	std::vector< String > tags = params.getAll( "tag" );
+*/
+
+FormParams::FormParams()
+	:   m_pExternal( "" ),
+	    m_nLength( 0 ),
+	    m_isIndexed( false )
+{
+}
+
+FormParams::FormParams( StringView data )
+	:   m_pExternal( data.data() ),
+	    m_nLength( data.length() ),
+	    m_isIndexed( false )
+{
+}
+
+/*: FormParams::FormParams( std::istream& )
+
+  Reads the rest of the stream and keeps it.
+
+  Throws: BFormatException on an I/O error
+*/
+FormParams::FormParams( std::istream& is )
+	:   m_pExternal( 0 ),
+	    m_isIndexed( false )
+{
+	char buf[4096];
+	while (is.read( buf, sizeof(buf) ) || is.gcount()>0)
+		m_owned.append( buf, is.gcount() );
 	if (!is.eof())
 		throw BFormatException("Unexpected I/O error");
+	m_nLength = m_owned.size();
+}
 
-	return varmap;
+/* Finds the pairs, without decoding them */
+void FormParams::index() const
+{
+	m_isIndexed = true;
+	const char* pData = data();
+	const char* p = pData;
+	const char* pEnd = p+m_nLength;
+	while (p<pEnd) {
+		const char* pPairEnd = (const char*)memchr( p, '&', pEnd-p );
+		if (!pPairEnd)
+			pPairEnd = pEnd;
+		const char* pEquals = (const char*)memchr( p, '=', pPairEnd-p );
+		const char* pKeyEnd = pEquals ? pEquals : pPairEnd;
+		if (pKeyEnd>p) {
+			Entry e;
+			e.nKey = p-pData;
+			e.nKeyLength = pKeyEnd-p;
+			e.nValue = pEquals ? pEquals+1-pData : pPairEnd-pData;
+			e.nValueLength = pPairEnd-pData-e.nValue;
+			e.isKeyEncoded = findEscape( p, pKeyEnd )!=pKeyEnd;
+			m_entries.push_back( e );
+		}
+		p = pPairEnd+1;
+	}
+}
+
+/* The index of the first entry from nFrom on with key pszKey, or -1 */
+int FormParams::find( const char* pszKey, int nFrom ) const
+{
+	if (!m_isIndexed)
+		index();
+	const char* pData = data();
+	int len = strlen( pszKey );
+	std::string buf;
+	for (int i=nFrom; i<(int)m_entries.size(); ++i) {
+		const Entry& e = m_entries[i];
+		if (!e.isKeyEncoded) {
+			if (e.nKeyLength==len && memcmp( pData+e.nKey, pszKey, len )==0)
+				return i;
+		} else if (decodeURLComponent( StringView( pData+e.nKey, e.nKeyLength ), buf )==pszKey) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+StringView FormParams::valueView( int i, std::string& buf ) const
+{
+	const Entry& e = m_entries[i];
+	return decodeURLComponent( StringView( data()+e.nValue, e.nValueLength ), buf );
+}
+
+/*: FormParams::has()
+
+  Prototype: bool FormParams::has( const char* pszKey ) const
+*/
+bool FormParams::has( const char* pszKey ) const
+{
+	return find( pszKey, 0 )>=0;
+}
+
+/*: FormParams::get()
+
+  Prototype: String FormParams::get( const char* pszKey, const char* pszDefault="" ) const
+*/
+String FormParams::get( const char* pszKey, const char* pszDefault ) const
+{
+	int i = find( pszKey, 0 );
+	if (i<0)
+		return pszDefault;
+	std::string buf;
+	StringView v = valueView( i, buf );
+	return String( v.data(), v.length() );
+}
+
+/*: FormParams::getView()
+
+  Prototype: StringView FormParams::getView( const char* pszKey, std::string& buf ) const
+*/
+StringView FormParams::getView( const char* pszKey, std::string& buf ) const
+{
+	int i = find( pszKey, 0 );
+	if (i<0)
+		return StringView();
+	return valueView( i, buf );
+}
+
+/*: FormParams::getAll()
+
+  Prototype: std::vector< String > FormParams::getAll( const char* pszKey ) const
+*/
+std::vector< String > FormParams::getAll( const char* pszKey ) const
+{
+	std::vector< String > values;
+	std::string buf;
+	for (int i=find( pszKey, 0 ); i>=0; i=find( pszKey, i+1 )) {
+		StringView v = valueView( i, buf );
+		values.push_back( String( v.data(), v.length() ) );
+	}
+	return values;
+}
+
+/*: FormParams::getLong()
+
+  The value as a decimal integer, with an optional sign.
+
+  Throws: BFormatException if it isn't one, or is out of range
+*/
+long FormParams::getLong( const char* pszKey, long nDefault ) const
+{
+	std::string buf;
+	StringView v = getView( pszKey, buf );
+	if (v.isEmpty())
+		return nDefault;
+	std::string value( v.data(), v.length() );
+	char* pEnd;
+	errno = 0;
+	long n = strtol( value.c_str(), &pEnd, 10 );
+	if (*pEnd!='\0' || errno==ERANGE || isspace( (unsigned char)value[0] ))
+		throw BFormatException("Not an integer");
+	return n;
+}
+
+/*: FormParams::getDouble()
+
+  Throws: BFormatException if the value isn't a number
+*/
+double FormParams::getDouble( const char* pszKey, double dDefault ) const
+{
+	std::string buf;
+	StringView v = getView( pszKey, buf );
+	if (v.isEmpty())
+		return dDefault;
+	std::string value( v.data(), v.length() );
+	char* pEnd;
+	errno = 0;
+	double d = strtod( value.c_str(), &pEnd );
+	if (*pEnd!='\0' || errno==ERANGE || isspace( (unsigned char)value[0] ))
+		throw BFormatException("Not a number");
+	return d;
+}
+
+/*: FormParams::getBool()
+
+  Throws: BFormatException if the value isn't 1/0, true/false, yes/no or on/off
+*/
+bool FormParams::getBool( const char* pszKey, bool isDefault ) const
+{
+	std::string buf;
+	StringView v = getView( pszKey, buf );
+	if (v.isEmpty())
+		return isDefault;
+	if (v=="1" || v.equalsIgnoreCase( "true" ) || v.equalsIgnoreCase( "yes" ) || v.equalsIgnoreCase( "on" ))
+		return true;
+	if (v=="0" || v.equalsIgnoreCase( "false" ) || v.equalsIgnoreCase( "no" ) || v.equalsIgnoreCase( "off" ))
+		return false;
+	throw BFormatException("Not a boolean");
+}
+
+/*: FormParams::size()
+
+  Prototype: int FormParams::size() const
+*/
+int FormParams::size() const
+{
+	if (!m_isIndexed)
+		index();
+	return m_entries.size();
+}
+
+String FormParams::key( int i ) const
+{
+	if (!m_isIndexed)
+		index();
+	bwassert( i>=0 && i<(int)m_entries.size() );
+	const Entry& e = m_entries[i];
+	std::string buf;
+	StringView v = decodeURLComponent( StringView( data()+e.nKey, e.nKeyLength ), buf );
+	return String( v.data(), v.length() );
+}
+
+String FormParams::value( int i ) const
+{
+	if (!m_isIndexed)
+		index();
+	bwassert( i>=0 && i<(int)m_entries.size() );
+	std::string buf;
+	StringView v = valueView( i, buf );
+	return String( v.data(), v.length() );
+}
+
+/*: FormParams::toMap()
+
+  Prototype: std::map< String, String > FormParams::toMap() const
+*/
+std::map< String, String > FormParams::toMap() const
+{
+	return parseHTTPData( StringView( data(), m_nLength ) );
+}
+
+/*: getFormParams()
+
+  The form data of a CGI request, as getAnyData() without multipart
+  (which has no parameters here).
+*/
+FormParams getFormParams()
+{
+	const char* pszMethod = getenv("REQUEST_METHOD");
+	if (pszMethod && strcmp( pszMethod, "GET" )==0) {
+		const char* psz = getenv("QUERY_STRING");
+		if (psz)
+			return FormParams( StringView( psz, strlen(psz) ) );
+	} else if (pszMethod && strcmp( pszMethod, "POST" )==0) {
+		const char* pszType = getenv("CONTENT_TYPE");
+		if (!pszType || strncmp( pszType, "multipart/", 10 )!=0)
+			return FormParams( std::cin );
+	}
+	return FormParams();
 }
 
 }	// namespace bw
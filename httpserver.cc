@@ -0,0 +1,923 @@
+/* httpserver.cc -- embedded HTTP/1.1 server
+
+Copyright (C) 1997-2013, Brian Bray
+
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <exception>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "bw/bwassert.h"
+#include "bw/exception.h"
+#include "bw/string.h"
+#include "bw/http.h"
+#include "bw/httpserver.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+
+namespace bw {
+
+// Compilation time options
+
+const size_t readSize = 64*1024;		// Bytes read from a connection at a time
+const size_t maxHeaderBytes = 16*1024;	// Request line and headers
+const size_t maxBodyBytes = 1024*1024;	// Content-Length accepted
+const size_t outHighWater = 256*1024;	// Unsent bytes at which reading stops
+const int maxEvents = 256;
+const int listenBacklog = 1024;
+const int idleTimeoutMillisecs = 60*1000;	// Waiting for the next request
+const int requestTimeoutMillisecs = 30*1000;	// Receiving a request, or with output not moving
+const int sweepMillisecs = 1000;		// Most time between checks of the deadlines
+
+
+/*: class HTTPServer
+
+  A small HTTP/1.1 server to embed in a program, for an admin page, an
+  API or a browser front end, without a web server and FastCGI in front.
+
+  One thread serves every connection:  the sockets are non-blocking and
+  epoll says which are ready.  Connections are kept alive (HTTP/1.1, or
+  HTTP/1.0 asking for it) and a client may pipeline requests:  each
+  complete request in the buffer is answered, in order, and the answers
+  go out in as few writes as possible.  While a client isn't reading its
+  answers, its requests aren't read either.
+
+  Requests are parsed where they lie in the input buffer:  the method,
+  target and headers are StringViews into it, so nothing is copied or
+  allocated to parse a request.  The response body is built in a buffer
+  kept by the server and reused.
+
+  Request bodies need a Content-Length (chunked bodies get 501).  The
+  server adds Content-Length, Date and Connection to each response.
+
+  Connections that wait too long for their next request, take too long
+  to send a request (counted from its first byte, so a client can't
+  keep one open by trickling bytes) or stop taking their answers are
+  closed (see setTimeouts()).  If the process runs out of descriptors,
+  accepting stops until a connection closes or the next check of the
+  deadlines, instead of epoll reporting the waiting client over and
+  over.
+
+  Example:
+	HTTPServer server( ":8080" );
+	server.run( []( const HTTPRequest& req, HTTPResponse& resp ) {
+		std::map< String, String > form = req.form();
+		resp.addHeader( "Content-Type", "text/html" );
+		resp.out() << "<p>Hello " << form["name"] << "</p>";
+	} );
+*/
+
+/* Appends to a std::string, for HTTPResponse::out() */
+class BodyBuf : public std::streambuf {
+public:
+	BodyBuf( std::string& s ) : m_str( s ) {}
+
+protected:
+	int_type overflow( int_type c ) {
+		if (c!=traits_type::eof())
+			m_str += (char)c;
+		return traits_type::not_eof( c );
+	}
+	std::streamsize xsputn( const char* p, std::streamsize n ) {
+		m_str.append( p, n );
+		return n;
+	}
+
+private:
+	std::string&	m_str;
+};
+
+/* Standard reason phrases */
+static const char* reasonOf( int nStatus )
+{
+	switch (nStatus) {
+	case 200: return "OK";
+	case 201: return "Created";
+	case 204: return "No Content";
+	case 301: return "Moved Permanently";
+	case 302: return "Found";
+	case 303: return "See Other";
+	case 304: return "Not Modified";
+	case 400: return "Bad Request";
+	case 401: return "Unauthorized";
+	case 403: return "Forbidden";
+	case 404: return "Not Found";
+	case 405: return "Method Not Allowed";
+	case 411: return "Length Required";
+	case 413: return "Payload Too Large";
+	case 431: return "Request Header Fields Too Large";
+	case 500: return "Internal Server Error";
+	case 501: return "Not Implemented";
+	case 503: return "Service Unavailable";
+	}
+	return "Unknown";
+}
+
+/* Whether a comma separated header value has token, ignoring case */
+static bool hasToken( StringView v, const char* pszToken )
+{
+	int len = strlen( pszToken );
+	const char* p = v.data();
+	const char* pEnd = p+v.length();
+	while (p<pEnd) {
+		while (p<pEnd && (*p==' ' || *p=='\t' || *p==','))
+			++p;
+		const char* pStart = p;
+		while (p<pEnd && *p!=',')
+			++p;
+		const char* pLast = p;
+		while (pLast>pStart && (pLast[-1]==' ' || pLast[-1]=='\t'))
+			--pLast;
+		if (pLast-pStart==len && strncasecmp( pStart, pszToken, len )==0)
+			return true;
+	}
+	return false;
+}
+
+
+/*: HTTPRequest::header()
+
+  Looks a header up by name, ignoring case.  Headers sent more than once
+  (other than Set-Cookie, which requests don't have) can be found with
+  numHeaders(), headerName() and headerValue().
+
+  Prototype: StringView HTTPRequest::header( const char* pszName ) const
+*/
+StringView HTTPRequest::header( const char* pszName ) const
+{
+	for (int i=0; i<m_nHeaders; ++i) {
+		if (m_aHeaders[i].name.equalsIgnoreCase( pszName ))
+			return m_aHeaders[i].value;
+	}
+	return StringView();
+}
+
+/* The query, or an application/x-www-form-urlencoded POST body */
+StringView HTTPRequest::formData() const
+{
+	if (m_method=="POST") {
+		StringView type = header( "Content-Type" );
+		const char* pszForm = "application/x-www-form-urlencoded";
+		int len = strlen( pszForm );
+		if (type.length()>=len && strncasecmp( type.data(), pszForm, len )==0)
+			return m_body;
+	}
+	return m_query;
+}
+
+/*: HTTPRequest::form()
+
+  Decodes the form data:  an application/x-www-form-urlencoded POST body,
+  or else the query string.
+
+  Throws: BFormatException if the data is malformed
+*/
+std::map< String, String > HTTPRequest::form() const
+{
+	return parseHTTPData( formData() );
+}
+
+/*: HTTPRequest::params()
+
+  As form(), but decoding only what the handler asks for.
+
+  Prototype: FormParams HTTPRequest::params() const
+*/
+FormParams HTTPRequest::params() const
+{
+	return FormParams( formData() );
+}
+
+
+HTTPResponse::HTTPResponse( std::ostream& os, std::string& body )
+	:   m_nStatus( 200 ),
+	    m_pszReason( 0 ),
+	    m_pOut( &os ),
+	    m_pBody( &body )
+{
+}
+
+/*: HTTPResponse::setStatus()
+
+  Prototype: void HTTPResponse::setStatus( int nStatus, const char* pszReason=0 )
+*/
+void HTTPResponse::setStatus( int nStatus, const char* pszReason )
+{
+	bwassert( nStatus>=100 && nStatus<=999 );
+	m_nStatus = nStatus;
+	m_pszReason = pszReason;
+}
+
+/*: HTTPResponse::addHeader()
+
+  Prototype: void HTTPResponse::addHeader( const char* pszName, const char* pszValue )
+*/
+void HTTPResponse::addHeader( const char* pszName, const char* pszValue )
+{
+	m_headers += pszName;
+	m_headers += ": ";
+	m_headers += pszValue;
+	m_headers += "\r\n";
+}
+
+/*: HTTPResponse::write()
+
+  Prototype: void HTTPResponse::write( const char* p, size_t n )
+*/
+void HTTPResponse::write( const char* p, size_t n )
+{
+	m_pOut->flush();
+	m_pBody->append( p, n );
+}
+
+
+#ifdef __linux__
+
+/* One client connection */
+struct HTTPConnection {
+	enum Phase { Idle, Receiving, Sending, New };
+
+	HTTPConnection( int fd ) : fd( fd ), nIn( 0 ), nOutSent( 0 ), events( EPOLLIN ), isClosing( false ),
+	                           phase( New ), msDeadline( 0 ) {}
+
+	int		fd;
+	std::vector<char>	in;		// Received, from in[0] to in[nIn]
+	size_t	nIn;
+	std::string	out;		// To send, from out[nOutSent]
+	size_t	nOutSent;
+	unsigned	events;		// Registered with epoll
+	bool	isClosing;		// Close once out is sent
+	Phase	phase;			// What msDeadline is for
+	long long	msDeadline;	// When it's closed, on the monotonic clock
+};
+
+/* Milliseconds on the monotonic clock */
+static long long monotonicMillisecs()
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec*1000LL + ts.tv_nsec/1000000;
+}
+
+class ServerState {
+public:
+	ServerState() : fdListen( -1 ), fdEpoll( -1 ), fdWake( -1 ), nPort( 0 ), isStopped( false ),
+	                nIdleMs( idleTimeoutMillisecs ), nRequestMs( requestTimeoutMillisecs ),
+	                msNow( 0 ), isListenPaused( false ), nHeaderTime( 0 ), bodybuf( body ), os( &bodybuf ) {}
+
+	void serve( HTTPServer::Handler& fn, std::atomic<unsigned long long>& nRequests );
+	void closeAll();
+
+	int		fdListen;
+	int		fdEpoll;
+	int		fdWake;
+	int		nPort;
+	std::atomic<bool>	isStopped;
+	int		nIdleMs;
+	int		nRequestMs;
+
+private:
+	void accept();
+	void listen( bool isOn );
+	void sweep();
+	void setDeadline( HTTPConnection* pc, bool isSent );
+	void readable( HTTPConnection* pc );
+	bool answer( HTTPConnection* pc );
+	bool flush( HTTPConnection* pc );
+	void update( HTTPConnection* pc );
+	void close( HTTPConnection* pc );
+	size_t parse( HTTPConnection* pc, size_t nStart, HTTPRequest& req, int& nError );
+	void respond( HTTPConnection* pc, const HTTPRequest& req, HTTPResponse& resp );
+	void error( HTTPConnection* pc, int nStatus );
+	void dateHeader();
+
+	std::map< int, HTTPConnection* >	conns;
+	HTTPServer::Handler*	pfn;
+	std::atomic<unsigned long long>*	pnRequests;
+	long long	msNow;			// When epoll_wait() last returned
+	bool	isListenPaused;		// Out of descriptors
+
+	time_t	nHeaderTime;		// When dateLine was made
+	char	dateLine[64];	// "Date: ...\r\n"
+	std::string	body;		// The body of the response being built
+	BodyBuf	bodybuf;
+	std::ostream	os;
+};
+
+/* Refreshes the cached Date header, once a second */
+void ServerState::dateHeader()
+{
+	time_t now = time( 0 );
+	if (now==nHeaderTime)
+		return;
+	nHeaderTime = now;
+	struct tm tm;
+	gmtime_r( &now, &tm );
+	strftime( dateLine, sizeof(dateLine), "Date: %a, %d %b %Y %H:%M:%S GMT\r\n", &tm );
+}
+
+void ServerState::serve( HTTPServer::Handler& fn, std::atomic<unsigned long long>& nRequests )
+{
+	pfn = &fn;
+	pnRequests = &nRequests;
+	struct epoll_event aEvents[maxEvents];
+	int nSweepMs = std::max( 1, std::min( sweepMillisecs, std::min( nIdleMs, nRequestMs )/2 ) );
+	msNow = monotonicMillisecs();
+	long long msSweep = msNow+nSweepMs;
+	while (!isStopped) {
+		int n = epoll_wait( fdEpoll, aEvents, maxEvents, (int)std::max( 0LL, msSweep-msNow ) );
+		if (n<0) {
+			if (errno!=EINTR)
+				throw BFileException( BFileException::SystemError );
+			n = 0;
+		}
+		msNow = monotonicMillisecs();
+		dateHeader();
+		for (int i=0; i<n && !isStopped; ++i) {
+			void* p = aEvents[i].data.ptr;
+			if (p==&fdListen) {
+				accept();
+			} else if (p==&fdWake) {
+				uint64_t count;
+				bwverify( ::read( fdWake, &count, sizeof(count) )==sizeof(count) );
+			} else {
+				HTTPConnection* pc = (HTTPConnection*)p;
+				if (aEvents[i].events & (EPOLLERR | EPOLLHUP) && !(aEvents[i].events & EPOLLIN)) {
+					close( pc );
+					continue;
+				}
+				if ((aEvents[i].events & EPOLLOUT) && (!flush( pc ) || !answer( pc )))
+					continue;
+				if (aEvents[i].events & EPOLLIN)
+					readable( pc );
+			}
+		}
+
+		// After the events, which may be for connections it closes
+		if (msNow>=msSweep) {
+			sweep();
+			msSweep = msNow+nSweepMs;
+		}
+	}
+}
+
+void ServerState::accept()
+{
+	for (;;) {
+		int fd = ::accept4( fdListen, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC );
+		if (fd<0) {
+			if (errno==EINTR || errno==ECONNABORTED)
+				continue;
+			if (errno==EMFILE || errno==ENFILE || errno==ENOBUFS || errno==ENOMEM) {
+				// The client stays queued, and the listening socket stays
+				// readable, so stop asking until a descriptor is free
+				listen( false );
+			}
+			return;
+		}
+		int on = 1;
+		setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on) );
+		HTTPConnection* pc = new HTTPConnection( fd );
+		struct epoll_event ev;
+		ev.events = pc->events;
+		ev.data.ptr = pc;
+		if (epoll_ctl( fdEpoll, EPOLL_CTL_ADD, fd, &ev )<0) {
+			::close( fd );
+			delete pc;
+			continue;
+		}
+		conns[fd] = pc;
+		setDeadline( pc, false );
+	}
+}
+
+/* Starts or stops epoll reporting connections waiting to be accepted */
+void ServerState::listen( bool isOn )
+{
+	if (isOn==!isListenPaused)
+		return;			// Already so
+	struct epoll_event ev;
+	ev.events = isOn ? EPOLLIN : 0;
+	ev.data.ptr = &fdListen;
+	if (epoll_ctl( fdEpoll, EPOLL_CTL_MOD, fdListen, &ev )==0)
+		isListenPaused = !isOn;
+}
+
+/* Closes the connections past their deadlines, and tries accepting again */
+void ServerState::sweep()
+{
+	std::map< int, HTTPConnection* >::iterator it = conns.begin();
+	while (it!=conns.end()) {
+		HTTPConnection* pc = (it++)->second;
+		if (pc->msDeadline<=msNow)
+			close( pc );
+	}
+	listen( true );
+}
+
+/* Sets the connection's deadline for what it's doing:  waiting for a
+   request, receiving one (from its first byte, however slowly the rest
+   comes) or sending (from the last progress) */
+void ServerState::setDeadline( HTTPConnection* pc, bool isSent )
+{
+	HTTPConnection::Phase phase = HTTPConnection::Idle;
+	if (pc->out.size()>pc->nOutSent)
+		phase = HTTPConnection::Sending;
+	else if (pc->nIn>0)
+		phase = HTTPConnection::Receiving;
+	if (phase!=pc->phase || (phase==HTTPConnection::Sending && isSent)) {
+		pc->phase = phase;
+		pc->msDeadline = msNow + (phase==HTTPConnection::Idle ? nIdleMs : nRequestMs);
+	}
+}
+
+void ServerState::close( HTTPConnection* pc )
+{
+	epoll_ctl( fdEpoll, EPOLL_CTL_DEL, pc->fd, 0 );
+	::close( pc->fd );
+	conns.erase( pc->fd );
+	delete pc;
+	listen( true );
+}
+
+void ServerState::closeAll()
+{
+	while (!conns.empty())
+		close( conns.begin()->second );
+}
+
+/* Sends what it can; returns false if the connection was closed */
+bool ServerState::flush( HTTPConnection* pc )
+{
+	bool isSent = false;
+	while (pc->nOutSent<pc->out.size()) {
+		ssize_t n = ::send( pc->fd, pc->out.data()+pc->nOutSent, pc->out.size()-pc->nOutSent, MSG_NOSIGNAL );
+		if (n<0) {
+			if (errno==EINTR)
+				continue;
+			if (errno==EAGAIN || errno==EWOULDBLOCK)
+				break;
+			close( pc );
+			return false;
+		}
+		pc->nOutSent += n;
+		isSent = true;
+	}
+	if (pc->nOutSent==pc->out.size()) {
+		pc->out.clear();
+		pc->nOutSent = 0;
+		if (pc->isClosing) {
+			close( pc );
+			return false;
+		}
+	}
+	setDeadline( pc, isSent );
+	update( pc );
+	return true;
+}
+
+/* Asks epoll for output space while there's output, and input while it isn't backed up */
+void ServerState::update( HTTPConnection* pc )
+{
+	size_t nUnsent = pc->out.size()-pc->nOutSent;
+	unsigned events = 0;
+	if (nUnsent>0)
+		events |= EPOLLOUT;
+	if (nUnsent<outHighWater && !pc->isClosing)
+		events |= EPOLLIN;
+	if (events!=pc->events) {
+		pc->events = events;
+		struct epoll_event ev;
+		ev.events = events;
+		ev.data.ptr = pc;
+		epoll_ctl( fdEpoll, EPOLL_CTL_MOD, pc->fd, &ev );
+	}
+}
+
+/* Reads what's arrived */
+void ServerState::readable( HTTPConnection* pc )
+{
+	if (pc->in.size()-pc->nIn<readSize/2)
+		pc->in.resize( std::max( pc->in.size()*2, pc->nIn+readSize ) );
+	ssize_t n = ::recv( pc->fd, &pc->in[pc->nIn], pc->in.size()-pc->nIn, 0 );
+	if (n<0) {
+		if (errno!=EINTR && errno!=EAGAIN && errno!=EWOULDBLOCK)
+			close( pc );
+		return;
+	}
+	if (n==0) {
+		// Client is done sending; finish the answers already owed
+		pc->isClosing = true;
+		flush( pc );
+		return;
+	}
+	pc->nIn += n;
+	answer( pc );
+}
+
+/* Answers every complete request received, unless output is backed up
+   Returns: false if the connection was closed */
+bool ServerState::answer( HTTPConnection* pc )
+{
+	HTTPRequest req;
+	size_t nStart = 0;
+	while (!pc->isClosing) {
+		if (pc->out.size()-pc->nOutSent>=outHighWater) {
+			// Send before answering more; stop if the client isn't reading
+			if (!flush( pc ))
+				return false;
+			if (pc->out.size()-pc->nOutSent>=outHighWater)
+				break;
+		}
+		int nError = 0;
+		size_t nEnd = parse( pc, nStart, req, nError );
+		if (nError) {
+			error( pc, nError );
+			break;
+		}
+		if (nEnd==0)
+			break;	// Incomplete
+		body.clear();
+		os.clear();
+		HTTPResponse resp( os, body );
+		respond( pc, req, resp );
+		nStart = nEnd;
+	}
+	if (nStart>0) {
+		memmove( &pc->in[0], &pc->in[nStart], pc->nIn-nStart );
+		pc->nIn -= nStart;
+		pc->phase = HTTPConnection::New;	// Any rest is the start of the next request
+	}
+	return flush( pc );
+}
+
+/* Parses the request at in[nStart]
+   Returns: the offset after it, or 0 if it isn't all here (or nError is set) */
+size_t ServerState::parse( HTTPConnection* pc, size_t nStart, HTTPRequest& req, int& nError )
+{
+	const char* pBuf = &pc->in[0];
+	const char* p = pBuf+nStart;
+	const char* pEnd = pBuf+pc->nIn;
+
+	// Blank lines before a request are allowed
+	while (p<pEnd && (*p=='\r' || *p=='\n'))
+		++p;
+	const char* pHeadEnd = (const char*)memmem( p, pEnd-p, "\r\n\r\n", 4 );
+	if (!pHeadEnd) {
+		if ((size_t)(pEnd-p)>maxHeaderBytes)
+			nError = 431;
+		return 0;
+	}
+	if ((size_t)(pHeadEnd-p)>maxHeaderBytes) {
+		nError = 431;
+		return 0;
+	}
+
+	// Request line:  method SP target SP HTTP/1.x CRLF
+	const char* pLineEnd = (const char*)memchr( p, '\r', pHeadEnd+2-p );
+	const char* pSpace = (const char*)memchr( p, ' ', pLineEnd-p );
+	if (!pSpace || pSpace==p || pLineEnd[1]!='\n') {
+		nError = 400;
+		return 0;
+	}
+	req.m_method = StringView( p, pSpace-p );
+	p = pSpace+1;
+	pSpace = (const char*)memchr( p, ' ', pLineEnd-p );
+	if (!pSpace || pSpace==p || pLineEnd-pSpace!=9 || memcmp( pSpace+1, "HTTP/1.", 7 )!=0
+	    || (pSpace[8]!='0' && pSpace[8]!='1')) {
+		nError = 400;
+		return 0;
+	}
+	req.m_target = StringView( p, pSpace-p );
+	req.m_nMinor = pSpace[8]-'0';
+	const char* pQuery = (const char*)memchr( p, '?', pSpace-p );
+	if (pQuery) {
+		req.m_path = StringView( p, pQuery-p );
+		req.m_query = StringView( pQuery+1, pSpace-pQuery-1 );
+	} else {
+		req.m_path = req.m_target;
+		req.m_query = StringView();
+	}
+
+	// Headers:  name ":" OWS value OWS CRLF
+	req.m_nHeaders = 0;
+	p = pLineEnd+2;
+	while (p<pHeadEnd+2) {
+		pLineEnd = (const char*)memchr( p, '\r', pHeadEnd+2-p );
+		if (pLineEnd[1]!='\n' || req.m_nHeaders==HTTPRequest::maxHeaders) {
+			nError = req.m_nHeaders==HTTPRequest::maxHeaders ? 431 : 400;
+			return 0;
+		}
+		const char* pColon = (const char*)memchr( p, ':', pLineEnd-p );
+		if (!pColon || pColon==p || pColon[-1]==' ' || pColon[-1]=='\t') {
+			nError = 400;
+			return 0;
+		}
+		const char* pValue = pColon+1;
+		while (pValue<pLineEnd && (*pValue==' ' || *pValue=='\t'))
+			++pValue;
+		const char* pValueEnd = pLineEnd;
+		while (pValueEnd>pValue && (pValueEnd[-1]==' ' || pValueEnd[-1]=='\t'))
+			--pValueEnd;
+		HTTPRequest::Header& h = req.m_aHeaders[req.m_nHeaders++];
+		h.name = StringView( p, pColon-p );
+		h.value = StringView( pValue, pValueEnd-pValue );
+		p = pLineEnd+2;
+	}
+	p = pHeadEnd+4;
+
+	// Body
+	if (!req.header( "Transfer-Encoding" ).isEmpty()) {
+		nError = 501;
+		return 0;
+	}
+	size_t nBody = 0;
+	StringView length = req.header( "Content-Length" );
+	if (!length.isEmpty()) {
+		for (int i=0; i<length.length(); ++i) {
+			char c = length.data()[i];
+			if (c<'0' || c>'9' || nBody>maxBodyBytes) {
+				nError = c<'0' || c>'9' ? 400 : 413;
+				return 0;
+			}
+			nBody = nBody*10+(c-'0');
+		}
+		if (nBody>maxBodyBytes) {
+			nError = 413;
+			return 0;
+		}
+	}
+	if ((size_t)(pEnd-p)<nBody)
+		return 0;
+	req.m_body = StringView( p, nBody );
+	return p+nBody-pBuf;
+}
+
+/* Calls the handler and queues its response */
+void ServerState::respond( HTTPConnection* pc, const HTTPRequest& req, HTTPResponse& resp )
+{
+	StringView connection = req.header( "Connection" );
+	bool isKeepAlive = req.minorVersion()>=1 ? !hasToken( connection, "close" ) : hasToken( connection, "keep-alive" );
+
+	try {
+		(*pfn)( req, resp );
+		resp.m_pOut->flush();
+	} catch (BException& e) {
+		resp.m_nStatus = 500;
+		resp.m_pszReason = 0;
+		resp.m_headers = "Content-Type: text/plain\r\n";
+		body = e.message();
+	} catch (std::exception& e) {
+		resp.m_nStatus = 500;
+		resp.m_pszReason = 0;
+		resp.m_headers = "Content-Type: text/plain\r\n";
+		body = e.what();
+	}
+	++*pnRequests;
+
+	char line[64];
+	std::string& out = pc->out;
+	sprintf( line, "HTTP/1.1 %d ", resp.m_nStatus );
+	out += line;
+	out += resp.m_pszReason ? resp.m_pszReason : reasonOf( resp.m_nStatus );
+	out += "\r\n";
+	out += dateLine;
+	out += resp.m_headers;
+	sprintf( line, "Content-Length: %lu\r\n", (unsigned long)body.size() );
+	out += line;
+	if (!isKeepAlive) {
+		out += "Connection: close\r\n";
+		pc->isClosing = true;
+	} else if (req.minorVersion()==0) {
+		out += "Connection: keep-alive\r\n";
+	}
+	out += "\r\n";
+	if (req.method()!="HEAD")
+		out += body;
+}
+
+/* Queues an error response and ends the connection */
+void ServerState::error( HTTPConnection* pc, int nStatus )
+{
+	char line[64];
+	std::string& out = pc->out;
+	sprintf( line, "HTTP/1.1 %d ", nStatus );
+	out += line;
+	out += reasonOf( nStatus );
+	out += "\r\n";
+	out += dateLine;
+	out += "Content-Length: 0\r\nConnection: close\r\n\r\n";
+	pc->isClosing = true;
+}
+
+
+/*: HTTPServer::HTTPServer()
+
+  Sets up the listening socket.  pszAddress is "host:port", or ":port"
+  for every interface; port 0 picks a free port (see port()).
+
+  Throws: BFileException if the socket can't be set up
+*/
+HTTPServer::HTTPServer( const char* pszAddress )
+	:   m_pState( new ServerState ),
+	    m_nRequests( 0 )
+{
+	ServerState& s = *m_pState;
+	try {
+		const char* pszColon = strrchr( pszAddress, ':' );
+		if (!pszColon) {
+			errno = EINVAL;
+			throw BFileException( BFileException::SystemError );
+		}
+		std::string host( pszAddress, pszColon-pszAddress );
+		struct addrinfo hints;
+		memset( &hints, 0, sizeof(hints) );
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_flags = AI_PASSIVE;
+		struct addrinfo* pai;
+		if (getaddrinfo( host.empty() ? 0 : host.c_str(), pszColon+1, &hints, &pai )!=0) {
+			errno = EADDRNOTAVAIL;
+			throw BFileException( BFileException::SystemError );
+		}
+		s.fdListen = ::socket( pai->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+		int error = errno;
+		if (s.fdListen>=0) {
+			int on = 1;
+			setsockopt( s.fdListen, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on) );
+			if (::bind( s.fdListen, pai->ai_addr, pai->ai_addrlen )<0 || ::listen( s.fdListen, listenBacklog )<0)
+				error = errno;
+			else
+				error = 0;
+		}
+		freeaddrinfo( pai );
+		if (s.fdListen<0 || error) {
+			errno = error;
+			throw BFileException( BFileException::SystemError );
+		}
+
+		struct sockaddr_storage addr;
+		socklen_t len = sizeof(addr);
+		getsockname( s.fdListen, (struct sockaddr*)&addr, &len );
+		if (addr.ss_family==AF_INET6)
+			s.nPort = ntohs( ((struct sockaddr_in6*)&addr)->sin6_port );
+		else
+			s.nPort = ntohs( ((struct sockaddr_in*)&addr)->sin_port );
+
+		s.fdEpoll = epoll_create1( EPOLL_CLOEXEC );
+		s.fdWake = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+		if (s.fdEpoll<0 || s.fdWake<0)
+			throw BFileException( BFileException::SystemError );
+		struct epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.ptr = &s.fdListen;
+		if (epoll_ctl( s.fdEpoll, EPOLL_CTL_ADD, s.fdListen, &ev )<0)
+			throw BFileException( BFileException::SystemError );
+		ev.data.ptr = &s.fdWake;
+		if (epoll_ctl( s.fdEpoll, EPOLL_CTL_ADD, s.fdWake, &ev )<0)
+			throw BFileException( BFileException::SystemError );
+	} catch (...) {
+		int error = errno;
+		if (s.fdListen>=0)
+			::close( s.fdListen );
+		if (s.fdEpoll>=0)
+			::close( s.fdEpoll );
+		if (s.fdWake>=0)
+			::close( s.fdWake );
+		delete m_pState;
+		errno = error;
+		throw;
+	}
+}
+
+/*: HTTPServer::~HTTPServer()
+
+  Closes the listening socket.
+*/
+HTTPServer::~HTTPServer()
+{
+	m_pState->closeAll();
+	::close( m_pState->fdListen );
+	::close( m_pState->fdEpoll );
+	::close( m_pState->fdWake );
+	delete m_pState;
+}
+
+/*: HTTPServer::port()
+
+  Prototype: int HTTPServer::port() const
+*/
+int HTTPServer::port() const
+{
+	return m_pState->nPort;
+}
+
+/*: HTTPServer::run()
+
+  Accepts connections and answers their requests with fn, until stop().
+  If fn throws, the client gets a 500 with the message.  Malformed
+  requests get a 400 (431 or 413 if too big) and the connection is
+  closed.  Open connections are closed when run() returns.
+
+  Throws: BFileException if epoll fails
+*/
+void HTTPServer::run( Handler fn )
+{
+	try {
+		m_pState->serve( fn, m_nRequests );
+	} catch (...) {
+		m_pState->closeAll();
+		throw;
+	}
+	m_pState->closeAll();
+	m_pState->isStopped = false;		// For the next run(), not one stop() came before
+}
+
+/*: HTTPServer::setTimeouts()
+
+  Sets how long a connection may wait for its next request (default 60
+  seconds), and how long it may take to send a whole request or go
+  without taking any of its answers (30 seconds).  Connections past them
+  are closed.  Call before run().
+
+  Prototype: void HTTPServer::setTimeouts( int nIdleMillisecs, int nRequestMillisecs )
+*/
+void HTTPServer::setTimeouts( int nIdleMillisecs, int nRequestMillisecs )
+{
+	bwassert( nIdleMillisecs>0 && nRequestMillisecs>0 );
+	m_pState->nIdleMs = nIdleMillisecs;
+	m_pState->nRequestMs = nRequestMillisecs;
+}
+
+/*: HTTPServer::stop()
+
+  Makes run() return once the request in hand is done.  Safe to call
+  from a handler or another thread, and before run() starts, which
+  then returns at once.
+*/
+void HTTPServer::stop()
+{
+	m_pState->isStopped = true;
+	uint64_t one = 1;
+	bwverify( ::write( m_pState->fdWake, &one, sizeof(one) )==sizeof(one) );
+}
+
+#else	// __linux__
+
+class ServerState {
+};
+
+HTTPServer::HTTPServer( const char* )
+	:   m_pState( 0 ),
+	    m_nRequests( 0 )
+{
+	errno = ENOSYS;
+	throw BFileException( BFileException::SystemError );
+}
+
+HTTPServer::~HTTPServer()
+{
+}
+
+int HTTPServer::port() const
+{
+	return 0;
+}
+
+void HTTPServer::run( Handler )
+{
+}
+
+void HTTPServer::setTimeouts( int, int )
+{
+}
+
+void HTTPServer::stop()
+{
+}
+
+#endif	// __linux__
+
+}	// namespace bw
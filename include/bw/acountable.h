@@ -0,0 +1,137 @@
+/* acountable.h -- thread safe smart pointer and AtomicCountable base class
+
+Copyright (C) 1997-2013, Brian Bray
+
+*/
+
+/* Needs:
+#include <atomic>
+#include "bw/bwassert.h"
+*/
+
+/*: class AtomicCountable
+
+	Base class for reference counted objects that may be shared between
+	threads.  It is the thread safe counterpart of Countable.
+
+	AddRef() and Release() are not virtual, so calls through acptr (or
+	cptr) are inlined instead of dispatched through the vtable.  The count
+	is atomic: increments are relaxed (a new reference can only be made
+	from an existing one, so nothing needs ordering), decrements are
+	acquire/release so that the thread deleting the object sees every
+	write made through the other references.
+
+	The template parameter is the class that is deleted when the count
+	reaches zero.  Use the root of a polymorphic hierarchy with a virtual
+	destructor or the concrete class itself:
+
+	class Foo : public AtomicCountable&lt;Foo> {...};
+
+	Classes that need to override Release() (e.g. to recycle objects on
+	a free list) should stay with Countable.
+*/
+template<class D>
+class AtomicCountable {
+public:
+	AtomicCountable() : m_cRef(1) {}
+	unsigned long AddRef() {
+		return m_cRef.fetch_add(1, std::memory_order_relaxed) + 1;
+	}
+	unsigned long Release() {
+		unsigned long cRef = m_cRef.fetch_sub(1, std::memory_order_acq_rel) - 1;
+		if (cRef==0)
+			delete static_cast<D*>(this);
+		return cRef;
+	}
+protected:
+	~AtomicCountable() {
+		bwassert(m_cRef.load(std::memory_order_relaxed)<=1);   // Note: 1 for throw in constructor
+	}
+	std::atomic<unsigned long> m_cRef;
+
+	// Copies start with their own count
+	AtomicCountable( const AtomicCountable& ) : m_cRef(1) {}
+	AtomicCountable& operator=( const AtomicCountable& ) {
+		return *this;
+	}
+};
+
+/*: class acptr
+
+	Smart pointer for AtomicCountable objects.  Semantics are the same as
+	cptr: assignment and construction from a regular pointer do not change
+	the reference count, all other assignments and constructors do.
+
+	acptr also has move construction and assignment, which hand over the
+	reference without touching the count at all.
+
+	An acptr may be copied from while other threads copy or release their
+	own acptrs to the same object.  A single acptr variable is not itself
+	safe to assign from one thread while another reads it.
+*/
+template<class C>
+class acptr {
+public:
+	acptr(const C* ptr=0)
+		: m_ptr( (C*)ptr ) {}
+	acptr(const acptr<C>& cp)
+		: m_ptr( cp.m_ptr ) {
+		if (m_ptr) m_ptr->AddRef();
+	}
+	acptr(acptr<C>&& cp)
+		: m_ptr( cp.m_ptr ) {
+		cp.m_ptr = 0;
+	}
+	~acptr() {
+		deallocate();
+	}
+
+	acptr<C>& operator=(const C* ptr) {
+		deallocate();
+		m_ptr=(C*)ptr;
+		return *this;
+	}
+	acptr<C>& operator=(const acptr<C>& cp) {
+		C* ptr = cp.m_ptr;
+		if (ptr) ptr->AddRef();		// First, in case of self assignment
+		deallocate();
+		m_ptr = ptr;
+		return *this;
+	}
+	acptr<C>& operator=(acptr<C>&& cp) {
+		if (this!=&cp) {
+			deallocate();
+			m_ptr = cp.m_ptr;
+			cp.m_ptr = 0;
+		}
+		return *this;
+	}
+
+	C* operator->() const {
+		bwassert( m_ptr );
+		return m_ptr;
+	}
+	C& operator*() const {
+		bwassert( m_ptr );
+		return *m_ptr;
+	}
+	operator C*() const {
+		return m_ptr;
+	}
+
+	bool operator==(const acptr<C>& cp) const {
+		return m_ptr==cp.m_ptr;
+	}
+	bool operator!=(const acptr<C>& cp) const {
+		return m_ptr!=cp.m_ptr;
+	}
+
+private:
+	void deallocate() {
+		if (m_ptr) m_ptr->Release();
+		m_ptr=0;
+	}
+
+	C*	m_ptr;
+};
+
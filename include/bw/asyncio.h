@@ -0,0 +1,99 @@
+/* asyncio.h -- asynchronous reads, writes and syncs of BFiles
+
+Copyright (C) 1996-2013, Brian Bray
+
+*/
+
+/* Needs:
+#include <functional>
+#include "bw/exception.h"
+#include "bw/file.h"
+*/
+
+namespace bw {
+
+class AsyncEngine;
+
+class AsyncIO
+// Purpose: Starts BFile reads, writes and syncs without blocking the caller
+// Note: Uses io_uring where the kernel allows it, else a small thread pool.
+//       Completions are queued until poll() (or wait()) runs their callbacks
+//       in the calling thread.
+{
+public:
+	enum Mode {
+		Auto=0,		// io_uring if available, else ThreadPool
+		ThreadPool=1	// Always use worker threads
+	};
+
+	enum Op {
+		Read=0,
+		Write=1,
+		Sync=2
+	};
+
+	struct Completion {
+		Op	op;
+		long	result;		// Bytes read or written (0 for Sync)
+		int	error;		// errno value, 0 on success
+
+		void check() const;
+		// Purpose: throws on error
+		// throw( BFileException ) if error is set
+	};
+
+	typedef std::function<void( const Completion& )> Callback;
+
+	explicit AsyncIO( Mode mode=AsyncIO::Auto, int nThreads=2 );
+	// Purpose: Creates an idle queue
+	// Note: nThreads is only used by the thread pool
+
+	~AsyncIO();
+	// Purpose: Waits for outstanding requests and runs their callbacks
+
+	void read( const BFile& file, void* buffer, long length, BFile::Offset position,
+	           Callback cb );
+	// Purpose: Starts reading length bytes at position into buffer
+	// Requires: Open file, buffer stays valid until the callback
+	// Promises: result is less than length only at end of file
+
+	void write( BFile& file, const void* buffer, long length, BFile::Offset position,
+	            Callback cb );
+	// Purpose: Starts writing length bytes from buffer at position
+	// Requires: Open file, buffer stays valid until the callback
+
+	void sync( BFile& file, Callback cb );
+	// Purpose: Starts committing the file to the device (fsync)
+	// Note: Only covers writes that have completed when it starts
+
+	int poll();
+	// Purpose: Runs the callbacks of finished requests
+	// Returns: number of callbacks run
+	// Note: Never blocks
+
+	void wait();
+	// Purpose: Blocks until every request has finished and its callback has run
+
+	int fd() const;
+	// Purpose: descriptor that is readable while completions wait for poll()
+	// Note: For select()/poll() based event loops, e.g. Scene::setAsyncIO()
+
+	int pending() const;
+	// Purpose: number of requests whose callbacks haven't run yet
+
+	bool isKernelAsync() const;
+	// Purpose: indicates if io_uring is in use
+
+private:
+	static int handleOf( const BFile& file ) {
+		return file.m_fd;
+	}
+
+	AsyncEngine*	m_pEngine;
+
+	// Cannot be copied or assigned
+	AsyncIO( const AsyncIO& );
+	AsyncIO& operator=( const AsyncIO& );
+};
+
+}	// namespace bw
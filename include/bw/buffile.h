@@ -0,0 +1,159 @@
+/* buffile.h -- buffered reading and writing of BFiles
+
+Copyright (C) 1996-2013, Brian Bray
+
+*/
+
+/* Needs:
+#include <string>
+#include <type_traits>
+#include "bw/exception.h"
+#include "bw/string.h"
+#include "bw/file.h"
+*/
+
+namespace bw {
+
+class BFileReader
+// Purpose: Buffered input from a BFile
+// Note: Reads go to the file in buffer sized chunks, so small reads are
+//       memory copies.  The file position is ahead of what has been read.
+{
+public:
+	enum { defaultBufferSize=64*1024 };
+
+	explicit BFileReader( BFile& file, long bufferSize=defaultBufferSize );
+	// Purpose: Reads from an open file, starting at its current position
+
+	~BFileReader();
+
+	void read( void* buffer, long length );
+	// Purpose: Reads length bytes into buffer
+	// throw( BFileException ) if there are fewer than length bytes left
+
+	long readUpTo( void* buffer, long length );
+	// Purpose: Reads up to length bytes into buffer
+	// Returns: count of bytes read, less than length only at end of file
+
+	int peek() {
+		if (m_pos==m_end && !fill())
+			return -1;
+		return (unsigned char)m_pBuffer[m_pos];
+	}
+	// Purpose: Returns the next byte without consuming it, or -1 at end of file
+
+	int get() {
+		if (m_pos==m_end && !fill())
+			return -1;
+		return (unsigned char)m_pBuffer[m_pos++];
+	}
+	// Purpose: Returns the next byte, or -1 at end of file
+
+	bool readLine( String& line );
+	// Purpose: Reads text up to the next '\n' (or end of file) into line
+	// Promises: The '\n' (and any '\r' before it) is consumed, not stored
+	// Returns: false if already at end of file
+
+	template<class T> void readValue( T& val ) {
+		static_assert( std::is_trivially_copyable<T>::value, "Plain data only" );
+		if (m_end-m_pos >= (long)sizeof(T)) {
+			std::char_traits<char>::copy( (char*)&val, m_pBuffer+m_pos, sizeof(T) );
+			m_pos += sizeof(T);
+		} else
+			read( &val, sizeof(T) );
+	}
+	// Purpose: Reads a value in its memory representation (as written by
+	//          BFileWriter::writeValue on the same platform)
+	// throw( BFileException ) at end of file
+
+	void skip( long length );
+	// Purpose: Discards length bytes
+	// throw( BFileException ) if there are fewer than length bytes left
+
+	bool atEof();
+	// Purpose: indicates that everything in the file has been read
+
+	BFile::Offset tell() const;
+	// Purpose: position in the file of the next byte to be read
+
+private:
+	bool fill();
+
+	BFile&	m_file;
+	char*	m_pBuffer;
+	long	m_size;
+	long	m_pos;		// Next byte in buffer
+	long	m_end;		// End of valid data in buffer
+	bool	m_atEof;	// File has been read to the end
+
+	// Cannot be copied or assigned
+	BFileReader( const BFileReader& );
+	BFileReader& operator=( const BFileReader& );
+};
+
+
+class BFileWriter
+// Purpose: Buffered output to a BFile
+// Note: Small writes are gathered and written together.  Data is only
+//       certain to reach the file after flush().
+{
+public:
+	enum { defaultBufferSize=64*1024 };
+
+	explicit BFileWriter( BFile& file, long bufferSize=defaultBufferSize );
+	// Purpose: Writes to an open file, starting at its current position
+
+	~BFileWriter();
+	// Purpose: Flushes, errors are ignored (call flush() to see them)
+
+	void write( const void* buffer, long length ) {
+		if (length <= m_size-m_len) {
+			std::char_traits<char>::copy( m_pBuffer+m_len, (const char*)buffer, length );
+			m_len += length;
+		} else
+			writeLarge( buffer, length );
+	}
+	// Purpose: Writes length bytes from buffer
+	// throw( BFileException ) if the file write fails
+
+	void put( char ch ) {
+		if (m_len==m_size)
+			flush();
+		m_pBuffer[m_len++] = ch;
+	}
+	// Purpose: Writes one byte
+
+	void writeLine( const char* psz );
+	// Purpose: Writes psz followed by '\n'
+
+	template<class T> void writeValue( const T& val ) {
+		static_assert( std::is_trivially_copyable<T>::value, "Plain data only" );
+		write( &val, sizeof(T) );
+	}
+	// Purpose: Writes a value in its memory representation
+
+	void flush();
+	// Purpose: Writes everything buffered to the file
+	// throw( BFileException ) if the file write fails
+
+	void commit();
+	// Purpose: flush() followed by BFile::commit()
+
+	BFile::Offset tell() const;
+	// Purpose: position in the file of the next byte to be written
+
+private:
+	void writeLarge( const void* buffer, long length );
+
+	BFile&	m_file;
+	char*	m_pBuffer;
+	long	m_size;
+	long	m_len;		// Bytes waiting in buffer
+
+	// Cannot be copied or assigned
+	BFileWriter( const BFileWriter& );
+	BFileWriter& operator=( const BFileWriter& );
+};
+
+}	// namespace bw
+
@@ -6,8 +6,8 @@ Copyright (C) 1997-2013, Brian Bray
 
 /*
 #include "bw/string.h"
+#include "bw/hashmap.h"
 #include <list>
-#include <map>
 */
 
 namespace bw {
@@ -80,7 +80,7 @@ private:
 
 	String	m_fname;
 	String	m_locale;
-	typedef std::map< String, std::map<String,String> >	ValType;
+	typedef StringMap< StringMap<String> >	ValType;
 	ValType	m_val;
 	bool	m_isWritable;
 };
@@ -5,6 +5,7 @@ Copyright (C) 1997-2013, Brian Bray
 */
 
 /*
+#include <string>
 #include "bw/filename.h"
 */
 
@@ -33,6 +34,7 @@ public:
 private:
 	FileName		m_fnDir;
 	FileName		m_fnPattern;
+	FilePattern		m_pattern;
 	FileName		m_fnResult;
 	void*		m_pvdir;
 	dirent*		m_pde;
@@ -47,6 +49,66 @@ private:
 };
 
 
+class DirectoryScan
+// Purpose: Fast enumeration of the entries of a large directory
+// Note: Reads many entries per system call and gives the type recorded in
+//       the directory, so most entries cost neither a stat nor an allocation
+{
+public:
+	DirectoryScan(const FileName& fnDir, const FileName& fnPattern="*");
+	// Purpose: Opens the directory; nothing is found if it can't be read
+
+	~DirectoryScan();
+
+	bool isOpen() const {
+		return m_fd>=0;
+	}
+
+	bool next();
+	// Purpose: Advances to the next entry matching the pattern
+	// Returns: false when there are no more
+	// Note: "." and ".." are skipped
+
+	const char* name() const {
+		return m_pszName;
+	}
+	// Purpose: Name of the current entry within the directory
+	// Note: Valid until the next call of next() or rewind()
+
+	FileName fileName() const;
+	// Purpose: Directory and name of the current entry
+
+	FileName::Type getType();
+	// Purpose: Type of the current entry, as FileName::getFileType()
+	// Note: Symbolic links are followed.  Only stats the entry if the file
+	//       system doesn't record types (or for links).
+
+	bool isSubdirectory();
+	// Purpose: indicates the current entry is a directory (not a link to one)
+	// Note: For walking a tree without following links
+
+	void rewind();
+	// Purpose: Restarts the enumeration
+
+private:
+	bool fill();
+
+	FileName		m_fnDir;
+	FilePattern		m_pattern;
+	int			m_fd;
+	void*			m_pvdir;	// Where getdents64() isn't available
+	char*			m_pBuffer;
+	long			m_pos;
+	long			m_end;
+	const char*		m_pszName;
+	unsigned char		m_dtype;	// DT_ value of the current entry
+
+	// Prohibit copying
+	DirectoryScan( const DirectoryScan& );
+	DirectoryScan& operator=( const DirectoryScan& );
+};
+
+
 }   // namespace
 
 
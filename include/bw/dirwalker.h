@@ -0,0 +1,81 @@
+/* dirwalker.h -- parallel walk of a directory tree
+
+Copyright (C) 1997-2013, Brian Bray
+
+*/
+
+/* Needs:
+#include <functional>
+#include <string>
+#include "bw/filename.h"
+*/
+
+namespace bw {
+
+class WalkerState;
+
+class DirectoryWalker
+// Purpose: Lists a whole directory tree, reading directories on several threads
+// Note: Results arrive through next() in no particular order
+{
+public:
+	struct Entry {
+		std::string	path;		// Root, then the path below it
+		size_t		nameOffset;	// Where the entry's own name starts in path
+		FileName::Type	type;		// As FileName::getFileType()
+		int		depth;		// 1 for entries in the root directory
+
+		const char* name() const {
+			return path.c_str()+nameOffset;
+		}
+	};
+
+	typedef std::function<bool( const char* pszPath, int depth )> PruneFn;
+	// Returns false to skip the directory's contents
+
+	explicit DirectoryWalker( const FileName& fnRoot, int nThreads=4 );
+	// Purpose: Walks the tree below fnRoot (which isn't itself listed)
+
+	~DirectoryWalker();
+	// Purpose: Stops the walk if it is still running
+
+	void setPattern( const FileName& fnPattern );
+	// Purpose: Lists only entries whose names match (all directories are still read)
+	// Requires: Walk not started
+
+	void setTypes( unsigned typeMask );
+	// Purpose: Lists only entries of these types, a mask of typeBit() values
+	// Requires: Walk not started
+
+	static unsigned typeBit( FileName::Type type ) {
+		return 1u<<type;
+	}
+
+	void setPrune( PruneFn fn );
+	// Purpose: Asks fn before reading each subdirectory
+	// Requires: Walk not started
+	// Note: fn is called on the worker threads, several at once
+
+	void setQueueSize( int nEntries );
+	// Purpose: Limits the entries found but not yet taken by next()
+	// Requires: Walk not started
+
+	bool next( Entry& entry );
+	// Purpose: Takes the next entry found, starting the walk on the first call
+	// Returns: false when the whole tree has been listed (or after stop())
+	// Note: Blocks while the workers are still reading.  entry's buffers
+	//       are exchanged with the queue's, so reusing one Entry allocates
+	//       almost nothing.
+
+	void stop();
+	// Purpose: Abandons the walk and waits for the threads
+
+private:
+	WalkerState*	m_pState;
+
+	// Prohibit copying
+	DirectoryWalker( const DirectoryWalker& );
+	DirectoryWalker& operator=( const DirectoryWalker& );
+};
+
+}   // namespace bw
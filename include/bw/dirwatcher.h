@@ -0,0 +1,69 @@
+/* dirwatcher.h -- notification of changes to directories
+
+Copyright (C) 1997-2013, Brian Bray
+
+*/
+
+/* Needs:
+#include <string>
+#include <vector>
+#include "bw/filename.h"
+*/
+
+namespace bw {
+
+class WatcherState;
+
+class DirectoryWatcher
+// Purpose: Reports files created, deleted, moved and written in watched directories
+// Note: Events are read in batches when fd() is readable, so a spool can be
+//       followed without rescanning it (see Scene::addInput())
+{
+public:
+	enum EventType {
+		Created=1,	// Name added (also for contents of new directories)
+		Deleted=2,	// Name removed
+		MovedFrom=4,	// Renamed away; a MovedTo with the same cookie may follow
+		MovedTo=8,	// Renamed into the directory
+		Written=16,	// Closed after being opened for writing
+		Rescan=32	// Events were lost: scan the whole of path once
+	};
+
+	struct Event {
+		EventType	type;
+		std::string	path;		// Watched directory, then the name in it
+		bool		isDirectory;
+		unsigned	cookie;		// Pairs MovedFrom with MovedTo, else 0
+	};
+
+	DirectoryWatcher();
+	// Purpose: Creates a watcher with no directories
+	// throw( BFileException ) if the system won't provide one
+
+	~DirectoryWatcher();
+
+	void watch( const FileName& fnDir, bool isRecursive=false );
+	// Purpose: Starts reporting changes in fnDir, and with isRecursive in all
+	//          directories below it (including ones created later)
+	// throw( BFileException ) if fnDir can't be watched
+
+	void unwatch( const FileName& fnDir );
+	// Purpose: Stops reporting changes for a directory given to watch()
+
+	int fd() const;
+	// Purpose: descriptor that is readable when there are events to read
+
+	int read( std::vector<Event>& events );
+	// Purpose: Appends the events waiting, without blocking
+	// Returns: number of events appended
+	// throw( BFileException ) on system errors
+
+private:
+	WatcherState*	m_pState;
+
+	// Prohibit copying
+	DirectoryWatcher( const DirectoryWatcher& );
+	DirectoryWatcher& operator=( const DirectoryWatcher& );
+};
+
+}   // namespace bw
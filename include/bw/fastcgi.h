@@ -0,0 +1,102 @@
+/* fastcgi.h -- long running FastCGI responder
+
+Copyright (C) 1997-2013, Brian Bray
+
+*/
+
+/* Needs:
+#include <atomic>
+#include <functional>
+#include <map>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "bw/string.h"
+#include "bw/http.h"
+*/
+
+namespace bw {
+
+class CGIParams;
+
+class CGIRequest
+// Purpose: One request to a CGI program: its parameters, body and output
+// Note: The same handler code serves plain CGI (the environment, cin and
+//       cout) and FastCGI (see FastCGIServer)
+{
+public:
+	CGIRequest();
+	// Purpose: The request of a plain CGI process
+
+	const char* param( const char* pszName ) const;
+	// Purpose: A CGI variable, eg: "REQUEST_METHOD" or "QUERY_STRING"
+	// Returns: 0 if absent
+
+	std::istream& in() {
+		return *m_pIn;
+	}
+	// Purpose: The request body (POST data)
+
+	std::ostream& out() {
+		return *m_pOut;
+	}
+	// Purpose: The response, starting with its CGI headers
+
+	// As the functions in http.h, for this request
+	std::map< String, String > getAnyData();
+	std::map< String, String > getPostData();
+	std::map< String, String > getGetData();
+	std::map< String, String > getMultiData();
+	FormParams getFormParams();
+
+private:
+	friend class FastCGIServer;
+	CGIRequest( const CGIParams* pParams, std::istream& is, std::ostream& os );
+
+	const CGIParams*	m_pParams;	// 0 for the environment
+	std::istream*	m_pIn;
+	std::ostream*	m_pOut;
+};
+
+class FastCGIServer
+// Purpose: Serves FastCGI requests from a web server, in one long running process
+// Note: Unlike CGI there is no process start per request, so connections,
+//       caches and configuration stay loaded between requests
+{
+public:
+	typedef std::function<void( CGIRequest& req )> Handler;
+
+	explicit FastCGIServer( const char* pszAddress=0 );
+	// Purpose: Listens on a Unix socket path, "host:port" or ":port"; with 0
+	//          uses the socket the web server passed as fd 0
+	// throw( BFileException ) if the socket can't be set up
+
+	~FastCGIServer();
+
+	void run( Handler fn );
+	// Purpose: Calls fn for each request until stop()
+	// Note: Several threads may call run() to serve requests in parallel
+	// throw( BFileException ) if the listening socket fails
+
+	void stop();
+	// Purpose: Makes run() return after the request in hand
+
+	unsigned long long requests() const {
+		return m_nRequests;
+	}
+	// Purpose: Number of requests served
+
+private:
+	int		m_fdListen;
+	bool	m_isOwned;		// Socket made here, closed by the destructor
+	String	m_strPath;		// Unix socket to remove, if any
+	std::atomic<bool>	m_isStopped;
+	std::atomic<unsigned long long>	m_nRequests;
+
+	// Prohibit copying
+	FastCGIServer( const FastCGIServer& );
+	FastCGIServer& operator=( const FastCGIServer& );
+};
+
+}	// namespace bw
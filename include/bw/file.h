@@ -8,6 +8,8 @@ Copyright (C) 1996-2013, Brian Bray
 #include "bw/exception.h"
 */
 
+struct iovec;
+
 namespace bw {
 
 class BFile
@@ -29,6 +31,8 @@ public:
 		fromEnd=2
 	};
 
+	typedef long long Offset;	// File positions and sizes, 64 bits everywhere
+
 	BFile();
 	// Purpose: Creates unopened file object, call open or create to open
 
@@ -72,9 +76,41 @@ public:
 	// Requires: Currently opened mode ReadWrite, Create, or CreateNew
 	// throw( BFileException ) if complete buffer is not written
 
+	void readAt( void* buffer, long length, Offset position ) const;
+	// Purpose: Reads length bytes at position into buffer
+	// Requires: Currently opened file
+	// Note: Doesn't use or move the file position, so threads may share the file
+	// throw( BFileException ) if unable to fully fill buffer
+
+	long readUpToAt( void* buffer, long length, Offset position ) const;
+	// Purpose: Reads up to length bytes at position into buffer
+	// Requires: Currently opened file
+	// Returns: actual count of bytes read, less than length only at end of file
+	// throw( BFileException ) if unable to complete operation
+
+	void writeAt( const void* buffer, long length, Offset position );
+	// Purpose: Writes length bytes from buffer at position
+	// Requires: Currently opened mode ReadWrite, Create, or CreateNew
+	// Note: Doesn't use or move the file position, so threads may share the file
+	// throw( BFileException ) if complete buffer is not written
+
+	long readv( const struct iovec* iov, int count );
+	// Note: struct iovec is declared in <sys/uio.h>
+	// Purpose: Reads into count buffers in order with one system call
+	// Requires: Currently opened file
+	// Promises: Sets atEof() if end of file reached
+	// Returns: actual count of bytes read (may be 0)
+	// throw( BFileException ) if unable to complete operation
+
+	void writev( const struct iovec* iov, int count );
+	// Purpose: Writes count buffers in order (gathered into one system call)
+	// Requires: Currently opened mode ReadWrite, Create, or CreateNew
+	// throw( BFileException ) if all buffers are not completely written
+
 	void commit();
-	// Purpose: Flushes output to device
+	// Purpose: Flushes output to device (fdatasync)
 	// Requires: Currently opened mode ReadWrite, Create, or CreateNew
+	// Note: Many threads committing one file should share a GroupCommit
 	// throw( BFileException ) on error
 
 	bool atEof() const;
@@ -84,18 +120,21 @@ public:
 	bool isOpen() const;
 	// Purpose: indicates if file is open
 
-	long seek( long position, SeekMode sm=BFile::fromStart );
+	Offset seek( Offset position, SeekMode sm=BFile::fromStart );
 	// Purpose: positions read/write pointer in file
 	// Requires: Currently opened file
 	// Returns: new file position
 	// throw( BfileException ) if unable to comply
 
-	long tell() const;
+	Offset tell() const;
 	// Purpose: indicates current read/write position
 	// Requires: Currently opened file
 	// Returns: file position
 
 private:
+	friend class AsyncIO;		// These need the descriptor
+	friend class GroupCommit;
+
 	// BFiles cannot be copied or assigned
 	BFile( const BFile& ) {}
 	BFile& operator=( const BFile& ) {
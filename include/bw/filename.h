@@ -5,6 +5,7 @@ Copyright (C) 1997-2013, Brian Bray
 */
 
 /* Needs:
+#include <string>
 #include "bw/string.h"
 */
 
@@ -12,6 +13,8 @@ namespace bw {
 
 class String;
 
+typedef StringView PathView;	// Part of a path, pointing into the FileName
+
 class FileName {
 public:
 	FileName(const char* pszFileName="");
@@ -25,6 +28,27 @@ public:
 	String extension() const;
 	String relativeName() const;
 	String fullName() const;
+
+	// As above, without copying (see PathView)
+	PathView rootView() const {
+		return PathView( m_sFileName, m_nRoot );
+	}
+	PathView directoryView() const {
+		return PathView( (const char*)m_sFileName+m_nRoot, m_nDir );
+	}
+	PathView baseNameView() const {
+		return PathView( (const char*)m_sFileName+m_nRoot+m_nDir, m_nBase );
+	}
+	PathView extensionView() const {
+		return PathView( (const char*)m_sFileName+m_nRoot+m_nDir+m_nBase, m_nExt );
+	}
+	PathView relativeNameView() const {
+		return PathView( (const char*)m_sFileName+m_nRoot+m_nDir, m_nBase+m_nExt );
+	}
+	PathView fullNameView() const {
+		return PathView( m_sFileName, m_nRoot+m_nDir+m_nBase+m_nExt );
+	}
+
 	void makeAbsolute();
 	void append(const FileName& fn);
 	static FileName currentDirectory();
@@ -43,10 +67,45 @@ private:
 	void parse();
 
 	String	m_sFileName;
-	short	m_nRoot;
-	short	m_nDir;
-	short	m_nBase;
-	short	m_nExt;
+	int		m_nRoot;
+	int		m_nDir;
+	int		m_nBase;
+	int		m_nExt;
+};
+
+class FilePattern
+// Purpose: A file name pattern (as for fnmatch) compiled for repeated matching
+// Note: Matches exactly what fnmatch( pattern, name, 0 ) does, in the locale
+//       current when it was compiled
+{
+public:
+	explicit FilePattern( const char* pszPattern="*" );
+	// Purpose: Compiles a pattern of literals, *, ? and [...] sets
+
+	bool matches( const char* pszName ) const;
+	// Purpose: indicates if a whole name matches
+
+	bool matchesAll() const {
+		return m_kind==All;
+	}
+	// Purpose: indicates the pattern is "*"
+
+private:
+	bool matchProgram( const char* pszName ) const;
+
+	enum Kind {
+		All,		// "*"
+		Literal,	// No wildcards
+		Prefix,		// Literal then "*"
+		Suffix,		// "*" then literal
+		General,	// Interpreted from m_program
+		System		// Left to fnmatch() (e.g. [:alpha:] classes, a trailing \)
+	};
+
+	Kind		m_kind;
+	std::string	m_literal;	// For Literal, Prefix and Suffix
+	std::string	m_program;	// For General; for System, the pattern
+	std::string	m_pattern;	// For General in a multibyte locale, for non-ASCII names
 };
 
 }   // namespace
@@ -0,0 +1,59 @@
+/* groupcommit.h -- coalesced commits of BFiles to the device
+
+Copyright (C) 1996-2013, Brian Bray
+
+*/
+
+/* Needs:
+#include <condition_variable>
+#include <mutex>
+#include "bw/exception.h"
+#include "bw/file.h"
+*/
+
+namespace bw {
+
+class GroupCommit
+// Purpose: Shares each device flush among all the threads committing at the time
+// Note: Writers call commit() instead of BFile::commit(); callers that arrive
+//       while a flush is running are covered together by the next one
+{
+public:
+	enum Scope {
+		File=0,		// Flushes the file's data (fdatasync)
+		FileSystem=1	// Flushes the whole file system holding the file (syncfs)
+	};
+
+	explicit GroupCommit( const BFile& file, Scope scope=GroupCommit::File );
+	// Purpose: Commits for file, or for every file on its file system
+	// Requires: Open file, which outlives the GroupCommit
+
+	void commit();
+	// Purpose: Returns when everything written (by any thread) before the call
+	//          has reached the device
+	// throw( BFileException ) if the flush fails, and for all later commits
+
+	unsigned long long commits() const;
+	// Purpose: number of commit() calls so far
+
+	unsigned long long flushes() const;
+	// Purpose: number of device flushes so far
+
+private:
+	int	m_fd;
+	Scope	m_scope;
+
+	mutable std::mutex	m_mutex;
+	std::condition_variable	m_cv;
+	unsigned long long	m_nRequested;	// Tickets handed out by commit()
+	unsigned long long	m_nDurable;	// Tickets covered by a completed flush
+	unsigned long long	m_nFlushes;
+	bool	m_isFlushing;
+	int	m_error;		// errno of a failed flush, sticky
+
+	// Cannot be copied or assigned
+	GroupCommit( const GroupCommit& );
+	GroupCommit& operator=( const GroupCommit& );
+};
+
+}	// namespace bw
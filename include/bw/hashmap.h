@@ -0,0 +1,346 @@
+/* hashmap.h -- open addressing hash map keyed by String
+
+Copyright (C) 1997-2013, Brian Bray
+
+*/
+
+/* Needs:
+#include <cstring>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "bw/bwassert.h"
+#include "bw/string.h"
+#include "bw/ustring.h"
+*/
+
+namespace std {
+
+template<> struct hash<bw::String> {
+	size_t operator()( const bw::String& str ) const {
+		return str.hash();
+	}
+};
+
+template<> struct hash<bw::UString> {
+	size_t operator()( const bw::UString& str ) const {
+		return str.hash();
+	}
+};
+
+}	// namespace std
+
+
+namespace bw {
+
+/*: class StringMap
+
+	An unordered map from String to V.  Use it in place of
+	std::map&lt;String,V> when iteration order doesn't matter.
+
+	Entries are stored inline in a single power-of-two table with linear
+	probing.  Each slot keeps the full hash of its key, so probes compare
+	hashes before touching the key text and String::hash() is only
+	computed once per key.  Erase uses backward shifting, so there are no
+	tombstones and lookups stay short after many erasures.
+
+	Lookups by const char* don't construct a temporary String.
+
+	Iterators and references are invalidated by any insertion or erasure.
+	As with std::unordered_map, the key of an entry can't be changed in
+	place; erase it and insert the new key.
+*/
+template<class V>
+class StringMap {
+public:
+	typedef std::pair<const String,V>	value_type;	// Key is const, as its hash is stored
+
+private:
+	struct Slot {
+		unsigned long	hash;	// 0 ==> empty
+		typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type	item;
+
+		value_type& val() {
+			return *reinterpret_cast<value_type*>(&item);
+		}
+		const value_type& val() const {
+			return *reinterpret_cast<const value_type*>(&item);
+		}
+	};
+
+public:
+	template<class S, class T>
+	class Iter {
+	public:
+		Iter() : m_ps(0), m_pe(0) {}
+		template<class S2, class T2>
+		Iter(const Iter<S2,T2>& it) : m_ps(it.m_ps), m_pe(it.m_pe) {}	// iterator to const_iterator
+		T& operator*() const {
+			return m_ps->val();
+		}
+		T* operator->() const {
+			return &m_ps->val();
+		}
+		Iter& operator++() {
+			++m_ps;
+			skip();
+			return *this;
+		}
+		bool operator==(const Iter& it) const {
+			return m_ps==it.m_ps;
+		}
+		bool operator!=(const Iter& it) const {
+			return m_ps!=it.m_ps;
+		}
+	private:
+		friend class StringMap;
+		template<class S2, class T2> friend class Iter;
+		Iter(S* ps, S* pe) : m_ps(ps), m_pe(pe) {
+			skip();
+		}
+		void skip() {
+			while (m_ps!=m_pe && m_ps->hash==0)
+				++m_ps;
+		}
+		S*	m_ps;
+		S*	m_pe;
+	};
+	typedef Iter<Slot,value_type>	iterator;
+	typedef Iter<const Slot,const value_type>	const_iterator;
+
+public:
+	explicit StringMap( int nCapacity=0 )
+		: m_pSlots(0), m_mask(0), m_size(0) {
+		if (nCapacity>0)
+			reserve(nCapacity);
+	}
+	StringMap( const StringMap& sm )
+		: m_pSlots(0), m_mask(0), m_size(0) {
+		copyFrom(sm);
+	}
+	StringMap( StringMap&& sm )
+		: m_pSlots(sm.m_pSlots), m_mask(sm.m_mask), m_size(sm.m_size) {
+		sm.m_pSlots = 0;
+		sm.m_mask = 0;
+		sm.m_size = 0;
+	}
+	~StringMap() {
+		release();
+	}
+	StringMap& operator=( const StringMap& sm ) {
+		if (this!=&sm) {
+			release();
+			copyFrom(sm);
+		}
+		return *this;
+	}
+
+	int size() const {
+		return m_size;
+	}
+	bool empty() const {
+		return m_size==0;
+	}
+	void clear() {
+		release();
+	}
+	void reserve( int n );
+
+	iterator begin() {
+		return iterator( m_pSlots, end().m_ps );
+	}
+	iterator end() {
+		Slot* pe = m_pSlots ? m_pSlots+m_mask+1 : 0;
+		return iterator( pe, pe );
+	}
+	const_iterator begin() const {
+		return const_iterator( m_pSlots, end().m_ps );
+	}
+	const_iterator end() const {
+		const Slot* pe = m_pSlots ? m_pSlots+m_mask+1 : 0;
+		return const_iterator( pe, pe );
+	}
+
+	iterator find( const String& key ) {
+		return at( probe(key,key.hash()) );
+	}
+	iterator find( const char* psz ) {
+		return at( probe(psz,hashBytes(psz,::strlen(psz))) );
+	}
+	const_iterator find( const String& key ) const {
+		return at( probe(key,key.hash()) );
+	}
+	const_iterator find( const char* psz ) const {
+		return at( probe(psz,hashBytes(psz,::strlen(psz))) );
+	}
+
+	V& operator[]( const String& key );
+	bool erase( const String& key );
+
+private:
+	int probe( const char* psz, unsigned long h ) const;
+	template<class... Args>
+	unsigned long insertNew( unsigned long h, Args&&... args );
+	void copyFrom( const StringMap& sm );
+	void release();
+
+	iterator at( int indx ) {
+		if (indx<0)
+			return end();
+		return iterator( m_pSlots+indx, m_pSlots+m_mask+1 );
+	}
+	const_iterator at( int indx ) const {
+		if (indx<0)
+			return end();
+		return const_iterator( m_pSlots+indx, m_pSlots+m_mask+1 );
+	}
+
+	Slot*	m_pSlots;
+	unsigned long	m_mask;	// Table size - 1
+	int		m_size;
+};
+
+
+// Returns the slot index holding the key or -1
+template<class V>
+int StringMap<V>::probe( const char* psz, unsigned long h ) const
+{
+	if (!m_pSlots)
+		return -1;
+	for (unsigned long i=h&m_mask; m_pSlots[i].hash; i=(i+1)&m_mask) {
+		if (m_pSlots[i].hash==h && m_pSlots[i].val().first==psz)
+			return i;
+	}
+	return -1;
+}
+
+// Constructs an entry for a key known not to be present in its slot,
+// table must have room
+template<class V>
+template<class... Args>
+unsigned long StringMap<V>::insertNew( unsigned long h, Args&&... args )
+{
+	unsigned long i = h&m_mask;
+	while (m_pSlots[i].hash)
+		i = (i+1)&m_mask;
+	new (&m_pSlots[i].item) value_type( std::forward<Args>(args)... );
+	m_pSlots[i].hash = h;
+	++m_size;
+	return i;
+}
+
+/*: StringMap::reserve()
+
+	Grows the table so that n entries fit without further rehashing.
+	The load factor is kept at or below 3/4.
+*/
+template<class V>
+void StringMap<V>::reserve( int n )
+{
+	unsigned long nSlots = 8;
+	while (nSlots*3 < (unsigned long)n*4)
+		nSlots *= 2;
+	if (m_pSlots && nSlots<=m_mask+1)
+		return;
+
+	Slot* pOld = m_pSlots;
+	unsigned long nOld = m_pSlots ? m_mask+1 : 0;
+
+	m_pSlots = new Slot[nSlots];
+	m_mask = nSlots-1;
+	m_size = 0;
+	for (unsigned long i=0; i<nSlots; ++i)
+		m_pSlots[i].hash = 0;
+
+	for (unsigned long i=0; i<nOld; ++i) {
+		if (pOld[i].hash) {
+			insertNew( pOld[i].hash, std::move(pOld[i].val()) );
+			pOld[i].val().~value_type();
+		}
+	}
+	delete [] pOld;
+}
+
+/*: StringMap::operator[]
+
+	Returns the value for key, inserting a default constructed value if
+	the key isn't present.
+*/
+template<class V>
+V& StringMap<V>::operator[]( const String& key )
+{
+	unsigned long h = key.hash();
+	int indx = probe( key, h );
+	if (indx>=0)
+		return m_pSlots[indx].val().second;
+
+	if (!m_pSlots || (unsigned long)(m_size+1)*4 > (m_mask+1)*3)
+		reserve( m_size+1 );
+	return m_pSlots[insertNew( h, key, V() )].val().second;
+}
+
+/*: StringMap::erase()
+
+	Removes key from the map.  Returns false if it wasn't there.
+*/
+template<class V>
+bool StringMap<V>::erase( const String& key )
+{
+	int indx = probe( key, key.hash() );
+	if (indx<0)
+		return false;
+
+	unsigned long i = indx;
+	m_pSlots[i].val().~value_type();
+	m_pSlots[i].hash = 0;
+	--m_size;
+
+	// Shift back any following entries whose probe sequence crosses the hole
+	for (unsigned long j=(i+1)&m_mask; m_pSlots[j].hash; j=(j+1)&m_mask) {
+		unsigned long home = m_pSlots[j].hash&m_mask;
+		if (((j-home)&m_mask) >= ((j-i)&m_mask)) {
+			new (&m_pSlots[i].item) value_type( std::move(m_pSlots[j].val()) );
+			m_pSlots[i].hash = m_pSlots[j].hash;
+			m_pSlots[j].val().~value_type();
+			m_pSlots[j].hash = 0;
+			i = j;
+		}
+	}
+	return true;
+}
+
+template<class V>
+void StringMap<V>::copyFrom( const StringMap& sm )
+{
+	bwassert( !m_pSlots );
+	if (!sm.m_pSlots)
+		return;
+
+	m_pSlots = new Slot[sm.m_mask+1];
+	m_mask = sm.m_mask;
+	for (unsigned long i=0; i<=m_mask; ++i) {
+		m_pSlots[i].hash = sm.m_pSlots[i].hash;
+		if (m_pSlots[i].hash)
+			new (&m_pSlots[i].item) value_type( sm.m_pSlots[i].val() );
+	}
+	m_size = sm.m_size;
+}
+
+template<class V>
+void StringMap<V>::release()
+{
+	if (m_pSlots) {
+		for (unsigned long i=0; i<=m_mask; ++i) {
+			if (m_pSlots[i].hash)
+				m_pSlots[i].val().~value_type();
+		}
+		delete [] m_pSlots;
+	}
+	m_pSlots = 0;
+	m_mask = 0;
+	m_size = 0;
+}
+
+}	// namespace bw
+
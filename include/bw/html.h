@@ -15,16 +15,49 @@ class String;
 
 class html {
 public:
-	static String httpProlog( const String& sMimeType );
-	static String prolog( const String& sTitle, const String& sGenerator="bw" );
+	class Text
+	// Purpose: The text a manipulator writes:  a String, C string or view
+	// Note: Points to the characters, which must outlive the statement
+	{
+	public:
+		Text( const char* psz );
+		Text( const String& s ) : m_pch( s ), m_nLength( s.length() ) {}
+		Text( StringView v ) : m_pch( v.data() ), m_nLength( v.length() ) {}
+
+		const char*	m_pch;
+		int		m_nLength;
+	};
+
+	class Emit
+	// Purpose: A manipulator with arguments, written straight to the ostream
+	// Note: Converts to a String for code that builds the text up first
+	{
+	public:
+		enum Kind { HttpProlog, Prolog, Heading, BeginTable, Definition,
+		            BeginLink, BeginLink2Link, DefineLink, Literal, SmartFormat };
+
+		Emit( Kind kind, Text a, Text b="", int n=0 ) : m_kind( kind ), m_a( a ), m_b( b ), m_n( n ) {}
+
+		void write( std::ostream& os ) const;
+		operator String() const;
+
+	private:
+		Kind	m_kind;
+		Text	m_a;
+		Text	m_b;
+		int		m_n;
+	};
+
+	static Emit httpProlog( Text sMimeType );
+	static Emit prolog( Text sTitle, Text sGenerator="bw" );
 	static std::ostream& epilog( std::ostream& os );
 
-	static String heading1( const String& sHead );
-	static String heading2( const String& sHead );
-	static String heading3( const String& sHead );
-	static String heading4( const String& sHead );
+	static Emit heading1( Text sHead );
+	static Emit heading2( Text sHead );
+	static Emit heading3( Text sHead );
+	static Emit heading4( Text sHead );
 
-	static String beginTable( int nCols );
+	static Emit beginTable( int nCols );
 	static std::ostream& beginRow( std::ostream& os );
 	static std::ostream& beginCell( std::ostream& os );
 	static std::ostream& nextCell( std::ostream& os );
@@ -33,13 +66,13 @@ public:
 	static std::ostream& endTable( std::ostream& os );
 
 	static std::ostream& beginDefinitionList( std::ostream& os );
-	static String definition( const String& sWhat );
+	static Emit definition( Text sWhat );
 	static std::ostream& endDefinitionList( std::ostream& os );
 
-	static String beginLink( const String& sWhere );
-	static String beginLink2Link( const String& sWhere );
+	static Emit beginLink( Text sWhere );
+	static Emit beginLink2Link( Text sWhere );
 	static std::ostream& endLink( std::ostream& os );
-	static String defineLink( const String& sWhere );
+	static Emit defineLink( Text sWhere );
 
 	static std::ostream& rule( std::ostream& os );
 	static std::ostream& newPara( std::ostream& os );
@@ -48,9 +81,15 @@ public:
 	static std::ostream& italicOn( std::ostream& os );
 	static std::ostream& italicOff( std::ostream& os );
 
-	static String literal( const String& sWhat, bool isMultiline=false );
-	static String smartFormat( const String& sWhat );
+	static Emit literal( Text sWhat, bool isMultiline=false );
+	static Emit smartFormat( Text sWhat );
 };
 
+inline std::ostream& operator<<( std::ostream& os, const html::Emit& e )
+{
+	e.write( os );
+	return os;
+}
+
 }	// namespace bw
 
@@ -5,8 +5,11 @@ Copyright (C) 1997-2013, Brian Bray
 */
 
 /* Needs:
+#include <functional>
 #include <map>
 #include <istream> or <sstream>
+#include <string>
+#include <vector>
 #include <bw/string.h>
 
 TODO: Forward Declarations
@@ -21,7 +24,107 @@ std::map< String, String > getAnyData();
 std::map< String, String > getPostData();
 std::map< String, String > getGetData();
 std::map< String, String > getMultiData();
+std::map< String, String > parseMultiData(std::istream& is, const char* pszContentType);
+// Purpose: Decodes a multipart/form-data body, uploaded files in memory
+// Note: A file's field holds its contents and field_name the name sent.
+//       To store larger uploads in files, use MultipartParser directly.
+// throw( BFormatException ) if malformed or a file is over 64K
 std::map< String, String > parseHTTPData(std::istream& is);
+std::map< String, String > parseHTTPData(StringView data);
+// Purpose: Decodes application/x-www-form-urlencoded data (a=1&b=two+words)
+// throw( BFormatException ) on a bad escape or a NUL character
+
+typedef std::function<void( StringView key, StringView value )> FormFn;
+
+void parseHTTPData(StringView data, const FormFn& fn);
+// Purpose: Calls fn with each decoded pair, in order, without building a map
+// Note: key and value are only valid during the call.  They point into data
+//       unless they had escapes.  Pairs with an empty key are skipped.
+// throw( BFormatException ) on a bad escape or a NUL character
+
+StringView decodeURLComponent(StringView in, std::string& buf);
+// Purpose: Decodes %XX escapes and '+'
+// Returns: in itself if it has no escapes, otherwise the decoded characters in buf
+// throw( BFormatException ) on a bad escape or a NUL character
+
+class FormParams
+// Purpose: Form data, looked up and decoded a key at a time
+// Note: Nothing is decoded until asked for, so a handler reading two
+//       parameters doesn't pay for the rest.  Keys may repeat.
+//       Not thread safe:  the first lookup builds an index.
+{
+public:
+	FormParams();
+	// Purpose: No parameters
+
+	explicit FormParams( StringView data );
+	// Purpose: Parameters in urlencoded data kept elsewhere (eg: QUERY_STRING)
+	// Note: data must outlive the FormParams
+
+	explicit FormParams( std::istream& is );
+	// Purpose: Parameters in the rest of a stream (eg: a POST body), which are kept
+	// throw( BFormatException ) on an I/O error
+
+	bool has( const char* pszKey ) const;
+
+	String get( const char* pszKey, const char* pszDefault="" ) const;
+	// Purpose: The first value of a key
+	// Returns: pszDefault if the key is absent
+
+	StringView getView( const char* pszKey, std::string& buf ) const;
+	// Purpose: As get(), without copying if the value has no escapes
+	// Returns: a view into the data or buf; empty if the key is absent
+
+	std::vector< String > getAll( const char* pszKey ) const;
+	// Purpose: Each value of a repeated key (eg: from checkboxes), in order
+
+	long getLong( const char* pszKey, long nDefault=0 ) const;
+	double getDouble( const char* pszKey, double dDefault=0 ) const;
+	// Purpose: A number
+	// Returns: the default if the key is absent or empty
+	// throw( BFormatException ) if the value isn't a number
+
+	bool getBool( const char* pszKey, bool isDefault=false ) const;
+	// Purpose: 1/0, true/false, yes/no or on/off (as checkboxes send)
+	// Returns: the default if the key is absent or empty
+	// throw( BFormatException ) if the value is something else
+
+	int size() const;
+	String key( int i ) const;
+	String value( int i ) const;
+	// Purpose: The pairs in order, for walking all of them
+
+	std::map< String, String > toMap() const;
+	// Purpose: As parseHTTPData()
+
+	// Note: Lookups throw BFormatException if the entries they decode have
+	//       bad escapes
+
+private:
+	struct Entry {
+		int	nKey;		// Offsets into the data
+		int	nKeyLength;
+		int	nValue;
+		int	nValueLength;
+		bool	isKeyEncoded;	// Has escapes
+	};
+
+	const char* data() const {
+		return m_pExternal ? m_pExternal : m_owned.data();
+	}
+	void index() const;
+	int find( const char* pszKey, int nFrom ) const;
+	StringView valueView( int i, std::string& buf ) const;
+
+	const char*	m_pExternal;	// The data, if kept elsewhere
+	std::string	m_owned;	// Otherwise the data
+	int		m_nLength;
+	mutable bool	m_isIndexed;
+	mutable std::vector<Entry>	m_entries;
+};
+
+FormParams getFormParams();
+// Purpose: The form data of a CGI request:  the query, or a urlencoded POST from cin
 
 }	// namespace bw
 
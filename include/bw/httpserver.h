@@ -0,0 +1,171 @@
+/* httpserver.h -- embedded HTTP/1.1 server
+
+Copyright (C) 1997-2013, Brian Bray
+
+*/
+
+/* Needs:
+#include <atomic>
+#include <functional>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "bw/string.h"
+#include "bw/http.h"
+*/
+
+namespace bw {
+
+class ServerState;
+
+class HTTPRequest
+// Purpose: One parsed HTTP request
+// Note: The views point into the connection's input buffer, so they are
+//       only valid during the handler call
+{
+public:
+	StringView method() const {
+		return m_method;
+	}
+	StringView target() const {
+		return m_target;
+	}
+	// Purpose: As sent, eg: "/search?q=bw"
+
+	StringView path() const {
+		return m_path;
+	}
+	StringView query() const {
+		return m_query;
+	}
+	// Purpose: The target before and after the '?' ("" if none)
+
+	StringView header( const char* pszName ) const;
+	// Purpose: A header's value, the name ignoring case
+	// Returns: empty view if absent
+
+	int minorVersion() const {
+		return m_nMinor;
+	}
+	// Purpose: 1 for HTTP/1.1, 0 for HTTP/1.0
+
+	StringView body() const {
+		return m_body;
+	}
+
+	std::map< String, String > form() const;
+	// Purpose: The query (GET) or urlencoded body (POST), as parseHTTPData()
+	// throw( BFormatException ) if malformed
+
+	FormParams params() const;
+	// Purpose: The same data, decoded only as it's asked for
+	// Note: Valid during the handler call, as the views
+
+	int numHeaders() const {
+		return m_nHeaders;
+	}
+	StringView headerName( int i ) const {
+		return m_aHeaders[i].name;
+	}
+	StringView headerValue( int i ) const {
+		return m_aHeaders[i].value;
+	}
+
+private:
+	friend class ServerState;
+	enum { maxHeaders=64 };
+	StringView formData() const;
+
+	struct Header {
+		StringView	name;
+		StringView	value;
+	};
+
+	StringView	m_method;
+	StringView	m_target;
+	StringView	m_path;
+	StringView	m_query;
+	StringView	m_body;
+	int		m_nMinor;
+	int		m_nHeaders;
+	Header	m_aHeaders[maxHeaders];
+};
+
+class HTTPResponse
+// Purpose: The response a handler builds: status, headers and body
+// Note: Content-Length, Date and Connection are added by the server
+{
+public:
+	void setStatus( int nStatus, const char* pszReason=0 );
+	// Purpose: Sets the status (default 200 OK); the reason defaults to the standard one
+
+	void addHeader( const char* pszName, const char* pszValue );
+	// Purpose: Adds a header line (eg: "Content-Type", "text/html")
+
+	std::ostream& out() {
+		return *m_pOut;
+	}
+	// Purpose: The body
+
+	void write( const char* p, size_t n );
+	// Purpose: Appends to the body without formatting
+
+private:
+	friend class ServerState;
+	HTTPResponse( std::ostream& os, std::string& body );
+
+	int		m_nStatus;
+	const char*	m_pszReason;
+	std::string	m_headers;
+	std::ostream*	m_pOut;
+	std::string*	m_pBody;
+};
+
+class HTTPServer
+// Purpose: Serves HTTP/1.1 from one thread, with epoll and non-blocking sockets
+// Note: Keeps connections alive and answers pipelined requests in order.
+//       Handlers run on the server's thread, so they shouldn't block.
+{
+public:
+	typedef std::function<void( const HTTPRequest& req, HTTPResponse& resp )> Handler;
+
+	explicit HTTPServer( const char* pszAddress );
+	// Purpose: Listens on "host:port" or ":port" (port 0 picks a free one)
+	// throw( BFileException ) if the socket can't be set up (or off Linux)
+
+	~HTTPServer();
+
+	int port() const;
+	// Purpose: The port listened on
+
+	void setTimeouts( int nIdleMillisecs, int nRequestMillisecs );
+	// Purpose: Closes connections idle longer than nIdleMillisecs (default 60s),
+	//          or taking longer than nRequestMillisecs (30s) to send a request
+	//          or to take some of their answers
+	// Note: Call before run()
+
+	void run( Handler fn );
+	// Purpose: Serves requests with fn until stop()
+	// throw( BFileException ) if epoll fails
+
+	void stop();
+	// Purpose: Makes run() return
+	// Note: Safe to call from a handler or another thread, or before run()
+
+	unsigned long long requests() const {
+		return m_nRequests;
+	}
+	// Purpose: Number of requests answered
+
+private:
+	ServerState*	m_pState;
+	std::atomic<unsigned long long>	m_nRequests;
+
+	// Prohibit copying
+	HTTPServer( const HTTPServer& );
+	HTTPServer& operator=( const HTTPServer& );
+};
+
+}	// namespace bw
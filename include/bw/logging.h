@@ -6,17 +6,50 @@ Copyright (C) 1999-2013, Brian Bray
 
 /* Needs:
 #include <fstream>
+#include <string>
+#include <vector>
 #include "bw/string.h"
 */
 
 enum LogPriority {EMERG, ALERT, CRIT, ERR, WARNING, NOTICE, INFO, DEBUG};
 
+// Least urgent priority compiled into bwlog() statements.  Anything less
+// urgent compiles to nothing.
+#ifndef BWLOG_LEVEL
+#ifdef _DEBUG
+#define BWLOG_LEVEL DEBUG
+#else
+#define BWLOG_LEVEL INFO
+#endif
+#endif
+
+// Use as:  bwlog( lout, WARNING ) << "message" << endl;
+// The message is only formatted if the priority passes both the compile
+// time level and the LogStream's threshold.
+#define bwlog( LS, P ) if ((P)>BWLOG_LEVEL || !(LS).isEnabled(P)) {} else (LS)(P)
+
+// Use as:  bwrecord( lout, INFO ) << "user " << id << " logged in";
+// As bwlog(), but builds a LogLine, which keeps the arguments raw in
+// Binary format.  There's no endl, the line ends with the statement.
+#define bwrecord( LS, P ) if ((P)>BWLOG_LEVEL || !(LS).isEnabled(P)) {} else (LS).record(P)
+
 namespace bw {
 
 class String;
+class LogWriter;
+class LogRecordBuf;
+class LogLine;
 
 class LogStream {
 public:
+	enum Overflow {
+		BlockWhenFull,	// Callers wait for the writer to catch up
+		DropWhenFull	// Records are discarded and counted
+	};
+	enum Format {
+		Text,		// Lines of text
+		Binary		// Compact records, expanded later by LogReader
+	};
 
 	LogStream();		// Must be opened before use
 	LogStream(const char* ident, const char* filename="");
@@ -26,12 +59,107 @@ public:
 	void close();
 	void reopen();
 
+	void setThreshold(LogPriority lprio) {
+		m_threshold = lprio;
+	}
+	LogPriority threshold() const {
+		return m_threshold;
+	}
+	bool isEnabled(LogPriority lprio) const {
+		return lprio<=m_threshold;
+	}
+
+	void startAsync(unsigned long maxQueued=1<<20, Overflow ov=BlockWhenFull);
+	void flush();
+	unsigned long dropped() const;
+
+	void setFormat(Format fmt);
+	Format format() const {
+		return m_format;
+	}
+
 	std::ostream& operator()(LogPriority lprio);
+	LogLine record(LogPriority lprio);
 
 private:
+	friend class LogRecordBuf;
+	friend class LogLine;
+
+	void stopAsync();
+	std::ostream& target();
+	void emit(std::string& rec);
+	void complete(LogPriority lprio, long long usec, std::string& text);
+	void defineIdent();
+
 	std::ofstream	os;
 	String	m_ident;
 	String	m_filename;
+	LogWriter*	m_pAsync;
+	LogPriority	m_threshold;
+	Format	m_format;
+	unsigned	m_identId;	// Names m_ident in Binary records
+
+	// Prohibit copying
+	LogStream( const LogStream& );
+	LogStream& operator=( const LogStream& );
+};
+
+
+class LogLine {
+public:
+	LogLine(LogStream* pLog, LogPriority lprio);	// pLog==0 discards
+	LogLine(LogLine&& ll);
+	~LogLine();
+
+	LogLine& operator<<(const char* psz);
+	LogLine& operator<<(const String& str);
+	LogLine& operator<<(const std::string& str);
+	LogLine& operator<<(char ch);
+	LogLine& operator<<(int n) {
+		return putSigned(n);
+	}
+	LogLine& operator<<(long n) {
+		return putSigned(n);
+	}
+	LogLine& operator<<(long long n) {
+		return putSigned(n);
+	}
+	LogLine& operator<<(unsigned n) {
+		return putUnsigned(n);
+	}
+	LogLine& operator<<(unsigned long n) {
+		return putUnsigned(n);
+	}
+	LogLine& operator<<(unsigned long long n) {
+		return putUnsigned(n);
+	}
+	LogLine& operator<<(double d);
+
+private:
+	LogLine& putSigned(long long n);
+	LogLine& putUnsigned(unsigned long long n);
+	void putText(const char* ps, unsigned long len);
+
+	LogStream*	m_pLog;
+	LogPriority	m_prio;
+	std::string	m_rec;
+
+	// Prohibit copying
+	LogLine( const LogLine& );
+	LogLine& operator=( const LogLine& );
+};
+
+
+class LogReader {
+public:
+	explicit LogReader(std::istream& is);
+
+	bool read(std::string& line, LogPriority& lprio);
+
+private:
+	std::istream&	m_is;
+	std::vector< std::pair<String,String> >	m_idents;	// host, ident by id
+	std::string	m_rec;
 };
 
 }	//namespace bw
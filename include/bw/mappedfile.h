@@ -0,0 +1,118 @@
+/* mappedfile.h -- memory mapped file object
+
+Copyright (C) 1996-2013, Brian Bray
+
+*/
+
+/* Needs:
+#include "bw/exception.h"
+#include "bw/file.h"
+*/
+
+namespace bw {
+
+class MappedFile
+// Purpose: Maps a whole file into memory
+// Note: The counterpart of BFile for code that wants the file contents as
+//       one contiguous block instead of reading them into a buffer
+{
+public:
+	enum Access {
+		ReadOnly=0,	// Existing file, pages may not be written
+		ReadWrite=1	// Existing file, changes are written back to it
+	};
+
+	enum Advice {
+		Normal=0,
+		Sequential=1,	// Read ahead aggressively, drop pages behind
+		Random=2,	// Don't read ahead
+		WillNeed=3,	// Start reading the range in now
+		DontNeed=4,	// Range won't be used again soon
+		HugePage=5	// Back the range with huge pages where supported
+	};
+
+	MappedFile();
+	// Purpose: Creates unmapped object, call open or create to map a file
+
+	~MappedFile();
+	// Purpose: Unmaps and closes file (if open)
+
+	MappedFile( const char* fileName, Access ac=MappedFile::ReadOnly );
+	// Purpose: Creates object mapping an existing file
+	// throw( BFileException ) if unable to open or map for any reason
+
+	bool open( const char* fileName, Access ac=MappedFile::ReadOnly );
+	// Purpose: Maps an existing file
+	// Requires: Not currently open
+	// Returns: true on success, false if file doesn't exist
+	// throw( BFileException ) on all other errors
+
+	void create( const char* fileName, BFile::Offset size );
+	// Purpose: Creates (or truncates) a file of size bytes (zeros) and maps it ReadWrite
+	// Requires: Not currently open
+	// throw( BFileException ) on error
+
+	void close();
+	// Purpose: Unmaps and closes file (if any)
+	// throw( BFileException ) on serious errors
+
+	bool isOpen() const {
+		return m_fd>=0;
+	}
+	// Purpose: indicates if a file is mapped
+
+	const char* data() const {
+		return m_pData;
+	}
+	// Purpose: Start of the file contents (0 for an empty file)
+	// Note: Invalidated by resize() and close()
+
+	char* data() {
+		return m_pData;
+	}
+	// Requires: Mapped ReadWrite to write through the pointer
+
+	BFile::Offset size() const {
+		return m_size;
+	}
+	// Purpose: Size of the file and the mapping
+	// Note: 64 bits, as BFile; a file bigger than the address space can't be mapped
+
+	bool isWritable() const {
+		return m_access==ReadWrite;
+	}
+
+	void resize( BFile::Offset newSize );
+	// Purpose: Grows (or shrinks) the file and its mapping to newSize bytes
+	// Requires: Mapped ReadWrite
+	// Promises: New bytes are zero, data() may change
+	// throw( BFileException ) on error
+
+	bool advise( Advice adv, BFile::Offset offset=0, BFile::Offset length=-1 );
+	// Purpose: Hints how a range (by default all) of the mapping will be used
+	// Returns: false if the system doesn't support the hint
+	// Note: Hints never change the contents
+
+	void sync( bool wait=true );
+	// Purpose: Writes changed pages back to the file
+	// Requires: Mapped ReadWrite
+	// Note: With wait false the writes are only scheduled
+	// throw( BFileException ) on error
+
+private:
+	void map();
+	void unmap();
+	void remap( BFile::Offset newSize );
+
+	int	m_fd;
+	Access	m_access;
+	char*	m_pData;
+	BFile::Offset	m_size;
+
+	// MappedFiles cannot be copied or assigned
+	MappedFile( const MappedFile& );
+	MappedFile& operator=( const MappedFile& );
+};
+
+}	// namespace bw
+
@@ -0,0 +1,158 @@
+/* metrics.h -- Counters and latency histograms for instrumentation
+
+Copyright (C) 1997-2013, Brian Bray
+
+*/
+
+/* Needs:
+#include <atomic>
+#include <chrono>
+#include <iosfwd>
+*/
+
+namespace bw {
+
+class MetricBlock;
+
+/*: class Metrics
+
+	Registry of all counters and histograms.  Every thread updates its
+	own copy of each metric, so recording never contends; reading adds
+	up the copies of all threads.
+*/
+class Metrics {
+public:
+	enum {
+		maxCounters = 256,
+		maxHistograms = 64,
+		nBuckets = 64		// Bucket i holds [2^i, 2^(i+1)) ns
+	};
+
+	static void writeText( std::ostream& os );
+
+	// This thread's copies
+	static MetricBlock& local() {
+		MetricBlock* pmb = s_pLocal;
+		return pmb ? *pmb : attach();
+	}
+
+private:
+	friend class MetricCounter;
+	friend class MetricHistogram;
+	friend struct MetricBlockOwner;
+
+	static MetricBlock& attach();
+	static int registerMetric( const char* name, const char* help, bool isHistogram );
+
+	static thread_local MetricBlock*	s_pLocal;
+};
+
+
+/* class MetricBlock
+
+   One thread's values.  Only the owning thread writes, so updates are
+   plain loads and stores; they are atomic only so that readers on other
+   threads see whole values.
+*/
+class MetricBlock {
+public:
+	struct Histogram {
+		std::atomic<unsigned long long>	count;
+		std::atomic<unsigned long long>	sumNs;
+		std::atomic<unsigned long long>	buckets[Metrics::nBuckets];
+	};
+
+	static void bump( std::atomic<unsigned long long>& cell, unsigned long long n ) {
+		cell.store( cell.load(std::memory_order_relaxed)+n, std::memory_order_relaxed );
+	}
+
+	std::atomic<unsigned long long>	counters[Metrics::maxCounters];
+	Histogram	histograms[Metrics::maxHistograms];
+	std::atomic<bool>	inUse;		// Owned by a live thread
+	MetricBlock*	pNext;		// All blocks, never removed
+};
+
+
+/*: class MetricCounter
+
+	A named count, e.g. of events handled.  Define counters with static
+	storage duration:
+
+	static MetricCounter s_nEvents( "bw_scene_events_total", "Events dispatched" );
+	...
+	s_nEvents.add();
+*/
+class MetricCounter {
+public:
+	MetricCounter( const char* name, const char* help="" )
+		: m_id( Metrics::registerMetric(name,help,false) ) {}
+
+	void add( unsigned long long n=1 ) {
+		MetricBlock::bump( Metrics::local().counters[m_id], n );
+	}
+	unsigned long long value() const;
+
+private:
+	int	m_id;
+};
+
+
+/*: class MetricHistogram
+
+	A named latency distribution.  Durations are counted in buckets whose
+	bounds are powers of two nanoseconds, so recording is a count of
+	leading zeros and three stores.  Use with MetricTimer:
+
+	static MetricHistogram s_drawTime( "bw_figure_draw_seconds", "Figure draw time" );
+	...
+	{
+		MetricTimer mt( s_drawTime );
+		draw( cvs );
+	}
+*/
+class MetricHistogram {
+public:
+	MetricHistogram( const char* name, const char* help="" )
+		: m_id( Metrics::registerMetric(name,help,true) ) {}
+
+	void record( unsigned long long ns ) {
+		MetricBlock::Histogram& h = Metrics::local().histograms[m_id];
+		int i = ns ? 63-__builtin_clzll(ns) : 0;
+		MetricBlock::bump( h.buckets[i], 1 );
+		MetricBlock::bump( h.sumNs, ns );
+		MetricBlock::bump( h.count, 1 );
+	}
+	unsigned long long count() const;
+	unsigned long long sumNs() const;
+	unsigned long long bucket( int i ) const;
+
+private:
+	int	m_id;
+};
+
+
+/*: class MetricTimer
+
+	Records the time from its construction to its destruction in a
+	histogram.
+*/
+class MetricTimer {
+public:
+	explicit MetricTimer( MetricHistogram& mh )
+		: m_mh(mh), m_start( std::chrono::steady_clock::now() ) {}
+	~MetricTimer() {
+		m_mh.record( std::chrono::duration_cast<std::chrono::nanoseconds>(
+		                 std::chrono::steady_clock::now()-m_start ).count() );
+	}
+
+private:
+	MetricHistogram&	m_mh;
+	std::chrono::steady_clock::time_point	m_start;
+
+	// Prohibit copying
+	MetricTimer( const MetricTimer& );
+	MetricTimer& operator=( const MetricTimer& );
+};
+
+}	// namespace bw
+
@@ -0,0 +1,79 @@
+/* multipart.h -- streaming parser for multipart/form-data uploads
+
+Copyright (C) 1997-2013, Brian Bray
+
+*/
+
+/* Needs:
+#include <functional>
+#include <map>
+#include <istream>
+#include "bw/string.h"
+*/
+
+namespace bw {
+
+class MultipartState;
+
+class MultipartParser
+// Purpose: Parses multipart/form-data (RFC 2388) as it arrives, passing file
+//          parts on without holding them in memory
+// Note: Binary safe.  Ordinary fields are collected in fields().
+{
+public:
+	struct Part {
+		String	name;		// From Content-Disposition
+		String	fileName;	// As sent by the browser, "" for ordinary fields
+		String	contentType;	// "" if not given
+	};
+
+	typedef std::function<void( const Part& part, const char* pData, size_t nData, bool isEnd )> FileFn;
+	// Called with each piece of a file part as it arrives, then once with isEnd
+
+	explicit MultipartParser( const char* pszBoundary );
+	// Purpose: Parser for a body whose parts are divided by pszBoundary
+	// throw( BFormatException ) if the boundary is empty or too long
+
+	~MultipartParser();
+
+	static String boundaryOf( const char* pszContentType );
+	// Purpose: Extracts the boundary from a Content-Type header (or CONTENT_TYPE)
+	// Returns: "" unless it is multipart/form-data with a boundary
+
+	void setFileDirectory( const char* pszDir );
+	// Purpose: Stores file parts in new files in pszDir (default $TMPDIR or /tmp)
+	// Note: fields() then maps the part's name to the file's path, and
+	//       name+"_name" to the fileName.  The caller removes the files once
+	//       finish() succeeds; before that the destructor does.
+
+	void setFileHandler( FileFn fn );
+	// Purpose: Passes file parts to fn instead of storing them
+
+	void setFieldLimit( int nBytes );
+	// Purpose: Largest ordinary field accepted (default 32K)
+	// Requires: nBytes<65536
+
+	void feed( const char* pData, size_t nData );
+	// Purpose: Parses the next piece of the body, of any size
+	// throw( BFormatException ) if the body is malformed or a field too long
+	// throw( BFileException ) if a file part can't be stored
+
+	void finish();
+	// Purpose: Checks the whole body was fed
+	// throw( BFormatException ) if the closing boundary wasn't seen
+
+	void parse( std::istream& is );
+	// Purpose: Feeds the rest of is in large blocks, then calls finish()
+
+	std::map< String, String >& fields();
+	// Purpose: Ordinary fields by name (and the stored files, see setFileDirectory())
+
+private:
+	MultipartState*	m_pState;
+
+	// Prohibit copying
+	MultipartParser( const MultipartParser& );
+	MultipartParser& operator=( const MultipartParser& );
+};
+
+}	// namespace bw
@@ -0,0 +1,75 @@
+/* pathbuilder.h -- normalized paths built in place
+
+Copyright (C) 1997-2013, Brian Bray
+
+*/
+
+/* Needs:
+#include <limits.h>
+#include <string>
+#include "bw/string.h"
+#include "bw/filename.h"
+*/
+
+namespace bw {
+
+class PathBuilder
+// Purpose: Builds a normalized path in a fixed buffer, without allocating
+// Note: "." components are dropped and ".." removes the component before
+//       it, so the path has no repeated or trailing '/'.  This is done on
+//       the text alone:  symbolic links are not followed.
+{
+public:
+	explicit PathBuilder( const char* pszPath="" );
+	// Purpose: Starts with pszPath, normalized
+	// throw( BFileException ) if longer than PATH_MAX
+
+	void set( const char* pszPath );
+	// Purpose: Replaces the path with pszPath, normalized
+	// throw( BFileException ) if longer than PATH_MAX
+
+	void append( const char* pszPath );
+	void append( const PathView& pv );
+	// Purpose: Adds a relative path at the end (an absolute one replaces the path)
+	// throw( BFileException ) if the result is longer than PATH_MAX, and then
+	//       the path is unchanged
+
+	bool pop();
+	// Purpose: Removes the last component (giving the parent directory, unless
+	//          the component is "..")
+	// Returns: false if there was none to remove (the path is "/" or "")
+
+	void clear() {
+		m_nLength = 0;
+		m_achPath[0] = '\0';
+	}
+
+	bool isAbsolute() const {
+		return m_achPath[0]=='/';
+	}
+
+	int length() const {
+		return m_nLength;
+	}
+
+	operator const char*() const {
+		return m_achPath;
+	}
+	// Note: "" for the current directory, when ".." or "." cancel everything
+
+	PathView lastComponent() const;
+	// Purpose: The final name in the path ("" for "/" or "")
+
+	FileName fileName() const {
+		return FileName( m_achPath );
+	}
+
+private:
+	void add( const char* pch, int nLength );
+	bool addUnchecked( const char* pch, int nLength );
+
+	int		m_nLength;
+	char	m_achPath[PATH_MAX];
+};
+
+}	// namespace bw
@@ -0,0 +1,61 @@
+/* response.h -- streamed, compressed HTTP response bodies
+
+Copyright (C) 1997-2013, Brian Bray
+
+*/
+
+/* Needs:
+#include <ostream>
+*/
+
+namespace bw {
+
+class ResponseBuf;
+
+class ResponseWriter : public std::ostream
+// Purpose: A response body sent as it's written, gzip or deflate compressed
+//          when the client accepts it
+// Note: Write any other headers (Status:, Set-Cookie: ...) to the underlying
+//       stream first, then call begin().  flush() sends what has been
+//       written so far, eg: the top of a page before a slow query.
+{
+public:
+	enum Encoding { Identity, Gzip, Deflate };
+
+	enum Framing {
+		CGI,		// The web server frames the body (CGI, FastCGI)
+		Chunked		// Transfer-Encoding: chunked, for HTTP/1.1 written directly
+	};
+
+	ResponseWriter( std::ostream& os, const char* pszAcceptEncoding, Framing framing=CGI );
+	// Purpose: A body written to os, compressed as pszAcceptEncoding (the
+	//          HTTP_ACCEPT_ENCODING variable, or 0) allows
+	// throw( std::bad_alloc ) if the compressor can't be set up
+
+	~ResponseWriter();
+	// Note: Calls finish() if it hasn't been, but only after begin() and not
+	//       when unwinding from an exception (the body is discarded then)
+
+	void begin( const char* pszContentType );
+	// Purpose: Writes Content-Type and the encoding headers, and ends the headers
+
+	void finish();
+	// Purpose: Writes the end of the compressed data and of the chunks, and flushes
+	// Note: Nothing more may be written after
+
+	Encoding encoding() const;
+	// Purpose: The encoding chosen
+
+	static Encoding negotiate( const char* pszAcceptEncoding );
+	// Purpose: The preferred encoding that an Accept-Encoding value allows
+	// Returns: Gzip before Deflate, Identity if neither is acceptable
+
+private:
+	ResponseBuf*	m_pBuf;
+
+	// Prohibit copying
+	ResponseWriter( const ResponseWriter& );
+	ResponseWriter& operator=( const ResponseWriter& );
+};
+
+}	// namespace bw
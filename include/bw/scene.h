@@ -14,6 +14,7 @@ class Scene;
 class String;
 
 class Atoms;
+class AsyncIO;
 
 class Scene : private virtual FigureBase, public Figure, public Parent {
 public:
@@ -27,6 +28,10 @@ public:
 	               LogPos lposWidth, LogPos lposHeight );
 	void removeFrame( Figure* pfig );
 	void setFlashRate( int msec );
+	void setAsyncIO( AsyncIO* paio );
+	typedef void (*InputProc)( int fd, void* pv );
+	void addInput( int fd, InputProc pfn, void* pv );
+	void removeInput( int fd );
 	void dispatch( const Event& ev, EventRet& evr );
 	void doDraw();
 	virtual void onResizeRequest( Figure* fig, LogPos lposWidth, LogPos lposHeight );
@@ -39,6 +44,7 @@ private:
 	bool onAction( const String& strCommand );
 	void draw( Canvas& cvs );
 	void messagePump();
+	bool waitForEvent();
 	void absLoc(Figure*,LogPos,LogPos,LogPos,LogPos,int&,int&,int&,int&);
 
 	void*	m_pDisplay;
@@ -47,6 +53,16 @@ private:
 	String	m_strCommand;
 	bool	m_haveInvalidRegions;
 	Atoms*	m_patoms;
+	AsyncIO*	m_paio;
+
+	enum { maxInputs=8 };
+	struct Input {
+		int		fd;
+		InputProc	pfn;
+		void*	pv;
+	};
+	Input	m_aInputs[maxInputs];
+	int		m_nInputs;
 };
 
 }	//Namespace bw
@@ -12,6 +12,7 @@ TODO: deprecated
 
 namespace bw {
 
+class UString;
 
 // Represents a null terminated string of characters
 class String {
@@ -29,6 +30,7 @@ public:	//	Ctor, Dtor
 	String( const String& str );
 	String( const char* psz );
 	String( const char* ps, const int length );
+	explicit String( const UString& ustr );
 	~String();
 
 public:	//	Operators
@@ -50,12 +52,16 @@ public:	//	Operators
 		return m_pszString;
 	}
 	String& operator=( const String& str) {
-		return operator=(str.m_pszString);
+		operator=(str.m_pszString);
+		m_hash = m_isLent ? 0 : __atomic_load_n( &str.m_hash, __ATOMIC_RELAXED );
+		return *this;
 	}
 	String& operator=( const char* );
 	String& operator=( char );
 	char& operator[](int indx) {
 		bwassert(indx<=length());
+		m_hash = 0;		// Caller may change the character, even after hash()
+		m_isLent = true;
 		return m_pszString[indx];
 	}
 	const char& operator[](int indx) const {
@@ -72,6 +78,10 @@ public:	//	Functions
 		return m_pszString;
 	}
 	int length() const;
+	unsigned long hash() const {
+		unsigned long h = __atomic_load_n( &m_hash, __ATOMIC_RELAXED );
+		return h ? h : computeHash();
+	}
 	void append( const String& str ) {
 		append(str.m_pszString);
 	}
@@ -113,14 +123,18 @@ public:	//	Functions
 	String substring(int start, int end) const;
 	void toLowerCase();
 	void toUpperCase();
+	UString toUString() const;
 
 
 private:  // Internal routines
+	unsigned long computeHash() const;
 
 
 private:  // Storage
 	char*	m_pszString;
 	int		m_lenMax;	// Allocated buffer length (includes null)
+	bool	m_isLent;	// A char& has been handed out, so hash() isn't cached
+	mutable unsigned long	m_hash;	// Cached hash(), 0 if not yet computed; atomic in const members
 };
 
 // Comparison operators
@@ -214,6 +228,44 @@ inline bool operator>(const char* s1, const String& s2)
 	return s2.compareTo(s1)<0;
 }
 
+class StringView
+// Purpose: Characters of a string kept elsewhere, as a pointer and length
+// Note: Not NUL terminated.  Valid until the string it came from changes.
+{
+public:
+	StringView() : m_pch( "" ), m_nLength( 0 ) {}
+	StringView( const char* pch, int nLength ) : m_pch( pch ), m_nLength( nLength ) {}
+
+	const char* data() const {
+		return m_pch;
+	}
+	int length() const {
+		return m_nLength;
+	}
+	bool isEmpty() const {
+		return m_nLength==0;
+	}
+
+	bool operator==( const char* psz ) const;
+	bool operator!=( const char* psz ) const {
+		return !operator==( psz );
+	}
+	// Purpose: Compares with a whole NUL terminated string
+
+	bool equalsIgnoreCase( const char* psz ) const;
+
+	String toString() const;
+	// Purpose: Copies the characters into a String
+
+private:
+	const char*	m_pch;
+	int		m_nLength;
+};
+
+// Hash of a byte sequence, never 0.  String::hash() is hashBytes() of
+// the characters without the terminator.
+unsigned long hashBytes( const void* pv, unsigned long len );
+
 // Syntax sugar
 
 // Localizable string constant TODO: StringConst V( S, __FILE__, V )
@@ -0,0 +1,101 @@
+/* template.h -- precompiled HTML templates
+
+Copyright (C) 1997-2013, Brian Bray
+
+*/
+
+/* Needs:
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "bw/string.h"
+*/
+
+namespace bw {
+
+class TemplateData
+// Purpose: The values a template is rendered with: named text, flags and lists of rows
+// Note: A row sees its own values first, then those of the data it was added to
+{
+public:
+	TemplateData();
+	~TemplateData();
+
+	void set( const char* pszName, StringView value );
+	void set( const char* pszName, const char* pszValue );
+	void set( const char* pszName, const String& value );
+	void set( const char* pszName, long nValue );
+	// Purpose: Sets a value, replacing any before
+
+	void setFlag( const char* pszName, bool isSet );
+	// Purpose: Sets a value for {{#name}} and {{^name}} to test
+
+	TemplateData& add( const char* pszList );
+	// Purpose: Adds a row to a list, for {{#name}} to loop over
+	// Returns: the row, to set its values
+
+	void clear();
+	// Purpose: Removes every value, to reuse the object
+
+private:
+	friend class Template;
+	struct Value {
+		std::string	name;
+		std::string	text;
+		std::vector<TemplateData*>	rows;
+	};
+
+	Value& value( const char* pszName );
+	const Value* find( const char* pch, int len ) const;
+
+	std::vector<Value>	m_values;
+	const TemplateData*	m_pParent;
+
+	// Prohibit copying
+	TemplateData( const TemplateData& );
+	TemplateData& operator=( const TemplateData& );
+};
+
+class Template
+// Purpose: An HTML page with {{name}} substitutions, parsed once and rendered many times
+// Note: Rendering writes straight into the stream's buffer
+{
+public:
+	explicit Template( StringView text );
+	// Purpose: Compiles a template
+	// throw( BFormatException ) if a tag is unterminated or sections don't match
+
+	void render( std::ostream& os, const TemplateData& data ) const;
+	// Purpose: Writes the page for data
+
+	static std::shared_ptr<const Template> load( const char* pszPath );
+	// Purpose: The compiled template in a file, cached for the process
+	// Note: Recompiled when the file changes (see setReloadInterval()).  Safe to
+	//       call from several threads; a render in progress keeps its version.
+	// throw( BFileException ) if the file can't be read
+	// throw( BFormatException ) if it isn't a valid template
+
+	static void setReloadInterval( int nSeconds );
+	// Purpose: How often load() checks whether a file changed (default 1 second)
+
+private:
+	struct Op {
+		enum Code { Text, Escaped, Raw, Section, Inverted };
+		Code	code;
+		int		nStart;		// Text or name, in m_source
+		int		nLength;
+		int		nEnd;		// Sections: the op after the section
+	};
+
+	void renderOps( std::ostream& os, int nFrom, int nTo, const TemplateData& data ) const;
+
+	std::string	m_source;
+	std::vector<Op>	m_ops;
+
+	// Prohibit copying
+	Template( const Template& );
+	Template& operator=( const Template& );
+};
+
+}	// namespace bw
@@ -1,4 +1,4 @@
-/* trace.h -- Trace ofstream or dummy
+/* trace.h -- Trace ofstream, ring buffer or dummy
 
 Copyright (C)1996-2013, Brian Bray
 
@@ -8,23 +8,212 @@ Copyright (C)1996-2013, Brian Bray
 #include <iostream>
 */
 
+// Modes:
+//   NOTRACE         trace output is discarded at compile time
+//   BTRACE_RING     trace output goes to a per thread in memory ring
+//                   buffer, dumped by BTraceRing::dump() (see tracering.cc)
+//   BTRACE_TRACING  trace is std::cout (default in _DEBUG builds)
+
 #ifdef _DEBUG
 #ifndef NOTRACE
+#ifndef BTRACE_RING
 #define BTRACE_TRACING
 #endif
 #endif
+#endif
 
-#ifdef BTRACE_TRACING
+#ifdef NOTRACE
+#undef BTRACE_RING
+#endif
 
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <atomic>
+
+namespace bw {
+class String;
+}
+
+class BTraceRing {
+public:
+	enum {
+		nSlots = 2048,		// Per thread, a power of 2
+		slotDataSize = 22
+	};
+	struct Slot {
+		unsigned long long	ns;	// When the line started
+		unsigned char	tag;
+		unsigned char	len;
+		char		data[slotDataSize];
+	};
+
+	// This thread's ring
+	static BTraceRing& local() {
+		BTraceRing* pRing = s_pLocal;
+		return pRing ? *pRing : attach();
+	}
+
+	static void dump( int fd=2 );
+	static void dumpOnSignal( int signo );
+
+	void put( unsigned char tag, const void* pv, unsigned len ) {
+		if (m_isLineStart) {
+			m_lineNs = now();
+			m_isLineStart = false;
+		}
+		unsigned long long h = m_head.load(std::memory_order_relaxed);
+		Slot& s = m_slots[h & (nSlots-1)];
+		s.ns = m_lineNs;
+		s.tag = tag;
+		s.len = len;
+		std::char_traits<char>::copy( s.data, (const char*)pv, len );
+		m_head.store(h+1, std::memory_order_release);
+	}
+	void putText( const char* ps, unsigned long len ) {
+		do {
+			unsigned n = len<slotDataSize ? len : slotDataSize;
+			put( 's', ps, n );
+			ps += n;
+			len -= n;
+		} while (len);
+	}
+	void endLine() {
+		put( 'e', 0, 0 );
+		m_isLineStart = true;
+	}
+
+private:
+	BTraceRing();
+	static BTraceRing& attach();
+	static unsigned long long now();
+	void dumpRing( int fd );
+
+	Slot	m_slots[nSlots];
+	std::atomic<unsigned long long>	m_head;	// Count of slots ever written
+	unsigned long long	m_lineNs;
+	bool	m_isLineStart;
+	std::atomic<bool>	m_inUse;	// Owned by a live thread
+	BTraceRing*	m_pNext;	// All rings, never removed
+
+	static thread_local BTraceRing*	s_pLocal;
+	static std::atomic<BTraceRing*>	s_pFirst;
+	friend struct BTraceRingOwner;
+};
+
+inline BTraceRing& operator<<(BTraceRing& tr, bool b)
+{
+	tr.put( 'b', &b, 1 );
+	return tr;
+}
+inline BTraceRing& operator<<(BTraceRing& tr, char ch)
+{
+	tr.put( 'c', &ch, 1 );
+	return tr;
+}
+inline BTraceRing& operator<<(BTraceRing& tr, long long n)
+{
+	tr.put( 'i', &n, sizeof(n) );
+	return tr;
+}
+inline BTraceRing& operator<<(BTraceRing& tr, unsigned long long n)
+{
+	tr.put( 'u', &n, sizeof(n) );
+	return tr;
+}
+inline BTraceRing& operator<<(BTraceRing& tr, short n)
+{
+	return tr << (long long)n;
+}
+inline BTraceRing& operator<<(BTraceRing& tr, int n)
+{
+	return tr << (long long)n;
+}
+inline BTraceRing& operator<<(BTraceRing& tr, long n)
+{
+	return tr << (long long)n;
+}
+inline BTraceRing& operator<<(BTraceRing& tr, unsigned short n)
+{
+	return tr << (unsigned long long)n;
+}
+inline BTraceRing& operator<<(BTraceRing& tr, unsigned n)
+{
+	return tr << (unsigned long long)n;
+}
+inline BTraceRing& operator<<(BTraceRing& tr, unsigned long n)
+{
+	return tr << (unsigned long long)n;
+}
+inline BTraceRing& operator<<(BTraceRing& tr, double d)
+{
+	tr.put( 'd', &d, sizeof(d) );
+	return tr;
+}
+inline BTraceRing& operator<<(BTraceRing& tr, float f)
+{
+	return tr << (double)f;
+}
+inline BTraceRing& operator<<(BTraceRing& tr, const void* pv)
+{
+	tr.put( 'p', &pv, sizeof(pv) );
+	return tr;
+}
+inline BTraceRing& operator<<(BTraceRing& tr, const char* psz)
+{
+	if (!psz)
+		psz = "(null)";
+	tr.putText( psz, std::char_traits<char>::length(psz) );
+	return tr;
+}
+inline BTraceRing& operator<<(BTraceRing& tr, char* psz)
+{
+	return tr << (const char*)psz;
+}
+inline BTraceRing& operator<<(BTraceRing& tr, const std::string& str)
+{
+	tr.putText( str.data(), str.size() );
+	return tr;
+}
+BTraceRing& operator<<(BTraceRing& tr, const bw::String& str);
+
+// Anything else that can go to an ostream is formatted as text
+template <class T> BTraceRing& operator<<(BTraceRing& tr, const T& v)
+{
+	std::ostringstream os;
+	os << v;
+	return tr << os.str();
+}
+
+// endl ends a line, other manipulators are ignored
+inline BTraceRing& operator<<(BTraceRing& tr, std::ostream& (*pf)(std::ostream&))
+{
+	if (pf==static_cast<std::ostream& (*)(std::ostream&)>(std::endl))
+		tr.endLine();
+	return tr;
+}
+inline BTraceRing& operator<<(BTraceRing& tr, std::ios& (*)(std::ios&))
+{
+	return tr;
+}
+inline BTraceRing& operator<<(BTraceRing& tr, std::ios_base& (*)(std::ios_base&))
+{
+	return tr;
+}
+
+
+#if defined(BTRACE_RING)
+
+#define trace BTraceRing::local()
+#define tracein std::cin
+
+#elif defined(BTRACE_TRACING)
 
 #define trace std::cout
 #define tracein std::cin
 
 #else
 
-#include <iostream>
-
 class BTrace {};
 extern BTrace trace, tracein;
 template <class T> BTrace& operator<<(BTrace& tr, T)
@@ -10,6 +10,7 @@ Copyright (C) 1997-2013, Brian Bray
 
 namespace bw {
 
+class String;
 
 // Represents a null terminated unicode string of characters
 class UString {
@@ -27,6 +28,7 @@ public:	//	Ctor, Dtor
 	UString( const UString& str );
 	UString( const wchar_t* psz );
 	UString( const wchar_t* ps, const int length );
+	explicit UString( const String& str );
 	~UString();
 
 public:	//	Operators
@@ -48,12 +50,16 @@ public:	//	Operators
 		return m_pszString;
 	}
 	UString& operator=( const UString& str) {
-		return operator=(str.m_pszString);
+		operator=(str.m_pszString);
+		m_hash = m_isLent ? 0 : __atomic_load_n( &str.m_hash, __ATOMIC_RELAXED );
+		return *this;
 	}
 	UString& operator=( const wchar_t* );
 	UString& operator=( wchar_t );
 	wchar_t& operator[](int indx) {
 		bwassert(indx<=length());
+		m_hash = 0;		// Caller may change the character, even after hash()
+		m_isLent = true;
 		return m_pszString[indx];
 	}
 	const wchar_t& operator[](int indx) const {
@@ -70,6 +76,10 @@ public:	//	Functions
 		return m_pszString;
 	}
 	int length() const;
+	unsigned long hash() const {
+		unsigned long h = __atomic_load_n( &m_hash, __ATOMIC_RELAXED );
+		return h ? h : computeHash();
+	}
 	void append( const UString& str ) {
 		append(str.m_pszString);
 	}
@@ -111,14 +121,18 @@ public:	//	Functions
 	UString substring(int start, int end) const;
 	void toLowerCase();
 	void toUpperCase();
+	String toString() const;
 
 
 private:  // Internal routines
+	unsigned long computeHash() const;
 
 
 private:  // Storage
 	wchar_t*	m_pszString;
 	int		m_lenMax;	// Allocated buffer length (includes null)
+	bool	m_isLent;	// A wchar_t& has been handed out, so hash() isn't cached
+	mutable unsigned long	m_hash;	// Cached hash(), 0 if not yet computed; atomic in const members
 };
 
 // Comparison operators
@@ -0,0 +1,34 @@
+/* utf8.h -- UTF-8 <-> UTF-32 (wchar_t) transcoding
+
+Copyright (C) 1997-2013, Brian Bray
+
+*/
+
+/* Needs:
+nothing
+*/
+
+namespace bw {
+
+int utf8DecodedLength( const char* ps, int len );
+// Purpose: Validates len bytes of UTF-8
+// Returns: count of wchar_t's needed to hold the decoded text (no terminator)
+//          or -1 if the input is not well formed UTF-8
+
+int utf8Decode( const char* ps, int len, wchar_t* pwsOut );
+// Purpose: Decodes len bytes of UTF-8 into pwsOut (not terminated)
+// Requires: pwsOut has room for utf8DecodedLength(ps,len) characters
+// Returns: count of wchar_t's written or -1 if the input is not well formed
+
+int utf8EncodedLength( const wchar_t* pws, int len );
+// Purpose: Validates len UTF-32 characters
+// Returns: count of bytes needed to hold the encoded text (no terminator)
+//          or -1 if a character is a surrogate or beyond U+10FFFF
+
+int utf8Encode( const wchar_t* pws, int len, char* psOut );
+// Purpose: Encodes len UTF-32 characters as UTF-8 into psOut (not terminated)
+// Requires: psOut has room for utf8EncodedLength(pws,len) bytes
+// Returns: count of bytes written or -1 if a character cannot be encoded
+
+}	// namespace bw
+
@@ -5,7 +5,8 @@ Copyright (C) 1999-2013, Brian Bray
 */
 
 /* Needs:
-#include "bw/countable.h"
+#include <atomic>
+#include "bw/acountable.h"
 #include "bw/exception.h"
 #include <string>
 #include <map>
@@ -25,12 +26,12 @@ using std::istream;
 class NumStream;
 class XMLNode;
 class XMLDocument;
-typedef cptr<XMLNode> XMLNodeRef;
-typedef cptr<XMLDocument> XMLDocRef;
+typedef acptr<XMLNode> XMLNodeRef;
+typedef acptr<XMLDocument> XMLDocRef;
 
 class XMLVisitor;
 
-class XMLNode : public Countable {
+class XMLNode : public AtomicCountable<XMLNode> {
 public:
 	virtual ~XMLNode() {}
 	string& value() {
@@ -4,21 +4,598 @@ Copyright (C) 1999-2013, Brian Bray
 
 */
 
-#include <iomanip>
 #include <fstream>
 #include <iostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
 
 #include "bw/bwassert.h"
 #include "bw/string.h"
+#include "bw/exception.h"
 #include "bw/logging.h"
 
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <ctime>
 using std::time;
-using std::localtime;
 #include <unistd.h>
 
 namespace bw {
 
+// Compilation time options
+
+// The background writer gathers queued records into writes of up to
+// this many bytes.
+const size_t asyncBatchSize = 64*1024;
+
+// The background writer wakes at least this often, so a missed wakeup
+// only delays output.
+const int asyncPollMillisecs = 50;
+
+
+/* class LogRecord
+
+   A completed log line on its way to the background writer.  Records are
+   linked into an intrusive multiple producer, single consumer queue.
+*/
+struct LogRecord {
+	std::atomic<LogRecord*>	pNext;
+	std::string		text;
+};
+
+
+/* class LogWriter
+
+   Background writer thread for an asynchronous LogStream.
+
+   Producers push records onto a lock free MPSC queue (D. Vyukov's
+   intrusive design: one atomic exchange per push).  The writer drains the
+   queue, concatenates records into large batches and writes each batch
+   with a single write and flush.  The mutex and condition variables are
+   only used for sleeping: by the writer when idle, by producers when the
+   queue is full under BlockWhenFull, and by flush().
+*/
+class LogWriter {
+public:
+	LogWriter(std::ostream& os, unsigned long maxQueued, LogStream::Overflow ov);
+	~LogWriter();
+
+	void push(std::string& text);
+	void flush();
+	unsigned long dropped() const {
+		return m_dropped.load(std::memory_order_relaxed);
+	}
+	std::mutex& ioMutex() {
+		return m_ioMutex;
+	}
+
+	static void flushAll();
+
+private:
+	void enqueue(LogRecord* prec);
+	LogRecord* dequeue();
+	void run();
+
+	std::ostream&	m_os;
+	const unsigned long	m_maxQueued;
+	const LogStream::Overflow	m_overflow;
+
+	std::atomic<LogRecord*>	m_head;		// Producers push here
+	LogRecord*		m_tail;		// Writer pops here
+	LogRecord		m_stub;
+
+	std::atomic<unsigned long>	m_queued;	// Bytes pushed but not yet written
+	std::atomic<unsigned long>	m_dropped;
+	std::atomic<bool>	m_sleeping;
+	std::atomic<bool>	m_stop;
+
+	std::mutex		m_mutex;
+	std::condition_variable	m_wakeCv;	// Wakes the writer
+	std::condition_variable	m_spaceCv;	// Signalled after each batch
+	std::mutex		m_ioMutex;	// Held while writing to m_os
+
+	LogWriter*		m_pNextLive;	// All running writers, for exit
+	static LogWriter*	s_pLive;
+	static std::mutex	s_liveMutex;
+
+	std::thread		m_thread;
+};
+
+LogWriter* LogWriter::s_pLive = 0;
+std::mutex LogWriter::s_liveMutex;
+
+static void flushAtExit()
+{
+	LogWriter::flushAll();
+}
+
+LogWriter::LogWriter(std::ostream& os, unsigned long maxQueued, LogStream::Overflow ov)
+	: m_os(os),
+	  m_maxQueued(maxQueued),
+	  m_overflow(ov),
+	  m_head(&m_stub),
+	  m_tail(&m_stub),
+	  m_queued(0),
+	  m_dropped(0),
+	  m_sleeping(false),
+	  m_stop(false)
+{
+	m_stub.pNext.store(0, std::memory_order_relaxed);
+
+	{
+		static bool isRegistered = false;
+		std::lock_guard<std::mutex> lock(s_liveMutex);
+		if (!isRegistered) {
+			std::atexit( flushAtExit );
+			isRegistered = true;
+		}
+		m_pNextLive = s_pLive;
+		s_pLive = this;
+	}
+
+	m_thread = std::thread( &LogWriter::run, this );
+}
+
+// Stops the writer after everything queued has been written
+LogWriter::~LogWriter()
+{
+	{
+		std::lock_guard<std::mutex> lock(s_liveMutex);
+		LogWriter** pp = &s_pLive;
+		while (*pp!=this)
+			pp = &(*pp)->m_pNextLive;
+		*pp = m_pNextLive;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wakeCv.notify_one();
+	m_thread.join();
+}
+
+void LogWriter::flushAll()
+{
+	std::lock_guard<std::mutex> lock(s_liveMutex);
+	for (LogWriter* p=s_pLive; p; p=p->m_pNextLive)
+		p->flush();
+}
+
+void LogWriter::enqueue(LogRecord* prec)
+{
+	prec->pNext.store(0, std::memory_order_relaxed);
+	LogRecord* pPrev = m_head.exchange(prec, std::memory_order_acq_rel);
+	pPrev->pNext.store(prec, std::memory_order_release);
+}
+
+// Returns the oldest record or 0 if the queue is empty (or a push is
+// part way through).  Only called from the writer thread.
+LogRecord* LogWriter::dequeue()
+{
+	LogRecord* pTail = m_tail;
+	LogRecord* pNext = pTail->pNext.load(std::memory_order_acquire);
+
+	if (pTail==&m_stub) {
+		if (!pNext)
+			return 0;
+		m_tail = pNext;
+		pTail = pNext;
+		pNext = pNext->pNext.load(std::memory_order_acquire);
+	}
+	if (pNext) {
+		m_tail = pNext;
+		return pTail;
+	}
+	if (pTail!=m_head.load(std::memory_order_acquire))
+		return 0;
+
+	// pTail is the last record, put the stub behind it so it can be taken
+	enqueue(&m_stub);
+	pNext = pTail->pNext.load(std::memory_order_acquire);
+	if (pNext) {
+		m_tail = pNext;
+		return pTail;
+	}
+	return 0;
+}
+
+// Hands a completed record to the writer.  The text is taken, leaving
+// the caller with an empty string.
+void LogWriter::push(std::string& text)
+{
+	unsigned long len = text.size();
+	unsigned long queued = m_queued.load(std::memory_order_relaxed);
+
+	for (;;) {
+		// A record larger than the limit is still let into an empty queue
+		if (queued+len<=m_maxQueued || queued==0) {
+			if (m_queued.compare_exchange_weak(queued, queued+len, std::memory_order_relaxed))
+				break;
+			continue;
+		}
+		if (m_overflow==LogStream::DropWhenFull) {
+			m_dropped.fetch_add(1, std::memory_order_relaxed);
+			text.clear();
+			return;
+		}
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_wakeCv.notify_one();
+		m_spaceCv.wait_for( lock, std::chrono::milliseconds(asyncPollMillisecs) );
+		queued = m_queued.load(std::memory_order_relaxed);
+	}
+
+	LogRecord* prec = new LogRecord;
+	prec->text.swap(text);
+	enqueue(prec);
+
+	if (m_sleeping.load(std::memory_order_relaxed))
+		m_wakeCv.notify_one();
+}
+
+// Waits until everything pushed so far has been written
+void LogWriter::flush()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (m_queued.load(std::memory_order_acquire)!=0) {
+		m_wakeCv.notify_one();
+		m_spaceCv.wait_for( lock, std::chrono::milliseconds(asyncPollMillisecs) );
+	}
+}
+
+void LogWriter::run()
+{
+	std::string batch;
+	batch.reserve(asyncBatchSize);
+
+	for (;;) {
+		unsigned long taken = 0;
+		LogRecord* prec;
+		while (batch.size()<asyncBatchSize && (prec=dequeue())!=0) {
+			batch += prec->text;
+			taken += prec->text.size();
+			delete prec;
+		}
+
+		if (taken) {
+			{
+				std::lock_guard<std::mutex> lock(m_ioMutex);
+				m_os.write( batch.data(), batch.size() );
+				m_os.flush();
+			}
+			batch.clear();
+			m_queued.fetch_sub(taken, std::memory_order_release);
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_spaceCv.notify_all();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (m_stop && m_queued.load(std::memory_order_acquire)==0)
+			break;
+		m_sleeping = true;
+		m_wakeCv.wait_for( lock, std::chrono::milliseconds(asyncPollMillisecs) );
+		m_sleeping = false;
+	}
+}
+
+
+/* class LogRecordBuf
+
+   Per thread buffer that log lines are formatted into in asynchronous
+   mode or Binary format.  Each flush (i.e. endl) hands the line back to
+   the LogStream that started it.  A line that wasn't ended is handed
+   back when the thread starts its next line, on any LogStream, when the
+   thread exits, or when its LogStream is closed or destroyed (by
+   whichever thread does that), so it's neither lost nor mixed into
+   another stream's record.
+
+   Buffers are registered with the LogStream they belong to while they
+   belong to one, and a closing stream detaches every buffer that still
+   points at it, so none is left holding a dangling or closed stream.
+   The registry is locked only when a thread changes streams, not for
+   each line.
+*/
+class LogRecordBuf;
+
+struct LineRegistry {
+	std::mutex	mutex;
+	std::set<LogRecordBuf*>	bufs;	// Those with an owner
+};
+
+// Never destroyed, as LogStreams may be destroyed at exit after it
+static LineRegistry& lineRegistry()
+{
+	static LineRegistry* pRegistry = new LineRegistry;
+	return *pRegistry;
+}
+
+class LogRecordBuf : public std::streambuf {
+public:
+	LogRecordBuf() : m_pLog(0), m_prio(INFO), m_usec(0) {}
+	~LogRecordBuf() {
+		setOwner(0);
+	}
+
+	void begin(LogStream* pLog, LogPriority lprio, long long usec) {
+		if (m_pLog.load(std::memory_order_relaxed)==pLog)
+			handBack();
+		else
+			setOwner(pLog);
+		m_prio = lprio;
+		m_usec = usec;
+		m_text.clear();
+	}
+
+	// Detaches the buffers that belong to pLog, handing back their lines
+	static void detachAll(LogStream* pLog) {
+		LineRegistry& reg = lineRegistry();
+		std::lock_guard<std::mutex> lock(reg.mutex);
+		for (std::set<LogRecordBuf*>::iterator it=reg.bufs.begin(); it!=reg.bufs.end(); ) {
+			LogRecordBuf* pBuf = *it;
+			if (pBuf->m_pLog.load(std::memory_order_relaxed)==pLog) {
+				pBuf->handBack();
+				pBuf->m_pLog.store(0, std::memory_order_relaxed);
+				it = reg.bufs.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+
+protected:
+	virtual int_type overflow(int_type ch) {
+		if (!traits_type::eq_int_type(ch, traits_type::eof()))
+			m_text.push_back( traits_type::to_char_type(ch) );
+		return traits_type::not_eof(ch);
+	}
+	virtual std::streamsize xsputn(const char* ps, std::streamsize n) {
+		m_text.append(ps, n);
+		return n;
+	}
+	virtual int sync() {
+		LogStream* pLog = m_pLog.load(std::memory_order_relaxed);
+		if (pLog && !m_text.empty())
+			pLog->complete(m_prio, m_usec, m_text);
+		m_text.clear();
+		return 0;
+	}
+
+private:
+	// Hands back a line that wasn't ended with endl
+	void handBack() {
+		if (!m_text.empty() && m_text.back()!='\n')
+			m_text.push_back('\n');
+		sync();
+	}
+
+	// Moves to pLog (or none), handing back a line for the stream before
+	void setOwner(LogStream* pLog) {
+		LineRegistry& reg = lineRegistry();
+		std::lock_guard<std::mutex> lock(reg.mutex);
+		if (m_pLog.load(std::memory_order_relaxed))
+			handBack();		// Still open, or it would have detached this
+		m_text.clear();
+		m_pLog.store(pLog, std::memory_order_relaxed);
+		if (pLog)
+			reg.bufs.insert(this);
+		else
+			reg.bufs.erase(this);
+	}
+
+	std::atomic<LogStream*>	m_pLog;		// Changed by closing streams, under the registry lock
+	LogPriority	m_prio;
+	long long	m_usec;
+	std::string	m_text;
+};
+
+struct ThreadLogStream {
+	ThreadLogStream() : os(&buf) {}
+
+	LogRecordBuf	buf;
+	std::ostream	os;
+};
+
+// This thread's lines being formatted for Binary format and asynchronous mode
+static ThreadLogStream& binaryLine()
+{
+	static thread_local ThreadLogStream tls;
+	return tls;
+}
+
+static ThreadLogStream& asyncLine()
+{
+	static thread_local ThreadLogStream tls;
+	return tls;
+}
+
+
+/* Line prefix
+
+   Text lines start with "YYYY/MM/DD HH:MM:SS\thost\t".  Breaking down the
+   time (localtime_r() takes the time zone lock) and formatting it is most
+   of the cost of a short line, so each thread keeps the prefix for the
+   current second and only rebuilds it when time(0) moves on.
+*/
+
+static std::string lookupHostName()
+{
+	char hostname[256] = "";
+	gethostname(hostname,sizeof(hostname)-1);
+	hostname[sizeof(hostname)-1] = '\0';
+	if (*hostname=='\0')
+		return "-";
+	return hostname;
+}
+
+static const std::string& hostName()
+{
+	static const std::string hostname = lookupHostName();
+	return hostname;
+}
+
+static inline char* putDigits2(char* p, int n)
+{
+	p[0] = '0' + n/10;
+	p[1] = '0' + n%10;
+	return p+2;
+}
+
+// Formats the prefix for time t into pch, returns its length
+static int formatPrefix(time_t t, const std::string& host, char* pch, int len)
+{
+	struct tm tmNow;
+	localtime_r(&t, &tmNow);		// Callers may be on many threads
+
+	char* p = pch;
+	int year = tmNow.tm_year+1900;
+	p = putDigits2(p, year/100 % 100);
+	p = putDigits2(p, year%100);
+	*p++ = '/';
+	p = putDigits2(p, tmNow.tm_mon+1);
+	*p++ = '/';
+	p = putDigits2(p, tmNow.tm_mday);
+	*p++ = ' ';
+	p = putDigits2(p, tmNow.tm_hour);
+	*p++ = ':';
+	p = putDigits2(p, tmNow.tm_min);
+	*p++ = ':';
+	p = putDigits2(p, tmNow.tm_sec);
+	*p++ = '\t';
+
+	int nHost = host.size();
+	if (nHost > len-(p-pch)-1)
+		nHost = len-(p-pch)-1;
+	memcpy(p, host.data(), nHost);
+	p += nHost;
+	*p++ = '\t';
+	return p-pch;
+}
+
+struct PrefixCache {
+	time_t	t;
+	int	len;
+	char	text[128];
+};
+
+// Returns this thread's prefix for the current second
+static const char* linePrefix(time_t now, int& len)
+{
+	static thread_local PrefixCache cache = { (time_t)-1, 0, "" };
+	if (cache.t!=now) {
+		cache.len = formatPrefix(now, hostName(), cache.text, sizeof(cache.text));
+		cache.t = now;
+	}
+	len = cache.len;
+	return cache.text;
+}
+
+static long long nowMicrosecs()
+{
+	using namespace std::chrono;
+	return duration_cast<microseconds>( system_clock::now().time_since_epoch() ).count();
+}
+
+
+/* Binary format
+
+   A Binary log is a sequence of records, all integers little endian:
+
+     u32   length of the rest of the record
+     u8    kind
+
+   kind 'I' names an ident (sent when the format is set and on each open):
+     u16   ident id
+     str   host
+     str   ident
+
+   kind 'R' is a log line:
+     u64   time in microseconds since the epoch
+     u8    priority
+     u16   ident id
+     then arguments up to the end of the record, each a u8 tag and value:
+       'i' i64, 'u' u64, 'd' f64 (IEEE bits as u64), 'c' u8, 's' str
+
+   where str is a u32 byte count and the bytes.  Lines written with
+   operator() are recorded as a single 's' argument.  Readers skip record
+   kinds they don't know.
+*/
+
+// Header of an 'R' record up to the arguments
+const int recordHeaderSize = 4+1+8+1+2;
+
+static inline void putU8(std::string& s, unsigned v)
+{
+	s.push_back( (char)(v&0xFF) );
+}
+
+static inline void putU16(std::string& s, unsigned v)
+{
+	char b[2] = { (char)(v&0xFF), (char)((v>>8)&0xFF) };
+	s.append(b, 2);
+}
+
+static inline void setU32(char* p, unsigned long v)
+{
+	for (int i=0; i<4; ++i)
+		p[i] = (char)((v>>(8*i))&0xFF);
+}
+
+static inline void putU32(std::string& s, unsigned long v)
+{
+	char b[4];
+	setU32(b, v);
+	s.append(b, 4);
+}
+
+static inline void putU64(std::string& s, unsigned long long v)
+{
+	char b[8];
+	for (int i=0; i<8; ++i)
+		b[i] = (char)((v>>(8*i))&0xFF);
+	s.append(b, 8);
+}
+
+static inline void putStr(std::string& s, const char* ps, unsigned long len)
+{
+	putU32(s, len);
+	s.append(ps, len);
+}
+
+// Starts an 'R' record, the length is filled in by endRecord()
+static void beginRecord(std::string& s, long long usec, LogPriority lprio, unsigned identId)
+{
+	s.append(4, '\0');
+	putU8(s, 'R');
+	putU64(s, usec);
+	putU8(s, lprio);
+	putU16(s, identId);
+}
+
+static void endRecord(std::string& s)
+{
+	setU32(&s[0], s.size()-4);
+}
+
+// Text for arguments, shared by text mode LogLines and LogReader
+static void formatDouble(std::string& s, double d)
+{
+	char buf[32];
+	int n = snprintf(buf, sizeof(buf), "%g", d);
+	s.append(buf, n);
+}
+
+static std::atomic<unsigned> s_nextIdentId(0);
+
+
 /*: class LogStream
 
   Output stream for event logging.
@@ -38,6 +615,36 @@ namespace bw {
   Output:
     Outputs lines starting with the date and time followed by the ident:
     and the message.
+
+  Binary format:
+    After setFormat(Binary), lines are written as compact records holding
+    the time, priority, an ident id and the message.  Messages built with
+    record() keep their arguments raw, so numbers are never converted to
+    text by the program:
+
+    bwrecord( lout, INFO ) << "request " << id << " took " << secs;
+
+    LogReader (and the bwlogdump tool) expand the records to the text
+    that the Text format would have written.
+
+  Priorities:
+    Lines less urgent than the threshold (see setThreshold()) go to a
+    stream that discards them without formatting.  The bwlog() macro
+    checks first, so the arguments aren't even evaluated, and it drops
+    priorities less urgent than BWLOG_LEVEL at compile time:
+
+    bwlog( lout, DEBUG ) << "Expensive " << dump() << endl;
+
+    BWLOG_LEVEL defaults to DEBUG in _DEBUG builds and INFO otherwise.
+
+  Asynchronous mode:
+    After startAsync(), each calling thread formats lines into its own
+    buffer and endl hands the completed line to a background thread,
+    which writes lines in large batches.  Callers don't wait for I/O
+    unless more than maxQueued bytes are waiting and the overflow policy
+    is BlockWhenFull.  With DropWhenFull such lines are discarded and
+    counted by dropped().  Pending lines are written by flush(), close(),
+    the destructor and at exit().
 */
 
 /*: LogStream::LogStream
@@ -54,10 +661,13 @@ namespace bw {
 */
 
 LogStream::LogStream()
+	: m_pAsync(0), m_threshold(DEBUG), m_format(Text),
+	  m_identId( s_nextIdentId.fetch_add(1, std::memory_order_relaxed) & 0xFFFF )
 {}
 
 LogStream::LogStream(const char* ident, const char* filename)
-	: m_ident(ident), m_filename(filename)
+	: m_ident(ident), m_filename(filename), m_pAsync(0), m_threshold(DEBUG), m_format(Text),
+	  m_identId( s_nextIdentId.fetch_add(1, std::memory_order_relaxed) & 0xFFFF )
 {
 	if (*filename!='\0')
 		os.open(filename,std::ios::app);
@@ -65,10 +675,13 @@ LogStream::LogStream(const char* ident, const char* filename)
 
 /*: LogStream::~LogStream
 
-  Destructor.
+  Destructor.  Waits for any pending asynchronous output to be written.
 */
 LogStream::~LogStream()
-{}
+{
+	LogRecordBuf::detachAll(this);
+	stopAsync();
+}
 
 /*: LogStream::open()
 
@@ -88,14 +701,19 @@ void LogStream::open(const char* ident, const char* filename)
 	m_filename = filename;
 	if (*filename!='\0')
 		os.open(filename,std::ios::app);
+	if (m_format==Binary)
+		defineIdent();
 }
 
 /*: LogStream::close()
 
-  Closes open logging stream.
+  Closes open logging stream.  In asynchronous mode, pending output is
+  written first and the stream returns to synchronous mode.
 */
 void LogStream::close()
 {
+	LogRecordBuf::detachAll(this);
+	stopAsync();
 	bwassert( os.is_open() );
 	os.close();
 }
@@ -108,51 +726,490 @@ void LogStream::close()
 */
 void LogStream::reopen()
 {
+	std::unique_lock<std::mutex> lock;
+	if (m_pAsync)
+		lock = std::unique_lock<std::mutex>( m_pAsync->ioMutex() );
+
 	if (os.is_open())
 		os.close();
 	if (*m_filename!='\0')
 		os.open(m_filename,std::ios::app);
+	lock = std::unique_lock<std::mutex>();
+
+	if (m_format==Binary)
+		defineIdent();
 }
 
+/*: LogStream::startAsync()
+
+  Switches to asynchronous mode.  Lines are written by a background
+  thread.  At most maxQueued bytes of lines wait to be written.  When
+  that limit is reached, callers either wait (BlockWhenFull) or their
+  lines are discarded (DropWhenFull).
 
-std::ostream& LogStream::operator()(LogPriority)
+  Prototype: void startAsync(unsigned long maxQueued=1<<20, Overflow ov=BlockWhenFull)
+*/
+void LogStream::startAsync(unsigned long maxQueued, Overflow ov)
 {
-	using std::clog;
-	using std::setw;
-	using std::setfill;
+	bwassert( !m_pAsync );
+	bwassert( maxQueued>0 );
 
-	// Note: The log priority is ignored.
-	const int hnbuflen = 30;
-	static char hostname[hnbuflen] = "";
-	// One time
-	if (*hostname=='\0') {
-		gethostname(hostname,hnbuflen);
-		if (*hostname=='\0') {
-			hostname[0] = '-';
-			hostname[1] = '\0';
-		}
+	m_pAsync = new LogWriter( target(), maxQueued, ov );
+}
+
+/*: LogStream::flush()
+
+  Waits until all lines logged so far have been written.  Does nothing
+  in synchronous mode.
+*/
+void LogStream::flush()
+{
+	if (m_pAsync)
+		m_pAsync->flush();
+}
+
+/*: LogStream::dropped()
+
+  Returns the count of lines discarded because the asynchronous queue was
+  full under the DropWhenFull policy.
+*/
+unsigned long LogStream::dropped() const
+{
+	return m_pAsync ? m_pAsync->dropped() : 0;
+}
+
+/*: LogStream::setThreshold()
+
+  Sets the least urgent priority that is logged.  The default is DEBUG,
+  i.e. everything.
+
+  Prototype: void setThreshold(LogPriority lprio)
+  Prototype: LogPriority threshold() const
+  Prototype: bool isEnabled(LogPriority lprio) const
+*/
+
+/* LogStream::stopAsync()
+
+   Writes pending output, stops the writer thread and returns to
+   synchronous mode.
+*/
+void LogStream::stopAsync()
+{
+	delete m_pAsync;
+	m_pAsync = 0;
+}
+
+
+/*: LogStream::setFormat()
+
+  Chooses between lines of Text (the default) and Binary records.  Set
+  the format right after opening, a file shouldn't hold both.
+
+  Prototype: void setFormat(Format fmt)
+  Prototype: Format format() const
+*/
+void LogStream::setFormat(Format fmt)
+{
+	m_format = fmt;
+	if (fmt==Binary)
+		defineIdent();
+}
+
+/* LogStream::target()
+
+   The stream that output is written to.
+*/
+std::ostream& LogStream::target()
+{
+	if (os.is_open())
+		return os;
+	return std::clog;
+}
+
+/* LogStream::emit()
+
+   Writes (or queues) a completed line or record.  The text is taken,
+   leaving rec empty.
+*/
+void LogStream::emit(std::string& rec)
+{
+	if (m_pAsync) {
+		m_pAsync->push(rec);
+	} else {
+		std::ostream& o = target();
+		o.write(rec.data(), rec.size());
+		o.flush();
+		rec.clear();
+	}
+}
+
+/* LogStream::complete()
+
+   Called with each line formatted by operator() into a per thread
+   buffer.  In Binary format the line becomes the only argument of a
+   record.
+*/
+void LogStream::complete(LogPriority lprio, long long usec, std::string& text)
+{
+	if (m_format==Text) {
+		emit(text);
+		return;
+	}
+
+	unsigned long len = text.size();
+	if (len>0 && text[len-1]=='\n')
+		--len;
+	std::string rec;
+	rec.reserve(recordHeaderSize+1+4+len);
+	beginRecord(rec, usec, lprio, m_identId);
+	putU8(rec, 's');
+	putStr(rec, text.data(), len);
+	endRecord(rec);
+	text.clear();
+	emit(rec);
+}
+
+/* LogStream::defineIdent()
+
+   Writes the 'I' record that names m_identId in Binary records.
+*/
+void LogStream::defineIdent()
+{
+	const std::string& host = hostName();
+	std::string rec(4, '\0');
+	putU8(rec, 'I');
+	putU16(rec, m_identId);
+	putStr(rec, host.data(), host.size());
+	putStr(rec, m_ident, m_ident.length());
+	endRecord(rec);
+	emit(rec);
+}
+
+
+/*: LogStream::operator()
+
+  Starts a log line with the given priority.  Returns the stream to send
+  the message to, terminated with endl.  If the priority is below the
+  threshold, the stream discards output.
+
+  Prototype: std::ostream& operator()(LogPriority lprio)
+*/
+std::ostream& LogStream::operator()(LogPriority lprio)
+{
+	if (!isEnabled(lprio)) {
+		// No streambuf, so the stream is bad and inserters do nothing
+		static thread_local std::ostream nullStream(0);
+		return nullStream;
+	}
+
+	if (m_format==Binary) {
+		ThreadLogStream& tls = binaryLine();
+		tls.buf.begin(this, lprio, nowMicrosecs());
+		return tls.os;
 	}
 
-	time_t now = time(0);
-	struct tm *ptime = localtime(&now);
 	std::ostream *pos;
-	if (os)
-		pos = &os;
-	else
-		pos = &clog;
-
-	*pos << ptime->tm_year+1900 << '/'
-	     << setw(2) << setfill('0') << ptime->tm_mon+1 << '/'
-	     << setw(2) << setfill('0') << ptime->tm_mday << ' '
-	     << setw(2) << setfill('0') << ptime->tm_hour << ':'
-	     << setw(2) << setfill('0') << ptime->tm_min << ':'
-	     << setw(2) << setfill('0') << ptime->tm_sec << '\t'
-	     << hostname << '\t'
-	     << m_ident << ":\t ";
+	if (m_pAsync) {
+		ThreadLogStream& tls = asyncLine();
+		tls.buf.begin(this, lprio, 0);
+		pos = &tls.os;
+	} else
+		pos = &target();
+
+	int len;
+	const char* pch = linePrefix(time(0), len);
+	pos->write(pch, len);
+	*pos << m_ident << ":\t ";
 	return *pos;
 }
 
+/*: LogStream::record()
+
+  Starts a log line with the given priority, like operator(), but
+  returns a LogLine.  The line is written when the LogLine is destroyed,
+  normally at the end of the statement, so don't send endl.
+
+  Prototype: LogLine record(LogPriority lprio)
+*/
+LogLine LogStream::record(LogPriority lprio)
+{
+	return LogLine( isEnabled(lprio) ? this : 0, lprio );
+}
 
-}	//namespace bw
 
+/*: class LogLine
+
+  A log line built with LogStream::record().  In Binary format the
+  arguments are stored raw with a type tag, in Text format they are
+  formatted as an ostream would.  Only strings, characters and numbers
+  can be sent.
+*/
+
+LogLine::LogLine(LogStream* pLog, LogPriority lprio)
+	: m_pLog(pLog), m_prio(lprio)
+{
+	if (!m_pLog)
+		return;
+
+	if (m_pLog->m_format==LogStream::Binary) {
+		beginRecord(m_rec, nowMicrosecs(), lprio, m_pLog->m_identId);
+	} else {
+		int len;
+		const char* pch = linePrefix(time(0), len);
+		m_rec.assign(pch, len);
+		m_rec += m_pLog->m_ident;
+		m_rec += ":\t ";
+	}
+}
+
+LogLine::LogLine(LogLine&& ll)
+	: m_pLog(ll.m_pLog), m_prio(ll.m_prio), m_rec(std::move(ll.m_rec))
+{
+	ll.m_pLog = 0;
+}
+
+// Writes the line
+LogLine::~LogLine()
+{
+	if (!m_pLog)
+		return;
+
+	if (m_pLog->m_format==LogStream::Binary)
+		endRecord(m_rec);
+	else
+		m_rec += '\n';
+	m_pLog->emit(m_rec);
+}
+
+void LogLine::putText(const char* ps, unsigned long len)
+{
+	if (m_pLog->m_format==LogStream::Binary) {
+		putU8(m_rec, 's');
+		putStr(m_rec, ps, len);
+	} else
+		m_rec.append(ps, len);
+}
+
+LogLine& LogLine::operator<<(const char* psz)
+{
+	if (m_pLog)
+		putText(psz, strlen(psz));
+	return *this;
+}
+
+LogLine& LogLine::operator<<(const String& str)
+{
+	if (m_pLog)
+		putText(str, str.length());
+	return *this;
+}
+
+LogLine& LogLine::operator<<(const std::string& str)
+{
+	if (m_pLog)
+		putText(str.data(), str.size());
+	return *this;
+}
+
+LogLine& LogLine::operator<<(char ch)
+{
+	if (!m_pLog)
+		return *this;
+	if (m_pLog->m_format==LogStream::Binary)
+		putU8(m_rec, 'c');
+	m_rec += ch;
+	return *this;
+}
 
+LogLine& LogLine::putSigned(long long n)
+{
+	if (!m_pLog)
+		return *this;
+	if (m_pLog->m_format==LogStream::Binary) {
+		putU8(m_rec, 'i');
+		putU64(m_rec, (unsigned long long)n);
+	} else
+		m_rec += std::to_string(n);
+	return *this;
+}
+
+LogLine& LogLine::putUnsigned(unsigned long long n)
+{
+	if (!m_pLog)
+		return *this;
+	if (m_pLog->m_format==LogStream::Binary) {
+		putU8(m_rec, 'u');
+		putU64(m_rec, n);
+	} else
+		m_rec += std::to_string(n);
+	return *this;
+}
+
+LogLine& LogLine::operator<<(double d)
+{
+	if (!m_pLog)
+		return *this;
+	if (m_pLog->m_format==LogStream::Binary) {
+		unsigned long long bits;
+		static_assert( sizeof(bits)==sizeof(d), "64 bit double is required" );
+		memcpy(&bits, &d, sizeof(bits));
+		putU8(m_rec, 'd');
+		putU64(m_rec, bits);
+	} else
+		formatDouble(m_rec, d);
+	return *this;
+}
+
+
+/*: class LogReader
+
+  Reads a Binary log and expands each record to the line that the Text
+  format would have written (without the newline).
+
+  Example:
+    std::ifstream is("app.log", std::ios::binary);
+    LogReader lr(is);
+    std::string line;
+    LogPriority lprio;
+    while (lr.read(line,lprio))
+        cout << line << endl;
+*/
+
+LogReader::LogReader(std::istream& is)
+	: m_is(is)
+{}
+
+static inline unsigned long long getLE(const char* p, int n)
+{
+	unsigned long long v = 0;
+	for (int i=n-1; i>=0; --i)
+		v = (v<<8) | (unsigned char)p[i];
+	return v;
+}
+
+/*: LogReader::read()
+
+  Reads the next log line.  Ident records are absorbed along the way.
+
+  Returns: false at the end of the log.
+
+  Exceptions: BFormatException if a record is damaged or truncated.
+*/
+bool LogReader::read(std::string& line, LogPriority& lprio)
+{
+	for (;;) {
+		char hdr[4];
+		if (!m_is.read(hdr, 4)) {
+			if (m_is.gcount()==0)
+				return false;
+			throw BFormatException("Truncated log record");
+		}
+		unsigned long len = getLE(hdr, 4);
+		if (len==0)
+			throw BFormatException("Damaged log record");
+		m_rec.resize(len);
+		if (!m_is.read(&m_rec[0], len))
+			throw BFormatException("Truncated log record");
+
+		const char* p = m_rec.data();
+		const char* pEnd = p+len;
+		char kind = *p++;
+
+		// Bounds checked access to the record
+		auto need = [&](unsigned long n) {
+			if ((unsigned long)(pEnd-p)<n)
+				throw BFormatException("Damaged log record");
+		};
+		auto getStr = [&](const char*& ps) -> unsigned long {
+			need(4);
+			unsigned long n = getLE(p, 4);
+			p += 4;
+			need(n);
+			ps = p;
+			p += n;
+			return n;
+		};
+
+		if (kind=='I') {
+			need(2);
+			unsigned id = getLE(p, 2);
+			p += 2;
+			const char* psHost;
+			unsigned long nHost = getStr(psHost);
+			const char* psIdent;
+			unsigned long nIdent = getStr(psIdent);
+			if (m_idents.size()<=id)
+				m_idents.resize(id+1);
+			m_idents[id].first = String(std::string(psHost, nHost).c_str());
+			m_idents[id].second = String(std::string(psIdent, nIdent).c_str());
+			continue;
+		}
+		if (kind!='R')
+			continue;
+
+		need(recordHeaderSize-5);
+		long long usec = getLE(p, 8);
+		lprio = (LogPriority)(unsigned char)p[8];
+		unsigned id = getLE(p+9, 2);
+		p += recordHeaderSize-5;
+
+		time_t t = usec/1000000;
+		if (usec<0 && usec%1000000)
+			--t;
+		char prefix[128];
+		line.clear();
+		if (id<m_idents.size()) {
+			std::string host = (const char*)m_idents[id].first;
+			line.append(prefix, formatPrefix(t, host, prefix, sizeof(prefix)));
+			line += (const char*)m_idents[id].second;
+		} else {
+			// Ident record lost, e.g. by rotation between it and this record
+			line.append(prefix, formatPrefix(t, "-", prefix, sizeof(prefix)));
+			line += '#';
+			line += std::to_string(id);
+		}
+		line += ":\t ";
+
+		while (p<pEnd) {
+			char tag = *p++;
+			const char* ps;
+			unsigned long long v;
+			switch (tag) {
+			case 's': {
+				unsigned long n = getStr(ps);
+				line.append(ps, n);
+				break;
+			}
+			case 'c':
+				need(1);
+				line += *p++;
+				break;
+			case 'i':
+				need(8);
+				line += std::to_string((long long)getLE(p, 8));
+				p += 8;
+				break;
+			case 'u':
+				need(8);
+				line += std::to_string(getLE(p, 8));
+				p += 8;
+				break;
+			case 'd': {
+				need(8);
+				v = getLE(p, 8);
+				double d;
+				memcpy(&d, &v, sizeof(d));
+				formatDouble(line, d);
+				p += 8;
+				break;
+			}
+			default:
+				throw BFormatException("Unknown log argument type");
+			}
+		}
+		return true;
+	}
+}
+
+
+}	//namespace bw
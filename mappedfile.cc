@@ -0,0 +1,368 @@
+/* mappedfile.cc -- Memory mapped file class
+
+Copyright (C) 1997-2013, Brian Bray
+
+*/
+
+// off_t, fstat() and ftruncate() are 64 bit on 32 bit systems too
+#define _FILE_OFFSET_BITS 64
+
+#include "bw/exception.h"
+#include "bw/bwassert.h"
+#include "bw/file.h"
+#include "bw/mappedfile.h"
+
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+
+
+namespace bw {
+
+/*: class MappedFile
+Memory mapped file object.
+Maps the whole of a disk file into the address space, so it can be
+parsed or updated in place without copying it through read buffers.
+<P>
+<B>Concrete class</B>
+<P>
+
+Superclass:
+	none
+Subclasses:
+	none
+
+Errors are reported with BFileException, as for BFile.
+
+Writable mappings are shared: changes go to the file (eventually, or at
+sync()) and are seen by other mappings of it.  A writable mapping can be
+grown or shrunk with resize(), which moves the contents if it has to.
+
+Example:
+	MappedFile mf( "data.bin" );
+	mf.advise( MappedFile::Sequential );
+	parse( mf.data(), mf.size() );
+*/
+
+
+static const int openModes[] = {
+	O_RDONLY,		// ReadOnly
+	O_RDWR			// ReadWrite
+};
+
+static const int pmode = S_IREAD | S_IWRITE;
+
+// Whether n bytes fit in the address space (always, with 64 bit pointers)
+static bool isMappable( BFile::Offset n )
+{
+	return (unsigned long long)n<=SIZE_MAX;
+}
+
+static const int advice[] = {
+	MADV_NORMAL,		// Normal
+	MADV_SEQUENTIAL,	// Sequential
+	MADV_RANDOM,		// Random
+	MADV_WILLNEED,		// WillNeed
+	MADV_DONTNEED,		// DontNeed
+#ifdef MADV_HUGEPAGE
+	MADV_HUGEPAGE		// HugePage
+#else
+	-1
+#endif
+};
+
+/*: MappedFile::MappedFile()#ctor1
+
+	Creates an unmapped object.  Call open or create to map a file.
+*/
+MappedFile::MappedFile()
+	: m_fd(-1),
+	  m_access(ReadOnly),
+	  m_pData(0),
+	  m_size(0)
+{}
+
+/*: MappedFile::MappedFile()#ctor2
+
+	Creates an object mapping an existing file.
+
+	Throws: BFileException if unable to open or map for any reason
+*/
+MappedFile::MappedFile( const char* fileName, Access ac )
+	: m_fd(-1),
+	  m_access(ReadOnly),
+	  m_pData(0),
+	  m_size(0)
+{
+	if ( !open(fileName,ac) )
+		throw BFileException( BFileException::FileNotFound );
+}
+
+/*: MappedFile::~MappedFile()
+
+	Unmaps and closes the file (if open).  Changes to a writable
+	mapping are not waited for; call sync() first for that.
+*/
+MappedFile::~MappedFile()
+{
+	try {
+		close();
+	} catch (BException&) {
+	}
+}
+
+/*: MappedFile::open()
+
+	Maps an existing file, all of it.
+
+	Requires: Not currently open
+
+	Returns: true on success, false if the file doesn't exist
+
+	Throws: BFileException on all other errors
+*/
+bool MappedFile::open( const char* fileName, Access ac )
+{
+	bwassert( m_fd<0 );
+
+	m_fd = ::open( fileName, openModes[ac] );
+	if (m_fd<0) {
+		if (errno!=ENOENT)
+			throw BFileException( BFileException::SystemError );
+		return false;
+	}
+	m_access = ac;
+
+	struct stat st;
+	if (fstat(m_fd,&st)!=0) {
+		BFileException e( BFileException::SystemError );
+		::close(m_fd);
+		m_fd = -1;
+		throw e;
+	}
+	m_size = st.st_size;
+
+	try {
+		map();
+	} catch (BFileException&) {
+		::close(m_fd);
+		m_fd = -1;
+		throw;
+	}
+	return true;
+}
+
+/*: MappedFile::create()
+
+	Creates a file of size bytes, all zero, and maps it ReadWrite.  An
+	existing file is truncated first.
+
+	Requires: Not currently open
+
+	Throws: BFileException on error
+*/
+void MappedFile::create( const char* fileName, BFile::Offset size )
+{
+	bwassert( m_fd<0 );
+	bwassert( size>=0 );
+
+	m_fd = ::open( fileName, O_RDWR | O_CREAT | O_TRUNC, pmode );
+	if (m_fd<0)
+		throw BFileException( BFileException::SystemError );
+	m_access = ReadWrite;
+	m_size = 0;
+
+	try {
+		resize( size );
+	} catch (BFileException&) {
+		::close(m_fd);
+		m_fd = -1;
+		throw;
+	}
+}
+
+/*: MappedFile::close()
+
+	Unmaps and closes the file (if any).
+
+	Throws: BFileException on serious errors
+*/
+void MappedFile::close()
+{
+	if (m_fd<0)
+		return;
+
+	unmap();
+	int ret = ::close( m_fd );
+	m_fd = -1;
+	if (ret!=0)
+		throw BFileException( BFileException::SystemError );
+}
+
+/* MappedFile::map()
+
+   Maps m_size bytes of the open file.  Nothing is mapped for an empty
+   file (mmap() refuses zero lengths).  A file bigger than the address
+   space (only possible with 32 bit pointers) fails with EFBIG.
+*/
+void MappedFile::map()
+{
+	bwassert( !m_pData );
+	if (m_size==0)
+		return;
+	if (!isMappable(m_size)) {
+		errno = EFBIG;
+		throw BFileException( BFileException::SystemError );
+	}
+
+	int prot = m_access==ReadWrite ? PROT_READ|PROT_WRITE : PROT_READ;
+	void* pv = mmap( 0, m_size, prot, MAP_SHARED, m_fd, 0 );
+	if (pv==MAP_FAILED)
+		throw BFileException( BFileException::SystemError );
+	m_pData = (char*)pv;
+}
+
+void MappedFile::unmap()
+{
+	if (m_pData)
+		munmap( m_pData, m_size );
+	m_pData = 0;
+}
+
+/* MappedFile::remap()
+
+   Changes the mapping (only) to newSize bytes.  On failure the old
+   mapping is left in place.
+*/
+void MappedFile::remap( BFile::Offset newSize )
+{
+#ifdef MREMAP_MAYMOVE
+	if (m_pData && newSize>0) {
+		void* pv = mremap( m_pData, m_size, newSize, MREMAP_MAYMOVE );
+		if (pv==MAP_FAILED)
+			throw BFileException( BFileException::SystemError );
+		m_pData = (char*)pv;
+		m_size = newSize;
+		return;
+	}
+#endif
+	// Map the new size before unmapping the old, so a failure changes nothing
+	char* pOld = m_pData;
+	BFile::Offset oldSize = m_size;
+	m_pData = 0;
+	m_size = newSize;
+	try {
+		map();
+	} catch (BFileException&) {
+		m_pData = pOld;
+		m_size = oldSize;
+		throw;
+	}
+	if (pOld)
+		munmap( pOld, oldSize );
+}
+
+/*: MappedFile::resize()
+
+	Changes the size of the file and its mapping to newSize bytes.  New
+	bytes are zero.  The mapping may move, so pointers into it must be
+	recomputed from data().  On Linux the pages are remapped without
+	copying.
+
+	Requires: Mapped ReadWrite
+
+	Throws: BFileException on error.  The file and mapping are unchanged
+	if either couldn't be resized.
+*/
+void MappedFile::resize( BFile::Offset newSize )
+{
+	bwassert( m_fd>=0 );
+	bwassert( m_access==ReadWrite );
+	bwassert( newSize>=0 );
+
+	if (newSize==m_size)
+		return;
+	if (!isMappable(newSize)) {
+		errno = EFBIG;
+		throw BFileException( BFileException::SystemError );
+	}
+
+	BFile::Offset oldSize = m_size;
+	if (newSize>oldSize) {
+		// Grow the file before the mapping, so there are no pages past its end
+		if (ftruncate(m_fd,newSize)!=0)
+			throw BFileException( BFileException::SystemError );
+		try {
+			remap( newSize );
+		} catch (BFileException&) {
+			int err = errno;
+			if (ftruncate(m_fd,oldSize)!=0)
+				bwassert( false );
+			errno = err;
+			throw;
+		}
+	} else {
+		// Shrink the file after the mapping
+		remap( newSize );
+		if (ftruncate(m_fd,newSize)!=0) {
+			int err = errno;
+			try {
+				remap( oldSize );
+			} catch (BFileException&) {
+				bwassert( false );
+			}
+			errno = err;
+			throw BFileException( BFileException::SystemError );
+		}
+	}
+}
+
+/*: MappedFile::advise()
+
+	Hints how a range of the mapping will be used, so the system can
+	read ahead (Sequential, WillNeed), stop reading ahead (Random), drop
+	pages (DontNeed) or use huge pages (HugePage).  With the default
+	length the rest of the mapping from offset is covered.  Offsets are
+	rounded down to a page boundary.
+
+	Returns: false if the system doesn't support the hint for this
+	mapping (e.g. huge pages for most file systems).
+*/
+bool MappedFile::advise( Advice adv, BFile::Offset offset, BFile::Offset length )
+{
+	bwassert( offset>=0 && offset<=m_size );
+
+	if (!m_pData || advice[adv]<0)
+		return false;
+	if (length<0 || length>m_size-offset)
+		length = m_size-offset;
+
+	BFile::Offset page = sysconf(_SC_PAGESIZE);
+	BFile::Offset start = offset & ~(page-1);
+	length += offset-start;
+	return madvise( m_pData+start, length, advice[adv] )==0;
+}
+
+/*: MappedFile::sync()
+
+	Writes changed pages back to the file.  If wait is false the writes
+	are scheduled and sync() returns at once.
+
+	Requires: Mapped ReadWrite
+
+	Throws: BFileException on error
+*/
+void MappedFile::sync( bool wait )
+{
+	bwassert( m_fd>=0 );
+	bwassert( m_access==ReadWrite );
+
+	if (m_pData && msync( m_pData, m_size, wait ? MS_SYNC : MS_ASYNC )!=0)
+		throw BFileException( BFileException::SystemError );
+}
+
+}	// namespace bw
+
@@ -0,0 +1,291 @@
+/* metrics.cc -- Counters and latency histograms for instrumentation
+
+Copyright (C) 1997-2013, Brian Bray
+
+*/
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdio>
+
+#include "bw/bwassert.h"
+#include "bw/metrics.h"
+
+namespace bw {
+
+// Compilation time options
+
+// Histograms are exported with cumulative buckets up to 2^k-1 nanoseconds
+// for k in this range (about 1 microsecond to 34 seconds), plus +Inf.
+const int exportFirstBucket = 10;
+const int exportLastBucket = 35;
+
+
+/* Registry
+
+   Metric names are registered (normally by static constructors) before
+   they are used, and never removed.  The ids index the arrays of each
+   thread's MetricBlock.
+*/
+struct MetricInfo {
+	std::string	name;
+	std::string	help;
+	bool		isHistogram;
+	int		id;
+};
+
+struct MetricRegistry {
+	MetricRegistry() : nCounters(0), nHistograms(0) {}
+
+	std::mutex	mutex;
+	std::vector<MetricInfo>	metrics;	// In registration order
+	int		nCounters;
+	int		nHistograms;
+};
+
+static MetricRegistry& registry()
+{
+	static MetricRegistry reg;		// Constructed before any static metric uses it
+	return reg;
+}
+
+thread_local MetricBlock* Metrics::s_pLocal = 0;
+static std::atomic<MetricBlock*> s_pFirstBlock(0);
+
+
+/* struct MetricBlockOwner
+
+   Hands the thread's block on for reuse when the thread exits.  The
+   values stay in the block, so totals never go backwards.
+*/
+struct MetricBlockOwner {
+	~MetricBlockOwner() {
+		if (Metrics::s_pLocal) {
+			Metrics::s_pLocal->inUse.store(false, std::memory_order_release);
+			Metrics::s_pLocal = 0;
+		}
+	}
+};
+
+static thread_local MetricBlockOwner s_owner;
+
+
+/*: class Metrics
+
+  Hot path instrumentation.  Counters (MetricCounter) and latency
+  histograms (MetricHistogram, usually fed by MetricTimer) are
+  registered by name and updated without locks or shared cache lines:
+  each thread has its own block of values, and reading a metric adds up
+  every thread's block.
+
+  The library records:
+    bw_scene_events_total, bw_scene_event_seconds   Scene::messagePump()
+    bw_figure_draw_seconds                          Figure Draw events
+    bw_xml_load_seconds                             XMLDocument loading
+    bw_custom_sync_seconds                          CustomFile::sync()
+    bw_sql_execute_seconds, bw_sql_fetch_seconds,
+    bw_sql_rows_total                               SQLStatement
+*/
+
+/* Metrics::attach()
+
+   Finds or makes a block for this thread.
+*/
+MetricBlock& Metrics::attach()
+{
+	MetricBlock* pmb = 0;
+	for (MetricBlock* p=s_pFirstBlock.load(std::memory_order_acquire); p; p=p->pNext) {
+		bool isFree = false;
+		if (p->inUse.compare_exchange_strong(isFree, true, std::memory_order_acquire)) {
+			pmb = p;
+			break;
+		}
+	}
+	if (!pmb) {
+		pmb = new MetricBlock();	// Zeroed
+		pmb->inUse.store(true, std::memory_order_relaxed);
+		MetricBlock* pFirst = s_pFirstBlock.load(std::memory_order_relaxed);
+		do {
+			pmb->pNext = pFirst;
+		} while (!s_pFirstBlock.compare_exchange_weak(pFirst, pmb, std::memory_order_release,
+		                                              std::memory_order_relaxed));
+	}
+
+	s_pLocal = pmb;
+	(void)&s_owner;		// Constructs the owner, so the block is released at thread exit
+	return *pmb;
+}
+
+/* Metrics::registerMetric()
+
+   Returns the id for a name, registering it if it's new.
+*/
+int Metrics::registerMetric( const char* name, const char* help, bool isHistogram )
+{
+	bwassert( name && *name );
+
+	MetricRegistry& reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	for (size_t i=0; i<reg.metrics.size(); ++i) {
+		if (reg.metrics[i].name==name) {
+			bwassert( reg.metrics[i].isHistogram==isHistogram );
+			return reg.metrics[i].id;
+		}
+	}
+
+	MetricInfo mi;
+	mi.name = name;
+	mi.help = help;
+	mi.isHistogram = isHistogram;
+	if (isHistogram) {
+		bwassert( reg.nHistograms<maxHistograms );
+		mi.id = reg.nHistograms++;
+	} else {
+		bwassert( reg.nCounters<maxCounters );
+		mi.id = reg.nCounters++;
+	}
+	reg.metrics.push_back(mi);
+	return mi.id;
+}
+
+static unsigned long long sumCounter( int id )
+{
+	unsigned long long n = 0;
+	for (MetricBlock* p=s_pFirstBlock.load(std::memory_order_acquire); p; p=p->pNext)
+		n += p->counters[id].load(std::memory_order_relaxed);
+	return n;
+}
+
+// Adds up every thread's copy of histogram id
+static void sumHistogram( int id, unsigned long long& count, unsigned long long& sumNs,
+                          unsigned long long* buckets )
+{
+	count = 0;
+	sumNs = 0;
+	for (int i=0; i<Metrics::nBuckets; ++i)
+		buckets[i] = 0;
+
+	for (MetricBlock* p=s_pFirstBlock.load(std::memory_order_acquire); p; p=p->pNext) {
+		const MetricBlock::Histogram& h = p->histograms[id];
+		count += h.count.load(std::memory_order_relaxed);
+		sumNs += h.sumNs.load(std::memory_order_relaxed);
+		for (int i=0; i<Metrics::nBuckets; ++i)
+			buckets[i] += h.buckets[i].load(std::memory_order_relaxed);
+	}
+}
+
+/*: MetricCounter::value()
+
+  Returns the total over all threads.
+*/
+unsigned long long MetricCounter::value() const
+{
+	return sumCounter( m_id );
+}
+
+/*: MetricHistogram::count()
+
+  Returns the number of durations recorded, their total in nanoseconds
+  (sumNs()), or the number in bucket i, i.e. from 2^i to 2^(i+1)-1
+  nanoseconds (bucket()).  All are totals over all threads.
+
+  Prototype: unsigned long long count() const
+  Prototype: unsigned long long sumNs() const
+  Prototype: unsigned long long bucket( int i ) const
+*/
+unsigned long long MetricHistogram::count() const
+{
+	unsigned long long n = 0;
+	for (MetricBlock* p=s_pFirstBlock.load(std::memory_order_acquire); p; p=p->pNext)
+		n += p->histograms[m_id].count.load(std::memory_order_relaxed);
+	return n;
+}
+
+unsigned long long MetricHistogram::sumNs() const
+{
+	unsigned long long n = 0;
+	for (MetricBlock* p=s_pFirstBlock.load(std::memory_order_acquire); p; p=p->pNext)
+		n += p->histograms[m_id].sumNs.load(std::memory_order_relaxed);
+	return n;
+}
+
+unsigned long long MetricHistogram::bucket( int i ) const
+{
+	bwassert( i>=0 && i<Metrics::nBuckets );
+	unsigned long long n = 0;
+	for (MetricBlock* p=s_pFirstBlock.load(std::memory_order_acquire); p; p=p->pNext)
+		n += p->histograms[m_id].buckets[i].load(std::memory_order_relaxed);
+	return n;
+}
+
+/*: Metrics::writeText()
+
+  Writes a snapshot of every registered metric in the Prometheus text
+  exposition format, so that a local scraper (or a person) can read it:
+
+    # HELP bw_scene_events_total Events dispatched by Scene::messagePump
+    # TYPE bw_scene_events_total counter
+    bw_scene_events_total 1234
+    # TYPE bw_figure_draw_seconds histogram
+    bw_figure_draw_seconds_bucket{le="1.023e-06"} 0
+    ...
+    bw_figure_draw_seconds_bucket{le="+Inf"} 17
+    bw_figure_draw_seconds_sum 0.0123
+    bw_figure_draw_seconds_count 17
+
+  Histogram buckets are cumulative and in seconds.  Each le bound is
+  2^k-1 ns, the longest whole duration counted below 2^k (a value of
+  exactly 2^k ns is counted in the next bucket).  Values from threads
+  that are recording while the snapshot is taken may or may not be
+  included.
+
+  Prototype: static void Metrics::writeText( std::ostream& os )
+*/
+void Metrics::writeText( std::ostream& os )
+{
+	std::vector<MetricInfo> metrics;
+	{
+		MetricRegistry& reg = registry();
+		std::lock_guard<std::mutex> lock(reg.mutex);
+		metrics = reg.metrics;
+	}
+
+	char buf[64];
+	for (size_t i=0; i<metrics.size(); ++i) {
+		const MetricInfo& mi = metrics[i];
+		if (!mi.help.empty())
+			os << "# HELP " << mi.name << ' ' << mi.help << '\n';
+		os << "# TYPE " << mi.name << (mi.isHistogram ? " histogram\n" : " counter\n");
+
+		if (!mi.isHistogram) {
+			os << mi.name << ' ' << sumCounter(mi.id) << '\n';
+			continue;
+		}
+
+		unsigned long long count, sumNs;
+		unsigned long long buckets[nBuckets];
+		sumHistogram( mi.id, count, sumNs, buckets );
+
+		// Values up to 2^k-1 ns are in buckets 0 to k-1
+		unsigned long long cumulative = 0;
+		for (int k=0; k<exportFirstBucket; ++k)
+			cumulative += buckets[k];
+		for (int k=exportFirstBucket; k<=exportLastBucket; ++k) {
+			snprintf( buf, sizeof(buf), "%.12g", (double)((1ULL<<k)-1)*1e-9 );
+			os << mi.name << "_bucket{le=\"" << buf << "\"} " << cumulative << '\n';
+			cumulative += buckets[k];
+		}
+		os << mi.name << "_bucket{le=\"+Inf\"} " << count << '\n';
+		snprintf( buf, sizeof(buf), "%.9g", sumNs*1e-9 );
+		os << mi.name << "_sum " << buf << '\n';
+		os << mi.name << "_count " << count << '\n';
+	}
+	os.flush();
+}
+
+}	// namespace bw
+
@@ -0,0 +1,546 @@
+/* multipart.cc -- streaming parser for multipart/form-data uploads
+
+Copyright (C) 1997-2013, Brian Bray
+
+*/
+
+#include <functional>
+#include <map>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "bw/bwassert.h"
+#include "bw/exception.h"
+#include "bw/string.h"
+#include "bw/file.h"
+#include "bw/multipart.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <errno.h>
+
+
+namespace bw {
+
+// Compilation time options
+
+const size_t readBlockSize = 64*1024;	// Bytes read at a time by parse()
+const size_t maxHeaderSize = 16*1024;	// Longest header block of one part
+const size_t maxBoundary = 70;		// RFC 2046
+
+
+/*: class MultipartParser
+
+  Parses a multipart/form-data body (RFC 2388), as sent by a form with
+  enctype="multipart/form-data", in whatever pieces it arrives.  Each
+  part has a small block of headers followed by its data; the data runs
+  up to the next "\r\n--boundary", which may be split across pieces.
+
+  The boundary is found with the Boyer-Moore-Horspool search, which
+  mostly looks at one byte in every boundary length, so large uploads
+  are scanned in big blocks rather than line by line.  Data before the
+  last few bytes of a block (which might begin a boundary) is passed on
+  at once, so only a boundary's length is held back between pieces.
+
+  Ordinary fields are collected in fields(), up to setFieldLimit()
+  bytes each.  Parts with a file name are stored in temporary files, or
+  passed to a handler (setFileHandler()), e.g. to write to a BFile of
+  the program's choosing.  Either way the data is binary safe.
+
+  Example:
+	String boundary = MultipartParser::boundaryOf( getenv("CONTENT_TYPE") );
+	MultipartParser mp( boundary );
+	mp.parse( std::cin );
+	String upload = mp.fields()["upload"];	// Path of the stored file
+*/
+
+class MultipartState {
+public:
+	enum Phase {
+		Preamble,	// Before the first boundary
+		Delimiter,	// After a boundary, before "--" or the end of line
+		Headers,	// Part headers
+		Body,		// Part data
+		Done		// After the closing boundary
+	};
+
+	MultipartState( const char* pszBoundary );
+	~MultipartState();
+
+	size_t find( const char* p, size_t n ) const;
+	size_t process( const char* p, size_t n );
+	void headers( const char* p, size_t n );
+	void beginPart();
+	void data( const char* p, size_t n );
+	void endPart();
+	void setField( const String& name, const String& value );
+
+	std::string	delim;		// "\r\n--" boundary
+	size_t		skip[256];	// Horspool shift for each last byte
+	std::vector<char>	buf;	// Unprocessed input
+	Phase		phase;
+
+	MultipartParser::Part	part;
+	bool		isFile;
+	std::string	value;		// Field being collected
+	int		nFieldLimit;
+
+	String		strDir;
+	MultipartParser::FileFn	fnFile;
+	BFile		file;		// File part being stored
+	String		strFilePath;
+	std::vector<String>	files;	// Stored, removed unless finished
+	bool		isFinished;	// finish() found the whole body
+
+	std::map< String, String >	fields;
+};
+
+MultipartState::MultipartState( const char* pszBoundary )
+	:   phase( Preamble ),
+	    isFile( false ),
+	    nFieldLimit( 32*1024 ),
+	    isFinished( false )
+{
+	size_t n = strlen( pszBoundary );
+	if (n==0 || n>maxBoundary)
+		throw BFormatException( "Invalid multipart boundary" );
+
+	delim = "\r\n--";
+	delim += pszBoundary;
+	size_t m = delim.size();
+	for (int i=0; i<256; ++i)
+		skip[i] = m;
+	for (size_t j=0; j+1<m; ++j)
+		skip[(unsigned char)delim[j]] = m-1-j;
+
+	// So a boundary at the very start matches like all the others
+	buf.push_back( '\r' );
+	buf.push_back( '\n' );
+
+	const char* pszTemp = getenv( "TMPDIR" );
+	strDir = pszTemp && *pszTemp ? pszTemp : "/tmp";
+}
+
+MultipartState::~MultipartState()
+{
+	if (file.isOpen()) {
+		// Abandoned part way through
+		try {
+			file.close();
+		} catch (BFileException&) {
+		}
+		unlink( strFilePath );
+	}
+
+	// The body wasn't all parsed, so the caller never got the files
+	if (!isFinished) {
+		for (size_t i=0; i<files.size(); ++i)
+			unlink( files[i] );
+	}
+}
+
+/* MultipartState::find()
+
+   Returns the offset of the delimiter in p, or n if it isn't there.
+*/
+size_t MultipartState::find( const char* p, size_t n ) const
+{
+	size_t m = delim.size();
+	if (n<m)
+		return n;
+
+	const char* pDelim = delim.data();
+	unsigned char chLast = pDelim[m-1];
+	size_t i = 0;
+	while (i<=n-m) {
+		unsigned char ch = p[i+m-1];
+		if (ch==chLast && memcmp( p+i, pDelim, m-1 )==0)
+			return i;
+		i += skip[ch];
+	}
+	return n;
+}
+
+/* MultipartState::process()
+
+   Parses as much of p as can be, returning the number of bytes used.
+   The rest must be presented again with the following input.
+*/
+size_t MultipartState::process( const char* p, size_t n )
+{
+	size_t pos = 0;
+	while (pos<n) {
+		switch (phase) {
+		case Preamble:
+		case Body: {
+			size_t i = find( p+pos, n-pos );
+			if (i==n-pos) {
+				// Pass on all but what might begin a delimiter
+				size_t nKeep = delim.size()-1;
+				if (n-pos<=nKeep)
+					return pos;
+				if (phase==Body)
+					data( p+pos, n-pos-nKeep );
+				return n-nKeep;
+			}
+			if (phase==Body) {
+				data( p+pos, i );
+				endPart();
+			}
+			pos += i+delim.size();
+			phase = Delimiter;
+			break;
+		}
+
+		case Delimiter: {
+			if (n-pos<2)
+				return pos;
+			if (p[pos]=='-' && p[pos+1]=='-') {
+				phase = Done;
+				return n;
+			}
+			const char* pEol = (const char*)memmem( p+pos, n-pos, "\r\n", 2 );
+			if (!pEol) {
+				if (n-pos>maxHeaderSize)
+					throw BFormatException( "Multipart boundary line too long" );
+				return pos;
+			}
+			for (const char* ps=p+pos; ps<pEol; ++ps) {
+				if (*ps!=' ' && *ps!='\t')
+					throw BFormatException( "Multipart data format error" );
+			}
+			pos = pEol+2-p;
+			phase = Headers;
+			break;
+		}
+
+		case Headers: {
+			size_t nHeaders;
+			size_t nSkip;
+			if (n-pos>=2 && p[pos]=='\r' && p[pos+1]=='\n') {
+				nHeaders = 0;		// No headers at all
+				nSkip = 2;
+			} else {
+				const char* pEnd = (const char*)memmem( p+pos, n-pos, "\r\n\r\n", 4 );
+				if (!pEnd) {
+					if (n-pos>maxHeaderSize)
+						throw BFormatException( "Multipart headers too long" );
+					return pos;
+				}
+				nHeaders = pEnd-(p+pos);
+				nSkip = 4;
+			}
+			headers( p+pos, nHeaders );
+			pos += nHeaders+nSkip;
+			beginPart();
+			phase = Body;
+			break;
+		}
+
+		case Done:
+			return n;			// Epilogue ignored
+		}
+	}
+	return pos;
+}
+
+/* nextParam()
+
+   Reads the next "; key=value" parameter of a header value from ps, with
+   the quotes removed from the value.  Returns false at the end.
+*/
+static bool nextParam( const char*& ps, const char* pEnd, std::string& key, std::string& value )
+{
+	while (ps<pEnd && *ps!=';')
+		++ps;				// The value before the parameters, or junk
+	if (ps>=pEnd)
+		return false;
+	++ps;
+	while (ps<pEnd && (*ps==' ' || *ps=='\t'))
+		++ps;
+
+	key.clear();
+	while (ps<pEnd && *ps!='=' && *ps!=';' && *ps!=' ')
+		key += tolower( (unsigned char)*ps++ );
+	while (ps<pEnd && *ps==' ')
+		++ps;
+	value.clear();
+	if (ps>=pEnd || *ps!='=')
+		return true;
+	++ps;
+	while (ps<pEnd && *ps==' ')
+		++ps;
+	if (ps<pEnd && *ps=='"') {
+		++ps;
+		while (ps<pEnd && *ps!='"')
+			value += *ps++;		// Not unescaped: IE sends C:\path\name
+		if (ps<pEnd)
+			++ps;
+	} else {
+		while (ps<pEnd && *ps!=';' && *ps!=' ' && *ps!='\t')
+			value += *ps++;
+	}
+	return true;
+}
+
+/* MultipartState::headers()
+
+   Takes the name, file name and content type from a part's headers.
+   Other headers are ignored.
+*/
+void MultipartState::headers( const char* p, size_t n )
+{
+	part.name = "";
+	part.fileName = "";
+	part.contentType = "";
+
+	const char* pEnd = p+n;
+	std::string key;
+	std::string val;
+	while (p<pEnd) {
+		const char* pEol = (const char*)memmem( p, pEnd-p, "\r\n", 2 );
+		if (!pEol)
+			pEol = pEnd;
+		const char* pColon = (const char*)memchr( p, ':', pEol-p );
+		if (pColon) {
+			const char* pValue = pColon+1;
+			while (pValue<pEol && (*pValue==' ' || *pValue=='\t'))
+				++pValue;
+			size_t nName = pColon-p;
+			if (nName==19 && strncasecmp( p, "Content-Disposition", nName )==0) {
+				const char* ps = pValue;
+				while (nextParam( ps, pEol, key, val )) {
+					if (key=="name")
+						part.name = String( val.data(), val.size() );
+					else if (key=="filename")
+						part.fileName = String( val.data(), val.size() );
+				}
+			} else if (nName==12 && strncasecmp( p, "Content-Type", nName )==0) {
+				const char* ps = pEol;
+				while (ps>pValue && (ps[-1]==' ' || ps[-1]=='\t'))
+					--ps;
+				part.contentType = String( pValue, ps-pValue );
+			}
+		}
+		p = pEol+2;
+	}
+}
+
+void MultipartState::beginPart()
+{
+	if (part.name=="")
+		throw BFormatException( "Multipart data format error" );
+
+	isFile = part.fileName!="";
+	value.clear();
+	if (!isFile || fnFile)
+		return;
+
+	std::string path( (const char*)strDir );
+	path += "/bwuploadXXXXXX";
+	int fd = mkstemp( &path[0] );
+	if (fd<0)
+		throw BFileException( BFileException::SystemError );
+	::close( fd );
+	strFilePath = path.c_str();
+	file.open( strFilePath, BFile::ReadWrite );
+}
+
+void MultipartState::data( const char* p, size_t n )
+{
+	if (n==0)
+		return;
+	if (isFile) {
+		if (fnFile)
+			fnFile( part, p, n, false );
+		else
+			file.write( p, n );
+	} else {
+		if (value.size()+n>(size_t)nFieldLimit)
+			throw BFormatException( "Multipart field too long" );
+		value.append( p, n );
+	}
+}
+
+void MultipartState::endPart()
+{
+	if (!isFile) {
+		setField( part.name, String( value.data(), value.size() ) );
+		return;
+	}
+	if (fnFile) {
+		fnFile( part, 0, 0, true );
+		return;
+	}
+	file.close();
+	files.push_back( strFilePath );
+	setField( part.name, strFilePath );
+	setField( part.name+"_name", part.fileName );
+}
+
+/* MultipartState::setField()
+
+   Sets a field.  A file stored for an earlier part of the same name is
+   removed, as the caller will never see it.
+*/
+void MultipartState::setField( const String& name, const String& value )
+{
+	std::map< String, String >::iterator it = fields.find( name );
+	if (it==fields.end()) {
+		fields[name] = value;
+		return;
+	}
+	for (size_t i=0; i<files.size(); ++i) {
+		if (files[i]==it->second) {
+			unlink( files[i] );
+			files.erase( files.begin()+i );
+			break;
+		}
+	}
+	it->second = value;
+}
+
+
+/*: MultipartParser::MultipartParser()
+
+  Creates a parser for a body whose parts are divided by pszBoundary (see
+  boundaryOf()).
+
+  Throws: BFormatException if the boundary is empty or longer than 70
+  characters
+*/
+MultipartParser::MultipartParser( const char* pszBoundary )
+	:   m_pState( new MultipartState( pszBoundary ) )
+{}
+
+/*: MultipartParser::~MultipartParser()
+
+  Stored files are removed unless finish() (or parse()) found the whole
+  body, so a malformed or cut short body leaves nothing behind.
+*/
+MultipartParser::~MultipartParser()
+{
+	delete m_pState;
+}
+
+/*: MultipartParser::boundaryOf()
+
+  Returns the boundary parameter of a multipart/form-data content type,
+  or "" if pszContentType (which may be 0) is anything else.
+*/
+String MultipartParser::boundaryOf( const char* pszContentType )
+{
+	if (!pszContentType || strncasecmp( pszContentType, "multipart/form-data", 19 )!=0)
+		return "";
+
+	const char* ps = pszContentType+19;
+	const char* pEnd = ps+strlen( ps );
+	std::string key;
+	std::string val;
+	while (nextParam( ps, pEnd, key, val )) {
+		if (key=="boundary" && val.size()<=maxBoundary)
+			return String( val.data(), val.size() );
+	}
+	return "";
+}
+
+/*: MultipartParser::setFileDirectory()
+
+  Stores file parts in new files in pszDir, named bwuploadXXXXXX.  The
+  default is $TMPDIR, or /tmp.  fields() maps the part's name to the
+  file's path, and name+"_name" to the file name the browser sent; the
+  caller removes the files when done with them.
+*/
+void MultipartParser::setFileDirectory( const char* pszDir )
+{
+	m_pState->strDir = pszDir;
+}
+
+/*: MultipartParser::setFileHandler()
+
+  Passes file parts to fn as they arrive, in pieces of any size, instead
+  of storing them.  fn is called once more with isEnd true at the end of
+  each part.
+*/
+void MultipartParser::setFileHandler( FileFn fn )
+{
+	m_pState->fnFile = fn;
+}
+
+/*: MultipartParser::setFieldLimit()
+
+  Sets the longest ordinary (not file) field accepted.  Longer fields
+  throw BFormatException, so a client can't fill memory.
+*/
+void MultipartParser::setFieldLimit( int nBytes )
+{
+	bwassert( nBytes>=0 && nBytes<65536 );
+	m_pState->nFieldLimit = nBytes;
+}
+
+/*: MultipartParser::feed()
+
+  Parses the next piece of the body.  Pieces can be any size; the end of
+  a piece is held back only if it might begin a boundary.
+
+  Throws: BFormatException if the body is malformed or a field too long,
+  BFileException if a file part can't be stored
+*/
+void MultipartParser::feed( const char* pData, size_t nData )
+{
+	std::vector<char>& buf = m_pState->buf;
+	buf.insert( buf.end(), pData, pData+nData );
+	size_t n = m_pState->process( buf.data(), buf.size() );
+	buf.erase( buf.begin(), buf.begin()+n );
+}
+
+/*: MultipartParser::finish()
+
+  Checks that the whole body has been fed.  The stored files are then
+  the caller's; until then the destructor removes them.
+
+  Throws: BFormatException if the closing boundary hasn't been seen
+*/
+void MultipartParser::finish()
+{
+	if (m_pState->phase!=MultipartState::Done)
+		throw BFormatException( "Multipart data truncated" );
+	m_pState->isFinished = true;
+}
+
+/*: MultipartParser::parse()
+
+  Parses the rest of is, reading it in large blocks straight into the
+  parser's buffer, then calls finish().
+
+  Throws: as feed() and finish()
+*/
+void MultipartParser::parse( std::istream& is )
+{
+	std::vector<char>& buf = m_pState->buf;
+	while (is && m_pState->phase!=MultipartState::Done) {
+		size_t nOld = buf.size();
+		buf.resize( nOld+readBlockSize );
+		is.read( &buf[nOld], readBlockSize );
+		buf.resize( nOld+is.gcount() );
+		size_t n = m_pState->process( buf.data(), buf.size() );
+		buf.erase( buf.begin(), buf.begin()+n );
+	}
+	finish();
+}
+
+/*: MultipartParser::fields()
+
+  Returns the ordinary fields by name, and any stored files (see
+  setFileDirectory()).  A repeated name keeps the last value.
+*/
+std::map< String, String >& MultipartParser::fields()
+{
+	return m_pState->fields;
+}
+
+}	// namespace bw
@@ -4,6 +4,10 @@ Copyright (C) 1997-2013, Brian Bray
 
 */
 
+// Compile time option
+#define NOTRACE
+#include "bw/trace.h"
+
 #include "bw/bwassert.h"
 #include "bw/string.h"
 #include "bw/exception.h"
@@ -98,7 +102,10 @@ void FProcess::fatalError( const BException& e ) throw()
 	using std::cerr;
 	using std::endl;
 
-	// First, give the user a crack at it.
+	// The recent trace first, as the user's handler may save data and exit
+	BTraceRing::dump();
+
+	// Then give the user a crack at it.
 	bwassert( Process::m_TheProcess );
 	Process::m_TheProcess->fatalError( e );
 
@@ -0,0 +1,321 @@
+/* response.cc -- streamed, compressed HTTP response bodies
+
+Copyright (C) 1997-2013, Brian Bray
+
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <new>
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+#include "bw/bwassert.h"
+#include "bw/response.h"
+
+#include <string.h>
+#include <strings.h>
+#include <zlib.h>
+
+
+namespace bw {
+
+// Compilation time options
+
+const int bufferSize = 16*1024;		// Body bytes compressed (or sent) at a time
+const int compressionLevel = 6;		// zlib's default: most of level 9's ratio at a third the time
+
+
+/*: class ResponseWriter
+
+  The body of a CGI or HTTP response, streamed to the client as it's
+  written instead of built up first, and compressed with gzip or deflate
+  if the request's Accept-Encoding allows.  Large HTML pages shrink to a
+  fifth or less, and the compressor runs as the page is written, so
+  there's never a copy of the whole page.
+
+  With the CGI framing the web server sends the body on (chunked or
+  not, as it decides).  With the Chunked framing the writer frames the
+  body itself, for a handler that writes HTTP/1.1 directly to a socket
+  and doesn't know the length in advance.
+
+  Example:
+	CGIRequest req;
+	req.out() << "Status: 200 OK\r\n";
+	ResponseWriter out( req.out(), req.param( "HTTP_ACCEPT_ENCODING" ) );
+	out.begin( "text/html" );
+	out << html::prolog( "Report" ) << html::heading1( "Report" ) << std::flush;
+	for (...)		// Slow
+		out << html::beginRow << ...;
+	out << html::epilog;
+	out.finish();
+*/
+
+/* class ResponseBuf
+
+   The body is written into a bufferSize put area.  When it fills, or on
+   flush or finish, it's compressed (or not) and the result is written to
+   the underlying stream, as a chunk if chunked.  A failure to write sets
+   the underlying stream's state and makes this one bad.
+*/
+class ResponseBuf : public std::streambuf {
+public:
+	ResponseBuf( std::ostream& os, ResponseWriter::Encoding encoding, ResponseWriter::Framing framing );
+	~ResponseBuf();
+
+	bool finish();
+
+	std::ostream&	os;
+	ResponseWriter::Encoding	encoding;
+	ResponseWriter::Framing	framing;
+	bool	isBegun;		// The headers have been ended
+	bool	isFinished;
+
+protected:
+	int_type overflow( int_type ch );
+	int sync();
+
+private:
+	bool deliver( int flush );
+	void send( const char* p, size_t n );
+
+	std::vector<char>	in;
+	std::vector<char>	out;
+	z_stream	z;
+};
+
+ResponseBuf::ResponseBuf( std::ostream& os, ResponseWriter::Encoding encoding, ResponseWriter::Framing framing )
+	:   os( os ),
+	    encoding( encoding ),
+	    framing( framing ),
+	    isBegun( false ),
+	    isFinished( false ),
+	    in( bufferSize )
+{
+	setp( in.data(), in.data()+in.size() );
+	if (encoding==ResponseWriter::Identity)
+		return;
+
+	// windowBits 15 is the zlib format (Content-Encoding: deflate), +16 the gzip format
+	memset( &z, 0, sizeof(z) );
+	int windowBits = encoding==ResponseWriter::Gzip ? 15+16 : 15;
+	if (deflateInit2( &z, compressionLevel, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY )!=Z_OK)
+		throw std::bad_alloc();
+	out.resize( deflateBound( &z, bufferSize ) );
+}
+
+ResponseBuf::~ResponseBuf()
+{
+	if (encoding!=ResponseWriter::Identity)
+		deflateEnd( &z );
+}
+
+/* Writes n bytes of the (compressed) body, as a chunk if chunked */
+void ResponseBuf::send( const char* p, size_t n )
+{
+	if (n==0)
+		return;
+	if (framing==ResponseWriter::Chunked) {
+		char achSize[20];
+		int len = sprintf( achSize, "%lx\r\n", (unsigned long)n );
+		os.write( achSize, len );
+		os.write( p, n );
+		os.write( "\r\n", 2 );
+	} else {
+		os.write( p, n );
+	}
+}
+
+/* Sends the put area, compressed with zlib's flush mode, and empties it */
+bool ResponseBuf::deliver( int flush )
+{
+	size_t n = pptr()-pbase();
+	setp( in.data(), in.data()+in.size() );
+	if (encoding==ResponseWriter::Identity) {
+		send( in.data(), n );
+		return os.good();
+	}
+
+	z.next_in = (Bytef*)in.data();
+	z.avail_in = n;
+	do {
+		z.next_out = (Bytef*)out.data();
+		z.avail_out = out.size();
+		int rc = deflate( &z, flush );
+		bwassert( rc!=Z_STREAM_ERROR );
+		(void)rc;
+		send( out.data(), out.size()-z.avail_out );
+	} while (z.avail_out==0 || z.avail_in>0);
+	return os.good();
+}
+
+ResponseBuf::int_type ResponseBuf::overflow( int_type ch )
+{
+	if (isFinished || !deliver( Z_NO_FLUSH ))
+		return traits_type::eof();
+	if (!traits_type::eq_int_type( ch, traits_type::eof() )) {
+		*pptr() = traits_type::to_char_type( ch );
+		pbump( 1 );
+	}
+	return traits_type::not_eof( ch );
+}
+
+/* A sync flush ends the compressed data so far on a byte boundary, so the
+   client can show it, at a cost of a few bytes */
+int ResponseBuf::sync()
+{
+	if (isFinished)
+		return 0;
+	if (!deliver( Z_SYNC_FLUSH ))
+		return -1;
+	os.flush();
+	return os.good() ? 0 : -1;
+}
+
+bool ResponseBuf::finish()
+{
+	if (isFinished)
+		return os.good();
+	bool isOk = deliver( Z_FINISH );
+	isFinished = true;
+	if (framing==ResponseWriter::Chunked)
+		os.write( "0\r\n\r\n", 5 );
+	os.flush();
+	return isOk && os.good();
+}
+
+
+ResponseWriter::ResponseWriter( std::ostream& os, const char* pszAcceptEncoding, Framing framing )
+	:   std::ostream( 0 ),
+	    m_pBuf( new ResponseBuf( os, negotiate( pszAcceptEncoding ), framing ) )
+{
+	rdbuf( m_pBuf );
+}
+
+/*: ResponseWriter::~ResponseWriter()
+
+  Finishes the body if begin() was called and the writer isn't being
+  destroyed by an exception.  Otherwise what was written is discarded,
+  so a handler that throws doesn't send the end of a body that's cut
+  short, or a body after headers that were never ended.
+*/
+ResponseWriter::~ResponseWriter()
+{
+	if (m_pBuf->isBegun && !std::uncaught_exception())
+		m_pBuf->finish();
+	delete m_pBuf;
+}
+
+/*: ResponseWriter::begin()
+
+  Ends the headers with the Content-Type, the Content-Encoding chosen
+  and Vary (so caches keep the compressed and plain versions apart), and
+  Transfer-Encoding if chunked.
+
+  Prototype: void ResponseWriter::begin( const char* pszContentType )
+*/
+void ResponseWriter::begin( const char* pszContentType )
+{
+	std::ostream& os = m_pBuf->os;
+	os << "Content-Type: " << pszContentType << "\r\n";
+	if (m_pBuf->encoding==Gzip)
+		os << "Content-Encoding: gzip\r\n";
+	else if (m_pBuf->encoding==Deflate)
+		os << "Content-Encoding: deflate\r\n";
+	os << "Vary: Accept-Encoding\r\n";
+	if (m_pBuf->framing==Chunked)
+		os << "Transfer-Encoding: chunked\r\n";
+	os << "\r\n";
+	m_pBuf->isBegun = true;
+}
+
+/*: ResponseWriter::finish()
+
+  Prototype: void ResponseWriter::finish()
+*/
+void ResponseWriter::finish()
+{
+	if (!m_pBuf->finish())
+		setstate( std::ios_base::badbit );
+}
+
+/*: ResponseWriter::encoding()
+
+  Prototype: ResponseWriter::Encoding ResponseWriter::encoding() const
+*/
+ResponseWriter::Encoding ResponseWriter::encoding() const
+{
+	return m_pBuf->encoding;
+}
+
+/* A qvalue, "0" or "1" with up to three decimals (RFC 7231 5.3.1), in
+   thousandths.  Parsed by hand, as strtod() would take a decimal comma
+   in some locales.  Anything else is 0, refusing the coding. */
+static int qvalue( const char* p )
+{
+	if (*p!='0' && *p!='1')
+		return 0;
+	int q = *p++=='1' ? 1000 : 0;
+	if (*p=='.') {
+		++p;
+		for (int scale=100; scale>0 && *p>='0' && *p<='9'; scale/=10)
+			q += (*p++-'0')*scale;
+	}
+	if (q>1000 || (*p && *p!=',' && *p!=';' && *p!=' ' && *p!='\t'))
+		return 0;
+	return q;
+}
+
+/*: ResponseWriter::negotiate()
+
+  Reads an Accept-Encoding value, eg: "gzip, deflate, br" or
+  "deflate;q=1.0, gzip;q=0.5, *;q=0".  The codings are compared by their
+  q values (1 if not given), and "*" stands for gzip if gzip isn't named.
+  A q of 0, or one that isn't a valid qvalue, refuses a coding.
+
+  Prototype: ResponseWriter::Encoding ResponseWriter::negotiate( const char* pszAcceptEncoding )
+*/
+ResponseWriter::Encoding ResponseWriter::negotiate( const char* pszAcceptEncoding )
+{
+	int qGzip = -1;			// Not named
+	int qDeflate = -1;
+	int qAny = -1;
+	const char* p = pszAcceptEncoding ? pszAcceptEncoding : "";
+	while (*p) {
+		while (*p==' ' || *p=='\t' || *p==',')
+			++p;
+		const char* pStart = p;
+		while (*p && *p!=',' && *p!=';' && *p!=' ' && *p!='\t')
+			++p;
+		size_t len = p-pStart;
+		int q = 1000;
+		while (*p && *p!=',') {
+			if (*p==';') {
+				++p;
+				while (*p==' ' || *p=='\t')
+					++p;
+				if ((*p=='q' || *p=='Q') && p[1]=='=')
+					q = qvalue( p+2 );
+			} else {
+				++p;
+			}
+		}
+		if ((len==4 && strncasecmp( pStart, "gzip", 4 )==0) || (len==6 && strncasecmp( pStart, "x-gzip", 6 )==0))
+			qGzip = q;
+		else if (len==7 && strncasecmp( pStart, "deflate", 7 )==0)
+			qDeflate = q;
+		else if (len==1 && *pStart=='*')
+			qAny = q;
+	}
+	if (qGzip<0)
+		qGzip = qAny;
+	if (qGzip>0 && qGzip>=qDeflate)
+		return Gzip;
+	if (qDeflate>0)
+		return Deflate;
+	return Identity;
+}
+
+}	// namespace bw
@@ -9,6 +9,9 @@ Copyright (C) 1997-2013, Brian Bray
 //#define NOTRACE
 #include "bw/trace.h"
 
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include "bw/bwassert.h"
 #include "bw/string.h"
 #include "bw/figure.h"
@@ -17,6 +20,9 @@ Copyright (C) 1997-2013, Brian Bray
 #include "bw/process.h"
 #include "bw/context.h"
 #include "bw/tools.h"
+#include "bw/metrics.h"
+#include "bw/file.h"
+#include "bw/asyncio.h"
 
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
@@ -27,6 +33,9 @@ Copyright (C) 1997-2013, Brian Bray
 #include "event.h"
 #include "gdevice.h"
 
+#include <poll.h>
+#include <errno.h>
+
 namespace bw {
 
 /*: class Scene
@@ -146,7 +155,9 @@ Scene::Scene( String strScreen, int msecFlashRate )
 	    m_iScreen( 0 ),
 	    m_strDisplayName( "" ),
 	    m_strCommand( "" ),
-	    m_haveInvalidRegions( false )
+	    m_haveInvalidRegions( false ),
+	    m_paio( 0 ),
+	    m_nInputs( 0 )
 {
 	bwassert( msecFlashRate==0 );		// TODO
 	//
@@ -433,6 +444,124 @@ void Scene::draw( Canvas& )
 	// Intentionally empty
 }
 
+/*: Scene::setAsyncIO()
+
+  Makes the message loop run the callbacks of an AsyncIO queue as its
+  requests finish, in the GUI thread, while it waits for input.  So file
+  I/O can be started from event handlers without blocking the display, and
+  the callbacks can update Figures directly.  Pass 0 to stop.
+
+  The AsyncIO must outlive its use by the Scene.
+*/
+void Scene::setAsyncIO( AsyncIO* paio )
+{
+	m_paio = paio;
+}
+
+/*: Scene::addInput()
+
+  Calls pfn(fd,pv) from the message loop, in the GUI thread, whenever fd
+  is readable (eg: a DirectoryWatcher, a pipe or a socket).  pfn must
+  read what is waiting, or it is called again at once.  Adding an fd
+  that is already present replaces its callback.
+
+  Prototype: void addInput( int fd, InputProc pfn, void* pv )
+*/
+void Scene::addInput( int fd, InputProc pfn, void* pv )
+{
+	bwassert( fd>=0 && pfn!=0 );
+	int i;
+	for (i=0; i<m_nInputs && m_aInputs[i].fd!=fd; i++)
+		;
+	if (i==m_nInputs) {
+		bwassert( m_nInputs<maxInputs );
+		m_nInputs++;
+	}
+	m_aInputs[i].fd = fd;
+	m_aInputs[i].pfn = pfn;
+	m_aInputs[i].pv = pv;
+}
+
+/*: Scene::removeInput()
+
+  Stops watching an fd given to addInput().  The fd should be removed
+  before it is closed.
+*/
+void Scene::removeInput( int fd )
+{
+	for (int i=0; i<m_nInputs; i++) {
+		if (m_aInputs[i].fd==fd) {
+			m_aInputs[i] = m_aInputs[--m_nInputs];
+			return;
+		}
+	}
+}
+
+/* Scene::waitForEvent()
+
+   Waits for an X event, running AsyncIO callbacks and input callbacks
+   (and the redraws and commands they cause) while waiting.  Xlib may
+   already have events read into its queue, so the connection is only
+   polled when XPending() says there are none.
+
+   Returns false if a callback queued a command.
+*/
+bool Scene::waitForEvent()
+{
+	Display* pDisplay = (Display*)m_pDisplay;
+	while (XPending( pDisplay )==0) {
+		struct pollfd apfd[2+maxInputs];
+		int nfd = 0;
+		apfd[nfd].fd = ConnectionNumber( pDisplay );
+		apfd[nfd++].events = POLLIN;
+		int iaio = -1;
+		if (m_paio) {
+			iaio = nfd;
+			apfd[nfd].fd = m_paio->fd();
+			apfd[nfd++].events = POLLIN;
+		}
+		int iInputs = nfd;
+		int nInputs = m_nInputs;
+		for (int i=0; i<nInputs; i++) {
+			apfd[nfd].fd = m_aInputs[i].fd;
+			apfd[nfd++].events = POLLIN;
+		}
+		for (int i=0; i<nfd; i++)
+			apfd[i].revents = 0;
+		if (::poll( apfd, nfd, -1 )<0 && errno!=EINTR)
+			throw BGUIException( BGUIException::SystemError, "Cannot wait for input." );
+
+		bool isWork = false;
+		if (iaio>=0 && apfd[iaio].revents) {
+			m_paio->poll();
+			isWork = true;
+		}
+		for (int i=0; i<nInputs; i++) {
+			if (apfd[iInputs+i].revents==0)
+				continue;
+			// A callback may have removed inputs
+			int fd = apfd[iInputs+i].fd;
+			for (int j=0; j<m_nInputs; j++) {
+				if (m_aInputs[j].fd==fd) {
+					m_aInputs[j].pfn( fd, m_aInputs[j].pv );
+					isWork = true;
+					break;
+				}
+			}
+		}
+		if (isWork) {
+			if (m_strCommand!="")
+				return false;
+			if (m_haveInvalidRegions)
+				doDraw();
+		}
+	}
+	return true;
+}
+
+static MetricCounter s_nEvents( "bw_scene_events_total", "Events dispatched by Scene::messagePump" );
+static MetricHistogram s_eventTime( "bw_scene_event_seconds", "Time to dispatch one event" );
+
 /* Scene::messagePump()
 
    This is the message loop.  This is the only routine to manipulate the
@@ -462,6 +591,10 @@ void Scene::draw( Canvas& )
    <LI>Invalidations deferred to the next Flash
    </OL>
 
+   If an AsyncIO is attached (setAsyncIO), or inputs added (addInput),
+   their callbacks are run while waiting for input, so finished file I/O
+   and other descriptors are handled like events.
+
    TODO: Multi-threads (lock scene?)
 */
 void Scene::messagePump()
@@ -502,6 +635,8 @@ void Scene::messagePump()
 		//
 		// TODO: Commands queued by other Threads will not be processed
 		//
+		if ((m_paio || m_nInputs>0) && !waitForEvent())
+			return;
 		XNextEvent( (Display*)m_pDisplay, pevt );
 
 		//
@@ -537,7 +672,11 @@ void Scene::messagePump()
 		//
 		// Now, send it out
 		//
-		dispatch( ev, evr );
+		{
+			MetricTimer mt( s_eventTime );
+			dispatch( ev, evr );
+		}
+		s_nEvents.add();
 
 	} // end of event loop
 
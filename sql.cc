@@ -5,11 +5,14 @@ Copyright (C) 1999-2013, Brian Bray
 */
 
 #include <sstream>
+#include <atomic>
+#include <chrono>
 
 #include "bw/bwassert.h"
 #include "bw/string.h"
 #include "bw/exception.h"
 #include "bw/sql.h"
+#include "bw/metrics.h"
 
 #include <cstring>
 #include <cstdlib>
@@ -248,10 +251,15 @@ void SQLStatement::prepare( const char* stmt )
 }
 
 
+static MetricHistogram s_executeTime( "bw_sql_execute_seconds", "Time for SQLStatement::execute" );
+static MetricHistogram s_fetchTime( "bw_sql_fetch_seconds", "Time for SQLStatement::fetch" );
+static MetricCounter s_nRows( "bw_sql_rows_total", "Rows fetched by SQLStatement::fetch" );
+
 void SQLStatement::execute()
 {
 	SQLRETURN rc;
 
+	MetricTimer mt( s_executeTime );
 	rc = SQLExecute( hstmt );
 	if (rc!=SQL_SUCCESS)
 		throw BSQLException(rc, "SQL statement execution failed.",SQL_HANDLE_STMT,hstmt);
@@ -263,11 +271,13 @@ bool SQLStatement::fetch()
 	// Returns true on success
 	SQLRETURN rc;
 
+	MetricTimer mt( s_fetchTime );
 	rc = SQLFetch( hstmt );
 	if (rc==SQL_NO_DATA_FOUND)
 		return false;
 	if (rc!=SQL_SUCCESS)
 		throw BSQLException(rc, "Unexpected fetch error.",SQL_HANDLE_STMT,hstmt);
+	s_nRows.add();
 	return true;
 }
 
@@ -12,9 +12,13 @@ Copyright (C) 1997-2013, Brian Bray
 
 #include "bw/bwassert.h"
 #include "bw/string.h"
+#include "bw/ustring.h"
+#include "bw/utf8.h"
+#include "bw/exception.h"
 
 #include <cctype>
 #include <cstring>
+#include <stdint.h>
 
 namespace bw {
 
@@ -52,6 +56,10 @@ const int quantaAlloc=16;
   Prototype: String( const String& str );
   Prototype: String( const char* psz );
   Prototype: String( const char* ps, const int len );
+  Prototype: explicit String( const UString& ustr );
+
+  The UString variant encodes as UTF-8 and throws BFormatException if the
+  UString holds a surrogate or a character beyond U+10FFFF.
 */
 String::String( const int len )
 {
@@ -62,6 +70,8 @@ String::String( const int len )
 	bwassert( m_lenMax>len );
 	bwassert( (m_lenMax&15) == 0 );
 	m_pszString = new char[m_lenMax];
+	m_hash = 0;
+	m_isLent = false;
 	*m_pszString = '\0';
 }
 
@@ -74,6 +84,8 @@ String::String( const String& str )
 
 	m_lenMax = (len+quantaAlloc) & -quantaAlloc;  // Adds one and rounds up
 	m_pszString = new char[m_lenMax];
+	m_hash = __atomic_load_n( &str.m_hash, __ATOMIC_RELAXED );
+	m_isLent = false;
 	::strcpy( m_pszString, str.m_pszString );
 }
 
@@ -88,6 +100,8 @@ String::String( const char* psz)
 	m_lenMax = (len+quantaAlloc) & -quantaAlloc;  // Adds one and rounds up
 
 	m_pszString = new char[m_lenMax];
+	m_hash = 0;
+	m_isLent = false;
 	::strcpy( m_pszString, psz );
 }
 
@@ -99,10 +113,29 @@ String::String( const char* ps, const int len )
 
 	m_lenMax = (len+quantaAlloc) & -quantaAlloc;  // Adds one and round up
 	m_pszString = new char[m_lenMax];
+	m_hash = 0;
+	m_isLent = false;
 	::memcpy( m_pszString, ps, len );
 	m_pszString[len] = '\0';
 }
 
+
+String::String( const UString& ustr )
+{
+	int lenIn = ustr.length();
+	int len = utf8EncodedLength( ustr, lenIn );
+	if (len<0)
+		throw BFormatException( "Character not representable in UTF-8" );
+	bwassert( len<65536 );       // Reasonableness
+
+	m_lenMax = (len+quantaAlloc) & -quantaAlloc;  // Adds one and round up
+	m_pszString = new char[m_lenMax];
+	m_hash = 0;
+	m_isLent = false;
+	utf8Encode( ustr, lenIn, m_pszString );
+	m_pszString[len] = '\0';
+}
+
 /////////////////////////////////////////////////////////////////////////
 /*: routine String::~String
 
@@ -169,6 +202,7 @@ String& String::operator=( const char* psz)
 {
 	bwassert( m_pszString );
 	bwassert( psz );
+	m_hash = 0;
 	if (m_pszString != psz) {	// Handle a=a
 		int len = ::strlen(psz);
 		bwassert( len>=0 );
@@ -188,6 +222,7 @@ String& String::operator=( const char* psz)
 String& String::operator=( char ch )
 {
 	bwassert( m_pszString );
+	m_hash = 0;
 
 	if (m_lenMax>(maxSpill+1)) {
 		// Need to shorten
@@ -222,6 +257,69 @@ int String::length() const
 }
 
 
+/////////////////////////////////////////////////////////////////////////
+/*: routine String::hash()
+
+  Returns a hash of the string contents suitable for hash tables.  The
+  value is computed on first use and cached until the String is changed.
+  It is never 0.  Several threads may hash the same const String; the
+  cache is written with a relaxed atomic store, and each computes the
+  same value.  Once operator[] has handed out a modifiable char& the
+  hash is computed each time, since the caller may write through it
+  later.
+
+  Prototype: unsigned long hash() const inline;
+*/
+unsigned long String::computeHash() const
+{
+	bwassert( m_pszString );
+	unsigned long h = hashBytes( m_pszString, ::strlen(m_pszString) );
+	if (!m_isLent)
+		__atomic_store_n( &m_hash, h, __ATOMIC_RELAXED );
+	return h;
+}
+
+
+/////////////////////////////////////////////////////////////////////////
+/*: routine hashBytes()
+
+  Hashes a sequence of bytes.  Input is consumed 8 bytes at a time, each
+  word is folded in with a multiply and the result goes through a final
+  avalanche mix (from MurmurHash3) so that the low bits are usable as a
+  table index.  The result is never 0, so that 0 can mark an empty slot
+  or an uncomputed hash.
+
+  Prototype: unsigned long hashBytes( const void* pv, unsigned long len )
+*/
+unsigned long hashBytes( const void* pv, unsigned long len )
+{
+	const uint64_t mult = 0x9E3779B97F4A7C15ULL;
+	const unsigned char* p = (const unsigned char*)pv;
+	uint64_t h = len * mult;
+	uint64_t w;
+
+	for (; len>=8; len-=8, p+=8) {
+		::memcpy( &w, p, 8 );
+		h = (h ^ w) * mult;
+		h ^= h>>32;
+	}
+	if (len) {
+		w = 0;
+		::memcpy( &w, p, len );
+		h = (h ^ w) * mult;
+	}
+
+	h ^= h>>33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h>>33;
+	h *= 0xC4CEB9FE1A85EC53ULL;
+	h ^= h>>33;
+
+	unsigned long ret = (unsigned long)h;
+	return ret ? ret : 1;
+}
+
+
 /////////////////////////////////////////////////////////////////////////
 /*: routine String::append
 
@@ -235,6 +333,7 @@ int String::length() const
 void String::append( const char* psz)
 {
 	bwassert( m_pszString );
+	m_hash = 0;
 	ensureCapacity( length()+::strlen( psz ) );
 	::strcat( m_pszString, psz );
 }
@@ -242,6 +341,7 @@ void String::append( const char* psz)
 void String::append( char ch )
 {
 	bwassert( m_pszString );
+	m_hash = 0;
 
 	int len = length();
 	ensureCapacity( len+1 );
@@ -480,6 +580,7 @@ String String::substring( int start, int end ) const
 void String::toUpperCase()
 {
 	bwassert( m_pszString );
+	m_hash = 0;
 
 	for (char *pch = m_pszString; *pch; pch++)
 		*pch = toupper(*pch);
@@ -493,9 +594,68 @@ void String::toUpperCase()
 void String::toLowerCase()
 {
 	bwassert( m_pszString );
+	m_hash = 0;
 
 	for (char *pch = m_pszString; *pch; pch++)
 		*pch = tolower(*pch);
 }
 
+/////////////////////////////////////////////////////////////////////////
+/*: routine String::toUString()
+
+  Returns the String decoded from UTF-8 as a UString.  Throws
+  BFormatException if the String is not well formed UTF-8.
+*/
+UString String::toUString() const
+{
+	return UString( *this );
+}
+
+
+
+/////////////////////////////////////////////////////////////////////////
+/*: class StringView
+
+  Characters of a string stored elsewhere (a String, a FileName, an
+  input buffer), as a pointer and a length, so parts of it can be handed
+  out without copying.  Only a view that reaches the end of a NUL
+  terminated string is followed by a NUL, so use length() rather than
+  strlen().  Used for FileName::baseNameView() etc. (as PathView) and for
+  parsed HTTP requests.
+*/
+
+/*: StringView::operator==()
+
+  Indicates if the view holds exactly the characters of psz.
+*/
+bool StringView::operator==( const char* psz ) const
+{
+	// Lengths first: the view may hold a NUL, and psz may be shorter
+	return strlen( psz )==(size_t)m_nLength && memcmp( m_pch, psz, m_nLength )==0;
+}
+
+/*: StringView::equalsIgnoreCase()
+
+  As operator==(), ignoring case (eg: for HTTP header names).
+*/
+bool StringView::equalsIgnoreCase( const char* psz ) const
+{
+	if (strlen( psz )!=(size_t)m_nLength)
+		return false;
+	for (int i=0; i<m_nLength; ++i) {
+		if (tolower( (unsigned char)m_pch[i] )!=tolower( (unsigned char)psz[i] ))
+			return false;
+	}
+	return true;
+}
+
+/*: StringView::toString()
+
+  Returns a copy of the characters, for keeping after the string changes.
+*/
+String StringView::toString() const
+{
+	return String( m_pch, m_nLength );
+}
+
 }	// namespace bw
@@ -0,0 +1,385 @@
+/* template.cc -- precompiled HTML templates
+
+Copyright (C) 1997-2013, Brian Bray
+
+*/
+
+#include <cctype>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "bw/bwassert.h"
+#include "bw/exception.h"
+#include "bw/string.h"
+#include "bw/file.h"
+#include "bw/html.h"
+#include "bw/template.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+
+namespace bw {
+
+// Compilation time options
+
+const int defaultReloadSeconds = 1;	// How often load() looks at a file's mtime
+const long readSize = 16*1024;
+
+
+/*: class Template
+
+  Pages written as HTML, with the program's values put in by name, in
+  place of markup built up in C++.  A template is parsed once into a
+  list of operations (copy text, substitute a value, loop) and rendered
+  from that list straight into the stream's buffer.
+
+  The tags:
+	{{name}}		the value, escaped as html::literal()
+	{{{name}}} or {{&name}}	the value as it is, for HTML the program made
+	{{#name}}...{{/name}}	once for each row of a list, or once if the
+				value is set and not empty
+	{{^name}}...{{/name}}	once if the value is unset or empty
+	{{! comment }}		nothing
+
+  A name that isn't set renders as nothing.  Inside a list, names are
+  looked up in the row and then in the data the row was added to.
+
+  Escaping replaces <, & and ", so values in attributes need double quotes.
+
+  Template::load() keeps each file's compiled template for the life of
+  the process, and compiles it again when the file changes, so pages
+  can be edited on a running server.
+
+  Example:
+	<h1>{{title}}</h1>
+	<table>{{#rows}}<tr><td>{{name}}</td><td>{{price}}</td></tr>{{/rows}}</table>
+	{{^rows}}<p>Nothing found.</p>{{/rows}}
+
+	TemplateData data;
+	data.set( "title", "Parts" );
+	TemplateData& row = data.add( "rows" );
+	row.set( "name", "Widget <large>" );
+	row.set( "price", 42L );
+	Template::load( "/srv/pages/parts.html" )->render( os, data );
+*/
+
+// Writes n characters to the stream's buffer (inside a sentry)
+static inline void put( std::ostream& os, const char* p, long n )
+{
+	if (n>0 && os.rdbuf()->sputn( p, n )!=n)
+		os.setstate( std::ios_base::badbit );
+}
+
+
+TemplateData::TemplateData()
+	:   m_pParent( 0 )
+{
+}
+
+TemplateData::~TemplateData()
+{
+	clear();
+}
+
+/* The value named, added if it isn't there */
+TemplateData::Value& TemplateData::value( const char* pszName )
+{
+	for (size_t i=0; i<m_values.size(); ++i) {
+		if (m_values[i].name==pszName)
+			return m_values[i];
+	}
+	m_values.push_back( Value() );
+	m_values.back().name = pszName;
+	return m_values.back();
+}
+
+/* The value named, here or in the data this row belongs to, or 0 */
+const TemplateData::Value* TemplateData::find( const char* pch, int len ) const
+{
+	for (const TemplateData* pData=this; pData; pData=pData->m_pParent) {
+		for (size_t i=0; i<pData->m_values.size(); ++i) {
+			const Value& v = pData->m_values[i];
+			if ((int)v.name.size()==len && memcmp( v.name.data(), pch, len )==0)
+				return &v;
+		}
+	}
+	return 0;
+}
+
+/*: TemplateData::set()
+
+  Prototype: void TemplateData::set( const char* pszName, StringView value )
+  Prototype: void TemplateData::set( const char* pszName, const char* pszValue )
+  Prototype: void TemplateData::set( const char* pszName, const String& value )
+  Prototype: void TemplateData::set( const char* pszName, long nValue )
+*/
+void TemplateData::set( const char* pszName, StringView v )
+{
+	value( pszName ).text.assign( v.data(), v.length() );
+}
+
+void TemplateData::set( const char* pszName, const char* pszValue )
+{
+	value( pszName ).text = pszValue;
+}
+
+void TemplateData::set( const char* pszName, const String& s )
+{
+	value( pszName ).text.assign( s, s.length() );
+}
+
+void TemplateData::set( const char* pszName, long nValue )
+{
+	char ach[24];
+	int len = sprintf( ach, "%ld", nValue );
+	value( pszName ).text.assign( ach, len );
+}
+
+/*: TemplateData::setFlag()
+
+  Prototype: void TemplateData::setFlag( const char* pszName, bool isSet )
+*/
+void TemplateData::setFlag( const char* pszName, bool isSet )
+{
+	value( pszName ).text = isSet ? "1" : "";
+}
+
+/*: TemplateData::add()
+
+  Prototype: TemplateData& TemplateData::add( const char* pszList )
+*/
+TemplateData& TemplateData::add( const char* pszList )
+{
+	TemplateData* pRow = new TemplateData;
+	pRow->m_pParent = this;
+	value( pszList ).rows.push_back( pRow );
+	return *pRow;
+}
+
+/*: TemplateData::clear()
+
+  Prototype: void TemplateData::clear()
+*/
+void TemplateData::clear()
+{
+	for (size_t i=0; i<m_values.size(); ++i) {
+		for (size_t j=0; j<m_values[i].rows.size(); ++j)
+			delete m_values[i].rows[j];
+	}
+	m_values.clear();
+}
+
+
+/*: Template::Template()
+
+  Compiles the text into operations.  Literal text is kept as offsets
+  into a copy of the text, so rendering copies it with one call.
+
+  Throws: BFormatException if a tag isn't closed or sections don't match
+*/
+Template::Template( StringView text )
+	:   m_source( text.data(), text.length() )
+{
+	const char* pSource = m_source.data();
+	std::vector<int> open;		// Sections not yet ended
+	size_t pos = 0;
+	for (;;) {
+		size_t nTag = m_source.find( "{{", pos );
+		size_t nText = (nTag==std::string::npos ? m_source.size() : nTag)-pos;
+		if (nText>0) {
+			Op op = { Op::Text, (int)pos, (int)nText, 0 };
+			m_ops.push_back( op );
+		}
+		if (nTag==std::string::npos)
+			break;
+
+		// The tag's sigil, name and end
+		Op::Code code = Op::Escaped;
+		size_t nName = nTag+2;
+		size_t nClose;
+		size_t nAfter;
+		if (pSource[nName]=='{') {
+			code = Op::Raw;
+			++nName;
+			nClose = m_source.find( "}}}", nName );
+			nAfter = nClose+3;
+		} else {
+			nClose = m_source.find( "}}", nName );
+			nAfter = nClose+2;
+		}
+		if (nClose==std::string::npos)
+			throw BFormatException( "Unterminated template tag" );
+		char chSigil = code==Op::Raw ? 0 : pSource[nName];
+		if (chSigil=='#' || chSigil=='^' || chSigil=='/' || chSigil=='!' || chSigil=='&')
+			++nName;
+		while (nName<nClose && isspace( (unsigned char)pSource[nName] ))
+			++nName;
+		size_t nNameEnd = nClose;
+		while (nNameEnd>nName && isspace( (unsigned char)pSource[nNameEnd-1] ))
+			--nNameEnd;
+		int len = nNameEnd-nName;
+		pos = nAfter;
+
+		if (chSigil=='!')
+			continue;
+		if (len==0)
+			throw BFormatException( "Template tag without a name" );
+		if (chSigil=='/') {
+			if (open.empty())
+				throw BFormatException( "Template section ended but not begun" );
+			Op& begin = m_ops[open.back()];
+			if (begin.nLength!=len || memcmp( pSource+begin.nStart, pSource+nName, len )!=0)
+				throw BFormatException( "Template sections don't nest" );
+			begin.nEnd = m_ops.size();
+			open.pop_back();
+			continue;
+		}
+		if (chSigil=='#')
+			code = Op::Section;
+		else if (chSigil=='^')
+			code = Op::Inverted;
+		else if (chSigil=='&')
+			code = Op::Raw;
+		if (code==Op::Section || code==Op::Inverted)
+			open.push_back( m_ops.size() );
+		Op op = { code, (int)nName, len, 0 };
+		m_ops.push_back( op );
+	}
+	if (!open.empty())
+		throw BFormatException( "Template section not ended" );
+}
+
+/*: Template::render()
+
+  Prototype: void Template::render( std::ostream& os, const TemplateData& data ) const
+*/
+void Template::render( std::ostream& os, const TemplateData& data ) const
+{
+	std::ostream::sentry ok( os );
+	if (ok)
+		renderOps( os, 0, m_ops.size(), data );
+}
+
+void Template::renderOps( std::ostream& os, int nFrom, int nTo, const TemplateData& data ) const
+{
+	const char* pSource = m_source.data();
+	for (int i=nFrom; i<nTo; ++i) {
+		const Op& op = m_ops[i];
+		if (op.code==Op::Text) {
+			put( os, pSource+op.nStart, op.nLength );
+			continue;
+		}
+		const TemplateData::Value* pv = data.find( pSource+op.nStart, op.nLength );
+		switch (op.code) {
+		case Op::Escaped:
+			if (pv)
+				html::literal( StringView( pv->text.data(), pv->text.size() ) ).write( os );
+			break;
+
+		case Op::Raw:
+			if (pv)
+				put( os, pv->text.data(), pv->text.size() );
+			break;
+
+		case Op::Section:
+			if (pv && !pv->rows.empty()) {
+				for (size_t j=0; j<pv->rows.size(); ++j)
+					renderOps( os, i+1, op.nEnd, *pv->rows[j] );
+			} else if (pv && !pv->text.empty()) {
+				renderOps( os, i+1, op.nEnd, data );
+			}
+			i = op.nEnd-1;
+			break;
+
+		case Op::Inverted:
+			if (!pv || (pv->rows.empty() && pv->text.empty()))
+				renderOps( os, i+1, op.nEnd, data );
+			i = op.nEnd-1;
+			break;
+
+		case Op::Text:
+			break;
+		}
+	}
+}
+
+
+// The templates load() has compiled
+struct CachedTemplate {
+	std::shared_ptr<const Template>	pTemplate;
+	struct timespec	mtime;		// Of the file compiled
+	off_t	size;
+	time_t	checked;	// When the file was last looked at
+};
+
+static std::mutex cacheMutex;
+static std::map<std::string,CachedTemplate> cache;
+static int reloadSeconds = defaultReloadSeconds;
+
+/*: Template::load()
+
+  Returns the file's compiled template.  The file is compiled the first
+  time and kept.  After that its mtime and size are checked at most once
+  a reload interval, and it's compiled again if either changed.  Until a
+  change is seen, the stat is skipped too.
+
+  Throws: BFileException if the file can't be read,
+          BFormatException if it isn't a valid template
+*/
+std::shared_ptr<const Template> Template::load( const char* pszPath )
+{
+	std::lock_guard<std::mutex> lock( cacheMutex );
+	time_t now = time( 0 );
+	std::map<std::string,CachedTemplate>::iterator it = cache.find( pszPath );
+	if (it!=cache.end() && now-it->second.checked<reloadSeconds)
+		return it->second.pTemplate;
+
+	struct stat st;
+	if (stat( pszPath, &st )!=0)
+		throw BFileException( BFileException::SystemError );
+	if (it!=cache.end()) {
+		CachedTemplate& c = it->second;
+		c.checked = now;
+		if (c.mtime.tv_sec==st.st_mtim.tv_sec && c.mtime.tv_nsec==st.st_mtim.tv_nsec && c.size==st.st_size)
+			return c.pTemplate;
+	}
+
+	std::string text;
+	BFile file( pszPath );
+	char buf[readSize];
+	long n;
+	while ((n = file.readUpTo( buf, readSize ))>0)
+		text.append( buf, n );
+
+	std::shared_ptr<const Template> pTemplate = std::make_shared<const Template>( StringView( text.data(), text.size() ) );
+	CachedTemplate& c = cache[pszPath];
+	c.pTemplate = pTemplate;
+	c.mtime = st.st_mtim;
+	c.size = st.st_size;
+	c.checked = now;
+	return c.pTemplate;
+}
+
+/*: Template::setReloadInterval()
+
+  0 checks the file on every load(), for development.
+
+  Prototype: void Template::setReloadInterval( int nSeconds )
+*/
+void Template::setReloadInterval( int nSeconds )
+{
+	std::lock_guard<std::mutex> lock( cacheMutex );
+	reloadSeconds = nSeconds;
+}
+
+}	// namespace bw
@@ -0,0 +1,171 @@
+// Main program to exercise AsyncIO
+//
+
+#include <cstring>
+#include <functional>
+#include <vector>
+#include <unistd.h>
+#include <poll.h>
+
+#include <bw/bwassert.h>
+#include <bw/exception.h>
+#include <bw/file.h>
+#include <bw/asyncio.h>
+
+using namespace bw;
+
+const char* fname = "/tmp/bwasyncio1.dat";
+
+const int nBlocks = 300;		// More than io_uring has in flight at once
+const int blockSize = 4096;
+
+static void exercise( AsyncIO& aio )
+{
+	unlink(fname);
+	bwverify( aio.pending()==0 );
+
+	// Writes, out of order, then a sync once they are done
+	std::vector<char> out( nBlocks*blockSize );
+	for (size_t i=0; i<out.size(); ++i)
+		out[i] = (char)(i*31+i/blockSize);
+	{
+		BFile f;
+		f.create(fname);
+		int nWritten = 0;
+		for (int b=nBlocks-1; b>=0; --b) {
+			aio.write( f, &out[b*blockSize], blockSize, (BFile::Offset)b*blockSize,
+			           [&nWritten]( const AsyncIO::Completion& c ) {
+				c.check();
+				bwverify( c.op==AsyncIO::Write && c.result==blockSize );
+				++nWritten;
+			} );
+		}
+		bwverify( aio.pending()>0 );
+		aio.wait();
+		bwverify( nWritten==nBlocks );
+		bwverify( aio.pending()==0 );
+		bwverify( f.tell()==0 );
+
+		bool isSynced = false;
+		aio.sync( f, [&isSynced]( const AsyncIO::Completion& c ) {
+			c.check();
+			bwverify( c.op==AsyncIO::Sync );
+			isSynced = true;
+		} );
+		aio.wait();
+		bwverify( isSynced );
+	}
+
+	// Reads, completed through fd() and poll() as an event loop would
+	{
+		BFile f(fname);
+		std::vector<char> in( nBlocks*blockSize );
+		int nRead = 0;
+		for (int b=0; b<nBlocks; ++b) {
+			aio.read( f, &in[b*blockSize], blockSize, (BFile::Offset)b*blockSize,
+			          [&nRead]( const AsyncIO::Completion& c ) {
+				c.check();
+				bwverify( c.op==AsyncIO::Read && c.result==blockSize );
+				++nRead;
+			} );
+		}
+		while (aio.pending()>0) {
+			struct pollfd pfd;
+			pfd.fd = aio.fd();
+			pfd.events = POLLIN;
+			pfd.revents = 0;
+			bwverify( poll( &pfd, 1, 5000 )==1 );
+			bwverify( aio.poll()>0 );
+		}
+		bwverify( nRead==nBlocks );
+		bwverify( in==out );
+		bwverify( aio.poll()==0 );
+
+		// Short read at end of file
+		char buf[100];
+		long result = -1;
+		aio.read( f, buf, sizeof(buf), (BFile::Offset)nBlocks*blockSize-10,
+		          [&result]( const AsyncIO::Completion& c ) {
+			result = c.result;
+		} );
+		aio.wait();
+		bwverify( result==10 );
+	}
+
+	// Many small reads at once.  Each reap queues a completion queue's worth
+	// from the backlog, more than the submission queue holds, so it fills
+	// and is submitted part way through.
+	{
+		BFile f(fname);
+		const int nSmall = 4000;
+		const int smallSize = 64;
+		std::vector<char> in( nSmall*smallSize );
+		int nRead = 0;
+		for (int i=0; i<nSmall; ++i) {
+			BFile::Offset pos = (BFile::Offset)i*smallSize % (nBlocks*blockSize);
+			aio.read( f, &in[i*smallSize], smallSize, pos,
+			          [&nRead]( const AsyncIO::Completion& c ) {
+				c.check();
+				bwverify( c.result==smallSize );
+				++nRead;
+			} );
+		}
+		aio.wait();
+		bwverify( nRead==nSmall );
+		for (int i=0; i<nSmall; ++i) {
+			size_t pos = (size_t)i*smallSize % out.size();
+			bwverify( memcmp( &in[i*smallSize], &out[pos], smallSize )==0 );
+		}
+	}
+
+	// Errors are reported in the completion
+	{
+		BFile f(fname);		// Read only
+		int error = 0;
+		bool isThrown = false;
+		aio.write( f, "x", 1, 0, [&]( const AsyncIO::Completion& c ) {
+			error = c.error;
+			try {
+				c.check();
+			} catch (BFileException&) {
+				isThrown = true;
+			}
+		} );
+		aio.wait();
+		bwverify( error!=0 );
+		bwverify( isThrown );
+	}
+
+	// Outstanding requests are finished by the destructor
+	{
+		BFile f(fname);
+		char buf[blockSize];
+		bool isDone = false;
+		{
+			AsyncIO aio2( aio.isKernelAsync() ? AsyncIO::Auto : AsyncIO::ThreadPool );
+			aio2.read( f, buf, sizeof(buf), 0, [&isDone]( const AsyncIO::Completion& ) {
+				isDone = true;
+			} );
+		}
+		bwverify( isDone );
+		bwverify( memcmp(buf, &out[0], blockSize)==0 );
+	}
+
+	unlink(fname);
+}
+
+int main(int, char**)
+{
+	{
+		AsyncIO aio( AsyncIO::ThreadPool, 3 );
+		bwverify( !aio.isKernelAsync() );
+		exercise( aio );
+	}
+
+	{
+		AsyncIO aio;		// io_uring if the kernel allows it
+		exercise( aio );
+	}
+
+	return 0;
+}
@@ -0,0 +1,100 @@
+// Main program to exercise BFileReader and BFileWriter
+//
+
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <unistd.h>
+
+#include <bw/bwassert.h>
+#include <bw/exception.h>
+#include <bw/string.h>
+#include <bw/file.h>
+#include <bw/buffile.h>
+
+using namespace bw;
+
+const char* fname = "/tmp/bwbuffile1.dat";
+
+struct Record {
+	int	id;
+	double	value;
+};
+
+int main(int, char**)
+{
+	const int nRecords = 5000;
+	char big[300];
+	for (int i=0; i<(int)sizeof(big); ++i)
+		big[i] = (char)i;
+
+	// Writer with a small buffer, so every path is used
+	{
+		BFile f;
+		f.create(fname);
+		BFileWriter bw(f, 64);
+		bw.writeLine("first line");
+		bw.writeLine("second line\r");
+		bw.put('x');
+		bw.put('\n');
+		for (int i=0; i<nRecords; ++i) {
+			Record rec = { i, i*0.5 };
+			bw.writeValue(rec);
+		}
+		bw.write(big, sizeof(big));		// Larger than the buffer
+		bwverify( bw.tell()==(long)(11+13+2+nRecords*sizeof(Record)+sizeof(big)) );
+		bw.writeLine("no newline at end");
+		bw.write("tail", 4);
+		bw.flush();
+		f.close();
+	}
+
+	// Reader with a small buffer
+	{
+		BFile f(fname);
+		BFileReader br(f, 50);
+		String line;
+		bwverify( br.readLine(line) && line=="first line" );
+		bwverify( br.readLine(line) && line=="second line" );
+		bwverify( br.peek()=='x' );
+		bwverify( br.get()=='x' );
+		bwverify( br.readLine(line) && line=="" );
+		for (int i=0; i<nRecords; ++i) {
+			Record rec;
+			br.readValue(rec);
+			bwverify( rec.id==i && rec.value==i*0.5 );
+		}
+		char buf[sizeof(big)];
+		br.read(buf, sizeof(buf));
+		bwverify( memcmp(buf, big, sizeof(big))==0 );
+		bwverify( br.readLine(line) && line=="no newline at end" );
+		long pos = br.tell();
+		bwverify( br.readLine(line) && line=="tail" );
+		bwverify( br.atEof() );
+		bwverify( !br.readLine(line) );
+		bwverify( br.peek()==-1 );
+		bwverify( br.tell()==pos+4 );
+	}
+
+	// Skipping and reading past the end
+	{
+		BFile f(fname);
+		BFileReader br(f, 16);
+		br.skip(11);
+		String line;
+		bwverify( br.readLine(line) && line=="second line" );
+		br.skip(2 + nRecords*sizeof(Record) + sizeof(big));
+		bwverify( br.readLine(line) && line=="no newline at end" );
+
+		bool isThrown = false;
+		try {
+			char buf[10];
+			br.read(buf, sizeof(buf));
+		} catch (BFileException&) {
+			isThrown = true;
+		}
+		bwverify( isThrown );
+	}
+
+	unlink(fname);
+}
@@ -0,0 +1,93 @@
+/* Commit benchmark
+
+Copyright (C) 1999-2013 Brian Bray
+
+Several threads each write small records and commit every one:
+  - BFile::commit, a device flush per record
+  - GroupCommit, flushes shared by the threads waiting at the time
+
+The file is written in the current directory, which should be on a real
+disk (flushes to tmpfs cost nothing).
+*/
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include <bw/bwassert.h>
+#include <bw/exception.h>
+#include <bw/file.h>
+#include <bw/groupcommit.h>
+
+using namespace bw;
+using std::cout;
+using std::endl;
+
+const char* fname = "bwcommitbench.dat";
+const int nThreads = 8;
+const int nCommits = 100;		// Per thread
+const int recordSize = 128;
+
+static double seconds( std::chrono::steady_clock::time_point start )
+{
+	return std::chrono::duration<double>( std::chrono::steady_clock::now()-start ).count();
+}
+
+// Runs the writers, committing with commit(f)
+template<class Commit>
+static double run( BFile& f, Commit commit )
+{
+	std::atomic<long> nextRecord(0);
+	std::vector<std::thread> threads;
+	auto start = std::chrono::steady_clock::now();
+	for (int t=0; t<nThreads; ++t) {
+		threads.push_back( std::thread( [&]() {
+			char rec[recordSize];
+			memset( rec, 'r', recordSize );
+			for (int i=0; i<nCommits; ++i) {
+				long n = nextRecord++;
+				f.writeAt( rec, recordSize, (BFile::Offset)n*recordSize );
+				commit();
+			}
+		} ) );
+	}
+	for (int t=0; t<nThreads; ++t)
+		threads[t].join();
+	return seconds(start);
+}
+
+static void report( const char* what, double secs, unsigned long long flushes )
+{
+	long n = (long)nThreads*nCommits;
+	cout << what << ": " << n/secs << " commits/s, "
+	     << flushes << " flushes for " << n << " commits" << endl;
+}
+
+int main(int, char**)
+{
+	cout << nThreads << " threads, " << nCommits << " commits each" << endl;
+	{
+		BFile f;
+		f.create(fname);
+		double secs = run( f, [&f]() {
+			f.commit();
+		} );
+		report( "BFile::commit", secs, (unsigned long long)nThreads*nCommits );
+	}
+	{
+		BFile f;
+		f.create(fname);
+		GroupCommit gc(f);
+		double secs = run( f, [&gc]() {
+			gc.commit();
+		} );
+		report( "GroupCommit  ", secs, gc.flushes() );
+	}
+	unlink(fname);
+}
@@ -4,8 +4,12 @@ Copyright (C) 1999-2013 Brian Bray
 
 */
 
+#include <atomic>
+#include <thread>
+#include <vector>
 #include <bw/bwassert.h>
 #include <bw/countable.h>
+#include <bw/acountable.h>
 #include <bw/string.h>
 #include <map>
 
@@ -39,6 +43,39 @@ private:
 
 int Testme::myCount = 0;
 
+class ATestme;
+typedef acptr<ATestme> ATestmeRef;
+
+class ATestme : public AtomicCountable<ATestme> {
+public:
+	ATestme() {
+		++myCount;
+	}
+	~ATestme() {
+		--myCount;
+	}
+	static int count() {
+		return myCount;
+	}
+	int mycount() {
+		return m_cRef;
+	}
+
+private:
+	static std::atomic<int> myCount;
+};
+
+std::atomic<int> ATestme::myCount(0);
+
+static void churn( ATestmeRef ref )
+{
+	for (int i=0; i<100000; ++i) {
+		ATestmeRef copy = ref;
+		ATestmeRef moved( std::move(copy) );
+		bwverify( !copy );
+	}
+}
+
 int main(int, char**)
 {
 	using bw::String;
@@ -97,6 +134,29 @@ int main(int, char**)
 	bwverify(three->mycount()==2);
 	bwverify(one==zero);
 
+	// acptr/AtomicCountable
+	{
+		ATestmeRef a = new ATestme;
+		bwverify(ATestme::count()==1);
+		ATestmeRef b = a;
+		bwverify(a->mycount()==2);
+		b = b;
+		bwverify(a->mycount()==2);
+		ATestmeRef c( std::move(b) );
+		bwverify(a->mycount()==2);
+		bwverify(!b);
+		bwverify(c==a);
+
+		std::vector<std::thread> threads;
+		for (int i=0; i<4; ++i)
+			threads.push_back( std::thread(churn,a) );
+		for (size_t i=0; i<threads.size(); ++i)
+			threads[i].join();
+		bwverify(a->mycount()==2);
+		bwverify(ATestme::count()==1);
+	}
+	bwverify(ATestme::count()==0);
+
 	//bwverify(false);
 	//bwassert(false);
 
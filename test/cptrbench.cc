@@ -0,0 +1,107 @@
+/* cptr/acptr benchmark
+
+Copyright (C) 1999-2013 Brian Bray
+
+Times copying and destroying references in a tight loop:
+  - cptr to a Countable (virtual, non-atomic count), one thread
+  - acptr to an AtomicCountable, one thread
+  - acptr, many threads sharing one object (contended count)
+  - acptr, many threads each with their own object
+*/
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+
+#include <bw/bwassert.h>
+#include <bw/countable.h>
+#include <bw/acountable.h>
+
+using std::cout;
+using std::endl;
+
+class VObj : public Countable {
+public:
+	int	value;
+};
+
+class AObj : public AtomicCountable<AObj> {
+public:
+	int	value;
+	char	pad[64];	// Keep per thread objects off each other's cache lines
+};
+
+const long loops = 20000000;
+
+// Keeps the optimizer from discarding the loop
+std::atomic<long> sink(0);
+
+template<class R>
+void copyLoop( R ref, long n )
+{
+	long sum = 0;
+	for (long i=0; i<n; ++i) {
+		R copy = ref;
+		sum += copy->value;
+	}
+	sink += sum;
+}
+
+template<class F>
+double timeit( F f )
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	f();
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double>(end-start).count();
+}
+
+void report( const char* what, double secs, long ops )
+{
+	cout << what << ": " << secs*1e9/ops << " ns/copy, "
+	     << ops/secs/1e6 << " M copies/s" << endl;
+}
+
+int main(int argc, char** argv)
+{
+	int nThreads = argc>1 ? atoi(argv[1]) : std::thread::hardware_concurrency();
+	if (nThreads<1)
+		nThreads = 1;
+
+	cptr<VObj> vref = new VObj;
+	vref->value = 1;
+	acptr<AObj> aref = new AObj;
+	aref->value = 1;
+
+	report( "cptr, 1 thread", timeit( [&] { copyLoop(vref,loops); } ), loops );
+	report( "acptr, 1 thread", timeit( [&] { copyLoop(aref,loops); } ), loops );
+
+	double secs = timeit( [&] {
+		std::vector<std::thread> threads;
+		for (int i=0; i<nThreads; ++i)
+			threads.push_back( std::thread( copyLoop< acptr<AObj> >, aref, loops/nThreads ) );
+		for (size_t i=0; i<threads.size(); ++i)
+			threads[i].join();
+	} );
+	cout << "(" << nThreads << " threads)" << endl;
+	report( "acptr, shared object", secs, loops/nThreads*nThreads );
+
+	std::vector< acptr<AObj> > refs;
+	for (int i=0; i<nThreads; ++i) {
+		refs.push_back( new AObj );
+		refs.back()->value = 1;
+	}
+	secs = timeit( [&] {
+		std::vector<std::thread> threads;
+		for (int i=0; i<nThreads; ++i)
+			threads.push_back( std::thread( copyLoop< acptr<AObj> >, refs[i], loops/nThreads ) );
+		for (size_t i=0; i<threads.size(); ++i)
+			threads[i].join();
+	} );
+	report( "acptr, object per thread", secs, loops/nThreads*nThreads );
+
+	bwverify( sink>0 );
+}
@@ -0,0 +1,115 @@
+// Main program to exercise Directory, DirectoryScan and FilePattern
+//
+
+#include <cstdlib>
+#include <set>
+#include <string>
+#include <fnmatch.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "bw/bwassert.h"
+#include "bw/exception.h"
+#include "bw/string.h"
+#include "bw/filename.h"
+#include "bw/directory.h"
+
+using namespace bw;
+
+const char* dname = "/tmp/bwdirectory1";
+
+static void touch( const std::string& name )
+{
+	int fd = open( (std::string(dname)+"/"+name).c_str(), O_WRONLY|O_CREAT, 0600 );
+	bwverify( fd>=0 );
+	close(fd);
+}
+
+int main(int, char**)
+{
+	// Patterns agree with fnmatch
+	const char* apszPatterns[] = {
+		"*", "**", "readme.txt", "read*", "*.txt", "*.t?t", "r*e*.txt", "*e*",
+		"[rR]eadme.*", "[!r]*", "[^r]*", "[a-m]*", "[]x]*", "*[0-9]", "x[", "a\\*b",
+		"\\[x]", "*.[ch]", "?", "", "[[:digit:]]*", "a*b*c", "*a*b"
+	};
+	const char* apszNames[] = {
+		"readme.txt", "README.txt", "readme.txs", "read", "notes.txt", "a.c", "b.h",
+		"main.cc", "file7", "x[", "a*b", "ab", "[x]", "]x", "x", "", "abc", "aXbYc",
+		"aab", "ba", ".hidden", "9lives"
+	};
+	for (size_t i=0; i<sizeof(apszPatterns)/sizeof(apszPatterns[0]); ++i) {
+		FilePattern fp( apszPatterns[i] );
+		for (size_t j=0; j<sizeof(apszNames)/sizeof(apszNames[0]); ++j) {
+			bool expected = fnmatch( apszPatterns[i], apszNames[j], 0 )==0;
+			bwverify( fp.matches(apszNames[j])==expected );
+		}
+	}
+	bwverify( FilePattern("*").matchesAll() );
+	bwverify( !FilePattern("*.txt").matchesAll() );
+
+	// A directory with some files and a subdirectory
+	std::string cmd = std::string("rm -rf ") + dname;
+	bwverify( system(cmd.c_str())==0 );
+	bwverify( mkdir(dname, 0700)==0 );
+	std::set<std::string> all;
+	for (int i=0; i<2000; ++i) {
+		std::string name = "file" + std::to_string(i) + (i%3==0 ? ".txt" : ".dat");
+		touch(name);
+		all.insert(name);
+	}
+	bwverify( mkdir((std::string(dname)+"/sub").c_str(), 0700)==0 );
+	all.insert("sub");
+	bwverify( symlink("sub", (std::string(dname)+"/link").c_str())==0 );
+	all.insert("link");
+
+	// Everything, with types
+	{
+		DirectoryScan ds( dname );
+		bwverify( ds.isOpen() );
+		std::set<std::string> found;
+		while (ds.next()) {
+			std::string name = ds.name();
+			bwverify( found.insert(name).second );
+			FileName::Type type = ds.getType();
+			bwverify( type==ds.fileName().getFileType() );
+			bool isDir = name=="sub" || name=="link";
+			bwverify( type==(isDir ? FileName::Directory : FileName::RegularFile) );
+		}
+		bwverify( found==all );
+		bwverify( !ds.next() );
+
+		ds.rewind();
+		int n = 0;
+		while (ds.next())
+			++n;
+		bwverify( n==(int)all.size() );
+	}
+
+	// With a pattern, agreeing with Directory
+	{
+		std::set<std::string> fromScan, fromDirectory;
+		DirectoryScan ds( dname, "*.txt" );
+		while (ds.next())
+			fromScan.insert( ds.name() );
+		bwverify( fromScan.size()==667 );
+
+		FileName fnDir( (std::string(dname)+"/").c_str() );
+		for (Directory dir( fnDir, "*.txt" ); !dir.atEof(); ++dir) {
+			bwverify( dir.getType()==FileName::RegularFile );
+			fromDirectory.insert( (const char*)dir->baseName() + std::string(dir->extension()) );
+		}
+		bwverify( fromScan==fromDirectory );
+	}
+
+	// Missing directories are empty
+	{
+		DirectoryScan ds( "/tmp/bwdirectory1/none" );
+		bwverify( !ds.isOpen() );
+		bwverify( !ds.next() );
+	}
+
+	bwverify( system(cmd.c_str())==0 );
+	return 0;
+}
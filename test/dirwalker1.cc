@@ -0,0 +1,130 @@
+// Main program to exercise DirectoryWalker
+//
+
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <set>
+#include <string>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "bw/bwassert.h"
+#include "bw/exception.h"
+#include "bw/string.h"
+#include "bw/filename.h"
+#include "bw/dirwalker.h"
+
+using namespace bw;
+
+const std::string root = "/tmp/bwdirwalker1";
+
+static void touch( const std::string& path )
+{
+	int fd = open( path.c_str(), O_WRONLY|O_CREAT, 0600 );
+	bwverify( fd>=0 );
+	close(fd);
+}
+
+// Makes a tree width directories wide and depth deep, with files in each
+static void makeTree( const std::string& dir, int depth, std::set<std::string>& all )
+{
+	for (int i=0; i<3; ++i) {
+		std::string file = dir + "/f" + std::to_string(i) + (i==0 ? ".txt" : ".dat");
+		touch(file);
+		all.insert(file);
+	}
+	if (depth==0)
+		return;
+	for (int i=0; i<4; ++i) {
+		std::string sub = dir + "/d" + std::to_string(i);
+		bwverify( mkdir(sub.c_str(), 0700)==0 );
+		all.insert(sub);
+		makeTree(sub, depth-1, all);
+	}
+}
+
+int main(int, char**)
+{
+	std::string cmd = "rm -rf " + root;
+	bwverify( system(cmd.c_str())==0 );
+	bwverify( mkdir(root.c_str(), 0700)==0 );
+	std::set<std::string> all;
+	makeTree(root, 4, all);
+	bwverify( symlink("d0", (root+"/loop").c_str())==0 );	// Not followed
+	all.insert(root+"/loop");
+
+	// Everything, through a small queue
+	{
+		DirectoryWalker dw( root.c_str(), 3 );
+		dw.setQueueSize(7);
+		std::set<std::string> found;
+		DirectoryWalker::Entry e;
+		while (dw.next(e)) {
+			bwverify( found.insert(e.path).second );
+			bwverify( e.path.compare(0, e.nameOffset, e.path.substr(0, e.path.rfind('/')+1))==0 );
+			int depth = 0;
+			for (size_t i=root.size(); i<e.path.size(); ++i)
+				depth += e.path[i]=='/';
+			bwverify( e.depth==depth );
+			bwverify( e.type==FileName(e.path.c_str()).getFileType() );
+		}
+		bwverify( found==all );
+		bwverify( !dw.next(e) );
+	}
+
+	// Pattern and type filters
+	{
+		DirectoryWalker dw( root.c_str() );
+		dw.setPattern("*.txt");
+		dw.setTypes( DirectoryWalker::typeBit(FileName::RegularFile) );
+		int n = 0;
+		DirectoryWalker::Entry e;
+		while (dw.next(e)) {
+			bwverify( e.type==FileName::RegularFile );
+			bwverify( std::string(e.name())=="f0.txt" );
+			++n;
+		}
+		bwverify( n==1+4+16+64+256 );
+	}
+
+	// Pruning
+	{
+		std::atomic<int> nCalls(0);
+		DirectoryWalker dw( root.c_str(), 2 );
+		dw.setTypes( DirectoryWalker::typeBit(FileName::Directory) );
+		dw.setPrune( [&nCalls]( const char* pszPath, int depth ) {
+			++nCalls;
+			return depth<2;
+		} );
+		int n = 0;
+		DirectoryWalker::Entry e;
+		while (dw.next(e)) {
+			bwverify( e.depth<=2 );
+			++n;
+		}
+		bwverify( n==4+16+1 );		// The link to d0 is a directory too
+		bwverify( nCalls==4+16 );
+	}
+
+	// Stopping early
+	{
+		DirectoryWalker dw( root.c_str() );
+		dw.setQueueSize(2);
+		DirectoryWalker::Entry e;
+		bwverify( dw.next(e) );
+		dw.stop();
+		bwverify( !dw.next(e) );
+	}
+
+	// Missing roots are empty
+	{
+		DirectoryWalker dw( (root+"/none").c_str() );
+		DirectoryWalker::Entry e;
+		bwverify( !dw.next(e) );
+	}
+
+	bwverify( system(cmd.c_str())==0 );
+	return 0;
+}
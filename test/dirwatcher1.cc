@@ -0,0 +1,198 @@
+// Main program to exercise DirectoryWatcher
+//
+
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include "bw/bwassert.h"
+#include "bw/exception.h"
+#include "bw/string.h"
+#include "bw/filename.h"
+#include "bw/dirwatcher.h"
+
+using namespace bw;
+
+const std::string root = "/tmp/bwdirwatcher1";
+
+static void touch( const std::string& path )
+{
+	int fd = open( path.c_str(), O_WRONLY|O_CREAT, 0600 );
+	bwverify( fd>=0 );
+	bwverify( write(fd, "x", 1)==1 );
+	close(fd);
+}
+
+// Waits briefly for events and reads them, keyed by path
+static std::multimap<std::string,DirectoryWatcher::Event> collect( DirectoryWatcher& dw )
+{
+	std::vector<DirectoryWatcher::Event> events;
+	struct pollfd pfd;
+	pfd.fd = dw.fd();
+	pfd.events = POLLIN;
+	while (poll(&pfd, 1, 200)>0)
+		dw.read(events);
+	std::multimap<std::string,DirectoryWatcher::Event> byPath;
+	for (size_t i=0; i<events.size(); ++i)
+		byPath.insert( std::make_pair(events[i].path, events[i]) );
+	return byPath;
+}
+
+static bool has( const std::multimap<std::string,DirectoryWatcher::Event>& m,
+                 const std::string& path, DirectoryWatcher::EventType type )
+{
+	typedef std::multimap<std::string,DirectoryWatcher::Event>::const_iterator It;
+	std::pair<It,It> r = m.equal_range(path);
+	for (It it=r.first; it!=r.second; ++it)
+		if (it->second.type==type)
+			return true;
+	return false;
+}
+
+int main(int, char**)
+{
+	std::string cmd = "rm -rf " + root;
+	bwverify( system(cmd.c_str())==0 );
+	bwverify( mkdir(root.c_str(), 0700)==0 );
+	bwverify( mkdir((root+"/flat").c_str(), 0700)==0 );
+	bwverify( mkdir((root+"/tree").c_str(), 0700)==0 );
+	bwverify( mkdir((root+"/tree/old").c_str(), 0700)==0 );
+
+	DirectoryWatcher dw;
+	std::vector<DirectoryWatcher::Event> events;
+	bwverify( dw.read(events)==0 );
+
+	// Non-recursive: create, write, rename, delete
+	{
+		dw.watch( (root+"/flat/").c_str() );
+		touch(root+"/flat/a");
+		bwverify( rename((root+"/flat/a").c_str(), (root+"/flat/b").c_str())==0 );
+		bwverify( unlink((root+"/flat/b").c_str())==0 );
+		bwverify( mkdir((root+"/flat/sub").c_str(), 0700)==0 );
+		touch(root+"/flat/sub/ignored");
+
+		std::multimap<std::string,DirectoryWatcher::Event> m = collect(dw);
+		bwverify( has(m, root+"/flat/a", DirectoryWatcher::Created) );
+		bwverify( has(m, root+"/flat/a", DirectoryWatcher::Written) );
+		bwverify( has(m, root+"/flat/a", DirectoryWatcher::MovedFrom) );
+		bwverify( has(m, root+"/flat/b", DirectoryWatcher::MovedTo) );
+		bwverify( has(m, root+"/flat/b", DirectoryWatcher::Deleted) );
+		bwverify( has(m, root+"/flat/sub", DirectoryWatcher::Created) );
+		bwverify( m.find(root+"/flat/sub")->second.isDirectory );
+		bwverify( m.count(root+"/flat/sub/ignored")==0 );
+		unsigned cookieFrom = 0, cookieTo = 0;
+		typedef std::multimap<std::string,DirectoryWatcher::Event>::const_iterator It;
+		for (It it=m.begin(); it!=m.end(); ++it) {
+			if (it->second.type==DirectoryWatcher::MovedFrom)
+				cookieFrom = it->second.cookie;
+			if (it->second.type==DirectoryWatcher::MovedTo)
+				cookieTo = it->second.cookie;
+		}
+		bwverify( cookieFrom!=0 && cookieFrom==cookieTo );
+		bwverify( m.size()==6 );
+		dw.unwatch( (root+"/flat").c_str() );
+		touch(root+"/flat/c");
+		bwverify( collect(dw).empty() );
+	}
+
+	// Recursive: existing and new subdirectories, directories moved in and out
+	{
+		dw.watch( (root+"/tree").c_str(), true );
+		touch(root+"/tree/old/f");
+		bwverify( system(("mkdir -p " + root + "/tree/new/deep").c_str())==0 );
+		touch(root+"/tree/new/deep/g");
+		bwverify( mkdir((root+"/outside").c_str(), 0700)==0 );
+		touch(root+"/outside/h");
+		bwverify( rename((root+"/outside").c_str(), (root+"/tree/in").c_str())==0 );
+
+		std::multimap<std::string,DirectoryWatcher::Event> m = collect(dw);
+		bwverify( has(m, root+"/tree/old/f", DirectoryWatcher::Written) );
+		bwverify( has(m, root+"/tree/new", DirectoryWatcher::Created) );
+		bwverify( has(m, root+"/tree/new/deep", DirectoryWatcher::Created) );
+		bwverify( has(m, root+"/tree/new/deep/g", DirectoryWatcher::Created) );
+		bwverify( has(m, root+"/tree/in", DirectoryWatcher::MovedTo) );
+		bwverify( has(m, root+"/tree/in/h", DirectoryWatcher::Created) );
+
+		// Watches follow the rename, and stop when moved out
+		touch(root+"/tree/in/i");
+		bwverify( rename((root+"/tree/new").c_str(), (root+"/moved").c_str())==0 );
+		touch(root+"/moved/deep/j");
+		m = collect(dw);
+		bwverify( has(m, root+"/tree/in/i", DirectoryWatcher::Written) );
+		bwverify( has(m, root+"/tree/new", DirectoryWatcher::MovedFrom) );
+		bwverify( m.size()==3 );
+	}
+
+	// A directory inside a recursive watch watched on its own as well:
+	// each watch keeps what it covers until it is unwatched
+	{
+		dw.watch( (root+"/tree/in").c_str() );
+		bwverify( mkdir((root+"/tree/in/sub").c_str(), 0700)==0 );
+		std::multimap<std::string,DirectoryWatcher::Event> m = collect(dw);
+		bwverify( has(m, root+"/tree/in/sub", DirectoryWatcher::Created) );
+		bwverify( m.size()==1 );
+		touch(root+"/tree/in/sub/k");
+		m = collect(dw);
+		bwverify( has(m, root+"/tree/in/sub/k", DirectoryWatcher::Written) );
+		bwverify( m.size()==2 );
+
+		dw.unwatch( (root+"/tree/in").c_str() );
+		touch(root+"/tree/in/l");
+		touch(root+"/tree/in/sub/m");
+		m = collect(dw);
+		bwverify( has(m, root+"/tree/in/l", DirectoryWatcher::Written) );
+		bwverify( has(m, root+"/tree/in/sub/m", DirectoryWatcher::Written) );
+		bwverify( m.size()==4 );
+
+		dw.watch( (root+"/moved").c_str(), true );
+		dw.watch( (root+"/moved/deep").c_str() );
+		dw.unwatch( (root+"/moved").c_str() );
+		touch(root+"/moved/n");
+		touch(root+"/moved/deep/o");
+		m = collect(dw);
+		bwverify( has(m, root+"/moved/deep/o", DirectoryWatcher::Written) );
+		bwverify( m.size()==2 );
+		dw.unwatch( (root+"/moved/deep").c_str() );
+	}
+
+	// Overflow gives one Rescan per watched directory
+	{
+		long nMax = 16384;
+		std::ifstream limits("/proc/sys/fs/inotify/max_queued_events");
+		limits >> nMax;
+		if (nMax<=100000) {
+			dw.watch( (root+"/flat").c_str() );
+			for (long i=0; i<=nMax/2+10; ++i) {
+				std::string name = root + "/flat/o" + std::to_string(i);
+				touch(name);
+			}
+			std::multimap<std::string,DirectoryWatcher::Event> m = collect(dw);
+			bwverify( has(m, root+"/flat", DirectoryWatcher::Rescan) );
+			bwverify( has(m, root+"/tree", DirectoryWatcher::Rescan) );
+			bwverify( m.count(root+"/flat")==1 );
+			bwverify( m.count(root+"/tree")==1 );
+
+			// Still working afterwards
+			touch(root+"/tree/in/k");
+			m = collect(dw);
+			bwverify( has(m, root+"/tree/in/k", DirectoryWatcher::Created) );
+		}
+	}
+
+	// Errors
+	try {
+		dw.watch( (root+"/none").c_str() );
+		bwverify( false );
+	} catch (BFileException&) {
+	}
+
+	bwverify( system(cmd.c_str())==0 );
+	return 0;
+}
@@ -0,0 +1,243 @@
+// Main program to exercise FastCGIServer, with a small FastCGI client
+//
+
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "bw/bwassert.h"
+#include "bw/exception.h"
+#include "bw/string.h"
+#include "bw/http.h"
+#include "bw/fastcgi.h"
+
+using namespace bw;
+
+const char* sockPath = "/tmp/bwfastcgi1.sock";
+
+// The web server's side of the protocol
+class Client {
+public:
+	Client() {
+		m_fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+		bwverify( m_fd>=0 );
+		struct sockaddr_un addr;
+		memset( &addr, 0, sizeof(addr) );
+		addr.sun_family = AF_UNIX;
+		strcpy( addr.sun_path, sockPath );
+		bwverify( connect(m_fd, (struct sockaddr*)&addr, sizeof(addr))==0 );
+	}
+	~Client() {
+		close( m_fd );
+	}
+
+	void record( int type, int id, const std::string& content, int nPadding=0 ) {
+		std::string r;
+		r += (char)1;
+		r += (char)type;
+		r += (char)(id>>8);
+		r += (char)id;
+		r += (char)(content.size()>>8);
+		r += (char)content.size();
+		r += (char)nPadding;
+		r += (char)0;
+		r += content;
+		r += std::string( nPadding, 'P' );
+		bwverify( write(m_fd, r.data(), r.size())==(ssize_t)r.size() );
+	}
+
+	static void pair( std::string& s, const std::string& name, const std::string& value ) {
+		length( s, name.size() );
+		length( s, value.size() );
+		s += name;
+		s += value;
+	}
+
+	void begin( int id, bool keepConn, int role=1 ) {
+		std::string body( 8, '\0' );
+		body[1] = (char)role;
+		body[2] = keepConn ? 1 : 0;
+		record( 1, id, body );
+	}
+
+	bool readRecord( int& type, int& id, std::string& content ) {
+		unsigned char header[8];
+		if (!readExact( (char*)header, 8 ))
+			return false;
+		type = header[1];
+		id = (header[2]<<8) | header[3];
+		content.resize( (header[4]<<8) | header[5] );
+		std::string padding( header[6], '\0' );
+		return readExact( &content[0], content.size() ) && readExact( &padding[0], padding.size() );
+	}
+
+	// Sends a whole request; returns its stdout and sets its status and stderr
+	std::string request( int id, const std::vector< std::pair<std::string,std::string> >& params,
+	                     const std::string& body, bool keepConn, int& appStatus, std::string& err ) {
+		begin( id, keepConn );
+		std::string p;
+		for (size_t i=0; i<params.size(); ++i)
+			pair( p, params[i].first, params[i].second );
+		// Split the parameters across records, as servers may
+		record( 4, id, p.substr(0, p.size()/2), 3 );
+		record( 4, id, p.substr(p.size()/2) );
+		record( 4, id, "" );
+		for (size_t pos=0; pos<body.size(); pos+=40000)
+			record( 5, id, body.substr(pos, 40000) );
+		record( 5, id, "" );
+		return response( id, appStatus, err );
+	}
+
+	std::string response( int idWanted, int& appStatus, std::string& err ) {
+		std::string out;
+		int type;
+		int id;
+		std::string content;
+		while (readRecord( type, id, content )) {
+			bwverify( id==idWanted );
+			if (type==6)
+				out += content;
+			else if (type==7)
+				err += content;
+			else if (type==3) {
+				bwverify( content.size()==8 );
+				appStatus = (unsigned char)content[3];
+				m_protocolStatus = content[4];
+				return out;
+			}
+		}
+		bwverify( false );
+		return out;
+	}
+
+	int	m_protocolStatus;
+
+private:
+	static void length( std::string& s, size_t n ) {
+		if (n<128) {
+			s += (char)n;
+		} else {
+			s += (char)(0x80 | (n>>24));
+			s += (char)(n>>16);
+			s += (char)(n>>8);
+			s += (char)n;
+		}
+	}
+
+	bool readExact( char* p, size_t n ) {
+		while (n>0) {
+			ssize_t len = read( m_fd, p, n );
+			if (len<=0)
+				return false;
+			p += len;
+			n -= len;
+		}
+		return true;
+	}
+
+	int	m_fd;
+};
+
+typedef std::vector< std::pair<std::string,std::string> > Params;
+
+int main(int, char**)
+{
+	FastCGIServer server( sockPath );
+	int nCalls = 0;
+	std::thread thread( [&]() {
+		server.run( [&]( CGIRequest& req ) {
+			++nCalls;
+			std::map< String, String > form = req.getAnyData();
+			if (form.count("fail"))
+				throw BFormatException( "Asked to fail" );
+			const char* pszAgent = req.param( "HTTP_USER_AGENT" );
+			req.out() << "Content-Type: text/plain\r\n\r\n";
+			req.out() << (pszAgent ? pszAgent : "none") << "|" << form.size();
+			for (std::map< String, String >::iterator it=form.begin(); it!=form.end(); ++it)
+				req.out() << "|" << it->first << "=" << it->second;
+			if (form.count("big"))
+				req.out() << std::string( 200000, 'b' );
+		} );
+	} );
+
+	int appStatus;
+	std::string err;
+
+	// GET, on a kept connection, then POST on the same connection
+	{
+		Client c;
+		Params params;
+		params.push_back( std::make_pair("REQUEST_METHOD", "GET") );
+		params.push_back( std::make_pair("QUERY_STRING", "a=1&b=two+words") );
+		params.push_back( std::make_pair("HTTP_USER_AGENT", std::string(300, 'u')) );
+		std::string out = c.request( 1, params, "", true, appStatus, err );
+		bwverify( out=="Content-Type: text/plain\r\n\r\n" + std::string(300, 'u') + "|2|a=1|b=two words" );
+		bwverify( appStatus==0 && c.m_protocolStatus==0 && err.empty() );
+
+		Params post;
+		post.push_back( std::make_pair("REQUEST_METHOD", "POST") );
+		post.push_back( std::make_pair("CONTENT_TYPE", "application/x-www-form-urlencoded") );
+		std::string body = "x=" + std::string(50000, 'x') + "&big=1";
+		out = c.request( 2, post, body, true, appStatus, err );
+		bwverify( out.size()==strlen("Content-Type: text/plain\r\n\r\n")+strlen("none|2|big=1|x=")+50000+200000 );
+		bwverify( out.compare(0, 46, "Content-Type: text/plain\r\n\r\nnone|2|big=1|x=xxx")==0 );
+		bwverify( appStatus==0 );
+
+		// Management records
+		std::string q;
+		Client::pair( q, "FCGI_MPXS_CONNS", "" );
+		c.record( 9, 0, q );
+		int type;
+		int id;
+		std::string content;
+		bwverify( c.readRecord(type, id, content) );
+		bwverify( type==10 && id==0 );
+		bwverify( content==std::string("\x0f\x01") + "FCGI_MPXS_CONNS0" );
+		c.record( 42, 0, "" );
+		bwverify( c.readRecord(type, id, content) );
+		bwverify( type==11 && content[0]==42 );
+
+		// A handler that throws; the connection carries on
+		Params fail;
+		fail.push_back( std::make_pair("REQUEST_METHOD", "GET") );
+		fail.push_back( std::make_pair("QUERY_STRING", "fail=yes") );
+		out = c.request( 3, fail, "", false, appStatus, err );
+		bwverify( out=="" && appStatus==1 );
+		bwverify( err.find("Asked to fail")!=std::string::npos );
+	}
+
+	// Multiplexing and other roles are refused
+	{
+		Client c;
+		c.begin( 5, false );
+		c.begin( 6, false );
+		c.response( 6, appStatus, err );
+		bwverify( c.m_protocolStatus==1 );
+		c.record( 4, 5, "" );
+		c.record( 5, 5, "" );
+		std::string out = c.response( 5, appStatus, err );
+		bwverify( c.m_protocolStatus==0 );
+		bwverify( out=="Content-Type: text/plain\r\n\r\nnone|0" );
+	}
+	{
+		Client c;
+		c.begin( 7, false, 2 );
+		c.response( 7, appStatus, err );
+		bwverify( c.m_protocolStatus==3 );
+	}
+
+	server.stop();
+	thread.join();
+	bwverify( nCalls==4 );
+	bwverify( server.requests()==4 );
+	return 0;
+}
@@ -0,0 +1,190 @@
+/* FastCGI benchmark
+
+Copyright (C) 1999-2013 Brian Bray
+
+The same handler (parse a query string, write a small page) served by:
+  - CGI, a fork and exec of this program per request, as a web server does
+  - FastCGIServer, with a new connection per request
+  - FastCGIServer, with one kept connection (FCGI_KEEP_CONN)
+
+The client side plays the web server, on a Unix socket.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include <bw/bwassert.h>
+#include <bw/exception.h>
+#include <bw/string.h>
+#include <bw/http.h>
+#include <bw/fastcgi.h>
+
+using namespace bw;
+using std::cout;
+using std::endl;
+
+const char* sockPath = "/tmp/bwfcgibench.sock";
+const char* query = "name=Brian&item=42&colour=dark+blue&sort=asc&page=3";
+const int nCGIRequests = 300;
+const int nFastCGIRequests = 20000;
+
+static void handler( CGIRequest& req )
+{
+	std::map< String, String > form = req.getAnyData();
+	req.out() << "Content-Type: text/html\r\n\r\n<html><body><p>Hello " << form["name"]
+	          << ", item " << form["item"] << "</p></body></html>\n";
+}
+
+static double seconds( std::chrono::steady_clock::time_point start )
+{
+	return std::chrono::duration<double>( std::chrono::steady_clock::now()-start ).count();
+}
+
+static void report( const char* what, int n, double secs )
+{
+	cout << what << ": " << (long)(n/secs) << " requests/s" << endl;
+}
+
+// One CGI request:  fork, exec, read the page, wait
+static void cgiRequest( const char* pszProgram )
+{
+	int afd[2];
+	bwverify( pipe(afd)==0 );
+	pid_t pid = fork();
+	if (pid==0) {
+		dup2( afd[1], 1 );
+		close( afd[0] );
+		close( afd[1] );
+		setenv( "REQUEST_METHOD", "GET", 1 );
+		setenv( "QUERY_STRING", query, 1 );
+		execl( pszProgram, pszProgram, "cgi", (char*)0 );
+		_exit( 127 );
+	}
+	close( afd[1] );
+	char buf[4096];
+	long nTotal = 0;
+	long n;
+	while ((n = read( afd[0], buf, sizeof(buf) ))>0)
+		nTotal += n;
+	close( afd[0] );
+	int status;
+	waitpid( pid, &status, 0 );
+	bwverify( nTotal>0 && WIFEXITED(status) && WEXITSTATUS(status)==0 );
+}
+
+static int connectServer()
+{
+	int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+	struct sockaddr_un addr;
+	memset( &addr, 0, sizeof(addr) );
+	addr.sun_family = AF_UNIX;
+	strcpy( addr.sun_path, sockPath );
+	bwverify( connect(fd, (struct sockaddr*)&addr, sizeof(addr))==0 );
+	return fd;
+}
+
+static void addRecord( std::string& s, int type, const std::string& content )
+{
+	char header[8] = { 1, (char)type, 0, 1, (char)(content.size()>>8), (char)content.size(), 0, 0 };
+	s.append( header, 8 );
+	s += content;
+}
+
+static void addPair( std::string& s, const char* pszName, const char* pszValue )
+{
+	s += (char)strlen( pszName );
+	s += (char)strlen( pszValue );
+	s += pszName;
+	s += pszValue;
+}
+
+// The records of one request, as a web server would send them
+static std::string requestRecords( bool keepConn )
+{
+	std::string begin( 8, '\0' );
+	begin[1] = 1;
+	begin[2] = keepConn ? 1 : 0;
+	std::string params;
+	addPair( params, "REQUEST_METHOD", "GET" );
+	addPair( params, "QUERY_STRING", query );
+	addPair( params, "SERVER_SOFTWARE", "bwbench" );
+	addPair( params, "REMOTE_ADDR", "127.0.0.1" );
+	std::string s;
+	addRecord( s, 1, begin );
+	addRecord( s, 4, params );
+	addRecord( s, 4, "" );
+	addRecord( s, 5, "" );
+	return s;
+}
+
+// Sends one request and reads up to its FCGI_END_REQUEST
+static void fastcgiRequest( int fd, const std::string& records )
+{
+	bwverify( write(fd, records.data(), records.size())==(ssize_t)records.size() );
+	std::string in;
+	char buf[4096];
+	for (;;) {
+		// Records: look for the end record's header
+		size_t pos = 0;
+		while (pos+8<=in.size()) {
+			if (in[pos+1]==3 && pos+16<=in.size())
+				return;
+			pos += 8+(((unsigned char)in[pos+4]<<8) | (unsigned char)in[pos+5])+(unsigned char)in[pos+6];
+		}
+		ssize_t n = read( fd, buf, sizeof(buf) );
+		bwverify( n>0 );
+		in.append( buf, n );
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc>1 && strcmp( argv[1], "cgi" )==0) {
+		CGIRequest req;
+		handler( req );
+		return 0;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i=0; i<nCGIRequests; ++i)
+		cgiRequest( argv[0] );
+	report( "CGI, fork and exec        ", nCGIRequests, seconds(start) );
+
+	FastCGIServer server( sockPath );
+	std::thread thread( [&server]() {
+		server.run( handler );
+	} );
+
+	std::string records = requestRecords( false );
+	start = std::chrono::steady_clock::now();
+	for (int i=0; i<nFastCGIRequests; ++i) {
+		int fd = connectServer();
+		fastcgiRequest( fd, records );
+		close( fd );
+	}
+	report( "FastCGI, connection each  ", nFastCGIRequests, seconds(start) );
+
+	records = requestRecords( true );
+	int fd = connectServer();
+	start = std::chrono::steady_clock::now();
+	for (int i=0; i<nFastCGIRequests; ++i)
+		fastcgiRequest( fd, records );
+	report( "FastCGI, kept connection  ", nFastCGIRequests, seconds(start) );
+	close( fd );
+
+	server.stop();
+	thread.join();
+	bwverify( server.requests()==2*nFastCGIRequests );
+}
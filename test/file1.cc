@@ -0,0 +1,151 @@
+// Main program to exercise BFile positional and scatter/gather I/O
+//
+
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include <bw/bwassert.h>
+#include <bw/exception.h>
+#include <bw/file.h>
+
+using namespace bw;
+
+const char* fname = "/tmp/bwfile1.dat";
+
+const int nRecords = 1000;
+const int recordSize = 16;
+
+// Record i holds i, then its bytes are derived from i
+static void makeRecord( int i, char* rec )
+{
+	memcpy( rec, &i, sizeof(i) );
+	for (int j=sizeof(i); j<recordSize; ++j)
+		rec[j] = (char)(i*7+j);
+}
+
+int main(int, char**)
+{
+	unlink(fname);
+
+	// 64 bit offsets
+	bwverify( sizeof(BFile::Offset)==8 );
+
+	// Positional writes, out of order
+	{
+		BFile f;
+		f.create(fname);
+		char rec[recordSize];
+		for (int i=nRecords-1; i>=0; --i) {
+			makeRecord(i, rec);
+			f.writeAt(rec, recordSize, (BFile::Offset)i*recordSize);
+		}
+		bwverify( f.tell()==0 );		// Position untouched
+		bwverify( f.seek(0, BFile::fromEnd)==nRecords*recordSize );
+	}
+
+	// Threads share one BFile for positional reads
+	{
+		const BFile f(fname);
+		const int nThreads = 4;
+		std::vector<int> errors(nThreads, 0);
+		std::vector<std::thread> threads;
+		for (int t=0; t<nThreads; ++t) {
+			threads.push_back( std::thread( [&f,&errors,t]() {
+				char rec[recordSize], expected[recordSize];
+				for (int n=0; n<nRecords; ++n) {
+					int i = (n*(t*2+3)) % nRecords;
+					f.readAt(rec, recordSize, (BFile::Offset)i*recordSize);
+					makeRecord(i, expected);
+					if (memcmp(rec, expected, recordSize)!=0)
+						++errors[t];
+				}
+			} ) );
+		}
+		for (int t=0; t<nThreads; ++t) {
+			threads[t].join();
+			bwverify( errors[t]==0 );
+		}
+		bwverify( f.tell()==0 );
+	}
+
+	// End of file
+	{
+		BFile f(fname);
+		char buf[recordSize*2];
+		BFile::Offset last = (BFile::Offset)(nRecords-1)*recordSize;
+		bwverify( f.readUpToAt(buf, sizeof(buf), last)==recordSize );
+		bwverify( f.readUpToAt(buf, sizeof(buf), last+recordSize)==0 );
+		bool isThrown = false;
+		try {
+			f.readAt(buf, sizeof(buf), last);
+		} catch (BFileException&) {
+			isThrown = true;
+		}
+		bwverify( isThrown );
+	}
+
+	// Gather write, scatter read
+	{
+		BFile f;
+		f.create(fname);
+		char head[4] = { 'h', 'e', 'a', 'd' };
+		char body[10000];
+		for (int i=0; i<(int)sizeof(body); ++i)
+			body[i] = (char)i;
+		const char* tail = "tail";
+		struct iovec iov[3];
+		iov[0].iov_base = head;
+		iov[0].iov_len = sizeof(head);
+		iov[1].iov_base = body;
+		iov[1].iov_len = sizeof(body);
+		iov[2].iov_base = (void*)tail;
+		iov[2].iov_len = 4;
+		f.writev(iov, 3);
+		bwverify( f.tell()==4+10000+4 );
+
+		// Only empty buffers, or none, write nothing and succeed
+		struct iovec empty[2];
+		empty[0].iov_base = body;
+		empty[0].iov_len = 0;
+		empty[1] = empty[0];
+		f.writev(empty, 2);
+		f.writev(empty, 0);
+		bwverify( f.tell()==4+10000+4 );
+		f.close();
+
+		f.open(fname);
+		char head2[4], body2[10000], tail2[8];
+		iov[0].iov_base = head2;
+		iov[1].iov_base = body2;
+		iov[2].iov_base = tail2;
+		iov[2].iov_len = sizeof(tail2);
+		bwverify( f.readv(iov, 3)==4+10000+4 );
+		bwverify( f.atEof() );
+		bwverify( memcmp(head, head2, 4)==0 );
+		bwverify( memcmp(body, body2, sizeof(body))==0 );
+		bwverify( memcmp(tail, tail2, 4)==0 );
+	}
+
+	// Offsets past 4GB (sparse, so no disk space is used)
+	{
+		BFile f;
+		f.create(fname);
+		BFile::Offset big = 5LL*1024*1024*1024;
+		f.writeAt("far", 3, big);
+		bwverify( f.seek(0, BFile::fromEnd)==big+3 );
+		f.close();
+
+		BFile f2(fname);
+		char buf[3];
+		f2.readAt(buf, 3, big);
+		bwverify( memcmp(buf, "far", 3)==0 );
+		bwverify( f2.seek(big)==big );
+		bwverify( f2.tell()==big );
+	}
+
+	unlink(fname);
+	return 0;
+}
@@ -0,0 +1,109 @@
+/* BFile benchmark
+
+Copyright (C) 1999-2013 Brian Bray
+
+Times writing and then reading back small fixed size records:
+  - one BFile::write / BFile::read call per field
+  - the same through BFileWriter / BFileReader
+*/
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <unistd.h>
+
+#include <bw/bwassert.h>
+#include <bw/exception.h>
+#include <bw/string.h>
+#include <bw/file.h>
+#include <bw/buffile.h>
+
+using namespace bw;
+using std::cout;
+using std::endl;
+
+const char* fname = "/tmp/bwfilebench.dat";
+const long nRecords = 200000;
+
+// A 16 byte record, written and read as three fields
+struct Record {
+	int	id;
+	int	flags;
+	double	value;
+};
+
+static double seconds( std::chrono::steady_clock::time_point start )
+{
+	return std::chrono::duration<double>( std::chrono::steady_clock::now()-start ).count();
+}
+
+static void report( const char* what, double secs )
+{
+	double mb = nRecords*sizeof(Record) / (1024.0*1024.0);
+	cout << what << ": " << secs*1e9/nRecords << " ns/record, "
+	     << mb/secs << " MB/s" << endl;
+}
+
+int main(int, char**)
+{
+	long sum = 0;
+
+	{
+		BFile f;
+		f.create(fname);
+		auto start = std::chrono::steady_clock::now();
+		for (long i=0; i<nRecords; ++i) {
+			Record rec = { (int)i, 0, i*0.5 };
+			f.write( &rec.id, sizeof(rec.id) );
+			f.write( &rec.flags, sizeof(rec.flags) );
+			f.write( &rec.value, sizeof(rec.value) );
+		}
+		report( "BFile write      ", seconds(start) );
+	}
+	{
+		BFile f(fname);
+		auto start = std::chrono::steady_clock::now();
+		for (long i=0; i<nRecords; ++i) {
+			Record rec;
+			f.read( &rec.id, sizeof(rec.id) );
+			f.read( &rec.flags, sizeof(rec.flags) );
+			f.read( &rec.value, sizeof(rec.value) );
+			sum += rec.id;
+		}
+		report( "BFile read       ", seconds(start) );
+	}
+
+	{
+		BFile f;
+		f.create(fname);
+		auto start = std::chrono::steady_clock::now();
+		{
+			BFileWriter bw(f);
+			for (long i=0; i<nRecords; ++i) {
+				Record rec = { (int)i, 0, i*0.5 };
+				bw.writeValue( rec.id );
+				bw.writeValue( rec.flags );
+				bw.writeValue( rec.value );
+			}
+			bw.flush();
+		}
+		report( "BFileWriter      ", seconds(start) );
+	}
+	{
+		BFile f(fname);
+		auto start = std::chrono::steady_clock::now();
+		BFileReader br(f);
+		for (long i=0; i<nRecords; ++i) {
+			Record rec;
+			br.readValue( rec.id );
+			br.readValue( rec.flags );
+			br.readValue( rec.value );
+			sum += rec.id;
+		}
+		report( "BFileReader      ", seconds(start) );
+	}
+
+	unlink(fname);
+	bwverify( sum==nRecords*(nRecords-1) );
+}
@@ -4,9 +4,16 @@ Copyright (C) 1997-2013, Brian Bray
 
 */
 
+#include <fnmatch.h>
+#include <locale.h>
+#include <limits.h>
+#include <string>
+
 #include "bw/bwassert.h"
+#include "bw/exception.h"
 #include "bw/string.h"
 #include "bw/filename.h"
+#include "bw/pathbuilder.h"
 
 int main(int, char**)
 {
@@ -192,5 +199,126 @@ int main(int, char**)
 	fn18.makeAbsolute();
 	fn20.makeAbsolute();
 
-
+	// Views share the name's characters
+	FileName fn21 = "/usr/src/linux.tar.gz";
+	bwverify( fn21.rootView()=="/" );
+	bwverify( fn21.directoryView()=="usr/src/" );
+	bwverify( fn21.baseNameView()=="linux.tar" );
+	bwverify( fn21.extensionView()==".gz" );
+	bwverify( fn21.relativeNameView()=="linux.tar.gz" );
+	bwverify( fn21.fullNameView()=="/usr/src/linux.tar.gz" );
+	bwverify( fn21.directoryView()!="usr/src" );
+	bwverify( fn21.baseNameView().data()==(const char*)fn21+9 );
+	bwverify( fn21.directoryView().toString()=="usr/src/" );
+	bwverify( FileName("..").baseNameView()==".." );
+	bwverify( FileName("").fullNameView().isEmpty() );
+
+	// append() gives what parsing the whole would
+	FileName fn22 = "/usr";
+	fn22.append( "src/linux.d" );
+	bwverify( fn22.fullName()=="/usr/src/linux.d" );
+	bwverify( fn22.directory()=="usr/src/" );
+	bwverify( fn22.baseName()=="linux" );
+	bwverify( fn22.extension()==".d" );
+	fn22.append( "" );
+	bwverify( fn22.directory()=="usr/src/linux.d/" );
+	bwverify( fn22.relativeName()=="" );
+	FileName fn23;
+	fn23.append( "a/b.c" );
+	bwverify( !fn23.isAbsolute() );
+	bwverify( fn23.directory()=="a/" && fn23.baseName()=="b" );
+
+	// Long names
+	std::string sLong = "/" + std::string( 40000, 'd' ) + "/" + std::string( 20000, 'n' ) + ".x";
+	FileName fn24 = sLong.c_str();
+	bwverify( fn24.directoryView().length()==40001 );
+	bwverify( fn24.baseNameView().length()==20000 );
+	bwverify( fn24.extensionView()==".x" );
+
+	// PathBuilder normalizes as it goes
+	bw::PathBuilder pb( "/var//spool/./in/" );
+	bwverify( std::string(pb)=="/var/spool/in" );
+	bwverify( pb.length()==13 );
+	bwverify( pb.lastComponent()=="in" );
+	pb.append( "../out/x.dat" );
+	bwverify( std::string(pb)=="/var/spool/out/x.dat" );
+	bwverify( pb.pop() );
+	bwverify( std::string(pb)=="/var/spool/out" );
+	pb.append( "../../../../.." );
+	bwverify( std::string(pb)=="/" );
+	bwverify( !pb.pop() );
+	pb.append( fn21.directoryView() );
+	bwverify( std::string(pb)=="/usr/src" );
+	pb.append( "/etc" );
+	bwverify( std::string(pb)=="/etc" && pb.isAbsolute() );
+	bwverify( pb.fileName().baseName()=="etc" );
+
+	bw::PathBuilder pbRel( "a/./b/../.." );
+	bwverify( std::string(pbRel)=="" );
+	pbRel.append( "../../c" );
+	bwverify( std::string(pbRel)=="../../c" );
+	bwverify( pbRel.pop() && pbRel.pop() );
+	bwverify( std::string(pbRel)==".." );
+	pbRel.set( "x" );
+	bwverify( std::string(pbRel)=="x" && !pbRel.isAbsolute() );
+
+	// Overflow leaves the path as it was
+	std::string sPart( PATH_MAX/2, 'p' );
+	bw::PathBuilder pbLong( sPart.c_str() );
+	bool isThrown = false;
+	try {
+		pbLong.append( sPart.c_str() );
+	} catch (bw::BFileException&) {
+		isThrown = true;
+	}
+	bwverify( isThrown );
+	bwverify( std::string(pbLong)==sPart );
+	pbLong.append( ("../" + sPart).c_str() );	// Fits once normalized
+	bwverify( std::string(pbLong)==sPart );
+
+	// FilePatterns whose step operands are '*': an escaped star, and a set
+	// whose last bitmap byte is 0x2A ('\xf9', '\xfb' and '\xfd')
+	using bw::FilePattern;
+	bwverify( !FilePattern("*x\\*").matches("x*b") );
+	bwverify( FilePattern("*x\\*").matches("ax*") );
+	bwverify( FilePattern("?\\**").matches("x*b") );
+	bwverify( FilePattern("?\\**").matches("a*zz") );
+	bwverify( FilePattern("[\xf9\xfb\xfd]*").matches("\xfb!") );
+
+	// And they agree with fnmatch
+	const char* apszPatterns[] = {
+		"*x\\*", "?\\**", "\\**", "*\\*", "x\\*", "a*\\*b", "\\*x*",
+		"[\xf9\xfb\xfd]*", "*[\xf9\xfb\xfd]", "*[*]", "[*]*", "a**", "**a", "a*",
+		"a\\", "\\", "*\\", "a*\\", "[a\\"
+	};
+	const char* apszNames[] = {
+		"x*b", "ax*", "a*zz", "x*", "*", "**", "*x", "a*b", "a**b", "*xyz", "x",
+		"\xfb!", "\xf9", "a\xfd", "a", "ba", "ab", "", "a\\", "\\", "[a\\"
+	};
+	for (size_t i=0; i<sizeof(apszPatterns)/sizeof(apszPatterns[0]); ++i) {
+		FilePattern fp( apszPatterns[i] );
+		for (size_t j=0; j<sizeof(apszNames)/sizeof(apszNames[0]); ++j) {
+			bool expected = fnmatch( apszPatterns[i], apszNames[j], 0 )==0;
+			bwverify( fp.matches(apszNames[j])==expected );
+		}
+	}
+
+	// In a UTF-8 locale ? and [...] match characters rather than bytes
+	if (setlocale( LC_ALL, "C.UTF-8" )) {
+		const char* apszMbPatterns[] = {
+			"?", "a?c", "[\xc3\xa9]x", "[!a]", "??", "*?", "a*"
+		};
+		const char* apszMbNames[] = {
+			"\xc3\xa9", "a\xc3\xa9" "c", "\xc3\xa9x", "a", "ab", "\xc3\xa9\xc3\xa9", "a\xc3\xa9", "\xff"
+		};
+		for (size_t i=0; i<sizeof(apszMbPatterns)/sizeof(apszMbPatterns[0]); ++i) {
+			FilePattern fp( apszMbPatterns[i] );
+			for (size_t j=0; j<sizeof(apszMbNames)/sizeof(apszMbNames[0]); ++j) {
+				bool expected = fnmatch( apszMbPatterns[i], apszMbNames[j], 0 )==0;
+				bwverify( fp.matches(apszMbNames[j])==expected );
+			}
+		}
+		bwverify( FilePattern("?").matches("\xc3\xa9") );
+		setlocale( LC_ALL, "C" );
+	}
 }
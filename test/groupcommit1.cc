@@ -0,0 +1,77 @@
+// Main program to exercise GroupCommit
+//
+
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include <bw/bwassert.h>
+#include <bw/exception.h>
+#include <bw/file.h>
+#include <bw/groupcommit.h>
+
+using namespace bw;
+
+const char* fname = "/tmp/bwgroupcommit1.dat";
+
+const int nThreads = 6;
+const int nCommits = 50;		// Per thread
+const int recordSize = 64;
+
+int main(int, char**)
+{
+	unlink(fname);
+
+	// Plain commit
+	{
+		BFile f;
+		f.create(fname);
+		f.write("x", 1);
+		f.commit();
+	}
+
+	// Many writers, each committing every record
+	{
+		BFile f;
+		f.create(fname);
+		GroupCommit gc(f);
+		std::atomic<long> nextRecord(0);
+		std::vector<std::thread> threads;
+		for (int t=0; t<nThreads; ++t) {
+			threads.push_back( std::thread( [&f,&gc,&nextRecord,t]() {
+				char rec[recordSize];
+				memset(rec, 'a'+t, recordSize);
+				for (int i=0; i<nCommits; ++i) {
+					long n = nextRecord++;
+					f.writeAt(rec, recordSize, (BFile::Offset)n*recordSize);
+					gc.commit();
+				}
+			} ) );
+		}
+		for (int t=0; t<nThreads; ++t)
+			threads[t].join();
+
+		bwverify( gc.commits()==(unsigned long long)nThreads*nCommits );
+		bwverify( gc.flushes()>0 && gc.flushes()<=gc.commits() );
+		bwverify( f.seek(0, BFile::fromEnd)==(BFile::Offset)nThreads*nCommits*recordSize );
+	}
+
+	// A single caller still gets a flush per commit
+	{
+		BFile f;
+		f.create(fname);
+		GroupCommit gc(f, GroupCommit::FileSystem);
+		for (int i=0; i<3; ++i) {
+			f.write("y", 1);
+			gc.commit();
+		}
+		bwverify( gc.commits()==3 && gc.flushes()==3 );
+	}
+
+	unlink(fname);
+	return 0;
+}
@@ -0,0 +1,122 @@
+// Main program to excercise String hashing and StringMap
+//
+
+#include <cstring>
+#include <functional>
+#include <new>
+#include <sstream>
+#include <thread>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+
+#include <bw/bwassert.h>
+#include <bw/string.h>
+#include <bw/ustring.h>
+#include <bw/hashmap.h>
+
+using namespace bw;
+
+static String keyname( int i )
+{
+	std::ostringstream ost;
+	ost << "key" << i;
+	return ost.str().c_str();
+}
+
+int main(int, char**)
+{
+	// Hashes depend only on contents and follow changes
+	String s1 = "abc";
+	String s2 = "ab";
+	bwverify( s1.hash()!=0 );
+	bwverify( s1.hash()!=s2.hash() );
+	s2 += 'c';
+	bwverify( s1.hash()==s2.hash() );
+	s2[0] = 'x';
+	bwverify( s1.hash()!=s2.hash() );
+	s2 = s1;
+	bwverify( s1.hash()==s2.hash() );
+	bwverify( s1.hash()==hashBytes("abc",3) );
+
+	// A character reference may be written after hash()
+	String s3 = "abd";
+	char& ch = s3[2];
+	bwverify( s3.hash()!=s1.hash() );
+	ch = 'c';
+	bwverify( s3.hash()==s1.hash() );
+	s3 = s1;
+	ch = 'x';
+	bwverify( s3.hash()==hashBytes("abx",3) );
+	UString u3 = L"abd";
+	wchar_t& wch = u3[2];
+	bwverify( u3.hash()!=UString(L"abc").hash() );
+	wch = L'c';
+	bwverify( u3.hash()==UString(L"abc").hash() );
+
+	// Threads may hash a shared const String
+	const String shared( "shared key" );
+	unsigned long hThread = 0;
+	std::thread t( [&]() { hThread = shared.hash(); } );
+	unsigned long hMain = shared.hash();
+	t.join();
+	bwverify( hThread==hMain && hMain==hashBytes("shared key",10) );
+	bwverify( UString(L"abc").hash()==UString(L"abc").hash() );
+	bwverify( UString(L"abc").hash()!=UString(L"abd").hash() );
+
+	std::unordered_set<String> uset;
+	uset.insert( "one" );
+	uset.insert( String("one") );
+	bwverify( uset.size()==1 );
+
+	// Keys can't be changed in place, where they'd no longer match their slot
+	static_assert( std::is_const<StringMap<int>::value_type::first_type>::value, "StringMap keys are const" );
+
+	// Map operations
+	StringMap<int> map;
+	bwverify( map.empty() );
+	bwverify( map.find("none")==map.end() );
+
+	const int n = 1000;
+	for (int i=0; i<n; ++i)
+		map[keyname(i)] = i;
+	bwverify( map.size()==n );
+	for (int i=0; i<n; ++i) {
+		StringMap<int>::iterator it = map.find( keyname(i) );
+		bwverify( it!=map.end() );
+		bwverify( (*it).second==i );
+	}
+	bwverify( map.find("key17")!=map.end() );
+
+	// Erase every third key and check the rest are still reachable
+	for (int i=0; i<n; i+=3)
+		bwverify( map.erase( keyname(i) ) );
+	bwverify( !map.erase( "key0" ) );
+	for (int i=0; i<n; ++i)
+		bwverify( (map.find( keyname(i) )==map.end()) == (i%3==0) );
+
+	int count = 0;
+	long sum = 0;
+	for (StringMap<int>::const_iterator it=map.begin(); it!=map.end(); ++it) {
+		++count;
+		sum += it->second;
+	}
+	bwverify( count==map.size() );
+	bwverify( sum==(long)n*(n-1)/2 - 3L*333*334/2 );
+
+	// Copies are independent
+	StringMap<int> map2 = map;
+	map2["key1"] = -1;
+	bwverify( map["key1"]==1 );
+	bwverify( map2["key1"]==-1 );
+	map.clear();
+	bwverify( map.empty() );
+	bwverify( map2.size()==count );
+
+	// Nested maps
+	StringMap< StringMap<String> > nest;
+	for (int i=0; i<50; ++i)
+		nest[keyname(i%7)][keyname(i)] = keyname(-i);
+	bwverify( nest.size()==7 );
+	bwverify( nest["key3"]["key10"]=="key-10" );
+}
@@ -0,0 +1,79 @@
+// Main program to exercise the html manipulators
+//
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string.h>
+
+#include "bw/bwassert.h"
+#include "bw/string.h"
+#include "bw/html.h"
+
+using namespace bw;
+
+// What a manipulator writes to a stream
+static std::string streamed( const html::Emit& e )
+{
+	std::ostringstream os;
+	os << e;
+	return os.str();
+}
+
+// Streamed and converted to a String, the same text
+static bool writes( const html::Emit& e, const char* psz )
+{
+	String s = e;
+	return streamed( e )==psz && s==psz;
+}
+
+int main(int, char**)
+{
+	bwverify( writes( html::httpProlog( "text/html" ), "Content-type: text/html\n\n" ) );
+	std::string prolog = streamed( html::prolog( "Title", "gen" ) );
+	bwverify( prolog.compare( 0, 16, "<!DOCTYPE html>\n" )==0 );
+	bwverify( prolog.find( "<TITLE>Title</TITLE>\n<META name=\"GENERATOR\" content=\"gen\">" )!=std::string::npos );
+	bwverify( prolog.find( "content=\"bw\"" )==std::string::npos );
+	bwverify( streamed( html::prolog( "T" ) ).find( "content=\"bw\"" )!=std::string::npos );
+
+	bwverify( writes( html::heading1( "One" ), "<H1>One</H1>\n" ) );
+	bwverify( writes( html::heading4( String("Four") ), "<H4>Four</H4>\n" ) );
+	bwverify( writes( html::beginTable( 3 ), "<TABLE COLS=03>\n" ) );
+	bwverify( writes( html::beginTable( 42 ), "<TABLE COLS=42>\n" ) );
+	bwverify( writes( html::definition( "Item" ), "<DT>Item\n<DD>" ) );
+	bwverify( writes( html::beginLink( "http://x/?a=1&b=2" ), "<A HREF=\"http://x/?a=1&b=2\">" ) );
+	bwverify( writes( html::beginLink2Link( "top" ), "<A HREF=\"#top\">" ) );
+	bwverify( writes( html::defineLink( "top" ), "<A NAME=\"top\"></A>\n" ) );
+
+	// Escaping, in short and long runs
+	bwverify( writes( html::literal( "a <b> & \"c\"\nline2\n" ), "a &lt;b> &amp; &quot;c&quot;\nline2\n" ) );
+	bwverify( writes( html::literal( "a <b> & \"c\"\nline2\n", true ), "a &lt;b> &amp; &quot;c&quot;\n<br>line2\n<br>" ) );
+	bwverify( writes( html::literal( "plain text that is longer than sixteen chars, then <tag> and more & more \"quotes\" at the end<" ),
+	                  "plain text that is longer than sixteen chars, then &lt;tag> and more &amp; more &quot;quotes&quot; at the end&lt;" ) );
+	bwverify( writes( html::literal( "" ), "" ) );
+	std::string longText( 1000, 'x' );
+	longText[999] = '&';
+	longText[16] = '"';
+	std::string out = streamed( html::literal( StringView( longText.data(), longText.size() ) ) );
+	bwverify( out.size()==1000+5+4 );
+	bwverify( out.compare( 16, 6, "&quot;" )==0 && out.compare( out.size()-5, 5, "&amp;" )==0 );
+
+	// Paragraphs at blank lines
+	bwverify( writes( html::smartFormat( "a\n\nb" ), "a\n<P>\nb" ) );
+	bwverify( writes( html::smartFormat( "a\n\n\nb\nc\n\n" ), "a\n<P>\n<P>\nb\nc\n<P>\n" ) );
+	bwverify( writes( html::smartFormat( "no breaks\nhere" ), "no breaks\nhere" ) );
+	bwverify( writes( html::smartFormat( "\n\nx <y>" ), "\n<P>\nx <y>" ) );
+
+	// Simple manipulators, mixed with the others
+	std::ostringstream os;
+	os << html::beginRow << html::beginCell << html::literal( "1<2" ) << html::nextCell
+	   << html::boldOn << 42 << html::boldOff << html::endCell << html::endRow;
+	bwverify( os.str()=="<TR>\n<TD>\n1&lt;2</TD><TD>\n<B>42</B></TD>\n</TR>\n" );
+
+	// Building text up first
+	String s = "<P>" + String( html::literal( "<" ) );
+	bwverify( s=="<P>&lt;" );
+
+	return 0;
+}
@@ -0,0 +1,112 @@
+/* html manipulator benchmark
+
+Copyright (C) 1999-2013 Brian Bray
+
+Times writing a page with a 10,000 row table, with headings, links and
+literal text (a few cells need escaping), to an ostringstream:
+  - with the html manipulators
+  - with the same page as a Template
+*/
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <bw/bwassert.h>
+#include <bw/string.h>
+#include <bw/html.h>
+#include <bw/template.h>
+
+using namespace bw;
+using std::cout;
+using std::endl;
+
+const int nRows = 10000;
+const int nPages = 20;
+
+struct Row {
+	String	name;
+	String	url;
+	String	description;
+};
+
+static double seconds( std::chrono::steady_clock::time_point start )
+{
+	return std::chrono::duration<double>( std::chrono::steady_clock::now()-start ).count();
+}
+
+static void page( std::ostream& os, const std::vector<Row>& rows )
+{
+	os << html::prolog( "Table benchmark" );
+	os << html::heading1( "Ten thousand rows" );
+	os << html::beginTable( 3 );
+	for (size_t i=0; i<rows.size(); ++i) {
+		const Row& r = rows[i];
+		os << html::beginRow << html::beginCell;
+		os << html::beginLink( r.url ) << html::literal( r.name ) << html::endLink;
+		os << html::nextCell << html::literal( r.description );
+		os << html::nextCell << html::smartFormat( "Line one\n\nLine two" );
+		os << html::endCell << html::endRow;
+	}
+	os << html::endTable << html::epilog;
+}
+
+const char* pageTemplate =
+	"<!DOCTYPE html>\n<HTML>\n<HEAD>\n<TITLE>{{title}}</TITLE>\n</HEAD>\n<BODY BGCOLOR=white>\n"
+	"<H1>Ten thousand rows</H1>\n<TABLE COLS=03>\n"
+	"{{#rows}}<TR>\n<TD>\n<A HREF=\"{{url}}\">{{name}}</A>\n</TD><TD>\n{{description}}</TD><TD>\n"
+	"Line one\n<P>\nLine two</TD>\n</TR>\n{{/rows}}"
+	"</TABLE>\n</BODY>\n</HTML>\n";
+
+static void report( const char* what, size_t nBytes, double secs )
+{
+	cout << what << ": " << secs/nPages*1000 << " ms, "
+	     << (long)(nBytes/secs/1000000) << " MB/s" << endl;
+}
+
+int main(int, char**)
+{
+	std::vector<Row> rows( nRows );
+	for (int i=0; i<nRows; ++i) {
+		std::string n = std::to_string( i );
+		rows[i].name = ("Item number " + n).c_str();
+		rows[i].url = ("/items/" + n + "?view=full").c_str();
+		if (i%10==0)
+			rows[i].description = ("A \"special\" <item> & its notes, number " + n).c_str();
+		else
+			rows[i].description = ("An ordinary item with a longer plain description, number " + n).c_str();
+	}
+
+	std::ostringstream os;
+	size_t nBytes = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int i=0; i<nPages; ++i) {
+		os.str( "" );
+		page( os, rows );
+		nBytes += os.str().size();
+	}
+	report( "10,000 row table, manipulators", nBytes, seconds(start) );
+
+	TemplateData data;
+	data.set( "title", "Table benchmark" );
+	for (int i=0; i<nRows; ++i) {
+		TemplateData& row = data.add( "rows" );
+		row.set( "name", rows[i].name );
+		row.set( "url", rows[i].url );
+		row.set( "description", rows[i].description );
+	}
+	Template t( StringView( pageTemplate, strlen(pageTemplate) ) );
+	nBytes = 0;
+	start = std::chrono::steady_clock::now();
+	for (int i=0; i<nPages; ++i) {
+		os.str( "" );
+		t.render( os, data );
+		nBytes += os.str().size();
+	}
+	report( "10,000 row table, template    ", nBytes, seconds(start) );
+}
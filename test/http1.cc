@@ -0,0 +1,189 @@
+// Main program to exercise the form data decoder
+//
+
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bw/bwassert.h"
+#include "bw/exception.h"
+#include "bw/string.h"
+#include "bw/http.h"
+
+using namespace bw;
+
+static StringView view( const char* psz )
+{
+	return StringView( psz, strlen(psz) );
+}
+
+static bool isBad( const char* psz )
+{
+	try {
+		parseHTTPData( view(psz) );
+	} catch (BFormatException&) {
+		return true;
+	}
+	return false;
+}
+
+int main(int, char**)
+{
+	// Without escapes the input comes back
+	std::string buf;
+	const char* psz = "plain-value.txt";
+	StringView v = decodeURLComponent( view(psz), buf );
+	bwverify( v.data()==psz && v.length()==15 );
+	bwverify( buf.empty() );
+
+	// Escapes, in either case, and '+'
+	v = decodeURLComponent( view("two+words%20and%2fa%2Fslash%7e"), buf );
+	bwverify( v=="two words and/a/slash~" );
+	bwverify( v.data()==buf.data() );
+	v = decodeURLComponent( view("%41"), buf );
+	bwverify( v=="A" );
+	v = decodeURLComponent( view("%C3%A9t%C3%A9"), buf );
+	bwverify( v=="\xC3\xA9t\xC3\xA9" );
+
+	// Pairs, in order, with views into the data where possible
+	const char* pszData = "a=1&b=two+words&&=empty&c&d=&a=2";
+	std::vector<std::string> pairs;
+	bool isAView = false;
+	parseHTTPData( view(pszData), [&]( StringView key, StringView value ) {
+		pairs.push_back( key.toString().c_str() + std::string("|") + value.toString().c_str() );
+		if (key=="a" && value=="1")
+			isAView = key.data()==pszData && value.data()==pszData+2;
+	} );
+	bwverify( isAView );
+	bwverify( pairs.size()==5 );
+	bwverify( pairs[0]=="a|1" && pairs[1]=="b|two words" && pairs[2]=="c|" && pairs[3]=="d|" && pairs[4]=="a|2" );
+
+	// As a map, the last of a repeated key wins
+	std::map< String, String > form = parseHTTPData( view(pszData) );
+	bwverify( form.size()==4 );
+	bwverify( form["a"]=="2" && form["b"]=="two words" && form["c"]=="" );
+	bwverify( parseHTTPData( view("") ).empty() );
+
+	// From a stream
+	std::istringstream is( "name=Brian+Bray&x=%3D%26" );
+	form = parseHTTPData( is );
+	bwverify( form.size()==2 && form["name"]=="Brian Bray" && form["x"]=="=&" );
+
+	// Bad escapes and NULs
+	bwverify( isBad( "a=%4" ) );
+	bwverify( isBad( "a=%" ) );
+	bwverify( isBad( "a=%zz" ) );
+	bwverify( isBad( "a%g1=1" ) );
+	bwverify( isBad( "a=%00" ) );
+	std::string withNul( "a=b\0c", 5 );
+	try {
+		parseHTTPData( StringView( withNul.data(), withNul.size() ) );
+		bwverify( false );
+	} catch (BFormatException&) {
+	}
+
+	// Many parameters
+	std::string data;
+	for (int i=0; i<5000; ++i)
+		data += "&field" + std::to_string(i) + "=" + (i%2 ? "v%21" : "v");
+	form = parseHTTPData( StringView( data.data(), data.size() ) );
+	bwverify( form.size()==5000 );
+	bwverify( form["field0"]=="v" && form["field4999"]=="v!" );
+
+	// FormParams: lookups, repeated keys and typed values
+	const char* pszQuery = "tag=a&n=-42&x=2.5&tag=b+c&on=Yes&off=0&%74ag=d&empty=&bad=12z&big=99999999999999999999";
+	FormParams params( view(pszQuery) );
+	bwverify( params.size()==10 );
+	bwverify( params.has( "n" ) && !params.has( "missing" ) && !params.has( "ta" ) );
+	bwverify( params.get( "tag" )=="a" );
+	bwverify( params.get( "missing", "default" )=="default" );
+	std::vector< String > tags = params.getAll( "tag" );
+	bwverify( tags.size()==3 && tags[0]=="a" && tags[1]=="b c" && tags[2]=="d" );
+	bwverify( params.getAll( "missing" ).empty() );
+	bwverify( params.getLong( "n" )==-42 );
+	bwverify( params.getLong( "empty", 7 )==7 && params.getLong( "missing", 8 )==8 );
+	bwverify( params.getDouble( "x" )==2.5 );
+	bwverify( params.getBool( "on" ) && !params.getBool( "off", true ) && params.getBool( "missing", true ) );
+	bool isThrown = false;
+	try {
+		params.getLong( "bad" );
+	} catch (BFormatException&) {
+		isThrown = true;
+	}
+	bwverify( isThrown );
+	isThrown = false;
+	try {
+		params.getLong( "big" );
+	} catch (BFormatException&) {
+		isThrown = true;
+	}
+	bwverify( isThrown );
+	isThrown = false;
+	try {
+		params.getBool( "x" );
+	} catch (BFormatException&) {
+		isThrown = true;
+	}
+	bwverify( isThrown );
+	bwverify( params.key( 6 )=="tag" && params.value( 3 )=="b c" );
+
+	// Views where there's nothing to decode
+	v = params.getView( "n", buf );
+	bwverify( v=="-42" && v.data()==pszQuery+8 );
+	v = params.getView( "missing", buf );
+	bwverify( v.isEmpty() );
+
+	// Only the pairs looked at are decoded
+	FormParams partly( view("a=1&b=%zz") );
+	bwverify( partly.get( "a" )=="1" );
+	isThrown = false;
+	try {
+		partly.get( "b" );
+	} catch (BFormatException&) {
+		isThrown = true;
+	}
+	bwverify( isThrown );
+	FormParams fromStream( is );
+	bwverify( fromStream.size()==0 );
+	std::istringstream is2( "k=v%21&k=w" );
+	FormParams owned( is2 );
+	FormParams copy( owned );
+	bwverify( copy.getAll( "k" ).size()==2 && copy.get( "k" )=="v!" );
+	std::map< String, String > m = copy.toMap();
+	bwverify( m.size()==1 && m["k"]=="w" );
+
+	// Multipart uploads come back in memory, leaving nothing in TMPDIR
+	{
+		std::string dir = "/tmp/bwhttp1";
+		bwverify( system(("rm -rf " + dir + " && mkdir " + dir).c_str())==0 );
+		setenv( "TMPDIR", dir.c_str(), 1 );
+		const char* pszType = "multipart/form-data; boundary=XyZ";
+		std::string head = "--XyZ\r\nContent-Disposition: form-data; name=\"upload\"; filename=\"a.txt\"\r\n\r\n";
+		std::string body = "--XyZ\r\nContent-Disposition: form-data; name=\"title\"\r\n\r\nHello\r\n" +
+		                   head + "line 1\r\nline 2\r\n--XyZ--\r\n";
+		std::istringstream is( body );
+		std::map< String, String > m = parseMultiData( is, pszType );
+		bwverify( m.size()==3 );
+		bwverify( m["title"]=="Hello" );
+		bwverify( m["upload"]=="line 1\r\nline 2" );
+		bwverify( m["upload_name"]=="a.txt" );
+
+		std::istringstream isBig( head + std::string( 70000, 'x' ) + "\r\n--XyZ--\r\n" );
+		bool isThrown = false;
+		try {
+			parseMultiData( isBig, pszType );
+		} catch (BFormatException&) {
+			isThrown = true;
+		}
+		bwverify( isThrown );
+		bwverify( rmdir(dir.c_str())==0 );	// Empty
+	}
+
+	return 0;
+}
@@ -0,0 +1,150 @@
+/* HTTP server benchmark
+
+Copyright (C) 1999-2013 Brian Bray
+
+A handler like fcgibench's (read two query parameters, write a small page)
+served by HTTPServer on loopback, to clients that:
+  - open a connection per request
+  - keep one connection alive, a request at a time
+  - keep one connection alive and pipeline requests, 16 deep
+  - do the same on 4 connections at once
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include <bw/bwassert.h>
+#include <bw/exception.h>
+#include <bw/string.h>
+#include <bw/http.h>
+#include <bw/httpserver.h>
+
+using namespace bw;
+using std::cout;
+using std::endl;
+
+const char* request = "GET /page?name=Brian&item=42&colour=dark+blue&sort=asc&page=3 HTTP/1.1\r\n"
+                      "Host: localhost\r\nUser-Agent: httpbench\r\nAccept: */*\r\n\r\n";
+const int nRequests = 100000;
+const int nDepth = 16;
+const int nClients = 4;
+
+static void handler( const HTTPRequest& req, HTTPResponse& resp )
+{
+	FormParams params = req.params();
+	resp.addHeader( "Content-Type", "text/html" );
+	resp.out() << "<html><body><p>Hello " << params.get( "name" )
+	           << ", item " << params.getLong( "item" ) << "</p></body></html>\n";
+}
+
+static double seconds( std::chrono::steady_clock::time_point start )
+{
+	return std::chrono::duration<double>( std::chrono::steady_clock::now()-start ).count();
+}
+
+static void report( const char* what, int n, double secs )
+{
+	cout << what << ": " << (long)(n/secs) << " requests/s" << endl;
+}
+
+static int connectServer( int nPort )
+{
+	int fd = socket( AF_INET, SOCK_STREAM, 0 );
+	struct sockaddr_in addr;
+	memset( &addr, 0, sizeof(addr) );
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons( nPort );
+	addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+	bwverify( connect(fd, (struct sockaddr*)&addr, sizeof(addr))==0 );
+	int on = 1;
+	setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on) );
+	return fd;
+}
+
+// Reads until n whole responses are in; they all have the same length
+static void readResponses( int fd, int n, std::string& in )
+{
+	size_t nResponse = 0;
+	for (;;) {
+		if (nResponse==0) {
+			size_t pos = in.find( "\r\n\r\n" );
+			size_t posLength = in.find( "Content-Length: " );
+			if (pos!=std::string::npos && posLength<pos)
+				nResponse = pos+4+atol( in.c_str()+posLength+16 );
+		}
+		if (nResponse>0 && in.size()>=n*nResponse) {
+			in.erase( 0, n*nResponse );
+			return;
+		}
+		char buf[65536];
+		ssize_t len = read( fd, buf, sizeof(buf) );
+		bwverify( len>0 );
+		in.append( buf, len );
+	}
+}
+
+// Sends nTotal requests on one connection, nDepth at a time
+static void client( int nPort, int nTotal, int nAtOnce )
+{
+	int fd = connectServer( nPort );
+	std::string batch;
+	for (int i=0; i<nAtOnce; ++i)
+		batch += request;
+	std::string in;
+	for (int i=0; i<nTotal; i+=nAtOnce) {
+		bwverify( write(fd, batch.data(), batch.size())==(ssize_t)batch.size() );
+		readResponses( fd, nAtOnce, in );
+	}
+	close( fd );
+}
+
+int main(int, char**)
+{
+	HTTPServer server( "127.0.0.1:0" );
+	std::thread thread( [&server]() {
+		server.run( handler );
+	} );
+
+	auto start = std::chrono::steady_clock::now();
+	std::string in;
+	for (int i=0; i<nRequests/10; ++i) {
+		int fd = connectServer( server.port() );
+		bwverify( write(fd, request, strlen(request))==(ssize_t)strlen(request) );
+		readResponses( fd, 1, in );
+		close( fd );
+	}
+	report( "Connection each           ", nRequests/10, seconds(start) );
+
+	start = std::chrono::steady_clock::now();
+	client( server.port(), nRequests, 1 );
+	report( "Kept alive                ", nRequests, seconds(start) );
+
+	start = std::chrono::steady_clock::now();
+	client( server.port(), nRequests, nDepth );
+	report( "Kept alive, pipelined     ", nRequests, seconds(start) );
+
+	start = std::chrono::steady_clock::now();
+	std::vector<std::thread> clients;
+	for (int i=0; i<nClients; ++i)
+		clients.push_back( std::thread( client, server.port(), nRequests, nDepth ) );
+	for (int i=0; i<nClients; ++i)
+		clients[i].join();
+	report( "4 connections, pipelined  ", nClients*nRequests, seconds(start) );
+
+	server.stop();
+	thread.join();
+	bwverify( server.requests()==(unsigned long long)(nRequests/10+2*nRequests+nClients*nRequests) );
+}
@@ -0,0 +1,321 @@
+// Main program to exercise HTTPServer, with a small HTTP client
+//
+
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "bw/bwassert.h"
+#include "bw/exception.h"
+#include "bw/string.h"
+#include "bw/http.h"
+#include "bw/httpserver.h"
+
+using namespace bw;
+
+class Client {
+public:
+	Client( int nPort ) {
+		m_fd = socket( AF_INET, SOCK_STREAM, 0 );
+		bwverify( m_fd>=0 );
+		struct sockaddr_in addr;
+		memset( &addr, 0, sizeof(addr) );
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons( nPort );
+		addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+		bwverify( connect(m_fd, (struct sockaddr*)&addr, sizeof(addr))==0 );
+	}
+	~Client() {
+		close( m_fd );
+	}
+
+	void send( const std::string& s ) {
+		bwverify( write(m_fd, s.data(), s.size())==(ssize_t)s.size() );
+	}
+
+	// Sends, returning false once the server has closed the connection
+	bool trySend( const std::string& s ) {
+		return ::send( m_fd, s.data(), s.size(), MSG_NOSIGNAL )==(ssize_t)s.size();
+	}
+
+	// Reads one response; returns its status, or 0 at end of file
+	int response( std::string& headers, std::string& body, bool isHead=false ) {
+		size_t pos;
+		while ((pos = m_in.find( "\r\n\r\n" ))==std::string::npos) {
+			if (!fill())
+				return 0;
+		}
+		headers = m_in.substr( 0, pos+2 );
+		m_in.erase( 0, pos+4 );
+		size_t len = 0;
+		size_t posLength = headers.find( "Content-Length: " );
+		if (posLength!=std::string::npos && !isHead)
+			len = atol( headers.c_str()+posLength+16 );
+		while (m_in.size()<len)
+			bwverify( fill() );
+		body = m_in.substr( 0, len );
+		m_in.erase( 0, len );
+		return atoi( headers.c_str()+9 );
+	}
+
+	bool isClosed() {
+		return m_in.empty() && !fill();
+	}
+
+private:
+	bool fill() {
+		char buf[65536];
+		ssize_t n = read( m_fd, buf, sizeof(buf) );
+		if (n<=0)
+			return false;
+		m_in.append( buf, n );
+		return true;
+	}
+
+	int		m_fd;
+	std::string	m_in;
+};
+
+int main(int, char**)
+{
+	HTTPServer server( "127.0.0.1:0" );
+	bwverify( server.port()>0 );
+	int nCalls = 0;
+	std::thread thread( [&]() {
+		server.run( [&]( const HTTPRequest& req, HTTPResponse& resp ) {
+			++nCalls;
+			std::map< String, String > form = req.form();
+			if (form.count("fail"))
+				throw BFormatException( "Asked to fail" );
+			if (req.path()=="/multi") {
+				FormParams params = req.params();
+				resp.out() << params.getAll( "t" ).size() << "|" << params.getLong( "n" );
+				return;
+			}
+			if (req.path()=="/missing") {
+				resp.setStatus( 404 );
+				resp.out() << "No such page";
+				return;
+			}
+			if (form.count("big")) {
+				std::string big( 1000000, 'b' );
+				resp.write( big.data(), big.size() );
+				return;
+			}
+			resp.addHeader( "Content-Type", "text/plain" );
+			StringView agent = req.header( "user-agent" );
+			resp.out() << req.method().toString() << " " << req.path().toString()
+			           << " " << agent.toString() << "|" << form.size();
+			for (std::map< String, String >::iterator it=form.begin(); it!=form.end(); ++it)
+				resp.out() << "|" << it->first << "=" << it->second;
+		} );
+	} );
+
+	std::string headers;
+	std::string body;
+
+	// GET, then a POST, on one connection
+	{
+		Client c( server.port() );
+		c.send( "GET /form?a=1&b=two+words HTTP/1.1\r\nHost: x\r\nUser-Agent:  bwtest \r\n\r\n" );
+		bwverify( c.response( headers, body )==200 );
+		bwverify( body=="GET /form bwtest|2|a=1|b=two words" );
+		bwverify( headers.compare( 0, 17, "HTTP/1.1 200 OK\r\n" )==0 );
+		bwverify( headers.find( "\r\nDate: " )!=std::string::npos );
+		bwverify( headers.find( "Content-Type: text/plain\r\n" )!=std::string::npos );
+		bwverify( headers.find( "Connection:" )==std::string::npos );
+
+		std::string post = "x=" + std::string(50000, 'x') + "&y=%41";
+		c.send( "POST /p?q=ignored HTTP/1.1\r\nContent-Type: application/x-www-form-urlencoded\r\n"
+		        "Content-Length: " + std::to_string( post.size() ) + "\r\n\r\n" );
+		c.send( post.substr( 0, 1000 ) );
+		usleep( 10000 );
+		c.send( post.substr( 1000 ) );
+		bwverify( c.response( headers, body )==200 );
+		bwverify( body.size()==strlen("POST /p |2|x=|y=A")+50000 );
+		bwverify( body.compare( body.size()-4, 4, "|y=A" )==0 );
+
+		c.send( "GET /multi?t=1&n=12&t=2&t=3 HTTP/1.1\r\n\r\n" );
+		bwverify( c.response( headers, body )==200 && body=="3|12" );
+
+		c.send( "GET /missing HTTP/1.1\r\n\r\n" );
+		bwverify( c.response( headers, body )==404 );
+		bwverify( headers.compare( 0, 24, "HTTP/1.1 404 Not Found\r\n" )==0 && body=="No such page" );
+
+		// A handler that throws; the connection carries on
+		c.send( "GET /?fail=1 HTTP/1.1\r\n\r\n" );
+		bwverify( c.response( headers, body )==500 );
+		bwverify( body=="Asked to fail" );
+		c.send( "HEAD /h HTTP/1.1\r\n\r\n" );
+		bwverify( c.response( headers, body, true )==200 );
+		bwverify( headers.find( "Content-Length: 10\r\n" )!=std::string::npos && body=="" );
+	}
+
+	// Pipelined requests, in one write, answered in order; a big answer
+	// in the middle backs the output up
+	{
+		Client c( server.port() );
+		std::string requests;
+		for (int i=0; i<20; ++i)
+			requests += "GET /" + std::to_string(i) + (i==5 ? "?big=1" : "") + " HTTP/1.1\r\n\r\n";
+		c.send( requests );
+		for (int i=0; i<20; ++i) {
+			bwverify( c.response( headers, body )==200 );
+			if (i==5) {
+				bwverify( body.size()==1000000 );
+			} else {
+				bwverify( body=="GET /" + std::to_string(i) + " |0" );
+			}
+		}
+	}
+
+	// HTTP/1.0 closes unless asked to keep alive; Connection: close is honoured
+	{
+		Client c( server.port() );
+		c.send( "GET /a HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\nGET /b HTTP/1.0\r\n\r\nGET /c HTTP/1.0\r\n\r\n" );
+		bwverify( c.response( headers, body )==200 && body=="GET /a |0" );
+		bwverify( headers.find( "Connection: keep-alive\r\n" )!=std::string::npos );
+		bwverify( c.response( headers, body )==200 && body=="GET /b |0" );
+		bwverify( headers.find( "Connection: close\r\n" )!=std::string::npos );
+		bwverify( c.isClosed() );
+	}
+	{
+		Client c( server.port() );
+		c.send( "GET /a HTTP/1.1\r\nConnection: close\r\n\r\n" );
+		bwverify( c.response( headers, body )==200 );
+		bwverify( c.isClosed() );
+	}
+
+	// Errors end the connection
+	const char* aBad[] = {
+		"GARBAGE\r\n\r\n",
+		"GET / HTTP/2.0\r\n\r\n",
+		"GET / HTTP/1.1\r\nNo colon\r\n\r\n",
+		"GET / HTTP/1.1\r\nContent-Length: 12x\r\n\r\n",
+	};
+	for (size_t i=0; i<sizeof(aBad)/sizeof(aBad[0]); ++i) {
+		Client c( server.port() );
+		c.send( aBad[i] );
+		bwverify( c.response( headers, body )==400 );
+		bwverify( c.isClosed() );
+	}
+	{
+		Client c( server.port() );
+		c.send( "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n" );
+		bwverify( c.response( headers, body )==501 );
+	}
+	{
+		Client c( server.port() );
+		c.send( "POST / HTTP/1.1\r\nContent-Length: 99999999\r\n\r\n" );
+		bwverify( c.response( headers, body )==413 );
+	}
+	{
+		Client c( server.port() );
+		c.send( "GET / HTTP/1.1\r\nX-Big: " + std::string( 20000, 'h' ) );
+		bwverify( c.response( headers, body )==431 );
+	}
+	{
+		// A good request before a bad one is still answered
+		Client c( server.port() );
+		c.send( "GET /ok HTTP/1.1\r\n\r\nBAD\r\n\r\n" );
+		bwverify( c.response( headers, body )==200 && body=="GET /ok |0" );
+		bwverify( c.response( headers, body )==400 );
+		bwverify( c.isClosed() );
+	}
+
+	server.stop();
+	thread.join();
+	bwverify( nCalls==30 );
+	bwverify( server.requests()==30 );
+
+	HTTPServer::Handler hello = []( const HTTPRequest&, HTTPResponse& resp ) {
+		resp.out() << "hello";
+	};
+
+	// A stop() before run() isn't lost
+	{
+		HTTPServer early( "127.0.0.1:0" );
+		early.stop();
+		std::atomic<bool> isReturned( false );
+		std::thread t( [&]() {
+			early.run( hello );
+			isReturned = true;
+		} );
+		for (int i=0; i<200 && !isReturned; ++i)
+			usleep( 10000 );
+		bwverify( isReturned );
+		if (!isReturned)
+			early.stop();
+		t.join();
+	}
+
+	// Idle connections, slowly sent requests and idle keep-alives are closed
+	{
+		HTTPServer timed( "127.0.0.1:0" );
+		timed.setTimeouts( 300, 300 );
+		std::thread t( [&]() { timed.run( hello ); } );
+		Client idle( timed.port() );
+		Client slow( timed.port() );
+		Client kept( timed.port() );
+		kept.send( "GET / HTTP/1.1\r\n\r\n" );
+		bwverify( kept.response( headers, body )==200 && body=="hello" );
+		const char* pszSlow = "GET / HTTP/1.1\r\nX-Slow: 12345678901234567890\r\n\r\n";
+		bool isCut = false;
+		for (int i=0; i<30 && !isCut; ++i) {
+			isCut = !slow.trySend( std::string( pszSlow+i, 1 ) );	// Progress, but too slowly
+			usleep( 50000 );
+		}
+		bwverify( isCut );
+		bwverify( slow.isClosed() );
+		bwverify( idle.isClosed() );
+		bwverify( kept.isClosed() );
+		timed.stop();
+		t.join();
+	}
+
+	// Out of descriptors, the server waits for one to be freed without
+	// spinning, and then accepts the waiting client
+	{
+		HTTPServer limited( "127.0.0.1:0" );
+		std::thread t( [&]() { limited.run( hello ); } );
+		int fdFree = dup( 0 );
+		close( fdFree );
+		struct rlimit rlOld;
+		bwverify( getrlimit( RLIMIT_NOFILE, &rlOld )==0 );
+		struct rlimit rl = rlOld;
+		rl.rlim_cur = fdFree+3;		// first, its accepted socket, second
+		bwverify( setrlimit( RLIMIT_NOFILE, &rl )==0 );
+		Client* pFirst = new Client( limited.port() );
+		pFirst->send( "GET / HTTP/1.1\r\n\r\n" );
+		bwverify( pFirst->response( headers, body )==200 );
+		Client second( limited.port() );		// Queued, not accepted
+		second.send( "GET / HTTP/1.1\r\n\r\n" );
+		usleep( 100000 );
+		struct rusage ruBefore, ruAfter;
+		getrusage( RUSAGE_SELF, &ruBefore );
+		usleep( 500000 );
+		getrusage( RUSAGE_SELF, &ruAfter );
+		long usecCpu = (ruAfter.ru_utime.tv_sec-ruBefore.ru_utime.tv_sec)*1000000L +
+		               (ruAfter.ru_utime.tv_usec-ruBefore.ru_utime.tv_usec) +
+		               (ruAfter.ru_stime.tv_sec-ruBefore.ru_stime.tv_sec)*1000000L +
+		               (ruAfter.ru_stime.tv_usec-ruBefore.ru_stime.tv_usec);
+		bwverify( usecCpu<100000 );
+		delete pFirst;			// Frees the server's descriptor too
+		bwverify( second.response( headers, body )==200 && body=="hello" );
+		bwverify( setrlimit( RLIMIT_NOFILE, &rlOld )==0 );
+		limited.stop();
+		t.join();
+	}
+	return 0;
+}
@@ -5,10 +5,16 @@
 #include <bw/trace.h>
 
 #include <list>
-#include <map>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 #include <bw/bwassert.h>
 #include <bw/string.h>
+#include <bw/ustring.h>
+#include <bw/hashmap.h>
 #include <bw/custom.h>
 #include <fstream>
 #include <unistd.h>
@@ -0,0 +1,226 @@
+// Main program to exercise LogStream
+//
+
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include <bw/bwassert.h>
+#include <bw/string.h>
+#include <bw/exception.h>
+#include <bw/logging.h>
+
+using namespace bw;
+
+const char* logname = "/tmp/bwlog1.log";
+const int nThreads = 4;
+const int nLines = 2000;
+
+static int countLines( const char* fname, const char* pszMust )
+{
+	std::ifstream is(fname);
+	std::string line;
+	int n = 0;
+	while (std::getline(is,line)) {
+		bwverify( line.find(pszMust)!=std::string::npos );
+		++n;
+	}
+	return n;
+}
+
+static void logLines( LogStream* plog, int id )
+{
+	for (int i=0; i<nLines; ++i)
+		(*plog)(INFO) << "thread " << id << " line " << i << std::endl;
+}
+
+int main(int, char**)
+{
+	unlink(logname);
+
+	// Synchronous
+	{
+		LogStream lout("log1", logname);
+		lout(ERR) << "An error message." << std::endl;
+		lout.close();
+	}
+	bwverify( countLines(logname,"log1:")==1 );
+
+	// Asynchronous, everything written by close()
+	{
+		LogStream lout("log1", logname);
+		lout.startAsync();
+		std::vector<std::thread> threads;
+		for (int i=0; i<nThreads; ++i)
+			threads.push_back( std::thread(logLines,&lout,i) );
+		for (size_t i=0; i<threads.size(); ++i)
+			threads[i].join();
+		lout.close();
+	}
+	bwverify( countLines(logname,"log1:")==1+nThreads*nLines );
+
+	// Asynchronous with a tiny queue, nothing lost when blocking
+	{
+		LogStream lout("log1", logname);
+		lout.startAsync(256, LogStream::BlockWhenFull);
+		logLines(&lout,0);
+		lout.flush();
+		bwverify( lout.dropped()==0 );
+	}
+	bwverify( countLines(logname,"log1:")==1+(nThreads+1)*nLines );
+
+	// Dropping: every line is either written or counted
+	unsigned long dropped;
+	{
+		LogStream lout("log1", logname);
+		lout.startAsync(256, LogStream::DropWhenFull);
+		logLines(&lout,0);
+		lout.flush();
+		dropped = lout.dropped();
+	}
+	bwverify( countLines(logname,"log1:")+dropped==1+(nThreads+2)*nLines );
+
+	// Priority filtering
+	unlink(logname);
+	int evaluated = 0;
+	{
+		LogStream lout("log1", logname);
+		lout.setThreshold(WARNING);
+		bwverify( lout.isEnabled(ERR) );
+		bwverify( !lout.isEnabled(INFO) );
+		lout(ERR) << "kept" << std::endl;
+		lout(INFO) << "discarded" << std::endl;
+		bwlog( lout, WARNING ) << "kept " << ++evaluated << std::endl;
+		bwlog( lout, DEBUG ) << "discarded " << ++evaluated << std::endl;
+		lout.close();
+	}
+	bwverify( evaluated==1 );
+	bwverify( countLines(logname,"kept")==2 );
+
+	// Text format LogLines read the same as ostream lines
+	unlink(logname);
+	{
+		LogStream lout("log1", logname);
+		lout(INFO) << "n=" << -7 << " u=" << 42u << " d=" << 2.5 << ' ' << String("s") << std::endl;
+		lout.record(INFO) << "n=" << -7 << " u=" << 42u << " d=" << 2.5 << ' ' << String("s");
+		bwrecord( lout, DEBUG ) << "n=" << -7 << " u=" << 42u << " d=" << 2.5 << ' ' << String("s");
+		lout.close();
+	}
+	bwverify( countLines(logname,"log1:\t n=-7 u=42 d=2.5 s")==3 );
+	{
+		std::ifstream is(logname);
+		std::string line;
+		std::getline(is,line);
+		bwverify( line.size()>20 && line[4]=='/' && line[7]=='/' && line[10]==' ' &&
+		          line[13]==':' && line[16]==':' && line[19]=='\t' );
+	}
+
+	// Binary format, read back as text
+	unlink(logname);
+	{
+		LogStream lout("log1", logname);
+		lout.setFormat(LogStream::Binary);
+		lout(ERR) << "text " << 1 << std::endl;
+		lout.record(WARNING) << "raw " << -2 << ' ' << 3ul << ' ' << 0.25;
+		lout.startAsync();
+		logLines(&lout,0);
+		lout.close();
+	}
+	{
+		std::ifstream is(logname, std::ios::binary);
+		LogReader lr(is);
+		std::string line;
+		LogPriority lprio;
+		bwverify( lr.read(line,lprio) && lprio==ERR );
+		bwverify( line.find("log1:\t text 1")!=std::string::npos );
+		bwverify( line[4]=='/' && line[19]=='\t' );
+		bwverify( lr.read(line,lprio) && lprio==WARNING );
+		bwverify( line.find("log1:\t raw -2 3 0.25")!=std::string::npos );
+		int n = 0;
+		while (lr.read(line,lprio)) {
+			bwverify( lprio==INFO );
+			bwverify( line.find("thread 0 line "+std::to_string(n))!=std::string::npos );
+			++n;
+		}
+		bwverify( n==nLines );
+	}
+
+	// Lines not ended with endl are kept, and kept apart, when two streams
+	// are used in turn on one thread
+	const char* logname2 = "/tmp/bwlog1b.log";
+	unlink(logname);
+	unlink(logname2);
+	{
+		LogStream la("la", logname);
+		LogStream lb("lb", logname2);
+		la.startAsync();
+		lb.setFormat(LogStream::Binary);
+		la(INFO) << "first a";
+		lb(INFO) << "first b";
+		la(INFO) << "second a" << std::endl;
+		lb(INFO) << "second b";
+		la.close();
+		lb.close();
+	}
+	{
+		std::ifstream is(logname);
+		std::string line;
+		bwverify( std::getline(is,line) && line.find("la:\t first a")!=std::string::npos );
+		bwverify( std::getline(is,line) && line.find("la:\t second a")!=std::string::npos );
+		bwverify( !std::getline(is,line) );
+	}
+	{
+		std::ifstream is(logname2, std::ios::binary);
+		LogReader lr(is);
+		std::string line;
+		LogPriority lprio;
+		bwverify( lr.read(line,lprio) && line.find("lb:\t first b")!=std::string::npos );
+		bwverify( line.find("first a")==std::string::npos );
+		bwverify( lr.read(line,lprio) && line.find("lb:\t second b")!=std::string::npos );
+		bwverify( !lr.read(line,lprio) );
+	}
+
+	// A line left unended by another thread is written when its stream is
+	// destroyed, and never reaches a later stream
+	unlink(logname);
+	unlink(logname2);
+	{
+		LogStream* pla = new LogStream("la", logname);
+		pla->setFormat(LogStream::Binary);
+		std::promise<void> started, destroyed;
+		std::thread t( [&]() {
+			(*pla)(INFO) << "unended";
+			started.set_value();
+			destroyed.get_future().wait();
+			LogStream lc("lc", logname2);
+			lc.setFormat(LogStream::Binary);
+			lc(INFO) << "later" << std::endl;
+		} );
+		started.get_future().wait();
+		delete pla;
+		destroyed.set_value();
+		t.join();
+	}
+	{
+		std::ifstream is(logname, std::ios::binary);
+		LogReader lr(is);
+		std::string line;
+		LogPriority lprio;
+		bwverify( lr.read(line,lprio) && line.find("la:\t unended")!=std::string::npos );
+		bwverify( !lr.read(line,lprio) );
+	}
+	{
+		std::ifstream is(logname2, std::ios::binary);
+		LogReader lr(is);
+		std::string line;
+		LogPriority lprio;
+		bwverify( lr.read(line,lprio) && line.find("lc:\t later")!=std::string::npos );
+		bwverify( !lr.read(line,lprio) );
+	}
+
+	unlink(logname);
+	unlink(logname2);
+}
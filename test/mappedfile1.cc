@@ -0,0 +1,127 @@
+// Main program to exercise MappedFile
+//
+
+#include <cstring>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include <bw/bwassert.h>
+#include <bw/exception.h>
+#include <bw/file.h>
+#include <bw/mappedfile.h>
+
+using namespace bw;
+
+const char* fname = "/tmp/bwmapped1.dat";
+
+int main(int, char**)
+{
+	unlink(fname);
+
+	// Missing files
+	{
+		MappedFile mf;
+		bwverify( !mf.open(fname) );
+		bwverify( !mf.isOpen() );
+		bool isThrown = false;
+		try {
+			MappedFile mf2(fname);
+		} catch (BFileException&) {
+			isThrown = true;
+		}
+		bwverify( isThrown );
+	}
+
+	// Create, write, grow
+	{
+		MappedFile mf;
+		mf.create(fname, 100);
+		bwverify( mf.isOpen() && mf.isWritable() );
+		bwverify( mf.size()==100 );
+		bwverify( mf.data()[0]==0 && mf.data()[99]==0 );
+		strcpy( mf.data(), "hello" );
+
+		mf.resize(1000000);
+		bwverify( mf.size()==1000000 );
+		bwverify( strcmp(mf.data(),"hello")==0 );
+		bwverify( mf.data()[999999]==0 );
+		mf.data()[999999] = 'z';
+		mf.sync();
+
+		mf.resize(10);
+		bwverify( mf.size()==10 );
+		bwverify( strcmp(mf.data(),"hello")==0 );
+		mf.close();
+		bwverify( !mf.isOpen() );
+	}
+
+	// The file has the changes
+	{
+		BFile f(fname);
+		char buf[20];
+		bwverify( f.readUpTo(buf, sizeof(buf))==10 );
+		bwverify( strcmp(buf,"hello")==0 );
+	}
+
+	// Read only, with hints
+	{
+		MappedFile mf(fname);
+		bwverify( !mf.isWritable() );
+		bwverify( mf.size()==10 );
+		bwverify( memcmp(mf.data(),"hello",6)==0 );
+		bwverify( mf.advise(MappedFile::Sequential) );
+		bwverify( mf.advise(MappedFile::WillNeed, 3, 2) );
+		mf.advise(MappedFile::HugePage);	// May not be supported
+	}
+
+	// Empty files map to nothing but can grow
+	{
+		MappedFile mf;
+		mf.create(fname, 0);
+		bwverify( mf.size()==0 && mf.data()==0 );
+		mf.resize(5);
+		memcpy( mf.data(), "abcde", 5 );
+		mf.close();
+		MappedFile mf2(fname, MappedFile::ReadWrite);
+		bwverify( mf2.size()==5 && memcmp(mf2.data(),"abcde",5)==0 );
+	}
+
+	// A mapping that can't grow leaves the file and mapping as they were
+	{
+		MappedFile mf;
+		mf.create(fname, 5);
+		memcpy( mf.data(), "abcde", 5 );
+		struct rlimit rlOld;
+		bwverify( getrlimit(RLIMIT_AS, &rlOld)==0 );
+		struct rlimit rl = rlOld;
+		rl.rlim_cur = 1ULL<<36;		// Well short of the new size
+		bwverify( setrlimit(RLIMIT_AS, &rl)==0 );
+		bool isThrown = false;
+		try {
+			mf.resize(1LL<<40);
+		} catch (BFileException&) {
+			isThrown = true;
+		}
+		bwverify( setrlimit(RLIMIT_AS, &rlOld)==0 );
+		bwverify( isThrown );
+		bwverify( mf.size()==5 && memcmp(mf.data(),"abcde",5)==0 );
+		struct stat st;
+		bwverify( stat(fname, &st)==0 && st.st_size==5 );
+	}
+
+	// Past 2 GB, sparse so nothing is written but the last page
+	{
+		const BFile::Offset big = (3LL<<30)+7;
+		MappedFile mf;
+		mf.create(fname, big);
+		bwverify( mf.size()==big );
+		mf.data()[big-1] = 'z';
+		mf.close();
+		MappedFile mf2(fname);
+		bwverify( mf2.size()==big && mf2.data()[big-1]=='z' && mf2.data()[0]==0 );
+		bwverify( mf2.advise(MappedFile::DontNeed, big-1) );
+	}
+
+	unlink(fname);
+}
@@ -0,0 +1,88 @@
+// Main program to exercise the metrics registry
+//
+
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <map>
+#include <list>
+
+#include <bw/bwassert.h>
+#include <bw/acountable.h>
+#include <bw/exception.h>
+#include <bw/xml.h>
+#include <bw/metrics.h>
+
+using namespace bw;
+
+const int nThreads = 4;
+const int nAdds = 100000;
+
+static MetricCounter s_nTest( "test_adds_total", "Adds by the test threads" );
+static MetricHistogram s_testTime( "test_seconds" );
+
+static void adder()
+{
+	for (int i=0; i<nAdds; ++i)
+		s_nTest.add();
+}
+
+static bool contains( const std::string& s, const char* psz )
+{
+	return s.find(psz)!=std::string::npos;
+}
+
+int main(int, char**)
+{
+	// Counters add up over threads, including ones that have exited
+	std::vector<std::thread> threads;
+	for (int i=0; i<nThreads; ++i)
+		threads.push_back( std::thread(adder) );
+	for (size_t i=0; i<threads.size(); ++i)
+		threads[i].join();
+	s_nTest.add(5);
+	bwverify( s_nTest.value()==(unsigned long long)nThreads*nAdds+5 );
+
+	// The same name is the same counter
+	MetricCounter same( "test_adds_total" );
+	same.add();
+	bwverify( s_nTest.value()==(unsigned long long)nThreads*nAdds+6 );
+
+	// Histogram buckets are powers of two
+	s_testTime.record( 0 );
+	s_testTime.record( 1 );
+	s_testTime.record( 1024 );		// 2^10, the first value above le=2^10-1
+	s_testTime.record( 1500 );		// 2^10 <= 1500 < 2^11
+	s_testTime.record( 2047 );
+	{
+		MetricTimer mt( s_testTime );
+		std::this_thread::sleep_for( std::chrono::milliseconds(2) );
+	}
+	bwverify( s_testTime.count()==6 );
+	bwverify( s_testTime.bucket(0)==2 );
+	bwverify( s_testTime.bucket(10)==3 );
+	bwverify( s_testTime.sumNs()>=2000000+4572 );
+
+	// XMLDocument loads are timed by the library
+	{
+		std::istringstream is("<?xml version=\"1.0\"?><a>b</a>");
+		FileLoc floc;
+		XMLDocRef xdr = new XMLDocument(is, floc);
+	}
+
+	std::ostringstream os;
+	Metrics::writeText( os );
+	std::string s = os.str();
+	bwverify( contains(s, "# HELP test_adds_total Adds by the test threads\n") );
+	bwverify( contains(s, "# TYPE test_adds_total counter\ntest_adds_total 400006\n") );
+	bwverify( contains(s, "# TYPE test_seconds histogram\n") );
+	bwverify( contains(s, "test_seconds_bucket{le=\"1.023e-06\"} 2\n") );
+	bwverify( contains(s, "test_seconds_bucket{le=\"2.047e-06\"} 5\n") );
+	bwverify( contains(s, "test_seconds_bucket{le=\"34.359738367\"} 6\n") );
+	bwverify( contains(s, "test_seconds_bucket{le=\"+Inf\"} 6\n") );
+	bwverify( contains(s, "test_seconds_count 6\n") );
+	bwverify( contains(s, "bw_xml_load_seconds_count 1\n") );
+}
@@ -0,0 +1,207 @@
+// Main program to exercise MultipartParser
+//
+
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <string>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "bw/bwassert.h"
+#include "bw/exception.h"
+#include "bw/string.h"
+#include "bw/multipart.h"
+
+using namespace bw;
+
+const std::string dir = "/tmp/bwmultipart1";
+const char* boundary = "----WebKitFormBoundary7MA4YWxkTrZu0gW";
+
+// Binary data full of near misses for the boundary
+static std::string binaryData( size_t n )
+{
+	std::string s;
+	for (size_t i=0; i<n; ++i)
+		s += (char)((i*7919)%256);
+	s += "\r\n------WebKitFormBoundary7MA4YWxkTrZu0g";	// Almost
+	s += std::string( 3, '\0' );
+	s += "\r\n--";
+	return s;
+}
+
+static std::string body( const std::string& data )
+{
+	std::string b = "preamble\r\n--";
+	b += boundary;
+	b += "\r\nContent-Disposition: form-data; name=\"title\"\r\n\r\nHello, world\r\n--";
+	b += boundary;
+	b += "\r\ncontent-disposition: form-data; name=\"upload\"; filename=\"C:\\docs\\a;b.bin\"\r\n"
+	     "Content-Type: application/octet-stream\r\n\r\n";
+	b += data;
+	b += "\r\n--";
+	b += boundary;
+	b += "\r\nContent-Disposition: form-data; name=\"empty\"\r\n\r\n\r\n--";
+	b += boundary;
+	b += "--\r\nepilogue";
+	return b;
+}
+
+static std::string readFile( const char* pszPath )
+{
+	std::ifstream is( pszPath, std::ios::binary );
+	std::ostringstream os;
+	os << is.rdbuf();
+	return os.str();
+}
+
+// The number of files in a directory
+static int countFiles( const std::string& dirName )
+{
+	DIR* pdir = opendir( dirName.c_str() );
+	bwverify( pdir );
+	int n = 0;
+	while (struct dirent* pent = readdir( pdir )) {
+		if (pent->d_name[0]!='.')
+			++n;
+	}
+	closedir( pdir );
+	return n;
+}
+
+int main(int, char**)
+{
+	std::string cmd = "rm -rf " + dir;
+	bwverify( system(cmd.c_str())==0 );
+	bwverify( mkdir(dir.c_str(), 0700)==0 );
+
+	bwverify( MultipartParser::boundaryOf("multipart/form-data; boundary=abc")=="abc" );
+	bwverify( MultipartParser::boundaryOf("Multipart/Form-Data; charset=utf-8; boundary=\"a b\"")=="a b" );
+	bwverify( MultipartParser::boundaryOf("application/x-www-form-urlencoded")=="" );
+	bwverify( MultipartParser::boundaryOf(0)=="" );
+
+	std::string data = binaryData( 200000 );
+	std::string b = body( data );
+
+	// Fed in every piece size from one byte up, files passed to a handler
+	static const size_t sizes[] = { 1, 2, 7, 41, 1000, 65536, 1000000 };
+	for (size_t k=0; k<sizeof(sizes)/sizeof(sizes[0]); ++k) {
+		std::string received;
+		int nEnds = 0;
+		MultipartParser mp( boundary );
+		mp.setFileHandler( [&]( const MultipartParser::Part& part, const char* p, size_t n, bool isEnd ) {
+			bwverify( part.name=="upload" );
+			bwverify( part.fileName=="C:\\docs\\a;b.bin" );
+			bwverify( part.contentType=="application/octet-stream" );
+			if (isEnd)
+				++nEnds;
+			else
+				received.append( p, n );
+		} );
+		for (size_t pos=0; pos<b.size(); pos+=sizes[k])
+			mp.feed( b.data()+pos, std::min(sizes[k], b.size()-pos) );
+		mp.finish();
+		bwverify( received==data );
+		bwverify( nEnds==1 );
+		bwverify( mp.fields().size()==2 );
+		bwverify( mp.fields()["title"]=="Hello, world" );
+		bwverify( mp.fields()["empty"]=="" );
+	}
+
+	// From a stream, files stored
+	{
+		std::istringstream is( b );
+		MultipartParser mp( boundary );
+		mp.setFileDirectory( dir.c_str() );
+		mp.parse( is );
+		std::map< String, String >& fields = mp.fields();
+		bwverify( fields.size()==4 );
+		bwverify( fields["upload_name"]=="C:\\docs\\a;b.bin" );
+		bwverify( fields["upload"].startsWith( (dir+"/bwupload").c_str() ) );
+		bwverify( readFile(fields["upload"])==data );
+		bwverify( unlink(fields["upload"])==0 );
+	}
+
+	// Truncated bodies are errors, and partly stored files are removed
+	{
+		std::istringstream is( b.substr(0, b.size()/2) );
+		bool isThrown = false;
+		{
+			MultipartParser mp( boundary );
+			mp.setFileDirectory( dir.c_str() );
+			try {
+				mp.parse( is );
+			} catch (BFormatException&) {
+				isThrown = true;
+			}
+		}
+		bwverify( isThrown );
+		bwverify( countFiles(dir)==0 );
+	}
+
+	// Files already stored are removed when a later part is bad
+	{
+		std::string bad = b.substr( 0, b.find("name=\"empty\"") ) + "\r\n\r\nx\r\n--" + boundary + "--";
+		std::istringstream is( bad );
+		bool isThrown = false;
+		{
+			MultipartParser mp( boundary );
+			mp.setFileDirectory( dir.c_str() );
+			try {
+				mp.parse( is );
+			} catch (BFormatException&) {
+				isThrown = true;
+			}
+			bwverify( isThrown );
+			bwverify( countFiles(dir)==1 );	// Until the parser goes
+		}
+		bwverify( countFiles(dir)==0 );
+	}
+
+	// A repeated file field keeps only the last file
+	{
+		std::string head = std::string("\r\n--") + boundary +
+		                   "\r\nContent-Disposition: form-data; name=\"upload\"; filename=\"a.bin\"\r\n\r\n";
+		std::string twice = head + "first" + head + data + "\r\n--" + boundary + "--";
+		std::istringstream is( twice );
+		MultipartParser mp( boundary );
+		mp.setFileDirectory( dir.c_str() );
+		mp.parse( is );
+		bwverify( mp.fields().size()==2 );
+		bwverify( countFiles(dir)==1 );
+		bwverify( readFile(mp.fields()["upload"])==data );
+		bwverify( unlink(mp.fields()["upload"])==0 );
+		bwverify( rmdir(dir.c_str())==0 );	// Empty
+	}
+
+	// Fields beyond the limit are refused
+	{
+		MultipartParser mp( boundary );
+		mp.setFieldLimit( 5 );
+		bool isThrown = false;
+		try {
+			mp.feed( b.data(), b.size() );
+		} catch (BFormatException&) {
+			isThrown = true;
+		}
+		bwverify( isThrown );
+	}
+
+	// Parts must have names
+	{
+		std::string bad = std::string("--") + boundary + "\r\n\r\nx\r\n--" + boundary + "--";
+		MultipartParser mp( boundary );
+		bool isThrown = false;
+		try {
+			mp.feed( bad.data(), bad.size() );
+		} catch (BFormatException&) {
+			isThrown = true;
+		}
+		bwverify( isThrown );
+	}
+
+	return 0;
+}
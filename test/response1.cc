@@ -0,0 +1,215 @@
+// Main program to exercise ResponseWriter
+//
+
+#include <clocale>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "bw/bwassert.h"
+#include "bw/response.h"
+
+using namespace bw;
+
+// The body after the headers
+static std::string bodyOf( const std::string& response )
+{
+	size_t n = response.find( "\r\n\r\n" );
+	bwverify( n!=std::string::npos );
+	return response.substr( n+4 );
+}
+
+// The data of a chunked body, checking its framing
+static std::string unchunk( const std::string& body )
+{
+	std::string data;
+	size_t pos = 0;
+	for (;;) {
+		char* pEnd;
+		unsigned long n = strtoul( body.c_str()+pos, &pEnd, 16 );
+		pos = pEnd-body.c_str();
+		bwverify( body.compare( pos, 2, "\r\n" )==0 );
+		pos += 2;
+		if (n==0)
+			break;
+		data.append( body, pos, n );
+		pos += n;
+		bwverify( body.compare( pos, 2, "\r\n" )==0 );
+		pos += 2;
+	}
+	bwverify( body.compare( pos, std::string::npos, "\r\n" )==0 );
+	return data;
+}
+
+// Decompresses gzip or zlib data, as much as is there
+static std::string inflated( const std::string& data )
+{
+	z_stream z;
+	memset( &z, 0, sizeof(z) );
+	bwverify( inflateInit2( &z, 15+32 )==Z_OK );	// Either format
+	std::string result;
+	char buf[4096];
+	z.next_in = (Bytef*)data.data();
+	z.avail_in = data.size();
+	int rc;
+	do {
+		z.next_out = (Bytef*)buf;
+		z.avail_out = sizeof(buf);
+		rc = inflate( &z, Z_SYNC_FLUSH );
+		bwverify( rc==Z_OK || rc==Z_STREAM_END || rc==Z_BUF_ERROR );
+		result.append( buf, sizeof(buf)-z.avail_out );
+	} while (z.avail_out==0);
+	inflateEnd( &z );
+	return result;
+}
+
+// A page long enough to fill several buffers
+static std::string page()
+{
+	std::string s = "<html><body><table>\n";
+	for (int i=0; i<5000; ++i)
+		s += "<tr><td>Row " + std::to_string( i ) + "</td><td>Some repeated text</td></tr>\n";
+	return s + "</table></body></html>\n";
+}
+
+int main(int, char**)
+{
+	// Negotiation
+	bwverify( ResponseWriter::negotiate( 0 )==ResponseWriter::Identity );
+	bwverify( ResponseWriter::negotiate( "" )==ResponseWriter::Identity );
+	bwverify( ResponseWriter::negotiate( "gzip, deflate, br" )==ResponseWriter::Gzip );
+	bwverify( ResponseWriter::negotiate( "deflate" )==ResponseWriter::Deflate );
+	bwverify( ResponseWriter::negotiate( "br,DEFLATE" )==ResponseWriter::Deflate );
+	bwverify( ResponseWriter::negotiate( "x-gzip" )==ResponseWriter::Gzip );
+	bwverify( ResponseWriter::negotiate( "deflate;q=1.0, gzip;q=0.5" )==ResponseWriter::Deflate );
+	bwverify( ResponseWriter::negotiate( "gzip;q=0, deflate" )==ResponseWriter::Deflate );
+	bwverify( ResponseWriter::negotiate( "gzip; q=0, deflate;q=0" )==ResponseWriter::Identity );
+	bwverify( ResponseWriter::negotiate( "*" )==ResponseWriter::Gzip );
+	bwverify( ResponseWriter::negotiate( "*;q=0" )==ResponseWriter::Identity );
+	bwverify( ResponseWriter::negotiate( "identity, br" )==ResponseWriter::Identity );
+	bwverify( ResponseWriter::negotiate( "gzipped" )==ResponseWriter::Identity );
+	bwverify( ResponseWriter::negotiate( "gzip;q=0.998, deflate;q=0.999" )==ResponseWriter::Deflate );
+	bwverify( ResponseWriter::negotiate( "gzip;q=0.001" )==ResponseWriter::Gzip );
+	bwverify( ResponseWriter::negotiate( "gzip;q=1., deflate;q=0.5" )==ResponseWriter::Gzip );
+	bwverify( ResponseWriter::negotiate( "gzip;q=0.0001, deflate;q=0.5" )==ResponseWriter::Deflate );
+	bwverify( ResponseWriter::negotiate( "gzip;q=1.5, deflate;q=0.5" )==ResponseWriter::Deflate );
+	bwverify( ResponseWriter::negotiate( "gzip;q=0,5, deflate;q=0.4" )==ResponseWriter::Deflate );
+	bwverify( ResponseWriter::negotiate( "gzip;q=.5, deflate;q=0.4" )==ResponseWriter::Deflate );
+	bwverify( ResponseWriter::negotiate( "gzip;q=1e0" )==ResponseWriter::Identity );
+	bwverify( ResponseWriter::negotiate( "gzip;q=0.5 ;foo=1, deflate;q=0.4" )==ResponseWriter::Gzip );
+
+	// The same in a locale with a decimal comma, if there is one
+	if (setlocale( LC_NUMERIC, "de_DE.UTF-8" ) || setlocale( LC_NUMERIC, "fr_FR.UTF-8" )) {
+		bwverify( ResponseWriter::negotiate( "deflate;q=0.5, gzip;q=0.4" )==ResponseWriter::Deflate );
+		bwverify( ResponseWriter::negotiate( "gzip;q=0.5" )==ResponseWriter::Gzip );
+		setlocale( LC_NUMERIC, "C" );
+	}
+
+	std::string text = page();
+
+	// Plain, framed by the web server
+	{
+		std::ostringstream os;
+		os << "Status: 200 OK\r\n";
+		ResponseWriter out( os, 0 );
+		out.begin( "text/html" );
+		out << text;
+		out.finish();
+		bwverify( out.good() );
+		bwverify( os.str()=="Status: 200 OK\r\nContent-Type: text/html\r\nVary: Accept-Encoding\r\n\r\n"+text );
+	}
+
+	// Plain and chunked, finished by the destructor
+	{
+		std::ostringstream os;
+		{
+			ResponseWriter out( os, "br", ResponseWriter::Chunked );
+			out.begin( "text/plain" );
+			out << "short";
+			out.flush();
+			out << text;
+		}
+		std::string headers = "Content-Type: text/plain\r\nVary: Accept-Encoding\r\nTransfer-Encoding: chunked\r\n\r\n";
+		bwverify( os.str().compare( 0, headers.size(), headers )==0 );
+		std::string body = bodyOf( os.str() );
+		bwverify( body.compare( 0, 10, "5\r\nshort\r\n" )==0 );
+		bwverify( unchunk( body )=="short"+text );
+	}
+
+	// gzip, with the top of the page flushed out first
+	{
+		std::ostringstream os;
+		ResponseWriter out( os, "gzip, deflate" );
+		bwverify( out.encoding()==ResponseWriter::Gzip );
+		out.begin( "text/html" );
+		bwverify( os.str().find( "Content-Encoding: gzip\r\n" )!=std::string::npos );
+		out << "<h1>Report</h1>\n" << std::flush;
+		bwverify( inflated( bodyOf( os.str() ) )=="<h1>Report</h1>\n" );
+		out << text;
+		out.finish();
+		std::string body = bodyOf( os.str() );
+		bwverify( (unsigned char)body[0]==0x1f && (unsigned char)body[1]==0x8b );
+		bwverify( inflated( body )=="<h1>Report</h1>\n"+text );
+		bwverify( body.size()<text.size()/5 );
+	}
+
+	// deflate and chunked
+	{
+		std::ostringstream os;
+		ResponseWriter out( os, "deflate", ResponseWriter::Chunked );
+		out.begin( "text/html" );
+		bwverify( os.str().find( "Content-Encoding: deflate\r\n" )!=std::string::npos );
+		for (size_t i=0; i<text.size(); i+=1000)
+			out << text.substr( i, 1000 );
+		out.finish();
+		out.finish();
+		bwverify( inflated( unchunk( bodyOf( os.str() ) ) )==text );
+	}
+
+	// Nothing written
+	{
+		std::ostringstream os;
+		ResponseWriter out( os, "gzip", ResponseWriter::Chunked );
+		out.begin( "text/html" );
+		out.finish();
+		bwverify( inflated( unchunk( bodyOf( os.str() ) ) )=="" );
+	}
+
+	// Not finished without begin(), or when unwinding
+	{
+		std::ostringstream os;
+		{
+			ResponseWriter out( os, "gzip", ResponseWriter::Chunked );
+			out << "short";
+		}
+		bwverify( os.str().empty() );
+	}
+	{
+		std::ostringstream os;
+		try {
+			ResponseWriter out( os, 0, ResponseWriter::Chunked );
+			out.begin( "text/html" );
+			out << "cut short";
+			out.flush();
+			throw 1;
+		} catch (int) {
+		}
+		std::string body = bodyOf( os.str() );
+		bwverify( body=="9\r\ncut short\r\n" );	// No last chunk
+	}
+
+	// A failing stream makes the writer bad
+	{
+		std::ostringstream os;
+		ResponseWriter out( os, "gzip" );
+		out.begin( "text/html" );
+		os.setstate( std::ios_base::badbit );
+		out << text;
+		bwverify( !out.good() );
+	}
+
+	return 0;
+}
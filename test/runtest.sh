@@ -8,13 +8,51 @@ echo "The following tests should run to completion or assert on failure."
 echo ""
 ./string1
 ./string2
+./utf81
+./hashmap1
 echo "...string test completed"
 ./filename1
 echo "...filename test completed"
+./directory1
+echo "...directory test completed"
+./dirwalker1
+echo "...directory walker test completed"
+./dirwatcher1
+echo "...directory watcher test completed"
+./multipart1
+echo "...multipart form data test completed"
+./fastcgi1
+echo "...FastCGI test completed"
+./httpserver1
+echo "...HTTP server test completed"
+./http1
+echo "...form data decoding test completed"
+./html1
+echo "...html manipulator test completed"
+./template1
+echo "...template test completed"
+./response1
+echo "...response test completed"
+./file1
+echo "...binary file test completed"
+./buffile1
+echo "...buffered file test completed"
+./mappedfile1
+echo "...mapped file test completed"
+./asyncio1
+echo "...async I/O test completed"
+./groupcommit1
+echo "...group commit test completed"
 ./cptr1
 echo "...cptr/countable test completed"
+./trace1
+echo "...trace ring test completed"
+./metrics1
+echo "...metrics test completed"
 ./ini1
 echo "...INI file test completed"
+./log1
+echo "...logging test completed"
 ./xml1 xmldata1.xml /tmp/data1.out1
 ./xml1 /tmp/data1.out1 /tmp/data1.out2
 diff -s /tmp/data1.out1 /tmp/data1.out2
@@ -215,6 +215,20 @@ int main(int, char**)
 	bwverify( ! (pe>s) );	//Error
 	bwverify(   (pb>s) );
 
+	// StringViews compare whole strings, including any NUL inside the view
+	const char achHeader[] = "Transfer-Encoding\0xxxx";
+	StringView sv( achHeader, sizeof(achHeader)-1 );
+	bwverify( sv!="Transfer-Encoding" );
+	char achPadded[32] = "Transfer-Encoding";		// NULs to the end
+	bwverify( sv!=achPadded && !sv.equalsIgnoreCase(achPadded) );
+	bwverify( !sv.equalsIgnoreCase("transfer-encoding") );
+	StringView svName( achHeader, 17 );
+	bwverify( svName=="Transfer-Encoding" );
+	bwverify( svName.equalsIgnoreCase("TRANSFER-ENCODING") );
+	bwverify( svName!="Transfer-Encodin" && svName!="Transfer-Encodings" );
+	bwverify( !svName.equalsIgnoreCase("Transfer") );
+	bwverify( StringView()=="" && StringView().equalsIgnoreCase("") );
+
 
 
 	// Error checking
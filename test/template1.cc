@@ -0,0 +1,153 @@
+// Main program to exercise Template and TemplateData
+//
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <string.h>
+
+#include "bw/bwassert.h"
+#include "bw/exception.h"
+#include "bw/string.h"
+#include "bw/template.h"
+
+using namespace bw;
+
+const char* fname = "/tmp/bwtemplate1.html";
+
+static StringView view( const char* psz )
+{
+	return StringView( psz, strlen(psz) );
+}
+
+static std::string render( const char* pszTemplate, const TemplateData& data )
+{
+	Template t( view(pszTemplate) );
+	std::ostringstream os;
+	t.render( os, data );
+	return os.str();
+}
+
+static bool isBad( const char* pszTemplate )
+{
+	try {
+		Template t( view(pszTemplate) );
+	} catch (BFormatException&) {
+		return true;
+	}
+	return false;
+}
+
+static void writeFile( const char* pszText )
+{
+	std::ofstream f( fname );
+	f << pszText;
+}
+
+int main(int, char**)
+{
+	TemplateData data;
+	data.set( "title", "Parts & <things>" );
+	data.set( "html", "<b>bold</b>" );
+	data.set( "count", 3L );
+	data.set( "string", String( "a String" ) );
+	data.setFlag( "yes", true );
+	data.setFlag( "no", false );
+
+	// Substitutions
+	bwverify( render( "", data )=="" );
+	bwverify( render( "plain text", data )=="plain text" );
+	bwverify( render( "<h1>{{title}}</h1>", data )=="<h1>Parts &amp; &lt;things></h1>" );
+	bwverify( render( "{{{html}}}|{{& html }}|{{html}}", data )=="<b>bold</b>|<b>bold</b>|&lt;b>bold&lt;/b>" );
+	bwverify( render( "{{count}} {{ string }} [{{missing}}]", data )=="3 a String []" );
+	bwverify( render( "a{{! a comment }}b", data )=="ab" );
+	bwverify( render( "{ not a tag }", data )=="{ not a tag }" );
+
+	// Conditionals
+	bwverify( render( "{{#yes}}Y{{/yes}}{{#no}}N{{/no}}{{#missing}}M{{/missing}}", data )=="Y" );
+	bwverify( render( "{{^yes}}Y{{/yes}}{{^no}}N{{/no}}{{^missing}}M{{/missing}}", data )=="NM" );
+
+	// Loops, with outer values seen from rows, and nested
+	for (int i=1; i<=3; ++i) {
+		TemplateData& row = data.add( "rows" );
+		row.set( "n", (long)i );
+		if (i==2) {
+			row.set( "title", "<two>" );
+			row.add( "inner" ).set( "x", "a" );
+			row.add( "inner" ).set( "x", "b" );
+		}
+	}
+	bwverify( render( "<ul>{{#rows}}<li>{{n}} {{title}}{{#inner}}[{{x}}{{n}}]{{/inner}}</li>{{/rows}}</ul>{{^rows}}none{{/rows}}", data )==
+	          "<ul><li>1 Parts &amp; &lt;things></li><li>2 &lt;two>[a2][b2]</li><li>3 Parts &amp; &lt;things></li></ul>" );
+	bwverify( render( "{{^empty}}none{{/empty}}", data )=="none" );
+
+	// The same compiled template, rendered twice
+	Template t( view("{{#rows}}{{n}}{{/rows}}") );
+	std::ostringstream os;
+	t.render( os, data );
+	t.render( os, data );
+	bwverify( os.str()=="123123" );
+
+	data.clear();
+	bwverify( render( "{{title}}{{#rows}}x{{/rows}}", data )=="" );
+
+	// Errors
+	bwverify( isBad( "{{title" ) );
+	bwverify( isBad( "{{{title}}" ) );
+	bwverify( isBad( "{{#a}}" ) );
+	bwverify( isBad( "{{/a}}" ) );
+	bwverify( isBad( "{{#a}}{{#b}}{{/a}}{{/b}}" ) );
+	bwverify( isBad( "{{}}" ) );
+
+	// Loading, caching and reloading
+	Template::setReloadInterval( 3600 );
+	data.set( "name", "World" );
+	writeFile( "Hello {{name}}" );
+	std::shared_ptr<const Template> p1 = Template::load( fname );
+	std::shared_ptr<const Template> p2 = Template::load( fname );
+	bwverify( p1==p2 );
+	std::ostringstream os1;
+	p1->render( os1, data );
+	bwverify( os1.str()=="Hello World" );
+
+	// Not looked at again within the interval
+	writeFile( "Goodbye {{name}}" );
+	bwverify( Template::load( fname )==p1 );
+
+	Template::setReloadInterval( 0 );
+	std::shared_ptr<const Template> p3 = Template::load( fname );
+	bwverify( p3!=p1 );
+	bwverify( Template::load( fname )==p3 );
+	std::ostringstream os3;
+	p3->render( os3, data );
+	bwverify( os3.str()=="Goodbye World" );
+	// The old version is still usable
+	std::ostringstream os4;
+	p1->render( os4, data );
+	bwverify( os4.str()=="Hello World" );
+
+	// A broken edit throws
+	writeFile( "Broken {{name" );
+	bool isThrown = false;
+	try {
+		Template::load( fname );
+	} catch (BFormatException&) {
+		isThrown = true;
+	}
+	bwverify( isThrown );
+
+	unlink( fname );
+	isThrown = false;
+	try {
+		Template::load( fname );
+	} catch (BFileException&) {
+		isThrown = true;
+	}
+	bwverify( isThrown );
+
+	return 0;
+}
@@ -0,0 +1,92 @@
+// Main program to exercise the trace ring buffer
+//
+
+#define BTRACE_RING
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <bw/bwassert.h>
+#include <bw/string.h>
+#include <bw/exception.h>
+#include <bw/trace.h>
+
+using namespace bw;
+using std::endl;
+
+const char* dumpname = "/tmp/bwtrace1.out";
+
+static std::string dumpToString()
+{
+	int fd = open(dumpname, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+	bwverify( fd>=0 );
+	BTraceRing::dump(fd);
+	close(fd);
+
+	std::ifstream is(dumpname);
+	std::string s, line;
+	while (std::getline(is,line))
+		s += line + "\n";
+	unlink(dumpname);
+	return s;
+}
+
+static void worker()
+{
+	trace << "worker " << 7 << endl;
+}
+
+int main(int, char**)
+{
+	// Nothing traced, nothing dumped
+	bwverify( dumpToString().empty() );
+
+	trace << "int " << -42 << " unsigned " << 42u << " double " << 2.5
+	      << " char " << 'x' << " String " << String("str") << endl;
+	trace << "A longer string that needs several slots to hold it" << endl;
+	std::string s = dumpToString();
+	bwverify( s.find("== trace ring")!=std::string::npos );
+	bwverify( s.find("-- thread ")!=std::string::npos );
+	bwverify( s.find(" int -42 unsigned 42 double 2.500000 char x String str\n")!=std::string::npos );
+	bwverify( s.find(" A longer string that needs several slots to hold it\n")!=std::string::npos );
+
+	// Other threads get their own ring
+	std::thread t(worker);
+	t.join();
+	s = dumpToString();
+	bwverify( s.find(" worker 7\n")!=std::string::npos );
+
+	// Wrapping keeps the newest lines
+	for (int i=0; i<BTraceRing::nSlots; ++i)
+		trace << "line " << i << endl;
+	s = dumpToString();
+	bwverify( s.find("older output overwritten")!=std::string::npos );
+	bwverify( s.find("line " + std::to_string(BTraceRing::nSlots-1) + "\n")!=std::string::npos );
+	bwverify( s.find(" int -42")==std::string::npos );
+
+	// A failed bwassert dumps to stderr before throwing
+	int fdErr = dup(2);
+	int fd = open(dumpname, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+	dup2(fd, 2);
+	close(fd);
+	bool isThrown = false;
+	try {
+		trace << "before assert" << endl;
+		bwassert( s.empty() );
+	} catch (BException&) {
+		isThrown = true;
+	}
+	dup2(fdErr, 2);
+	close(fdErr);
+	bwverify( isThrown );
+	{
+		std::ifstream is(dumpname);
+		std::string text((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+		bwverify( text.find(" before assert\n")!=std::string::npos );
+	}
+	unlink(dumpname);
+}
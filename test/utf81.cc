@@ -0,0 +1,75 @@
+// Main program to excercise UTF-8 <-> UString conversion
+//
+
+#include <iostream>
+#include <cstring>
+
+#include <bw/bwassert.h>
+#include <bw/exception.h>
+#include <bw/string.h>
+#include <bw/ustring.h>
+#include <bw/utf8.h>
+
+using namespace bw;
+
+static bool rejects( const char* ps )
+{
+	try {
+		UString u( (String(ps)) );
+	} catch (BFormatException&) {
+		return true;
+	}
+	return false;
+}
+
+int main(int, char**)
+{
+	// ASCII, short and long enough for the vector paths
+	String s1 = "Hello, world";
+	UString u1( s1 );
+	bwverify( u1==L"Hello, world" );
+	bwverify( String(u1)==s1 );
+
+	String s2;
+	for (int i=0; i<100; ++i)
+		s2.append( (char)('!'+i%90) );
+	UString u2 = s2.toUString();
+	bwverify( u2.length()==100 );
+	for (int i=0; i<100; ++i)
+		bwverify( u2[i]==(wchar_t)('!'+i%90) );
+	bwverify( u2.toString()==s2 );
+
+	// One of each sequence length, with ASCII runs around them
+	const char* pmixed = "abcdefghijklmnopq\xC3\xA9z\xE2\x82\xAC" "0123456789abcdefghij\xF0\x9F\x98\x80!";
+	UString u3( (String(pmixed)) );
+	bwverify( u3.length()==17+1+1+1+20+1+1 );
+	bwverify( u3[17]==0xE9 );
+	bwverify( u3[19]==0x20AC );
+	bwverify( u3[40]==0x1F600 );
+	bwverify( u3.toString()==pmixed );
+	bwverify( utf8DecodedLength( pmixed, strlen(pmixed) )==u3.length() );
+	bwverify( utf8EncodedLength( u3, u3.length() )==(int)strlen(pmixed) );
+
+	// Empty
+	bwverify( UString( String() ).length()==0 );
+	bwverify( String( UString() ).length()==0 );
+
+	// Malformed input
+	bwverify( rejects( "\x80" ) );				// Stray continuation
+	bwverify( rejects( "abc\xC3" ) );			// Truncated
+	bwverify( rejects( "\xC0\xAF" ) );			// Overlong
+	bwverify( rejects( "\xE0\x80\xAF" ) );		// Overlong
+	bwverify( rejects( "\xED\xA0\x80" ) );		// Surrogate
+	bwverify( rejects( "\xF4\x90\x80\x80" ) );	// Beyond U+10FFFF
+	bwverify( rejects( "\xFF" ) );
+
+	wchar_t bad[] = { L'a', 0xD800, 0 };
+	bwverify( utf8EncodedLength( bad, 2 )==-1 );
+	bool thrown = false;
+	try {
+		String s( (UString(bad)) );
+	} catch (BFormatException&) {
+		thrown = true;
+	}
+	bwverify( thrown );
+}
@@ -3,11 +3,12 @@
 #include <string>
 #include <map>
 #include <list>
+#include <atomic>
 #include <iostream>
 #include <fstream>
 
 #include "bw/bwassert.h"
-#include "bw/countable.h"
+#include "bw/acountable.h"
 #include "bw/exception.h"
 #include <bw/xml.h>
 
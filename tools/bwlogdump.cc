@@ -0,0 +1,109 @@
+/* bwlogdump.cc -- Expands Binary LogStream records to text
+
+Copyright (C) 1999-2013, Brian Bray
+
+*/
+
+//
+// Usage: bwlogdump [-p] [-t threshold] [file...]
+//
+//   -p            Start each line with the priority name
+//   -t threshold  Only show lines at least as urgent as threshold
+//                 (a name such as WARNING or a number 0-7)
+//
+// With no files, reads standard input.  Output is the text that a Text
+// format LogStream would have written.
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <bw/bwassert.h>
+#include <bw/string.h>
+#include <bw/exception.h>
+#include <bw/logging.h>
+
+using namespace bw;
+
+static const char* priorityNames[] = {
+	"EMERG", "ALERT", "CRIT", "ERR", "WARNING", "NOTICE", "INFO", "DEBUG"
+};
+const int nPriorities = sizeof(priorityNames)/sizeof(priorityNames[0]);
+
+static int parsePriority( const char* psz )
+{
+	for (int i=0; i<nPriorities; ++i) {
+		if (strcmp(psz,priorityNames[i])==0)
+			return i;
+	}
+	if (*psz>='0' && *psz<'0'+nPriorities && psz[1]=='\0')
+		return *psz-'0';
+	return -1;
+}
+
+static bool dump( std::istream& is, const char* pszName, bool showPriority, int threshold )
+{
+	LogReader lr(is);
+	std::string line;
+	LogPriority lprio;
+	try {
+		while (lr.read(line,lprio)) {
+			if (lprio>threshold)
+				continue;
+			if (showPriority) {
+				if (lprio<nPriorities)
+					std::cout << priorityNames[lprio] << '\t';
+				else
+					std::cout << (int)lprio << '\t';
+			}
+			std::cout << line << '\n';
+		}
+	} catch (BException& e) {
+		std::cout.flush();
+		std::cerr << "bwlogdump: " << pszName << ": " << e.message() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+static void usage()
+{
+	std::cerr << "usage: bwlogdump [-p] [-t threshold] [file...]" << std::endl;
+	exit(2);
+}
+
+int main(int argc, char** argv)
+{
+	bool showPriority = false;
+	int threshold = DEBUG;
+	int i = 1;
+
+	for (; i<argc && argv[i][0]=='-' && argv[i][1]!='\0'; ++i) {
+		if (strcmp(argv[i],"-p")==0)
+			showPriority = true;
+		else if (strcmp(argv[i],"-t")==0 && i+1<argc) {
+			threshold = parsePriority(argv[++i]);
+			if (threshold<0)
+				usage();
+		} else
+			usage();
+	}
+
+	bool ok = true;
+	if (i==argc)
+		ok = dump( std::cin, "<stdin>", showPriority, threshold );
+	for (; i<argc; ++i) {
+		std::ifstream is( argv[i], std::ios::binary );
+		if (!is) {
+			std::cerr << "bwlogdump: can't open " << argv[i] << std::endl;
+			ok = false;
+			continue;
+		}
+		ok = dump( is, argv[i], showPriority, threshold ) && ok;
+	}
+	std::cout.flush();
+	return ok ? 0 : 1;
+}
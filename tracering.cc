@@ -0,0 +1,375 @@
+/* tracering.cc -- In memory trace ring buffers
+
+Copyright (C) 1996-2013, Brian Bray
+
+*/
+
+// Note: NOTRACE must always be set in this file
+#define NOTRACE
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "bw/bwassert.h"
+#include "bw/string.h"
+#include "bw/trace.h"
+
+
+/*: class BTraceRing
+
+  In memory trace buffer, used for trace when BTRACE_RING is defined.
+
+  Each thread writes its trace output into its own ring of nSlots fixed
+  size binary slots, so tracing takes no locks, makes no system calls
+  (other than the clock, read once per line) and formats nothing.
+  Numbers are stored raw; strings are copied in slotDataSize pieces.
+  When a ring is full the oldest slots are overwritten, so the ring
+  always holds the most recent trace lines of its thread.
+
+  The rings are written out as text by dump().  This happens
+  automatically when a bwassert fails or a fatal BException reaches
+  FProcess::fatalError() (before the application's own handler, which
+  may exit), and on a signal after dumpOnSignal().
+
+  Example:
+    #define BTRACE_RING
+    #include "bw/trace.h"
+
+    BTraceRing::dumpOnSignal( SIGUSR1 );
+    trace << "Accepted " << fd << " from " << pszAddr << endl;
+
+  Rings are never freed.  When a thread exits its ring is handed to the
+  next new thread, so the most recent output of exited threads survives
+  until it is overwritten.
+
+  A dump made while other threads are tracing is a best effort: the
+  slot being written at that moment may be shown garbled.
+*/
+
+thread_local BTraceRing* BTraceRing::s_pLocal = 0;
+std::atomic<BTraceRing*> BTraceRing::s_pFirst(0);
+
+
+/* struct BTraceRingOwner
+
+   Releases the thread's ring for reuse when the thread exits.
+*/
+struct BTraceRingOwner {
+	~BTraceRingOwner() {
+		if (BTraceRing::s_pLocal) {
+			BTraceRing::s_pLocal->m_inUse.store(false, std::memory_order_release);
+			BTraceRing::s_pLocal = 0;
+		}
+	}
+};
+
+static thread_local BTraceRingOwner s_owner;
+
+
+BTraceRing::BTraceRing()
+	: m_head(0), m_lineNs(0), m_isLineStart(true), m_inUse(true), m_pNext(0)
+{}
+
+/* BTraceRing::attach()
+
+   Finds or makes a ring for this thread.  The ring starts with a 't'
+   slot recording the thread id.
+*/
+BTraceRing& BTraceRing::attach()
+{
+	BTraceRing* pRing = 0;
+	for (BTraceRing* p=s_pFirst.load(std::memory_order_acquire); p; p=p->m_pNext) {
+		bool isFree = false;
+		if (p->m_inUse.compare_exchange_strong(isFree, true, std::memory_order_acquire)) {
+			pRing = p;
+			break;
+		}
+	}
+	if (!pRing) {
+		pRing = new BTraceRing;
+		BTraceRing* pFirst = s_pFirst.load(std::memory_order_relaxed);
+		do {
+			pRing->m_pNext = pFirst;
+		} while (!s_pFirst.compare_exchange_weak(pFirst, pRing, std::memory_order_release,
+		                                         std::memory_order_relaxed));
+	}
+
+	s_pLocal = pRing;
+	(void)&s_owner;		// Constructs the owner, so the ring is released at thread exit
+
+	if (!pRing->m_isLineStart)
+		pRing->endLine();	// Finish the previous thread's partial line
+	long long tid = syscall(SYS_gettid);
+	pRing->put( 't', &tid, sizeof(tid) );
+	pRing->m_isLineStart = true;
+	return *pRing;
+}
+
+// Wall clock time in nanoseconds
+unsigned long long BTraceRing::now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (unsigned long long)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+
+// Output for dump().  Only uses write(), so it can run in a signal
+// handler.
+class DumpBuffer {
+public:
+	explicit DumpBuffer( int fd ) : m_fd(fd), m_len(0) {}
+	~DumpBuffer() {
+		flush();
+	}
+
+	void put( const char* ps, unsigned long len ) {
+		while (len) {
+			if (m_len==sizeof(m_buf))
+				flush();
+			unsigned long n = sizeof(m_buf)-m_len;
+			if (n>len)
+				n = len;
+			memcpy(m_buf+m_len, ps, n);
+			m_len += n;
+			ps += n;
+			len -= n;
+		}
+	}
+	void put( const char* psz ) {
+		put( psz, strlen(psz) );
+	}
+	void put( char ch ) {
+		put( &ch, 1 );
+	}
+	void putUnsigned( unsigned long long n, int minDigits=1 ) {
+		char digits[24];
+		int i = sizeof(digits);
+		do {
+			digits[--i] = '0' + n%10;
+			n /= 10;
+			--minDigits;
+		} while (n || minDigits>0);
+		put( digits+i, sizeof(digits)-i );
+	}
+	void putSigned( long long n ) {
+		if (n<0) {
+			put('-');
+			putUnsigned( 0-(unsigned long long)n );
+		} else
+			putUnsigned( n );
+	}
+	void putHex( unsigned long long n ) {
+		char digits[16];
+		int i = sizeof(digits);
+		do {
+			digits[--i] = "0123456789abcdef"[n&0xF];
+			n >>= 4;
+		} while (n);
+		put( "0x" );
+		put( digits+i, sizeof(digits)-i );
+	}
+	// Six decimals, or an exponent for very large and small magnitudes
+	void putDouble( double d ) {
+		if (std::isnan(d)) {
+			put( "nan" );
+			return;
+		}
+		if (d<0) {
+			put('-');
+			d = -d;
+		}
+		if (std::isinf(d)) {
+			put( "inf" );
+			return;
+		}
+		int exp10 = 0;
+		if (d!=0) {
+			while (d>=1e15) {
+				d /= 10;
+				++exp10;
+			}
+			while (d<1e-4) {
+				d *= 10;
+				--exp10;
+			}
+		}
+		unsigned long long whole = (unsigned long long)d;
+		unsigned long long frac = (unsigned long long)((d-whole)*1e6 + 0.5);
+		if (frac>=1000000) {
+			++whole;
+			frac -= 1000000;
+		}
+		putUnsigned( whole );
+		put('.');
+		putUnsigned( frac, 6 );
+		if (exp10) {
+			put('e');
+			putSigned( exp10 );
+		}
+	}
+
+	void flush() {
+		const char* p = m_buf;
+		while (m_len) {
+			ssize_t n = write(m_fd, p, m_len);
+			if (n<=0)
+				break;
+			p += n;
+			m_len -= n;
+		}
+		m_len = 0;
+	}
+
+private:
+	int		m_fd;
+	unsigned long	m_len;
+	char	m_buf[1024];
+};
+
+/*: BTraceRing::dump()
+
+  Writes the contents of every thread's ring to fd (by default stderr)
+  as text, oldest first.  Each line starts with its wall clock time in
+  seconds since the epoch.  Rings that were never written are skipped.
+
+  Only write() is used for output, so dump() may be called from a
+  signal handler.
+
+  Prototype: static void BTraceRing::dump( int fd=2 )
+*/
+void BTraceRing::dump( int fd )
+{
+	for (BTraceRing* p=s_pFirst.load(std::memory_order_acquire); p; p=p->m_pNext)
+		p->dumpRing( fd );
+}
+
+void BTraceRing::dumpRing( int fd )
+{
+	unsigned long long head = m_head.load(std::memory_order_acquire);
+	if (head==0)
+		return;
+	unsigned long long first = head>nSlots ? head-nSlots : 0;
+
+	DumpBuffer db( fd );
+	db.put( "== trace ring" );
+	if (first)
+		db.put( ", older output overwritten" );
+	db.put( '\n' );
+
+	bool isLineStart = true;
+	for (unsigned long long i=first; i<head; ++i) {
+		const Slot& s = m_slots[i & (nSlots-1)];
+		if (s.tag=='t') {
+			long long tid;
+			memcpy(&tid, s.data, sizeof(tid));
+			db.put( "-- thread " );
+			db.putSigned( tid );
+			db.put( '\n' );
+			isLineStart = true;
+			continue;
+		}
+		if (isLineStart) {
+			db.putUnsigned( s.ns/1000000000ULL );
+			db.put('.');
+			db.putUnsigned( s.ns/1000 % 1000000, 6 );
+			db.put(' ');
+			isLineStart = false;
+		}
+
+		switch (s.tag) {
+		case 'e':
+			db.put('\n');
+			isLineStart = true;
+			break;
+		case 's':
+			db.put( s.data, s.len<=slotDataSize ? s.len : slotDataSize );
+			break;
+		case 'c':
+			db.put( s.data[0] );
+			break;
+		case 'b':
+			db.put( s.data[0] ? "1" : "0" );
+			break;
+		case 'i': {
+			long long n;
+			memcpy(&n, s.data, sizeof(n));
+			db.putSigned( n );
+			break;
+		}
+		case 'u': {
+			unsigned long long n;
+			memcpy(&n, s.data, sizeof(n));
+			db.putUnsigned( n );
+			break;
+		}
+		case 'd': {
+			double d;
+			memcpy(&d, s.data, sizeof(d));
+			db.putDouble( d );
+			break;
+		}
+		case 'p': {
+			const void* pv;
+			memcpy(&pv, s.data, sizeof(pv));
+			db.putHex( (unsigned long long)pv );
+			break;
+		}
+		default:
+			db.put( "<?>" );
+			break;
+		}
+	}
+	if (!isLineStart)
+		db.put('\n');
+}
+
+static void dumpHandler( int signo )
+{
+	BTraceRing::dump( 2 );
+
+	switch (signo) {
+	case SIGSEGV:
+	case SIGBUS:
+	case SIGFPE:
+	case SIGILL:
+	case SIGABRT:
+		// Fatal, carry on to the default action
+		signal( signo, SIG_DFL );
+		raise( signo );
+		break;
+	}
+}
+
+/*: BTraceRing::dumpOnSignal()
+
+  Installs a handler that dumps the rings to stderr when signal signo
+  arrives.  For SIGUSR1 and the like the program then continues.  For
+  fatal signals (SIGSEGV, SIGBUS, SIGFPE, SIGILL and SIGABRT) the
+  default action follows the dump.
+
+  Prototype: static void BTraceRing::dumpOnSignal( int signo )
+*/
+void BTraceRing::dumpOnSignal( int signo )
+{
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = dumpHandler;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_RESTART;
+	sigaction(signo, &sa, 0);
+}
+
+
+BTraceRing& operator<<(BTraceRing& tr, const bw::String& str)
+{
+	tr.putText( str, str.length() );
+	return tr;
+}
+
@@ -11,7 +11,10 @@ Copyright (C) 1997-2013, Brian Bray
 // the users program.
 
 #include "bw/bwassert.h"
+#include "bw/string.h"
 #include "bw/ustring.h"
+#include "bw/utf8.h"
+#include "bw/exception.h"
 
 #include <wctype.h>
 #include <wchar.h>
@@ -50,9 +53,13 @@ const int quantaAlloc=16;
   of formats or give an integer for the initial capacity.
 
   Prototype: UString( const int length=0 )
-  Prototype: UString( const String& str );
+  Prototype: UString( const UString& str );
+  Prototype: explicit UString( const String& str );
   Prototype: UString( const wchar_t* psz );
   Prototype: UString( const wchar_t* ps, const int len );
+
+  The String variant decodes UTF-8 and throws BFormatException if the
+  String is not well formed.
 */
 UString::UString( const int len )
 {
@@ -63,6 +70,8 @@ UString::UString( const int len )
 	bwassert( m_lenMax>len );
 	bwassert( (m_lenMax&15) == 0 );
 	m_pszString = new wchar_t[m_lenMax];
+	m_hash = 0;
+	m_isLent = false;
 	*m_pszString = L'\0';
 }
 
@@ -75,6 +84,8 @@ UString::UString( const UString& str )
 
 	m_lenMax = (len+quantaAlloc) & -quantaAlloc;  // Adds one and rounds up
 	m_pszString = new wchar_t[m_lenMax];
+	m_hash = __atomic_load_n( &str.m_hash, __ATOMIC_RELAXED );
+	m_isLent = false;
 	::wmemcpy( m_pszString, str.m_pszString, len+1 );
 }
 
@@ -89,6 +100,8 @@ UString::UString( const wchar_t* psz)
 	m_lenMax = (len+quantaAlloc) & -quantaAlloc;  // Adds one and rounds up
 
 	m_pszString = new wchar_t[m_lenMax];
+	m_hash = 0;
+	m_isLent = false;
 	::wmemcpy( m_pszString, psz, len+1 );
 }
 
@@ -100,10 +113,29 @@ UString::UString( const wchar_t* ps, const int len )
 
 	m_lenMax = (len+quantaAlloc) & -quantaAlloc;  // Adds one and round up
 	m_pszString = new wchar_t[m_lenMax];
+	m_hash = 0;
+	m_isLent = false;
 	::wmemcpy( m_pszString, ps, len );
 	m_pszString[len] = L'\0';
 }
 
+
+UString::UString( const String& str )
+{
+	int lenIn = str.length();
+	int len = utf8DecodedLength( str, lenIn );
+	if (len<0)
+		throw BFormatException( "Invalid UTF-8 string" );
+	bwassert( len<65536 );       // Reasonableness
+
+	m_lenMax = (len+quantaAlloc) & -quantaAlloc;  // Adds one and round up
+	m_pszString = new wchar_t[m_lenMax];
+	m_hash = 0;
+	m_isLent = false;
+	utf8Decode( str, lenIn, m_pszString );
+	m_pszString[len] = L'\0';
+}
+
 /////////////////////////////////////////////////////////////////////////
 /*: routine UString::~UString
 
@@ -170,6 +202,7 @@ UString& UString::operator=( const wchar_t* psz)
 {
 	bwassert( m_pszString );
 	bwassert( psz );
+	m_hash = 0;
 	if (m_pszString != psz) {	// Handle a=a
 		int len = ::wcslen(psz);
 		bwassert( len>=0 );
@@ -189,6 +222,7 @@ UString& UString::operator=( const wchar_t* psz)
 UString& UString::operator=( wchar_t ch )
 {
 	bwassert( m_pszString );
+	m_hash = 0;
 
 	if (m_lenMax>(maxSpill+1)) {
 		// Need to shorten
@@ -223,6 +257,29 @@ int UString::length() const
 }
 
 
+/////////////////////////////////////////////////////////////////////////
+/*: routine UString::hash()
+
+  Returns a hash of the string contents suitable for hash tables.  The
+  value is computed on first use and cached until the UString is changed.
+  It is never 0.  Several threads may hash the same const UString; the
+  cache is written with a relaxed atomic store, and each computes the
+  same value.  Once operator[] has handed out a modifiable wchar_t& the
+  hash is computed each time, since the caller may write through it
+  later.
+
+  Prototype: unsigned long hash() const inline;
+*/
+unsigned long UString::computeHash() const
+{
+	bwassert( m_pszString );
+	unsigned long h = hashBytes( m_pszString, ::wcslen(m_pszString)*sizeof(wchar_t) );
+	if (!m_isLent)
+		__atomic_store_n( &m_hash, h, __ATOMIC_RELAXED );
+	return h;
+}
+
+
 /////////////////////////////////////////////////////////////////////////
 /*: routine UString::append
 
@@ -236,6 +293,7 @@ int UString::length() const
 void UString::append( const wchar_t* psz)
 {
 	bwassert( m_pszString );
+	m_hash = 0;
 	ensureCapacity( length()+::wcslen( psz ) );
 	::wcscat( m_pszString, psz );
 }
@@ -243,6 +301,7 @@ void UString::append( const wchar_t* psz)
 void UString::append( wchar_t ch )
 {
 	bwassert( m_pszString );
+	m_hash = 0;
 
 	int len = length();
 	ensureCapacity( len+1 );
@@ -484,6 +543,7 @@ UString UString::substring( int start, int end ) const
 void UString::toUpperCase()
 {
 	bwassert( m_pszString );
+	m_hash = 0;
 
 	for (wchar_t *pch = m_pszString; *pch; ++pch)
 		*pch = towupper(*pch);
@@ -497,10 +557,21 @@ void UString::toUpperCase()
 void UString::toLowerCase()
 {
 	bwassert( m_pszString );
+	m_hash = 0;
 
 	for (wchar_t *pch = m_pszString; *pch; ++pch)
 		*pch = towlower(*pch);
 }
 
-}	// namespace bw
+/////////////////////////////////////////////////////////////////////////
+/*: routine UString::toString()
+
+  Returns the UTF-8 encoding of the UString.  Throws BFormatException if
+  the UString holds a surrogate or a character beyond U+10FFFF.
+*/
+String UString::toString() const
+{
+	return String( *this );
+}
 
+}	// namespace bw
@@ -0,0 +1,338 @@
+/* utf8.cc -- UTF-8 <-> UTF-32 (wchar_t) transcoding
+
+Copyright (C) 1997-2013, Brian Bray
+
+*/
+
+//
+// These routines replace mbstowcs()/wcstombs() for String <-> UString
+// conversion.  They don't depend on the C locale and don't need scratch
+// buffers.  Runs of ASCII are by far the most common input, so they are
+// detected and copied 16 (SSE2) or 8 (portable) characters at a time before
+// falling back to the general multibyte code.
+
+#include "bw/bwassert.h"
+#include "bw/utf8.h"
+
+#include <cstring>
+#include <stdint.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace bw {
+
+static_assert( sizeof(wchar_t)==4, "UTF-32 wchar_t is required" );
+
+
+/*: routine utf8DecodedLength
+
+  Validates UTF-8 text and returns the number of wide characters it
+  decodes to.  Overlong forms, surrogates, code points past U+10FFFF and
+  truncated sequences are all rejected.
+
+  Prototype: int utf8DecodedLength( const char* ps, int len )
+
+  Returns: Count of wchar_t's (not including any terminator) or -1 if
+  the input is not well formed.
+*/
+
+/*: routine utf8Decode
+
+  Decodes UTF-8 text into wide (UTF-32) characters.  No terminator is
+  written.
+
+  Prototype: int utf8Decode( const char* ps, int len, wchar_t* pwsOut )
+
+  Returns: Count of wchar_t's written or -1 if the input is not well formed.
+  The output buffer contents are undefined on failure.
+*/
+
+/*: routine utf8EncodedLength
+
+  Returns the number of bytes needed to encode wide characters as UTF-8.
+
+  Prototype: int utf8EncodedLength( const wchar_t* pws, int len )
+
+  Returns: Count of bytes (not including any terminator) or -1 if a
+  character is a surrogate or is out of the unicode range.
+*/
+
+/*: routine utf8Encode
+
+  Encodes wide (UTF-32) characters as UTF-8.  No terminator is written.
+
+  Prototype: int utf8Encode( const wchar_t* pws, int len, char* psOut )
+
+  Returns: Count of bytes written or -1 if a character cannot be encoded.
+  The output buffer contents are undefined on failure.
+*/
+
+
+// Internal routines
+
+// Length of the leading run of ASCII bytes
+static int asciiSpan( const unsigned char* ps, int len )
+{
+	int i = 0;
+#ifdef __SSE2__
+	for (; i+16<=len; i+=16) {
+		int mask = _mm_movemask_epi8( _mm_loadu_si128( (const __m128i*)(ps+i) ) );
+		if (mask)
+			return i + __builtin_ctz(mask);
+	}
+#endif
+	for (; i+8<=len; i+=8) {
+		uint64_t w;
+		::memcpy( &w, ps+i, 8 );
+		if (w & 0x8080808080808080ULL)
+			break;
+	}
+	while (i<len && ps[i]<0x80)
+		++i;
+	return i;
+}
+
+// Copies the leading run of ASCII bytes to wide characters, returns its length
+static int widenAscii( const unsigned char* ps, int len, wchar_t* pws )
+{
+	int i = 0;
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128();
+	for (; i+16<=len; i+=16) {
+		__m128i v = _mm_loadu_si128( (const __m128i*)(ps+i) );
+		if (_mm_movemask_epi8(v))
+			break;
+		__m128i lo = _mm_unpacklo_epi8( v, zero );
+		__m128i hi = _mm_unpackhi_epi8( v, zero );
+		_mm_storeu_si128( (__m128i*)(pws+i),    _mm_unpacklo_epi16(lo,zero) );
+		_mm_storeu_si128( (__m128i*)(pws+i+4),  _mm_unpackhi_epi16(lo,zero) );
+		_mm_storeu_si128( (__m128i*)(pws+i+8),  _mm_unpacklo_epi16(hi,zero) );
+		_mm_storeu_si128( (__m128i*)(pws+i+12), _mm_unpackhi_epi16(hi,zero) );
+	}
+#endif
+	while (i<len && ps[i]<0x80) {
+		pws[i] = ps[i];
+		++i;
+	}
+	return i;
+}
+
+// Length of the leading run of ASCII wide characters
+static int wideAsciiSpan( const wchar_t* pws, int len )
+{
+	int i = 0;
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i high = _mm_set1_epi32( ~0x7F );
+	for (; i+16<=len; i+=16) {
+		__m128i v = _mm_or_si128(
+		                _mm_or_si128( _mm_loadu_si128( (const __m128i*)(pws+i) ),
+		                              _mm_loadu_si128( (const __m128i*)(pws+i+4) ) ),
+		                _mm_or_si128( _mm_loadu_si128( (const __m128i*)(pws+i+8) ),
+		                              _mm_loadu_si128( (const __m128i*)(pws+i+12) ) ) );
+		if (_mm_movemask_epi8( _mm_cmpeq_epi32( _mm_and_si128(v,high), zero ) )!=0xFFFF)
+			break;
+	}
+#endif
+	while (i<len && (uint32_t)pws[i]<0x80)
+		++i;
+	return i;
+}
+
+// Copies the leading run of ASCII wide characters to bytes, returns its length
+static int narrowAscii( const wchar_t* pws, int len, char* ps )
+{
+	int i = 0;
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i high = _mm_set1_epi32( ~0x7F );
+	for (; i+16<=len; i+=16) {
+		__m128i a = _mm_loadu_si128( (const __m128i*)(pws+i) );
+		__m128i b = _mm_loadu_si128( (const __m128i*)(pws+i+4) );
+		__m128i c = _mm_loadu_si128( (const __m128i*)(pws+i+8) );
+		__m128i d = _mm_loadu_si128( (const __m128i*)(pws+i+12) );
+		__m128i v = _mm_or_si128( _mm_or_si128(a,b), _mm_or_si128(c,d) );
+		if (_mm_movemask_epi8( _mm_cmpeq_epi32( _mm_and_si128(v,high), zero ) )!=0xFFFF)
+			break;
+		// All values are <0x80 so the saturating packs are exact
+		_mm_storeu_si128( (__m128i*)(ps+i),
+		                  _mm_packus_epi16( _mm_packs_epi32(a,b), _mm_packs_epi32(c,d) ) );
+	}
+#endif
+	while (i<len && (uint32_t)pws[i]<0x80) {
+		ps[i] = (char)pws[i];
+		++i;
+	}
+	return i;
+}
+
+// Decodes one multibyte sequence, returns bytes consumed or 0 if invalid
+static int decodeSeq( const unsigned char* p, int n, uint32_t& wc )
+{
+	unsigned c = p[0];
+
+	if (c<0xC2)
+		return 0;		// Stray continuation byte or overlong 2 byte form
+	if (c<0xE0) {
+		if (n<2 || (p[1]&0xC0)!=0x80)
+			return 0;
+		wc = ((c&0x1F)<<6) | (p[1]&0x3F);
+		return 2;
+	}
+	if (c<0xF0) {
+		if (n<3 || (p[1]&0xC0)!=0x80 || (p[2]&0xC0)!=0x80)
+			return 0;
+		if (c==0xE0 && p[1]<0xA0)
+			return 0;	// Overlong
+		if (c==0xED && p[1]>=0xA0)
+			return 0;	// Surrogate
+		wc = ((c&0x0F)<<12) | ((p[1]&0x3F)<<6) | (p[2]&0x3F);
+		return 3;
+	}
+	if (c<0xF5) {
+		if (n<4 || (p[1]&0xC0)!=0x80 || (p[2]&0xC0)!=0x80 || (p[3]&0xC0)!=0x80)
+			return 0;
+		if (c==0xF0 && p[1]<0x90)
+			return 0;	// Overlong
+		if (c==0xF4 && p[1]>=0x90)
+			return 0;	// Beyond U+10FFFF
+		wc = ((c&0x07)<<18) | ((p[1]&0x3F)<<12) | ((p[2]&0x3F)<<6) | (p[3]&0x3F);
+		return 4;
+	}
+	return 0;
+}
+
+// Bytes needed to encode one non-ASCII character, 0 if it can't be encoded
+static inline int encodedSize( uint32_t wc )
+{
+	if (wc<0x800)
+		return 2;
+	if (wc<0x10000)
+		return (wc>=0xD800 && wc<0xE000) ? 0 : 3;
+	if (wc<0x110000)
+		return 4;
+	return 0;
+}
+
+
+int utf8DecodedLength( const char* ps, int len )
+{
+	bwassert( ps || len==0 );
+	bwassert( len>=0 );
+
+	const unsigned char* p = (const unsigned char*)ps;
+	int count = 0;
+	int i = 0;
+	uint32_t wc;
+
+	while (i<len) {
+		int n = asciiSpan( p+i, len-i );
+		i += n;
+		count += n;
+		if (i>=len)
+			break;
+		n = decodeSeq( p+i, len-i, wc );
+		if (n==0)
+			return -1;
+		i += n;
+		++count;
+	}
+	return count;
+}
+
+
+int utf8Decode( const char* ps, int len, wchar_t* pwsOut )
+{
+	bwassert( ps || len==0 );
+	bwassert( len>=0 );
+
+	const unsigned char* p = (const unsigned char*)ps;
+	wchar_t* pws = pwsOut;
+	int i = 0;
+	uint32_t wc;
+
+	while (i<len) {
+		int n = widenAscii( p+i, len-i, pws );
+		i += n;
+		pws += n;
+		if (i>=len)
+			break;
+		n = decodeSeq( p+i, len-i, wc );
+		if (n==0)
+			return -1;
+		i += n;
+		*pws++ = (wchar_t)wc;
+	}
+	return pws-pwsOut;
+}
+
+
+int utf8EncodedLength( const wchar_t* pws, int len )
+{
+	bwassert( pws || len==0 );
+	bwassert( len>=0 );
+
+	int count = 0;
+	int i = 0;
+
+	while (i<len) {
+		int n = wideAsciiSpan( pws+i, len-i );
+		i += n;
+		count += n;
+		if (i>=len)
+			break;
+		n = encodedSize( (uint32_t)pws[i] );
+		if (n==0)
+			return -1;
+		++i;
+		count += n;
+	}
+	return count;
+}
+
+
+int utf8Encode( const wchar_t* pws, int len, char* psOut )
+{
+	bwassert( pws || len==0 );
+	bwassert( len>=0 );
+
+	unsigned char* p = (unsigned char*)psOut;
+	int i = 0;
+
+	while (i<len) {
+		int n = narrowAscii( pws+i, len-i, (char*)p );
+		i += n;
+		p += n;
+		if (i>=len)
+			break;
+
+		uint32_t wc = (uint32_t)pws[i++];
+		switch (encodedSize(wc)) {
+		case 2:
+			*p++ = 0xC0 | (wc>>6);
+			*p++ = 0x80 | (wc&0x3F);
+			break;
+
+		case 3:
+			*p++ = 0xE0 | (wc>>12);
+			*p++ = 0x80 | ((wc>>6)&0x3F);
+			*p++ = 0x80 | (wc&0x3F);
+			break;
+
+		case 4:
+			*p++ = 0xF0 | (wc>>18);
+			*p++ = 0x80 | ((wc>>12)&0x3F);
+			*p++ = 0x80 | ((wc>>6)&0x3F);
+			*p++ = 0x80 | (wc&0x3F);
+			break;
+
+		default:
+			return -1;
+		}
+	}
+	return (char*)p-psOut;
+}
+
+}	// namespace bw
@@ -10,12 +10,15 @@ Copyright (C) 1999-2013, Brian Bray
 #include <string>
 #include <map>
 #include <list>
+#include <atomic>
+#include <chrono>
 #include <fstream>
 
 #include "bw/bwassert.h"
-#include "bw/countable.h"
+#include "bw/acountable.h"
 #include "bw/exception.h"
 #include "bw/xml.h"
+#include "bw/metrics.h"
 
 #include <cstring>
 
@@ -265,8 +268,12 @@ XMLDocument::XMLDocument(istream& ist, FileLoc& floc)
 XMLDocument::~XMLDocument()
 {}
 
+static MetricHistogram s_loadTime( "bw_xml_load_seconds", "Time to parse an XMLDocument" );
+
 void XMLDocument::load(NumStream& ist)
 {
+	MetricTimer mt( s_loadTime );
+
 	XMLNodeRef xnr = XMLDecl::found(ist);
 	if (xnr)
 		children().push_back(xnr);